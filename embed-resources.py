@@ -29,7 +29,13 @@ class OsmAndCoreResourcesPacker(object):
         outputFile.write("#include \"EmbeddedResources_private.h\"\n")
         outputFile.write("namespace OsmAnd {\n")
 
+        # Resources are sorted by name (in UTF-16 order, same as QString comparison does),
+        # so that lookup in runtime can use binary search. Sort is stable, so among duplicate
+        # names the first one listed still wins
+        resources = sorted(resources, key=lambda resource: resource[1].encode("utf-16-be"))
+
         # For each resource in collection, pack it
+        resourcesCompression = []
         for (idx, resource) in enumerate(resources):
             originalSize = os.path.getsize(resource[0])
             with open(resource[0], "rb") as resourceFile:
@@ -38,15 +44,23 @@ class OsmAndCoreResourcesPacker(object):
             packedContent = zlib.compress(resourceContent, 9)
             packedSize = len(packedContent)
 
+            # Already compressed content (like PNG) is stored as-is, so it can be accessed without copying
+            isCompressed = (packedSize + 4 < originalSize) or (originalSize == 0)
+            if not isCompressed:
+                packedContent = resourceContent
+                packedSize = originalSize
+            resourcesCompression.append(isCompressed)
+
             outputFile.write("\tstatic const QString __bundled_resource_name_%d = \"%s\";\n" % (idx, resource[1]))
             outputFile.write("\tstatic const uint8_t __bundled_resource_data_%d[] = {\n" % (idx))
 
-            # Write size header
-            outputFile.write("\t\t0x%02x, 0x%02x, 0x%02x, 0x%02x," % (
-                (originalSize >> 24)&0xff,
-                (originalSize >> 16)&0xff,
-                (originalSize >>  8)&0xff,
-                (originalSize >>  0)&0xff))
+            # Write size header (expected by qUncompress)
+            if isCompressed:
+                outputFile.write("\t\t0x%02x, 0x%02x, 0x%02x, 0x%02x," % (
+                    (originalSize >> 24)&0xff,
+                    (originalSize >> 16)&0xff,
+                    (originalSize >>  8)&0xff,
+                    (originalSize >>  0)&0xff))
 
             # Write content
             for (byteIdx, byteValue) in enumerate(packedContent):
@@ -55,15 +69,19 @@ class OsmAndCoreResourcesPacker(object):
                 outputFile.write("0x%02x, " % (byteValue))
             outputFile.write("\n")
             outputFile.write("\t};\n")
-            outputFile.write("\tconst size_t __bundled_resource_size_%d = 4 + %d;\n" % (idx, packedSize))
-
-            print("Packed '%s'(%d bytes) as '%s'(4+%d bytes)..." % (resource[0], originalSize, resource[1], packedSize))
+            if isCompressed:
+                outputFile.write("\tconst size_t __bundled_resource_size_%d = 4 + %d;\n" % (idx, packedSize))
+                print("Packed '%s'(%d bytes) as '%s'(4+%d bytes)..." % (resource[0], originalSize, resource[1], packedSize))
+            else:
+                outputFile.write("\tconst size_t __bundled_resource_size_%d = %d;\n" % (idx, packedSize))
+                print("Stored '%s'(%d bytes) as '%s'..." % (resource[0], originalSize, resource[1]))
            
 
         # For each resource in collection, fill information about it
         outputFile.write("\tconst OsmAnd::EmbeddedResource __bundled_resources[] = {\n")
         for (idx, resource) in enumerate(resources):
-            outputFile.write("\t\t{ __bundled_resource_name_%d, __bundled_resource_size_%d, &__bundled_resource_data_%d[0] },\n" % (idx, idx, idx))
+            outputFile.write("\t\t{ __bundled_resource_name_%d, __bundled_resource_size_%d, &__bundled_resource_data_%d[0], %s },\n" % (idx, idx, idx,
+                "true" if resourcesCompression[idx] else "false"))
         outputFile.write("\t};\n")
 
         # Write footer of the file and close it
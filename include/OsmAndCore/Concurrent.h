@@ -27,13 +27,16 @@
 #include <functional>
 
 #include <OsmAndCore/QtExtensions.h>
-#include <QThreadPool>
+#include <QThread>
 #include <QEventLoop>
 #include <QRunnable>
 #include <QWaitCondition>
 #include <QReadWriteLock>
 #include <QMutex>
 #include <QAtomicInt>
+#include <QElapsedTimer>
+#include <QString>
+#include <QList>
 
 #include <OsmAndCore.h>
 #include <OsmAndCore/CommonTypes.h>
@@ -42,6 +45,86 @@ namespace OsmAnd {
 
     namespace Concurrent {
 
+        class Thread;
+
+        // Pool of worker threads. Each worker owns a deque of tasks: tasks started from worker thread go to
+        // its own deque, other tasks go to shared queue. Idle workers take tasks from shared queue first
+        // and then steal from deques of other workers.
+        class OSMAND_CORE_API WorkersPool
+        {
+            Q_DISABLE_COPY(WorkersPool);
+        public:
+            struct Statistics
+            {
+                Statistics();
+
+                unsigned int threadsCount;
+                unsigned int queueLength;
+                unsigned int activeTasksCount;
+                uint64_t executedTasksCount;
+                uint64_t stolenTasksCount;
+
+                // In seconds
+                double averageWaitTime;
+                double maxWaitTime;
+                double averageExecutionTime;
+            };
+
+        private:
+            class Worker;
+            struct PendingTask
+            {
+                QRunnable* runnable;
+                qint64 enqueueTime;
+            };
+
+            mutable QMutex _mutex;
+            QWaitCondition _hasWorkCondition;
+            QWaitCondition _isIdleCondition;
+            QList<PendingTask> _sharedQueue;
+            QList< std::shared_ptr<Worker> > _workers;
+            unsigned int _threadsCount;
+            QThread::Priority _priority;
+            volatile bool _isAlive;
+            QAtomicInt _queuedTasksCount;
+            QAtomicInt _activeTasksCount;
+            QElapsedTimer _clock;
+
+            mutable QMutex _statisticsMutex;
+            uint64_t _executedTasksCount;
+            uint64_t _stolenTasksCount;
+            qint64 _totalWaitTime;
+            qint64 _maxWaitTime;
+            qint64 _totalExecutionTime;
+
+            void adjustWorkers();
+            std::shared_ptr<Worker> getCurrentWorker() const;
+            bool obtainTask(Worker* const worker, PendingTask& outTask);
+            void executeTask(const PendingTask& task);
+            void workerThreadProcedure(Worker* const worker);
+        protected:
+        public:
+            WorkersPool(const QString& name, const unsigned int threadsCount, const QThread::Priority priority = QThread::NormalPriority);
+            virtual ~WorkersPool();
+
+            const QString name;
+
+            unsigned int getThreadsCount() const;
+            void setThreadsCount(const unsigned int threadsCount);
+            QThread::Priority getPriority() const;
+            void setPriority(const QThread::Priority priority);
+
+            // Same semantics as QThreadPool::start(): runnable is deleted after execution if it's auto-deletable
+            void start(QRunnable* const runnable);
+            bool waitForDone(const int msecs = -1);
+
+            // Task running on this pool must not block waiting for other tasks of this pool, since all workers may be waiting
+            bool isCurrentThreadWorker() const;
+
+            Statistics getStatistics() const;
+            void resetStatistics();
+        };
+
         class OSMAND_CORE_API Pools
         {
             Q_DISABLE_COPY(Pools);
@@ -53,8 +136,17 @@ namespace OsmAnd {
 
             static const std::shared_ptr<Pools> instance;
 
-            const std::unique_ptr<QThreadPool> localStorage;
-            const std::unique_ptr<QThreadPool> network;
+            // Reading/writing local files
+            const std::unique_ptr<WorkersPool> localStorage;
+            // Network requests
+            const std::unique_ptr<WorkersPool> network;
+            // Obtaining map renderer resources (tiles decoding and rasterization)
+            const std::unique_ptr<WorkersPool> mapResources;
+            // Route calculations
+            const std::unique_ptr<WorkersPool> routing;
+
+            WorkersPool* getPool(const QString& name) const;
+            QList<WorkersPool*> getAllPools() const;
         };
         const extern OSMAND_CORE_API std::shared_ptr<Pools> pools;
 
@@ -35,6 +35,7 @@
 
 namespace OsmAnd {
 
+    class ObfInfoCache;
     class ObfAddressSectionReader_P;
     class ObfReader_P;
     class ObfAddressBlocksSectionInfo;
@@ -57,6 +58,7 @@ namespace OsmAnd {
 
         friend class OsmAnd::ObfAddressSectionReader_P;
         friend class OsmAnd::ObfReader_P;
+        friend class OsmAnd::ObfInfoCache;
     };
 
     class OSMAND_CORE_API ObfAddressBlocksSectionInfo : public ObfSectionInfo
@@ -74,6 +76,7 @@ namespace OsmAnd {
 
         friend class OsmAnd::ObfAddressSectionReader_P;
         friend class OsmAnd::ObfReader_P;
+        friend class OsmAnd::ObfInfoCache;
     };
 
 } // namespace OsmAnd
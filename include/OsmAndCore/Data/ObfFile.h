@@ -35,6 +35,7 @@ namespace OsmAnd {
 
     class ObfInfo;
     class ObfReader;
+    class ObfsCollection_P;
 
     class ObfFile_P;
     class OSMAND_CORE_API ObfFile
@@ -52,6 +53,7 @@ namespace OsmAnd {
         const std::shared_ptr<ObfInfo>& obfInfo;
 
     friend class OsmAnd::ObfReader;
+    friend class OsmAnd::ObfsCollection_P;
     };
 
 } // namespace OsmAnd
@@ -26,6 +26,7 @@
 #include <OsmAndCore/stdlib_common.h>
 
 #include <OsmAndCore/QtExtensions.h>
+#include <QString>
 #include <QList>
 
 #include <OsmAndCore.h>
@@ -34,6 +35,7 @@ class QIODevice;
 
 namespace OsmAnd {
 
+    class ObfInfoCache;
     class ObfReader;
     class ObfReader_P;
 
@@ -53,6 +55,7 @@ namespace OsmAnd {
         int _version;
         uint64_t _creationTimestamp;
         bool _isBasemap;
+        QString _filePath;
 
         QList< std::shared_ptr<ObfMapSectionInfo> > _mapSections;
         QList< std::shared_ptr<ObfAddressSectionInfo> > _addressSections;
@@ -65,6 +68,8 @@ namespace OsmAnd {
         const int& version;
         const uint64_t& creationTimestamp;
         const bool& isBasemap;
+        // File this information was read from. Empty if it was read from other kind of device
+        const QString& filePath;
 
         const QList< std::shared_ptr<ObfMapSectionInfo> >& mapSections;
         const QList< std::shared_ptr<ObfAddressSectionInfo> >& addressSections;
@@ -74,6 +79,7 @@ namespace OsmAnd {
 
     friend class OsmAnd::ObfReader;
     friend class OsmAnd::ObfReader_P;
+    friend class OsmAnd::ObfInfoCache;
     };
 
 } // namespace OsmAnd
@@ -37,6 +37,7 @@
 
 namespace OsmAnd {
 
+    class ObfInfoCache;
     class ObfMapSectionReader_P;
     class ObfReader_P;
 
@@ -67,6 +68,7 @@ namespace OsmAnd {
         const AreaI& area31;
 
     friend class OsmAnd::ObfMapSectionReader_P;
+    friend class OsmAnd::ObfInfoCache;
     };
 
     struct ObfMapSectionDecodingRule
@@ -126,6 +128,7 @@ namespace OsmAnd {
 
     friend class OsmAnd::ObfMapSectionReader_P;
     friend class OsmAnd::ObfReader_P;
+    friend class OsmAnd::ObfInfoCache;
     };
 
 } // namespace OsmAnd
@@ -33,6 +33,7 @@
 
 namespace OsmAnd {
 
+    class ObfInfoCache;
     class ObfPoiSectionReader_P;
     class ObfReader_P;
 
@@ -51,6 +52,7 @@ namespace OsmAnd {
 
         friend class OsmAnd::ObfPoiSectionReader_P;
         friend class OsmAnd::ObfReader_P;
+        friend class OsmAnd::ObfInfoCache;
     };
 
 } // namespace OsmAnd
@@ -59,6 +59,10 @@ namespace OsmAnd {
 
         std::shared_ptr<ObfInfo> obtainInfo() const;
 
+        // Creates reader of the same file with own input, so both can be used on different threads at the same time.
+        // Information that is already read is shared. Returns nullptr if input of this reader is not a file.
+        std::shared_ptr<ObfReader> createSiblingReader() const;
+
     friend class OsmAnd::ObfMapSectionReader;
     friend class OsmAnd::ObfAddressSectionReader;
     friend class OsmAnd::ObfRoutingSectionReader;
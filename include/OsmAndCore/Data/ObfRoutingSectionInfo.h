@@ -35,6 +35,7 @@
 
 namespace OsmAnd {
 
+    class ObfInfoCache;
     class ObfRoutingSectionReader_P;
     class ObfReader_P;
     class ObfRoutingSubsectionInfo;
@@ -68,6 +69,7 @@ namespace OsmAnd {
     friend class OsmAnd::RoutePlanner;
     friend class OsmAnd::RoutePlannerContext;
     friend class OsmAnd::RoutingRulesetContext;
+    friend class OsmAnd::ObfInfoCache;
     };
 
     class OSMAND_CORE_API ObfRoutingSubsectionInfo : public ObfSectionInfo
@@ -94,6 +96,7 @@ namespace OsmAnd {
 
     friend class OsmAnd::ObfRoutingSectionReader_P;
     friend class OsmAnd::ObfReader_P;
+    friend class OsmAnd::ObfInfoCache;
     };
 
     class OSMAND_CORE_API ObfRoutingBorderLineHeader
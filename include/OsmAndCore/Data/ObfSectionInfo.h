@@ -33,6 +33,7 @@
 
 namespace OsmAnd {
 
+    class ObfInfoCache;
     class ObfInfo;
     class ObfReader;
     class ObfReader_P;
@@ -60,6 +61,7 @@ namespace OsmAnd {
 
     friend class OsmAnd::ObfReader;
     friend class OsmAnd::ObfReader_P;
+    friend class OsmAnd::ObfInfoCache;
     };
 
 } // namespace OsmAnd
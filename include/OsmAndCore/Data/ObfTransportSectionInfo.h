@@ -33,6 +33,7 @@
 
 namespace OsmAnd {
 
+    class ObfInfoCache;
     class ObfTransportSectionReader_P;
     class ObfReader_P;
 
@@ -54,6 +55,7 @@ namespace OsmAnd {
 
         friend class OsmAnd::ObfTransportSectionReader_P;
         friend class OsmAnd::ObfReader_P;
+        friend class OsmAnd::ObfInfoCache;
     };
 
 } // namespace OsmAnd
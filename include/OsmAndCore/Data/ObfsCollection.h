@@ -47,11 +47,17 @@ namespace OsmAnd {
         ObfsCollection();
         virtual ~ObfsCollection();
 
+        // Sources are collected on first request of data interface. Later changes of watched collection,
+        // and of watched directories on platforms that support it, are applied in background
         void watchDirectory(const QDir& dir, bool recursive = true);
         void watchDirectory(const QString& dirPath, bool recursive = true);
         void registerExplicitFile(const QFileInfo& fileInfo);
         void registerExplicitFile(const QString& filePath);
 
+        // Parsed headers of OBF files are stored in given directory and reused until file changes
+        void setInfoCacheDirectory(const QDir& dir);
+        void setInfoCacheDirectory(const QString& dirPath);
+
         std::shared_ptr<ObfDataInterface> obtainDataInterface() const;
     };
 
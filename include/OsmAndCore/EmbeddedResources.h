@@ -42,6 +42,8 @@ namespace OsmAnd {
         virtual ~EmbeddedResources();
 
         static QByteArray decompressResource(const QString& name, bool* ok = nullptr);
+
+        // Returns resource data exactly as it is stored (compressed or not), without copying it
         static QByteArray getRawResource(const QString& name, bool* ok = nullptr);
         static bool containsResource(const QString& name);
     };
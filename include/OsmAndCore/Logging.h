@@ -16,11 +16,51 @@ namespace OsmAnd
         Info
     };
 
+    // Values of levels do not follow their verbosity, so levels are compared by rank:
+    // Error (1) < Warning (2) < Info (3) < Debug (4)
+    inline int GetLogSeverityLevelVerbosity(const LogSeverityLevel level)
+    {
+        return
+            (level == LogSeverityLevel::Error) ? 1 :
+            (level == LogSeverityLevel::Warning) ? 2 :
+            (level == LogSeverityLevel::Info) ? 3 :
+            4;
+    }
+
+    // Messages are formatted by calling thread and queued, actual output is performed by separate writer thread.
+    // If queue is full, message is dropped and counted.
     OSMAND_CORE_API void OSMAND_CORE_CALL LogPrintf(LogSeverityLevel level, const char* format, ...);
+    // Waits until all messages queued so far are written, and flushes outputs
     OSMAND_CORE_API void OSMAND_CORE_CALL LogFlush();
 
+    // Messages more verbose than threshold are discarded before being formatted
+    OSMAND_CORE_API void OSMAND_CORE_CALL SetLogSeverityLevelThreshold(const LogSeverityLevel threshold);
+    OSMAND_CORE_API LogSeverityLevel OSMAND_CORE_CALL GetLogSeverityLevelThreshold();
+    OSMAND_CORE_API bool OSMAND_CORE_CALL IsLogSeverityLevelEnabled(const LogSeverityLevel level);
+
+    // Total number of messages that were dropped due to full queue
+    OSMAND_CORE_API unsigned int OSMAND_CORE_CALL GetDroppedLogMessagesCount();
+
     OSMAND_CORE_API void OSMAND_CORE_CALL SaveLogsTo(const std::shared_ptr<QIODevice>& outputDevice, const bool autoClose = false);
     OSMAND_CORE_API void OSMAND_CORE_CALL StopSavingLogs();
 }
 
+// Messages with verbosity rank (see GetLogSeverityLevelVerbosity()) above this one are removed at compile time
+// when logged using OSMAND_LOG(). By default all levels are compiled in
+#if !defined(OSMAND_LOG_SEVERITY_LEVEL_COMPILE_THRESHOLD)
+#   define OSMAND_LOG_SEVERITY_LEVEL_COMPILE_THRESHOLD 4
+#endif
+
+// Arguments are not evaluated at all if level is disabled
+#define OSMAND_LOG(level, ...)                                                                                  \
+    do                                                                                                          \
+    {                                                                                                           \
+        if(OsmAnd::GetLogSeverityLevelVerbosity(OsmAnd::LogSeverityLevel::level) <=                             \
+                OSMAND_LOG_SEVERITY_LEVEL_COMPILE_THRESHOLD &&                                                  \
+            OsmAnd::IsLogSeverityLevelEnabled(OsmAnd::LogSeverityLevel::level))                                 \
+        {                                                                                                       \
+            OsmAnd::LogPrintf(OsmAnd::LogSeverityLevel::level, __VA_ARGS__);                                    \
+        }                                                                                                       \
+    } while(0)
+
 #endif // _OSMAND_CORE_LOGGING_H_
@@ -25,8 +25,6 @@
 #include <OsmAndCore/stdlib_common.h>
 
 #include <OsmAndCore/QtExtensions.h>
-#include <QString>
-#include <QDir>
 
 #include <OsmAndCore.h>
 #include <OsmAndCore/CommonTypes.h>
@@ -35,23 +33,35 @@
 
 namespace OsmAnd {
 
+    class IMapElevationDataProvider;
+
+    // Produces shaded relief overlay from elevation data. Each pixel is black with opacity
+    // equal to the amount of shade, computed using Horn's method for slope and aspect.
     class HillshadeTileProvider_P;
     class OSMAND_CORE_API HillshadeTileProvider : public IMapBitmapTileProvider
     {
         Q_DISABLE_COPY(HillshadeTileProvider);
     private:
-        const std::unique_ptr<HillshadeTileProvider> _d;
+        const std::unique_ptr<HillshadeTileProvider_P> _d;
     protected:
     public:
-        HillshadeTileProvider(const QDir& storagePath);
+        HillshadeTileProvider(const std::shared_ptr<IMapElevationDataProvider>& elevationDataProvider,
+            const uint32_t tileSize = 256, const unsigned int cacheSize = 128);
         virtual ~HillshadeTileProvider();
 
-        const QDir storagePath;
-        
-        void setIndexFilePath(const QString& indexFilePath);
-        const QString& indexFilePath;
+        const std::shared_ptr<IMapElevationDataProvider> elevationDataProvider;
+        const uint32_t tileSize;
+        // Maximal number of hillshade tiles kept in memory
+        const unsigned int cacheSize;
+
+        // Azimuth is measured in degrees clockwise from north, altitude in degrees above horizon
+        void setLightDirection(const float azimuth, const float altitude);
+        const float& lightAzimuth;
+        const float& lightAltitude;
 
-        void rebuildIndex();
+        // Vertical exaggeration of elevation data
+        void setZFactor(const float zFactor);
+        const float& zFactor;
 
         virtual float getTileDensity() const;
         virtual uint32_t getTileSize() const;
@@ -61,4 +71,4 @@ namespace OsmAnd {
 
 }
 
-#endif // _OSMAND_CORE_HILLSHADE_TILE_PROVIDER_H_
\ No newline at end of file
+#endif // _OSMAND_CORE_HILLSHADE_TILE_PROVIDER_H_
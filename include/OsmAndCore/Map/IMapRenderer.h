@@ -27,6 +27,8 @@
 
 #include <OsmAndCore/QtExtensions.h>
 #include <QSet>
+#include <QMap>
+#include <QList>
 
 #include <OsmAndCore.h>
 #include <OsmAndCore/CommonTypes.h>
@@ -102,6 +104,9 @@ namespace OsmAnd {
 
         virtual float getReferenceTileSizeOnScreen() = 0;
         virtual float getScaledTileSizeOnScreen() = 0;
+        // Tiles that requested state makes visible, grouped by zoom level. Only CPU is involved,
+        // so this works even if rendering was not initialized
+        virtual bool obtainVisibleTileset(QMap< ZoomLevel, QList<TileId> >& outVisibleTiles) = 0;
         //NOTE: screen points origin from top-left
         virtual bool getLocationFromScreenPoint(const PointI& screenPoint, PointI& location31) = 0;
         virtual bool getLocationFromScreenPoint(const PointI& screenPoint, PointI64& location) = 0;
@@ -0,0 +1,59 @@
+/**
+* @file
+*
+* @section LICENSE
+*
+* OsmAnd - Android navigation software based on OSM maps.
+* Copyright (C) 2010-2013  OsmAnd Authors listed in AUTHORS file
+*
+* This program is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+
+* You should have received a copy of the GNU General Public License
+* along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef _OSMAND_CORE_I_ONLINE_TILES_CACHE_H_
+#define _OSMAND_CORE_I_ONLINE_TILES_CACHE_H_
+
+#include <OsmAndCore/stdlib_common.h>
+
+#include <OsmAndCore/QtExtensions.h>
+#include <QByteArray>
+
+#include <OsmAndCore.h>
+#include <OsmAndCore/CommonTypes.h>
+
+namespace OsmAnd
+{
+    // Local storage of tiles downloaded by online tile providers.
+    // Implementations must allow concurrent calls from several threads.
+    class OSMAND_CORE_API IOnlineTilesCache
+    {
+        Q_DISABLE_COPY(IOnlineTilesCache);
+    private:
+    protected:
+        IOnlineTilesCache();
+    public:
+        virtual ~IOnlineTilesCache();
+
+        // Returns true if tile is known to cache, without reading its data or marking it as used
+        virtual bool containsTileData(const TileId tileId, const ZoomLevel zoom);
+
+        // Returns true if tile is known to cache. Empty data means that tile is known to not exist
+        virtual bool obtainTileData(const TileId tileId, const ZoomLevel zoom, QByteArray& outData) = 0;
+
+        // Stores tile data. Empty data marks tile as non-existent
+        virtual bool storeTileData(const TileId tileId, const ZoomLevel zoom, const QByteArray& data) = 0;
+    };
+
+} // namespace OsmAnd
+
+#endif // _OSMAND_CORE_I_ONLINE_TILES_CACHE_H_
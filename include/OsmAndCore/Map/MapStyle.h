@@ -59,7 +59,7 @@ namespace OsmAnd {
     private:
         const std::unique_ptr<MapStyle_P> _d;
     protected:
-        MapStyle(MapStyles* styles, const QString& resourcePath, const bool isEmbedded);
+        MapStyle(MapStyles* styles, const QString& resourcePath, const bool isEmbedded, const bool isCompiled = false);
 
         QString _name;
     public:
@@ -69,6 +69,7 @@ namespace OsmAnd {
 
         const QString resourcePath;
         const bool isEmbedded;
+        const bool isCompiled;
 
         const QString& title;
 
@@ -84,6 +85,11 @@ namespace OsmAnd {
         void dump(const QString& prefix = QString()) const;
         void dump(MapStyleRulesetType type, const QString& prefix = QString()) const;
 
+        // Writes fully resolved style (with all inherited rules merged) as a compact binary image,
+        // that can be later registered via MapStyles::registerCompiledStyle() without parsing any XML.
+        // Only style obtained via MapStyles::obtainStyle() can be compiled
+        bool saveCompiled(const QString& filePath) const;
+
         static std::shared_ptr<const MapStyleBuiltinValueDefinitions> getBuiltinValueDefinitions();
 
     friend class OsmAnd::MapStyles;
@@ -48,6 +48,8 @@ namespace OsmAnd {
         virtual ~MapStyles();
 
         bool registerStyle(const QString& filePath);
+        // Compiled style replaces registered source style with the same name, if that was not obtained yet
+        bool registerCompiledStyle(const QString& filePath);
         bool obtainStyle(const QString& name, std::shared_ptr<const OsmAnd::MapStyle>& outStyle);
 
     friend class OsmAnd::MapStyle;
@@ -37,6 +37,7 @@
 namespace OsmAnd {
 
     class OfflineMapDataProvider;
+    class RasterizationSurfacesPool;
     class OfflineMapRasterTileProvider_Software_P;
     class OSMAND_CORE_API OfflineMapRasterTileProvider_Software : public IMapBitmapTileProvider
     {
@@ -45,10 +46,15 @@ namespace OsmAnd {
         const std::unique_ptr<OfflineMapRasterTileProvider_Software_P> _d;
     protected:
     public:
-        OfflineMapRasterTileProvider_Software(const std::shared_ptr<OfflineMapDataProvider>& dataProvider, const uint32_t outputTileSize = 256, const float density = 1.0f);
+        OfflineMapRasterTileProvider_Software(
+            const std::shared_ptr<OfflineMapDataProvider>& dataProvider,
+            const uint32_t outputTileSize = 256,
+            const float density = 1.0f,
+            const std::shared_ptr<RasterizationSurfacesPool>& surfacesPool = nullptr);
         virtual ~OfflineMapRasterTileProvider_Software();
 
         const std::shared_ptr<OfflineMapDataProvider> dataProvider;
+        const std::shared_ptr<RasterizationSurfacesPool> surfacesPool;
 
         virtual float getTileDensity() const;
         virtual uint32_t getTileSize() const;
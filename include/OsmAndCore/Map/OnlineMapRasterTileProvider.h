@@ -27,6 +27,7 @@
 #include <OsmAndCore/QtExtensions.h>
 #include <QString>
 #include <QDir>
+#include <QSet>
 
 #include <OsmAndCore.h>
 #include <OsmAndCore/CommonTypes.h>
@@ -35,6 +36,8 @@
 
 namespace OsmAnd {
 
+    class IOnlineTilesCache;
+
     class OnlineMapRasterTileProvider_P;
     class OSMAND_CORE_API OnlineMapRasterTileProvider : public IMapBitmapTileProvider
     {
@@ -57,12 +60,24 @@ namespace OsmAnd {
         const uint32_t providerTileSize;
         const AlphaChannelData alphaChannelData;
 
+        // Switches to per-file local cache located at given path
         void setLocalCachePath(const QDir& localCachePath);
         const QDir& localCachePath;
 
+        // Sets local cache backend. Null cache disables local caching
+        void setLocalCache(const std::shared_ptr<IOnlineTilesCache>& localCache);
+        std::shared_ptr<IOnlineTilesCache> getLocalCache() const;
+
         void setNetworkAccessPermission(bool allowed);
         const bool& networkAccessAllowed;
 
+        // Enables prefetching of neighbours of each downloaded tile into local cache
+        void setNeighboursPrefetch(bool enabled);
+        const bool& neighboursPrefetchEnabled;
+
+        // Cancels downloads of tiles on given zoom, that are not in given set (e.g. tiles that left the view)
+        void cancelDownloadsExcept(const QSet<TileId>& tiles, const ZoomLevel zoom);
+
         virtual float getTileDensity() const;
         virtual uint32_t getTileSize() const;
 
@@ -0,0 +1,86 @@
+/**
+* @file
+*
+* @section LICENSE
+*
+* OsmAnd - Android navigation software based on OSM maps.
+* Copyright (C) 2010-2013  OsmAnd Authors listed in AUTHORS file
+*
+* This program is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+
+* You should have received a copy of the GNU General Public License
+* along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+#ifndef _OSMAND_CORE_ONLINE_TILES_DOWNLOADER_H_
+#define _OSMAND_CORE_ONLINE_TILES_DOWNLOADER_H_
+
+#include <OsmAndCore/stdlib_common.h>
+#include <functional>
+
+#include <OsmAndCore/QtExtensions.h>
+#include <QString>
+#include <QUrl>
+#include <QSet>
+#include <QByteArray>
+
+#include <OsmAndCore.h>
+#include <OsmAndCore/CommonTypes.h>
+
+namespace OsmAnd
+{
+    class IQueryController;
+
+    // Event-driven downloader of tiles from single URL pattern. All requests are served by one
+    // network thread, so connections to each host are kept alive and reused between tiles.
+    // Requests for the same tile are coalesced, requested tiles are downloaded before prefetched ones.
+    class OnlineTilesDownloader_P;
+    class OSMAND_CORE_API OnlineTilesDownloader
+    {
+        Q_DISABLE_COPY(OnlineTilesDownloader);
+    public:
+        STRONG_ENUM(Result)
+        {
+            Downloaded,
+            NotFound,
+            Failed,
+            Cancelled,
+        };
+        typedef std::function<void (const TileId tileId, const ZoomLevel zoom, const Result result, const QByteArray& data)> PrefetchCallback;
+    private:
+        const std::unique_ptr<OnlineTilesDownloader_P> _d;
+    protected:
+    public:
+        OnlineTilesDownloader(const QString& urlPattern, const uint32_t maxConcurrentDownloads = 1,
+            const QString& userAgent = QLatin1String("OsmAnd Core"));
+        virtual ~OnlineTilesDownloader();
+
+        const QString urlPattern;
+        // Maximal number of requests being downloaded at the same time, 0 means unlimited
+        const uint32_t maxConcurrentDownloads;
+        const QString userAgent;
+
+        QUrl getTileUrl(const TileId tileId, const ZoomLevel zoom) const;
+
+        // Blocks until tile is downloaded. Waiting stops with Result::Cancelled once controller is aborted
+        Result download(const TileId tileId, const ZoomLevel zoom, QByteArray& outData, const IQueryController* const controller = nullptr);
+
+        // Queues tile with low priority. Callback is invoked from network thread, unless someone
+        // requested same tile using download() meanwhile. Returns false if tile is already being downloaded
+        bool prefetch(const TileId tileId, const ZoomLevel zoom, const PrefetchCallback callback);
+
+        void cancel(const TileId tileId, const ZoomLevel zoom);
+        void cancelAllExcept(const QSet<TileId>& tiles, const ZoomLevel zoom);
+        void cancelAll();
+    };
+
+} // namespace OsmAnd
+
+#endif // _OSMAND_CORE_ONLINE_TILES_DOWNLOADER_H_
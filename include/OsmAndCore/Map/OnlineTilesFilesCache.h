@@ -0,0 +1,57 @@
+/**
+* @file
+*
+* @section LICENSE
+*
+* OsmAnd - Android navigation software based on OSM maps.
+* Copyright (C) 2010-2013  OsmAnd Authors listed in AUTHORS file
+*
+* This program is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+
+* You should have received a copy of the GNU General Public License
+* along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef _OSMAND_CORE_ONLINE_TILES_FILES_CACHE_H_
+#define _OSMAND_CORE_ONLINE_TILES_FILES_CACHE_H_
+
+#include <OsmAndCore/stdlib_common.h>
+
+#include <OsmAndCore/QtExtensions.h>
+#include <QDir>
+
+#include <OsmAndCore.h>
+#include <OsmAndCore/CommonTypes.h>
+#include <OsmAndCore/Map/IOnlineTilesCache.h>
+
+namespace OsmAnd
+{
+    // Stores each tile as separate 'zoom/x/y.tile' file, non-existent tiles are stored as empty files
+    class OSMAND_CORE_API OnlineTilesFilesCache : public IOnlineTilesCache
+    {
+        Q_DISABLE_COPY(OnlineTilesFilesCache);
+    private:
+    protected:
+        QString getTileFilename(const TileId tileId, const ZoomLevel zoom) const;
+    public:
+        OnlineTilesFilesCache(const QDir& path);
+        virtual ~OnlineTilesFilesCache();
+
+        const QDir path;
+
+        virtual bool containsTileData(const TileId tileId, const ZoomLevel zoom);
+        virtual bool obtainTileData(const TileId tileId, const ZoomLevel zoom, QByteArray& outData);
+        virtual bool storeTileData(const TileId tileId, const ZoomLevel zoom, const QByteArray& data);
+    };
+
+} // namespace OsmAnd
+
+#endif // _OSMAND_CORE_ONLINE_TILES_FILES_CACHE_H_
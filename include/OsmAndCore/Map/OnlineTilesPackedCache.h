@@ -0,0 +1,70 @@
+/**
+* @file
+*
+* @section LICENSE
+*
+* OsmAnd - Android navigation software based on OSM maps.
+* Copyright (C) 2010-2013  OsmAnd Authors listed in AUTHORS file
+*
+* This program is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+
+* You should have received a copy of the GNU General Public License
+* along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef _OSMAND_CORE_ONLINE_TILES_PACKED_CACHE_H_
+#define _OSMAND_CORE_ONLINE_TILES_PACKED_CACHE_H_
+
+#include <OsmAndCore/stdlib_common.h>
+
+#include <OsmAndCore/QtExtensions.h>
+#include <QDir>
+
+#include <OsmAndCore.h>
+#include <OsmAndCore/CommonTypes.h>
+#include <OsmAndCore/Map/IOnlineTilesCache.h>
+
+namespace OsmAnd
+{
+    // Stores all tiles in single append-only pack file, that is read and written through memory mapping.
+    // Location of each tile is kept in memory and persisted to index file on flush(), on destruction
+    // and periodically while tiles are stored.
+    // If size limit is set, least recently used tiles are evicted. Pack is compacted in background once
+    // it contains more evicted (or overwritten) data than live data.
+    class OnlineTilesPackedCache_P;
+    class OSMAND_CORE_API OnlineTilesPackedCache : public IOnlineTilesCache
+    {
+        Q_DISABLE_COPY(OnlineTilesPackedCache);
+    private:
+        const std::unique_ptr<OnlineTilesPackedCache_P> _d;
+    protected:
+    public:
+        OnlineTilesPackedCache(const QDir& path, const uint64_t sizeLimit = 0);
+        virtual ~OnlineTilesPackedCache();
+
+        const QDir path;
+        // Maximal size of live data in bytes, 0 means unlimited
+        const uint64_t sizeLimit;
+
+        uint64_t getSize() const;
+        unsigned int getTilesCount() const;
+
+        bool flush();
+        bool compact();
+
+        virtual bool containsTileData(const TileId tileId, const ZoomLevel zoom);
+        virtual bool obtainTileData(const TileId tileId, const ZoomLevel zoom, QByteArray& outData);
+        virtual bool storeTileData(const TileId tileId, const ZoomLevel zoom, const QByteArray& data);
+    };
+
+} // namespace OsmAnd
+
+#endif // _OSMAND_CORE_ONLINE_TILES_PACKED_CACHE_H_
@@ -0,0 +1,87 @@
+/**
+* @file
+*
+* @section LICENSE
+*
+* OsmAnd - Android navigation software based on OSM maps.
+* Copyright (C) 2010-2013  OsmAnd Authors listed in AUTHORS file
+*
+* This program is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+
+* You should have received a copy of the GNU General Public License
+* along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef _OSMAND_CORE_RASTERIZATION_SURFACES_POOL_H_
+#define _OSMAND_CORE_RASTERIZATION_SURFACES_POOL_H_
+
+#include <OsmAndCore/stdlib_common.h>
+
+#include <OsmAndCore/QtExtensions.h>
+#include <QtGlobal>
+
+#include <OsmAndCore.h>
+
+namespace OsmAnd
+{
+    class OfflineMapRasterTileProvider_Software_P;
+
+    class RasterizationSurfacesPool_P;
+    class OSMAND_CORE_API RasterizationSurfacesPool
+    {
+        Q_DISABLE_COPY(RasterizationSurfacesPool);
+    public:
+        struct Metrics
+        {
+            inline Metrics()
+            {
+                memset(this, 0, sizeof(Metrics));
+            }
+
+            // Number of surfaces that were allocated, since pool had no suitable one
+            unsigned int allocatedSurfaces;
+
+            // Number of surfaces that were taken from pool
+            unsigned int reusedSurfaces;
+
+            // Number of surfaces that were returned to pool
+            unsigned int returnedSurfaces;
+
+            // Number of surfaces that were freed, since pool was full
+            unsigned int discardedSurfaces;
+
+            // Number of surfaces that were freed, since their pixels were still shared with a bitmap copy
+            unsigned int sharedSurfaces;
+
+            // Number of surfaces currently held by pool
+            unsigned int pooledSurfaces;
+
+            // Size of pixel buffers currently held by pool (bytes)
+            size_t pooledBytes;
+        };
+    private:
+        const std::unique_ptr<RasterizationSurfacesPool_P> _d;
+    protected:
+    public:
+        RasterizationSurfacesPool(const unsigned int maxPooledSurfaces = 32);
+        virtual ~RasterizationSurfacesPool();
+
+        const unsigned int maxPooledSurfaces;
+
+        Metrics getMetrics() const;
+        void clear();
+
+    friend class OsmAnd::OfflineMapRasterTileProvider_Software_P;
+    };
+
+} // namespace OsmAnd
+
+#endif // _OSMAND_CORE_RASTERIZATION_SURFACES_POOL_H_
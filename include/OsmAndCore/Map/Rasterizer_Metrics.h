@@ -52,6 +52,9 @@ namespace OsmAnd {
             // Number of polygonized coastlines
             unsigned int polygonizedCoastlines;
 
+            // Number of times polygonized coastlines were taken from cache
+            unsigned int polygonizedCoastlinesCacheHits;
+
             // Time spent on obtaining primitives
             float elapsedTimeForObtainingPrimitives;
 
@@ -88,6 +91,15 @@ namespace OsmAnd {
             // Number of obtained point primitives
             unsigned int pointPrimitives;
 
+            // Time spent on simplification of primitives geometry
+            float elapsedTimeForSimplification;
+
+            // Number of vertices passed to simplification
+            unsigned int simplificationVerticesIn;
+
+            // Number of vertices left after simplification
+            unsigned int simplificationVerticesOut;
+
             // Time spent on obtaining primitives symbols
             float elapsedTimeForObtainingPrimitivesSymbols;
         };
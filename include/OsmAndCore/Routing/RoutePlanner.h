@@ -34,6 +34,7 @@
 #include <QMap>
 #include <QSet>
 #include <QList>
+#include <QVector>
 
 #include <OsmAndCore.h>
 #include <OsmAndCore/Routing/RoutePlannerContext.h>
@@ -65,8 +66,96 @@ namespace OsmAnd {
     struct RouteCalculationResult {
         QList< std::shared_ptr<OsmAnd::RouteSegment> >  list;
         QString warnMessage;
+        // Length (meters) of previously calculated route that was reused as-is by route recalculation
+        float reusedDistance;
         RouteCalculationResult(QString warn=""){
             warnMessage=warn;
+            reusedDistance=0;
+        }
+    };
+
+    struct RouteMatrixResult {
+        // Row-major [source][target] matrices. Unreachable pairs are marked with negative values
+        QVector<float> times;
+        QVector<float> distances;
+        int sourcesCount;
+        int targetsCount;
+        QString warnMessage;
+        RouteMatrixResult(int sourcesCount_ = 0, int targetsCount_ = 0)
+            : times(sourcesCount_ * targetsCount_, -1.0f)
+            , distances(sourcesCount_ * targetsCount_, -1.0f)
+            , sourcesCount(sourcesCount_)
+            , targetsCount(targetsCount_)
+        {
+        }
+
+        inline float time(int sourceIndex, int targetIndex) const {
+            return times[sourceIndex * targetsCount + targetIndex];
+        }
+        inline float distance(int sourceIndex, int targetIndex) const {
+            return distances[sourceIndex * targetsCount + targetIndex];
+        }
+    };
+
+    struct ClosestRoadPoint
+    {
+        std::shared_ptr<const OsmAnd::Model::Road> road;
+        // Index of end point of closest segment of the road
+        uint32_t pointIndex;
+        // Square distance in meters
+        double sqDistance;
+        // Projection of requested point on the road
+        uint32_t x31;
+        uint32_t y31;
+
+        ClosestRoadPoint()
+            : pointIndex(0)
+            , sqDistance(std::numeric_limits<double>::max())
+            , x31(0)
+            , y31(0)
+        {
+        }
+    };
+
+    struct MapMatchingParameters
+    {
+        // Number of closest roads considered as candidates for every GPS point
+        unsigned int candidatesCount;
+        // GPS points farther than this from any road (meters) are left unmatched
+        double maxCandidateDistance;
+        // Standard deviation of GPS noise (meters), drives emission probability
+        double gpsSigma;
+        // Expected difference between route and straight distances of consecutive points (meters),
+        // drives transition probability
+        double transitionBeta;
+        // Routing between candidates of consecutive points is not expanded beyond
+        // (straight distance * maxRouteDistanceFactor + 2 * maxCandidateDistance)
+        double maxRouteDistanceFactor;
+
+        MapMatchingParameters()
+            : candidatesCount(5)
+            , maxCandidateDistance(50.0)
+            , gpsSigma(10.0)
+            , transitionBeta(5.0)
+            , maxRouteDistanceFactor(3.0)
+        {
+        }
+    };
+
+    struct MapMatchingResult
+    {
+        // One entry per point of the trace, unmatched points have null road
+        QVector<ClosestRoadPoint> points;
+        int matchedCount;
+        // Number of times matching was restarted, since no route connected candidates of consecutive points
+        int breaksCount;
+        QString warnMessage;
+
+        MapMatchingResult(int pointsCount = 0)
+            : points(pointsCount)
+            , matchedCount(0)
+            , breaksCount(0)
+        {
         }
     };
 
@@ -83,12 +172,22 @@ namespace OsmAnd {
         >  RoadSegmentsPriorityQueue;
 
         static void loadRoads(RoutePlannerContext* context, uint32_t x31, uint32_t y31, uint32_t zoomAround, QList< std::shared_ptr<const Model::Road> >& roads);
+        static void visitRoutingTilesAround(RoutePlannerContext* context, uint32_t x31, uint32_t y31, uint32_t zoomAround, const std::function<void (const uint64_t tileId)>& visitor);
+        static unsigned int findClosestRoadPointsAround(
+            RoutePlannerContext* context,
+            uint32_t x31, uint32_t y31,
+            uint32_t zoomAround,
+            unsigned int maxRoadsCount,
+            QList<ClosestRoadPoint>& outPoints,
+            const std::function<bool (const std::shared_ptr<const Model::Road>& road)>& filter);
         static void loadRoadsFromTile(RoutePlannerContext* context, uint64_t tileId, QList< std::shared_ptr<const Model::Road> >& roads);
         static uint64_t getRoutingTileId(RoutePlannerContext* context, uint32_t x31, uint32_t y31, bool dontLoad);
         static uint32_t getCurrentEstimatedSize(RoutePlannerContext* context);
         static void cacheRoad(RoutePlannerContext* context, const std::shared_ptr<Model::Road>& road);
         static void loadTileHeader(RoutePlannerContext* context, uint32_t x31, uint32_t y31, QList< std::shared_ptr<RoutePlannerContext::RoutingSubsectionContext> >& subsectionsContexts);
         static void loadSubregionContext(RoutePlannerContext::RoutingSubsectionContext* context);
+        static void prefetchRoutingTiles(RoutePlannerContext::CalculationContext* context, const PointI& frontierPoint, const PointI& goalPoint);
+        static void cancelTilesPrefetch(RoutePlannerContext::CalculationContext* context);
 
         static bool findClosestRouteSegment(OsmAnd::RoutePlannerContext* context, double latitude, double longitude, std::shared_ptr<OsmAnd::RoutePlannerContext::RouteCalculationSegment>& routeSegment);
 
@@ -199,6 +298,13 @@ namespace OsmAnd {
             bool isIncrement);
 
         static void printRouteInfo(QVector< std::shared_ptr<RouteSegment> >& route);
+
+        struct RouteMatrixGraph;
+        static MapMatchingResult matchTrace(
+            RouteMatrixGraph& graph,
+            const QList< std::pair<double, double> >& trace,
+            const MapMatchingParameters& parameters,
+            const OsmAnd::IQueryController* const controller);
     public:
         virtual ~RoutePlanner();
         enum {
@@ -213,12 +319,91 @@ namespace OsmAnd {
             double* sqDistanceToClosestPoint = nullptr,
             uint32_t* rx31 = nullptr, uint32_t* ry31 = nullptr);
 
+        // Finds up to maxRoadsCount distinct roads closest to given point, sorted by distance. Roads are looked up
+        // in per-subsection segment indices, that contain only roads accepted by profile of the context
+        // (RoutingProfileContext::acceptsRoad). Optional filter may reject roads further.
+        static bool findClosestRoadPoints(
+            OsmAnd::RoutePlannerContext* context,
+            double latitude, double longitude,
+            unsigned int maxRoadsCount,
+            QList<ClosestRoadPoint>& outPoints,
+            const std::function<bool (const std::shared_ptr<const OsmAnd::Model::Road>& road)>& filter = nullptr);
+
+        // Snaps every point (latitude, longitude) to closest road. Points are processed grouped by routing tile,
+        // so each tile is loaded once. Entries of points that were not snapped have null road.
+        // Returns number of snapped points.
+        static unsigned int snapToRoads(
+            OsmAnd::RoutePlannerContext* context,
+            const QList< std::pair<double, double> >& points,
+            QVector<ClosestRoadPoint>& outPoints,
+            const std::function<bool (const std::shared_ptr<const OsmAnd::Model::Road>& road)>& filter = nullptr);
+
         static RouteCalculationResult calculateRoute(
             OsmAnd::RoutePlannerContext* context,
             const QList< std::pair<double, double> >& points,
             bool leftSideNavigation,
             const OsmAnd::IQueryController* const controller = nullptr);
 
+        // Recalculates previously calculated route from new position (e.g. after deviation from it) to the same target.
+        // Search runs only from new position until it reaches rest of previous route that lies farther than
+        // "recalculateDistanceHelp" from the point of previous route closest to new position, and that rest is reused as-is.
+        // Routing tiles loaded for previous route stay loaded in context. If rest of previous route can not be reached,
+        // whole route is calculated again.
+        static RouteCalculationResult recalculateRoute(
+            OsmAnd::RoutePlannerContext* context,
+            double latitude,
+            double longitude,
+            bool leftSideNavigation,
+            const OsmAnd::IQueryController* const controller = nullptr);
+
+        // Calculates route between two points by bidirectional A* search, with forward frontier running
+        // on calling thread and reverse one on its own dedicated thread at the same time.
+        // Each frontier has own queue and caches of road attributes and junctions, and they meet through shared
+        // registry of settled points. Both frontiers are directed by average of straight-line time estimates to
+        // their endpoints, which is admissible (unlike heuristic coefficient of calculateRoute() above 1), so route
+        // is the fastest one. Turn restrictions are honoured as in calculateRoute(), turn costs are not taken into
+        // account. Iterations are reported to route statistics of context. May be called from any thread, including routing pool.
+        static RouteCalculationResult calculateRouteParallel(
+            OsmAnd::RoutePlannerContext* context,
+            const QList< std::pair<double, double> >& points,
+            bool leftSideNavigation,
+            const OsmAnd::IQueryController* const controller = nullptr);
+
+        // Calculates travel times (seconds) and distances (meters) from every source to every target.
+        // One one-to-many Dijkstra search is run per source and it stops as soon as all targets are settled,
+        // so work is shared across targets. Sources are processed in parallel by threadsCount threads
+        // (0 means shared routing pool of Concurrent::pools, or calling thread if it's a worker of that pool).
+        // Loaded road tiles, road attributes and junctions are shared between all searches of the call. Turn costs and turn restrictions are not taken into account.
+        static RouteMatrixResult calculateRouteMatrix(
+            OsmAnd::RoutePlannerContext* context,
+            const QList< std::pair<double, double> >& sources,
+            const QList< std::pair<double, double> >& targets,
+            unsigned int threadsCount = 0,
+            const OsmAnd::IQueryController* const controller = nullptr);
+
+        // Matches GPS trace (sequence of latitude, longitude) to roads using hidden Markov model: candidates are
+        // closest roads of each point, transitions between candidates of consecutive points are scored by bounded
+        // local routing and the most probable sequence is found by Viterbi algorithm. If no route connects
+        // consecutive points, matching restarts from that point.
+        static MapMatchingResult matchTrace(
+            OsmAnd::RoutePlannerContext* context,
+            const QList< std::pair<double, double> >& trace,
+            const MapMatchingParameters& parameters = MapMatchingParameters(),
+            const OsmAnd::IQueryController* const controller = nullptr);
+
+        // Matches traces in parallel by threadsCount threads (0 means shared routing pool of Concurrent::pools,
+        // or calling thread if it's a worker of that pool). Loaded road tiles, road attributes and junctions are shared
+        // between all traces of the call; after each trace unused tiles are unloaded if memory limit is exceeded and
+        // shared caches are dropped if they grew too large. resultCallback receives result of each trace as soon as
+        // it's ready. Calls are serialized, but made from worker threads and not in order of traces.
+        static void matchTraces(
+            OsmAnd::RoutePlannerContext* context,
+            const QList< QList< std::pair<double, double> > >& traces,
+            const std::function<void (int traceIndex, const MapMatchingResult& result)>& resultCallback,
+            const MapMatchingParameters& parameters = MapMatchingParameters(),
+            unsigned int threadsCount = 0,
+            const OsmAnd::IQueryController* const controller = nullptr);
+
         friend class OsmAnd::RoutePlannerContext;
         friend class OsmAnd::RoutePlannerAnalyzer;
     };
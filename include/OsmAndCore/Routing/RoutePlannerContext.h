@@ -50,6 +50,8 @@ namespace OsmAnd {
     class ObfRoutingSectionInfo;
     class ObfRoutingSubsectionInfo;
     class ObfRoutingBorderLinePoint;
+    class RoadSegmentsIndex;
+    class RoutingTilesPrefetcher;
     class RoutePlanner;
 
     struct RouteStatistics
@@ -67,6 +69,11 @@ namespace OsmAnd {
         uint32_t distinctLoadedTiles;
         uint32_t loadedPrevUnloadedTiles;
 
+        // Subsections scheduled for background decoding, taken by search and dropped without use
+        uint32_t prefetchedTiles;
+        uint32_t prefetchHits;
+        uint32_t prefetchWasted;
+
         std::chrono::steady_clock::time_point timeToLoadBegin;
         std::chrono::steady_clock::time_point timeToCalculateBegin;
 
@@ -139,6 +146,8 @@ namespace OsmAnd {
             RoutingSubsectionContext(RoutePlannerContext* owner, const std::shared_ptr<ObfReader>& origin, const std::shared_ptr<const ObfRoutingSubsectionInfo>& subsection);
 
             QMap< uint64_t, std::shared_ptr<RouteCalculationSegment> > _roadSegments;
+            // Built on first nearest-road query after load, dropped when roads change or subsection is unloaded
+            std::shared_ptr<const RoadSegmentsIndex> _segmentsIndex;
 
             void markLoaded();
             void unload();
@@ -156,6 +165,7 @@ namespace OsmAnd {
 
             void registerRoad(const std::shared_ptr<const Model::Road>& road);
             void collectRoads(QList< std::shared_ptr<const Model::Road> >& output, QMap<uint64_t, std::shared_ptr<const Model::Road> >* duplicatesRegistry = nullptr);
+            std::shared_ptr<const RoadSegmentsIndex> obtainSegmentsIndex();
 
             friend class OsmAnd::RoutePlanner;
             friend class OsmAnd::RoutePlannerContext;
@@ -176,6 +186,9 @@ namespace OsmAnd {
 
             uint64_t _entranceRoadId;
             int _entranceRoadDirection;
+
+            // Reuse rest of owner's previously calculated route instead of searching from target (reset if that is not possible)
+            bool _partialRecalculation;
             
             QList< std::shared_ptr<BorderLine> > _borderLines;
             QVector< uint32_t > _borderLinesY31;
@@ -209,9 +222,13 @@ namespace OsmAnd {
         float _partialRecalculationDistanceLimit;
         int _loadedTiles;
         std::shared_ptr<RouteStatistics> _routeStatistics;
+        // Number of routing tiles ahead of each search frontier that are decoded in background (0 disables prefetching)
+        uint32_t _prefetchTilesAhead;
+        std::unique_ptr<RoutingTilesPrefetcher> _tilesPrefetcher;
 
         enum {
             DefaultRoadTilesLoadingZoomLevel = 16,
+            DefaultPrefetchTilesAhead = 4,
         };
     public:
         RoutePlannerContext(
@@ -228,6 +245,7 @@ namespace OsmAnd {
         const std::shared_ptr<OsmAnd::RoutingConfiguration> configuration;
         const std::shared_ptr<OsmAnd::RoutingProfileContext> profileContext;
 
+        std::shared_ptr<const RouteStatistics> getRouteStatistics() const;
         uint32_t getCurrentlyLoadedTiles();
         uint32_t getCurrentEstimatedSize();
         void unloadUnusedTiles(size_t memoryTarget);
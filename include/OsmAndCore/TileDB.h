@@ -30,6 +30,10 @@
 #include <QFile>
 #include <QString>
 #include <QMutex>
+#include <QReadWriteLock>
+#include <QHash>
+#include <QList>
+#include <QVector>
 #include <QSqlDatabase>
 
 #include <OsmAndCore.h>
@@ -40,21 +44,57 @@ namespace OsmAnd {
     class OSMAND_CORE_API TileDB
     {
     public:
+        STRONG_ENUM(AccessMode)
+        {
+            // All requests are serialized, tile file is opened and closed for each request
+            Serialized,
+
+            // Index is held in memory and tile files are read through pooled read-only connections,
+            // so that requests from different threads do not block each other
+            Concurrent
+        };
     private:
     protected:
         mutable QMutex _indexMutex;
         QSqlDatabase _indexDb;
 
         bool openIndex();
+
+        struct FileEntry;
+        struct IndexEntry
+        {
+            AreaI bbox;
+            int fileIndex;
+            // Maximal bbox.right in subtree rooted at this entry
+            int32_t subtreeMaxRight;
+        };
+        struct InMemoryIndex
+        {
+            QVector< std::shared_ptr<FileEntry> > files;
+            // Per zoom, sorted by bbox.left. Each range of entries is an implicit balanced interval tree
+            // with root in its middle, so lookup doesn't have to visit entries that can't contain the tile
+            std::array< QVector<IndexEntry>, ZoomLevelsCount > entries;
+        };
+        mutable QReadWriteLock _inMemoryIndexLock;
+        std::shared_ptr<const InMemoryIndex> _inMemoryIndex;
+        std::shared_ptr<const InMemoryIndex> obtainInMemoryIndex();
+        static int32_t buildIndexEntriesTree(QVector<IndexEntry>& entries, const int begin, const int end);
+        static void collectIndexEntriesWithTile(const QVector<IndexEntry>& entries, const int begin, const int end, const TileId tileId, QList<int>& outFilesIndices);
+        void collectFilesWithTile(const InMemoryIndex& index, const TileId tileId, const ZoomLevel zoom, QList<int>& outFilesIndices) const;
+        static bool readTileData(const std::shared_ptr<FileEntry>& file, const TileId tileId, const ZoomLevel zoom, QByteArray& data);
     public:
-        TileDB(const QDir& dataPath, const QString& indexFilename = QString());
+        TileDB(const QDir& dataPath, const QString& indexFilename = QString(), const AccessMode accessMode = AccessMode::Serialized);
         virtual ~TileDB();
 
         const QDir dataPath;
         const QString indexFilename;
+        const AccessMode accessMode;
 
         bool rebuildIndex();
         bool obtainTileData(const TileId tileId, const ZoomLevel zoom, QByteArray& data);
+
+        // Obtains data of many tiles at once. Tiles that are not present in any file are not put to output
+        bool obtainTilesData(const QList<TileId>& tileIds, const ZoomLevel zoom, QHash<uint64_t, QByteArray>& outData);
     };
 
 }
@@ -0,0 +1,119 @@
+/**
+* @file
+*
+* @section LICENSE
+*
+* OsmAnd - Android navigation software based on OSM maps.
+* Copyright (C) 2010-2013  OsmAnd Authors listed in AUTHORS file
+*
+* This program is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+
+* You should have received a copy of the GNU General Public License
+* along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef _OSMAND_CORE_TRACING_H_
+#define _OSMAND_CORE_TRACING_H_
+
+#include <OsmAndCore/stdlib_common.h>
+#include <array>
+
+#include <OsmAndCore/QtExtensions.h>
+#include <QString>
+#include <QList>
+#include <QIODevice>
+
+#include <OsmAndCore.h>
+#include <OsmAndCore/CommonTypes.h>
+
+namespace OsmAnd {
+
+    namespace Tracing {
+
+        // Completed span, times are in nanoseconds since tracing clock was started
+        struct Event
+        {
+            QString name;
+            QString category;
+            QString details;
+            quintptr threadId;
+            qint64 beginTime;
+            qint64 duration;
+        };
+
+        // Aggregated durations of all spans with same name. Bucket N counts durations
+        // in range [2^N, 2^(N+1)) microseconds, bucket 0 also counts everything shorter
+        struct StageStatistics
+        {
+            enum {
+                BucketsCount = 32
+            };
+
+            StageStatistics();
+
+            QString name;
+            uint64_t count;
+
+            // In seconds
+            double totalTime;
+            double minTime;
+            double maxTime;
+
+            std::array<uint64_t, BucketsCount> buckets;
+
+            // Approximated from buckets, in seconds
+            double getPercentile(const double percentile) const;
+        };
+
+        // Disabled by default. When disabled, span costs a single atomic read
+        OSMAND_CORE_API void OSMAND_CORE_CALL setEnabled(const bool enabled);
+        OSMAND_CORE_API bool OSMAND_CORE_CALL isEnabled();
+
+        // Maximal number of events kept in memory, oldest events are overwritten.
+        // Statistics are not affected by buffer size
+        OSMAND_CORE_API void OSMAND_CORE_CALL setBufferCapacity(const unsigned int capacity);
+        OSMAND_CORE_API unsigned int OSMAND_CORE_CALL getBufferCapacity();
+
+        OSMAND_CORE_API QList<Event> OSMAND_CORE_CALL getEvents();
+        OSMAND_CORE_API QList<StageStatistics> OSMAND_CORE_CALL getStagesStatistics();
+        OSMAND_CORE_API void OSMAND_CORE_CALL clear();
+
+        // Writes buffered events in Chrome trace-event format (chrome://tracing, Perfetto)
+        OSMAND_CORE_API bool OSMAND_CORE_CALL exportChromeTrace(QIODevice& output);
+        OSMAND_CORE_API bool OSMAND_CORE_CALL exportChromeTrace(const QString& fileName);
+
+        // Measures time between construction and destruction (or end()) on current thread.
+        // Name and category must be string literals or otherwise outlive the span
+        class OSMAND_CORE_API Span
+        {
+            Q_DISABLE_COPY(Span);
+        private:
+            const char* const _name;
+            const char* const _category;
+            QString _details;
+            qint64 _beginTime;
+        public:
+            Span(const char* name, const char* category = "core");
+            ~Span();
+
+            // False if tracing was disabled when span was started, or span has already ended
+            bool isActive() const;
+
+            // Details are exported as event arguments. Only format them if span is active
+            void setDetails(const QString& details);
+            void end();
+        };
+
+    } // namespace Tracing
+
+} // namespace OsmAnd
+
+#endif // _OSMAND_CORE_TRACING_H_
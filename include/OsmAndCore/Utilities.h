@@ -581,6 +581,7 @@ namespace OsmAnd {
         OSMAND_CORE_API void OSMAND_CORE_CALL findFiles(const QDir& origin, const QStringList& masks, QFileInfoList& files, const bool recursively = true);
 
         OSMAND_CORE_API void OSMAND_CORE_CALL scanlineFillPolygon(const unsigned int verticesCount, const PointF* const vertices, std::function<void(const PointI&)> fillPoint);
+        OSMAND_CORE_API void OSMAND_CORE_CALL simplifyPolyline(const QVector<PointI>& points, const double tolerance31, QVector<PointI>& outSimplified);
 
     } // namespace Utilities
 
@@ -6,17 +6,398 @@ const std::shared_ptr<OsmAnd::Concurrent::Pools> OsmAnd::Concurrent::Pools::inst
 const std::shared_ptr<OsmAnd::Concurrent::Pools> OsmAnd::Concurrent::pools(OsmAnd::Concurrent::Pools::instance);
 
 OsmAnd::Concurrent::Pools::Pools()
-    : localStorage(new QThreadPool())
-    , network(new QThreadPool())
+    : localStorage(new WorkersPool(QLatin1String("localStorage"), qMax(2, QThread::idealThreadCount() / 2)))
+    , network(new WorkersPool(QLatin1String("network"), qMax(4, QThread::idealThreadCount())))
+    , mapResources(new WorkersPool(QLatin1String("mapResources"), qMax(1, QThread::idealThreadCount() - 1), QThread::LowPriority))
+    , routing(new WorkersPool(QLatin1String("routing"), qMax(1, QThread::idealThreadCount())))
 {
-    localStorage->setMaxThreadCount(4);
-    network->setMaxThreadCount(4);
 }
 
 OsmAnd::Concurrent::Pools::~Pools()
 {
 }
 
+OsmAnd::Concurrent::WorkersPool* OsmAnd::Concurrent::Pools::getPool( const QString& name ) const
+{
+    const auto allPools = getAllPools();
+    for(auto itPool = allPools.cbegin(); itPool != allPools.cend(); ++itPool)
+    {
+        const auto pool = *itPool;
+        if(pool->name == name)
+            return pool;
+    }
+
+    return nullptr;
+}
+
+QList<OsmAnd::Concurrent::WorkersPool*> OsmAnd::Concurrent::Pools::getAllPools() const
+{
+    QList<WorkersPool*> allPools;
+    allPools.push_back(localStorage.get());
+    allPools.push_back(network.get());
+    allPools.push_back(mapResources.get());
+    allPools.push_back(routing.get());
+    return allPools;
+}
+
+class OsmAnd::Concurrent::WorkersPool::Worker
+{
+public:
+    Worker(WorkersPool* const owner_)
+        : owner(owner_)
+        , threadId(nullptr)
+        , isRetired(false)
+    {
+        thread.reset(new Thread(std::bind(&WorkersPool::workerThreadProcedure, owner, this)));
+    }
+
+    WorkersPool* const owner;
+    std::unique_ptr<Thread> thread;
+    volatile Qt::HANDLE threadId;
+    volatile bool isRetired;
+
+    mutable QMutex dequeMutex;
+    QList<PendingTask> deque;
+};
+
+OsmAnd::Concurrent::WorkersPool::Statistics::Statistics()
+    : threadsCount(0)
+    , queueLength(0)
+    , activeTasksCount(0)
+    , executedTasksCount(0)
+    , stolenTasksCount(0)
+    , averageWaitTime(0.0)
+    , maxWaitTime(0.0)
+    , averageExecutionTime(0.0)
+{
+}
+
+OsmAnd::Concurrent::WorkersPool::WorkersPool( const QString& name_, const unsigned int threadsCount, const QThread::Priority priority /*= QThread::NormalPriority*/ )
+    : _threadsCount(qMax(1u, threadsCount))
+    , _priority(priority)
+    , _isAlive(true)
+    , _queuedTasksCount(0)
+    , _activeTasksCount(0)
+    , _executedTasksCount(0)
+    , _stolenTasksCount(0)
+    , _totalWaitTime(0)
+    , _maxWaitTime(0)
+    , _totalExecutionTime(0)
+    , name(name_)
+{
+    _clock.start();
+}
+
+OsmAnd::Concurrent::WorkersPool::~WorkersPool()
+{
+    // Same as QThreadPool, complete all tasks before destruction
+    waitForDone();
+
+    {
+        QMutexLocker scopedLocker(&_mutex);
+
+        _isAlive = false;
+        _hasWorkCondition.wakeAll();
+    }
+    for(auto itWorker = _workers.cbegin(); itWorker != _workers.cend(); ++itWorker)
+        (*itWorker)->thread->wait();
+    _workers.clear();
+}
+
+unsigned int OsmAnd::Concurrent::WorkersPool::getThreadsCount() const
+{
+    QMutexLocker scopedLocker(&_mutex);
+
+    return _threadsCount;
+}
+
+void OsmAnd::Concurrent::WorkersPool::setThreadsCount( const unsigned int threadsCount )
+{
+    QMutexLocker scopedLocker(&_mutex);
+
+    _threadsCount = qMax(1u, threadsCount);
+
+    // If workers were not yet started, they will be started on demand
+    if(!_workers.isEmpty())
+        adjustWorkers();
+}
+
+QThread::Priority OsmAnd::Concurrent::WorkersPool::getPriority() const
+{
+    QMutexLocker scopedLocker(&_mutex);
+
+    return _priority;
+}
+
+void OsmAnd::Concurrent::WorkersPool::setPriority( const QThread::Priority priority )
+{
+    QMutexLocker scopedLocker(&_mutex);
+
+    _priority = priority;
+    for(auto itWorker = _workers.cbegin(); itWorker != _workers.cend(); ++itWorker)
+    {
+        const auto& worker = *itWorker;
+        if(worker->thread->isRunning())
+            worker->thread->setPriority(priority);
+    }
+}
+
+void OsmAnd::Concurrent::WorkersPool::adjustWorkers()
+{
+    // Forget workers that were retired and already have finished
+    for(auto itWorker = _workers.begin(); itWorker != _workers.end();)
+    {
+        const auto& worker = *itWorker;
+        if(worker->isRetired && worker->thread->isFinished())
+            itWorker = _workers.erase(itWorker);
+        else
+            ++itWorker;
+    }
+
+    // Count workers that are still in service
+    auto workersCount = 0u;
+    for(auto itWorker = _workers.cbegin(); itWorker != _workers.cend(); ++itWorker)
+    {
+        const auto& worker = *itWorker;
+        if(worker->isRetired)
+            continue;
+
+        // Retire excess workers: they complete tasks from own deque and exit
+        if(workersCount == _threadsCount)
+        {
+            worker->isRetired = true;
+            continue;
+        }
+        workersCount++;
+    }
+    _hasWorkCondition.wakeAll();
+
+    // Start missing workers
+    while(workersCount < _threadsCount)
+    {
+        std::shared_ptr<Worker> worker(new Worker(this));
+        worker->thread->setObjectName(QString::fromLatin1("%1#%2").arg(name).arg(_workers.size()));
+        _workers.push_back(worker);
+        worker->thread->start(_priority);
+
+        workersCount++;
+    }
+}
+
+std::shared_ptr<OsmAnd::Concurrent::WorkersPool::Worker> OsmAnd::Concurrent::WorkersPool::getCurrentWorker() const
+{
+    const auto currentThreadId = QThread::currentThreadId();
+    for(auto itWorker = _workers.cbegin(); itWorker != _workers.cend(); ++itWorker)
+    {
+        const auto& worker = *itWorker;
+        if(worker->threadId == currentThreadId)
+            return worker;
+    }
+
+    return nullptr;
+}
+
+void OsmAnd::Concurrent::WorkersPool::start( QRunnable* const runnable )
+{
+    assert(runnable != nullptr);
+
+    PendingTask task;
+    task.runnable = runnable;
+    task.enqueueTime = _clock.nsecsElapsed();
+
+    QMutexLocker scopedLocker(&_mutex);
+
+    if(_workers.isEmpty())
+        adjustWorkers();
+
+    // Task started from worker of this pool goes to it's own deque, since it's likely to use same data
+    const auto currentWorker = getCurrentWorker();
+    _queuedTasksCount.ref();
+    if(currentWorker && !currentWorker->isRetired)
+    {
+        QMutexLocker scopedDequeLocker(&currentWorker->dequeMutex);
+        currentWorker->deque.push_back(task);
+    }
+    else
+        _sharedQueue.push_back(task);
+
+    _hasWorkCondition.wakeOne();
+}
+
+bool OsmAnd::Concurrent::WorkersPool::isCurrentThreadWorker() const
+{
+    QMutexLocker scopedLocker(&_mutex);
+
+    return getCurrentWorker() != nullptr;
+}
+
+bool OsmAnd::Concurrent::WorkersPool::waitForDone( const int msecs /*= -1*/ )
+{
+    QElapsedTimer waitTimer;
+    waitTimer.start();
+
+    QMutexLocker scopedLocker(&_mutex);
+    while(_queuedTasksCount.load() > 0 || _activeTasksCount.load() > 0)
+    {
+        if(msecs < 0)
+        {
+            _isIdleCondition.wait(&_mutex);
+            continue;
+        }
+
+        const auto timeLeft = static_cast<qint64>(msecs) - waitTimer.elapsed();
+        if(timeLeft <= 0)
+            return false;
+        _isIdleCondition.wait(&_mutex, static_cast<unsigned long>(timeLeft));
+    }
+
+    return true;
+}
+
+// Obtained task is counted as active before it stops being counted as queued, under the same lock,
+// so waitForDone() never sees both counters at zero while task is in flight
+bool OsmAnd::Concurrent::WorkersPool::obtainTask( Worker* const worker, PendingTask& outTask )
+{
+    // Own deque first, newest task first
+    {
+        QMutexLocker scopedDequeLocker(&worker->dequeMutex);
+        if(!worker->deque.isEmpty())
+        {
+            outTask = worker->deque.takeLast();
+            _activeTasksCount.ref();
+            _queuedTasksCount.deref();
+            return true;
+        }
+    }
+
+    // Retired worker does not take new tasks
+    if(worker->isRetired)
+        return false;
+
+    // Then shared queue, oldest task first
+    QList< std::shared_ptr<Worker> > workers;
+    {
+        QMutexLocker scopedLocker(&_mutex);
+        if(!_sharedQueue.isEmpty())
+        {
+            outTask = _sharedQueue.takeFirst();
+            _activeTasksCount.ref();
+            _queuedTasksCount.deref();
+            return true;
+        }
+        workers = _workers;
+    }
+
+    // And finally steal oldest task from other workers
+    for(auto itOtherWorker = workers.cbegin(); itOtherWorker != workers.cend(); ++itOtherWorker)
+    {
+        const auto& otherWorker = *itOtherWorker;
+        if(otherWorker.get() == worker)
+            continue;
+
+        QMutexLocker scopedDequeLocker(&otherWorker->dequeMutex);
+        if(otherWorker->deque.isEmpty())
+            continue;
+
+        outTask = otherWorker->deque.takeFirst();
+        _activeTasksCount.ref();
+        _queuedTasksCount.deref();
+        {
+            QMutexLocker scopedStatisticsLocker(&_statisticsMutex);
+            _stolenTasksCount++;
+        }
+        return true;
+    }
+
+    return false;
+}
+
+void OsmAnd::Concurrent::WorkersPool::executeTask( const PendingTask& task )
+{
+    const auto startTime = _clock.nsecsElapsed();
+    const auto runnable = task.runnable;
+    const auto autoDelete = runnable->autoDelete();
+    runnable->run();
+    if(autoDelete)
+        delete runnable;
+    const auto finishTime = _clock.nsecsElapsed();
+
+    {
+        QMutexLocker scopedStatisticsLocker(&_statisticsMutex);
+
+        const auto waitTime = startTime - task.enqueueTime;
+        _executedTasksCount++;
+        _totalWaitTime += waitTime;
+        _maxWaitTime = qMax(_maxWaitTime, waitTime);
+        _totalExecutionTime += finishTime - startTime;
+    }
+
+    // Notify waiters if this was the last task
+    if(!_activeTasksCount.deref() && _queuedTasksCount.load() == 0)
+    {
+        QMutexLocker scopedLocker(&_mutex);
+        _isIdleCondition.wakeAll();
+    }
+}
+
+void OsmAnd::Concurrent::WorkersPool::workerThreadProcedure( Worker* const worker )
+{
+    worker->threadId = QThread::currentThreadId();
+
+    for(;;)
+    {
+        PendingTask task;
+        if(obtainTask(worker, task))
+        {
+            executeTask(task);
+            continue;
+        }
+
+        QMutexLocker scopedLocker(&_mutex);
+        if(!_isAlive || worker->isRetired)
+            break;
+
+        // Task may have been queued while lock was not held
+        if(_queuedTasksCount.load() > 0)
+            continue;
+
+        _hasWorkCondition.wait(&_mutex);
+    }
+
+    worker->threadId = nullptr;
+}
+
+OsmAnd::Concurrent::WorkersPool::Statistics OsmAnd::Concurrent::WorkersPool::getStatistics() const
+{
+    Statistics statistics;
+    statistics.threadsCount = getThreadsCount();
+    statistics.queueLength = qMax(0, _queuedTasksCount.load());
+    statistics.activeTasksCount = qMax(0, _activeTasksCount.load());
+
+    QMutexLocker scopedStatisticsLocker(&_statisticsMutex);
+    statistics.executedTasksCount = _executedTasksCount;
+    statistics.stolenTasksCount = _stolenTasksCount;
+    if(_executedTasksCount > 0)
+    {
+        statistics.averageWaitTime = (static_cast<double>(_totalWaitTime) / _executedTasksCount) / 1000000000.0;
+        statistics.averageExecutionTime = (static_cast<double>(_totalExecutionTime) / _executedTasksCount) / 1000000000.0;
+    }
+    statistics.maxWaitTime = static_cast<double>(_maxWaitTime) / 1000000000.0;
+
+    return statistics;
+}
+
+void OsmAnd::Concurrent::WorkersPool::resetStatistics()
+{
+    QMutexLocker scopedStatisticsLocker(&_statisticsMutex);
+
+    _executedTasksCount = 0;
+    _stolenTasksCount = 0;
+    _totalWaitTime = 0;
+    _maxWaitTime = 0;
+    _totalExecutionTime = 0;
+}
+
 OsmAnd::Concurrent::Task::Task( ExecuteSignature executeMethod, PreExecuteSignature preExecuteMethod /*= nullptr*/, PostExecuteSignature postExecuteMethod /*= nullptr*/ )
     : _cancellationRequestedByTask(false)
     , _cancellationRequestedByExternal(false)
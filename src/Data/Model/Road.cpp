@@ -22,12 +22,12 @@ OsmAnd::Model::Road::Road( const std::shared_ptr<const Road>& that, int insertId
     , _id(0)
     , _points(_ref->_points.size() + 1)
     , subsection(_ref->subsection)
-    , id(_ref->_id)
-    , names(_ref->_names)
+    , id(_ref->id)
+    , names(_ref->names)
     , points(_points)
-    , types(_ref->_types)
+    , types(_ref->types)
     , pointsTypes(_pointsTypes)
-    , restrictions(_ref->_restrictions)
+    , restrictions(_ref->restrictions)
 {
     int pointIdx = 0;
     for(; pointIdx < insertIdx; pointIdx++)
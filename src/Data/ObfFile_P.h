@@ -34,6 +34,8 @@ namespace OsmAnd {
 
     class ObfReader;
     class ObfInfo;
+    class ObfInfoCache;
+    class ObfsCollection_P;
 
     class ObfFile;
     class OSMAND_CORE_API ObfFile_P
@@ -47,11 +49,13 @@ namespace OsmAnd {
 
         mutable QMutex _obfInfoMutex;
         std::shared_ptr<ObfInfo> _obfInfo;
+        std::shared_ptr<const ObfInfoCache> _infoCache;
     public:
         virtual ~ObfFile_P();
 
     friend class OsmAnd::ObfFile;
     friend class OsmAnd::ObfReader;
+    friend class OsmAnd::ObfsCollection_P;
     };
 
 } // namespace OsmAnd
@@ -7,6 +7,7 @@ OsmAnd::ObfInfo::ObfInfo()
     , version(_version)
     , creationTimestamp(_creationTimestamp)
     , isBasemap(_isBasemap)
+    , filePath(_filePath)
     , mapSections(_mapSections)
     , addressSections(_addressSections)
     , routingSections(_routingSections)
@@ -0,0 +1,402 @@
+#include "ObfInfoCache.h"
+
+#include <cassert>
+
+#include <QDataStream>
+#include <QFile>
+#include <QSaveFile>
+#include <QDateTime>
+#include <QCryptographicHash>
+
+#include "ObfInfo.h"
+#include "ObfSectionInfo.h"
+#include "ObfMapSectionInfo.h"
+#include "ObfAddressSectionInfo.h"
+#include "ObfRoutingSectionInfo.h"
+#include "ObfRoutingSectionInfo_P.h"
+#include "ObfPoiSectionInfo.h"
+#include "ObfTransportSectionInfo.h"
+#include "Logging.h"
+
+OsmAnd::ObfInfoCache::ObfInfoCache( const QDir& directory_ )
+    : directory(directory_)
+{
+}
+
+OsmAnd::ObfInfoCache::~ObfInfoCache()
+{
+}
+
+QString OsmAnd::ObfInfoCache::getCacheFilename( const QString& obfFilePath ) const
+{
+    const auto pathHash = QCryptographicHash::hash(obfFilePath.toUtf8(), QCryptographicHash::Sha1).toHex();
+    return directory.filePath(QString::fromLatin1(pathHash) + QLatin1String(".obfinfo"));
+}
+
+std::shared_ptr<OsmAnd::ObfInfo> OsmAnd::ObfInfoCache::load( const QString& obfFilePath ) const
+{
+    const QFileInfo obfFileInfo(obfFilePath);
+    if(!obfFileInfo.exists())
+        return nullptr;
+
+    QFile cacheFile(getCacheFilename(obfFilePath));
+    if(!cacheFile.open(QIODevice::ReadOnly))
+        return nullptr;
+    QDataStream input(&cacheFile);
+    input.setVersion(QDataStream::Qt_5_0);
+
+    // Check that cached header belongs to exactly this file
+    quint32 magic;
+    quint32 formatVersion;
+    QString cachedObfFilePath;
+    qint64 obfFileSize;
+    qint64 obfFileLastModified;
+    input >> magic >> formatVersion;
+    if(input.status() != QDataStream::Ok || magic != Magic || formatVersion != FormatVersion)
+        return nullptr;
+    input >> cachedObfFilePath >> obfFileSize >> obfFileLastModified;
+    if(input.status() != QDataStream::Ok ||
+        cachedObfFilePath != obfFilePath ||
+        obfFileSize != obfFileInfo.size() ||
+        obfFileLastModified != obfFileInfo.lastModified().toMSecsSinceEpoch())
+    {
+        return nullptr;
+    }
+
+    const std::shared_ptr<ObfInfo> obfInfo(new ObfInfo());
+    qint32 version;
+    quint64 creationTimestamp;
+    input >> version >> creationTimestamp >> obfInfo->_isBasemap;
+    obfInfo->_version = version;
+    obfInfo->_creationTimestamp = creationTimestamp;
+
+    quint32 count;
+    input >> count;
+    for(auto idx = 0u; idx < count && input.status() == QDataStream::Ok; idx++)
+        obfInfo->_mapSections.push_back(qMove(readMapSection(input, obfInfo)));
+    input >> count;
+    for(auto idx = 0u; idx < count && input.status() == QDataStream::Ok; idx++)
+        obfInfo->_addressSections.push_back(qMove(readAddressSection(input, obfInfo)));
+    input >> count;
+    for(auto idx = 0u; idx < count && input.status() == QDataStream::Ok; idx++)
+        obfInfo->_routingSections.push_back(qMove(readRoutingSection(input, obfInfo)));
+    input >> count;
+    for(auto idx = 0u; idx < count && input.status() == QDataStream::Ok; idx++)
+        obfInfo->_poiSections.push_back(qMove(readPoiSection(input, obfInfo)));
+    input >> count;
+    for(auto idx = 0u; idx < count && input.status() == QDataStream::Ok; idx++)
+        obfInfo->_transportSections.push_back(qMove(readTransportSection(input, obfInfo)));
+
+    if(input.status() != QDataStream::Ok)
+    {
+        LogPrintf(LogSeverityLevel::Warning, "Cached header of '%s' is corrupted", qPrintable(obfFilePath));
+        return nullptr;
+    }
+
+    return obfInfo;
+}
+
+bool OsmAnd::ObfInfoCache::save( const QString& obfFilePath, const std::shared_ptr<const ObfInfo>& obfInfo ) const
+{
+    const QFileInfo obfFileInfo(obfFilePath);
+    if(!obfFileInfo.exists())
+        return false;
+
+    directory.mkpath(directory.absolutePath());
+
+    // Header is written to temporary file and replaces old one only when complete,
+    // so concurrent readers never see partially written cache
+    QSaveFile cacheFile(getCacheFilename(obfFilePath));
+    if(!cacheFile.open(QIODevice::WriteOnly))
+    {
+        LogPrintf(LogSeverityLevel::Warning, "Failed to open cache for header of '%s'", qPrintable(obfFilePath));
+        return false;
+    }
+    QDataStream output(&cacheFile);
+    output.setVersion(QDataStream::Qt_5_0);
+
+    output << static_cast<quint32>(Magic) << static_cast<quint32>(FormatVersion);
+    output << obfFilePath << static_cast<qint64>(obfFileInfo.size()) << static_cast<qint64>(obfFileInfo.lastModified().toMSecsSinceEpoch());
+
+    output << static_cast<qint32>(obfInfo->version) << static_cast<quint64>(obfInfo->creationTimestamp) << obfInfo->isBasemap;
+
+    output << static_cast<quint32>(obfInfo->mapSections.size());
+    for(auto itSection = obfInfo->mapSections.cbegin(); itSection != obfInfo->mapSections.cend(); ++itSection)
+        writeMapSection(output, *itSection);
+    output << static_cast<quint32>(obfInfo->addressSections.size());
+    for(auto itSection = obfInfo->addressSections.cbegin(); itSection != obfInfo->addressSections.cend(); ++itSection)
+        writeAddressSection(output, *itSection);
+    output << static_cast<quint32>(obfInfo->routingSections.size());
+    for(auto itSection = obfInfo->routingSections.cbegin(); itSection != obfInfo->routingSections.cend(); ++itSection)
+        writeRoutingSection(output, *itSection);
+    output << static_cast<quint32>(obfInfo->poiSections.size());
+    for(auto itSection = obfInfo->poiSections.cbegin(); itSection != obfInfo->poiSections.cend(); ++itSection)
+        writePoiSection(output, *itSection);
+    output << static_cast<quint32>(obfInfo->transportSections.size());
+    for(auto itSection = obfInfo->transportSections.cbegin(); itSection != obfInfo->transportSections.cend(); ++itSection)
+        writeTransportSection(output, *itSection);
+
+    if(output.status() != QDataStream::Ok || !cacheFile.commit())
+    {
+        LogPrintf(LogSeverityLevel::Warning, "Failed to write cached header of '%s'", qPrintable(obfFilePath));
+        return false;
+    }
+
+    return true;
+}
+
+void OsmAnd::ObfInfoCache::writeArea( QDataStream& output, const AreaI& area )
+{
+    output << static_cast<qint32>(area.top) << static_cast<qint32>(area.left) << static_cast<qint32>(area.bottom) << static_cast<qint32>(area.right);
+}
+
+void OsmAnd::ObfInfoCache::readArea( QDataStream& input, AreaI& area )
+{
+    qint32 top, left, bottom, right;
+    input >> top >> left >> bottom >> right;
+    area.top = top;
+    area.left = left;
+    area.bottom = bottom;
+    area.right = right;
+}
+
+void OsmAnd::ObfInfoCache::writeSectionInfo( QDataStream& output, const std::shared_ptr<const ObfSectionInfo>& section )
+{
+    output << section->_name << static_cast<quint32>(section->_length) << static_cast<quint32>(section->_offset);
+}
+
+void OsmAnd::ObfInfoCache::readSectionInfo( QDataStream& input, const std::shared_ptr<ObfSectionInfo>& section )
+{
+    quint32 length, offset;
+    input >> section->_name >> length >> offset;
+    section->_length = length;
+    section->_offset = offset;
+}
+
+void OsmAnd::ObfInfoCache::writeMapSection( QDataStream& output, const std::shared_ptr<const ObfMapSectionInfo>& section )
+{
+    writeSectionInfo(output, section);
+    output << section->_isBasemap;
+
+    output << static_cast<quint32>(section->_levels.size());
+    for(auto itLevel = section->_levels.cbegin(); itLevel != section->_levels.cend(); ++itLevel)
+    {
+        const auto& level = *itLevel;
+
+        output << static_cast<quint32>(level->_offset) << static_cast<quint32>(level->_length);
+        output << static_cast<qint32>(level->_minZoom) << static_cast<qint32>(level->_maxZoom);
+        writeArea(output, level->_area31);
+        output << static_cast<quint32>(level->_boxesInnerOffset);
+    }
+}
+
+std::shared_ptr<OsmAnd::ObfMapSectionInfo> OsmAnd::ObfInfoCache::readMapSection( QDataStream& input, const std::shared_ptr<ObfInfo>& info )
+{
+    const std::shared_ptr<ObfMapSectionInfo> section(new ObfMapSectionInfo(info));
+    readSectionInfo(input, section);
+    input >> section->_isBasemap;
+
+    quint32 levelsCount;
+    input >> levelsCount;
+    for(auto idx = 0u; idx < levelsCount && input.status() == QDataStream::Ok; idx++)
+    {
+        const std::shared_ptr<ObfMapSectionLevel> level(new ObfMapSectionLevel());
+
+        quint32 offset, length, boxesInnerOffset;
+        qint32 minZoom, maxZoom;
+        input >> offset >> length >> minZoom >> maxZoom;
+        readArea(input, level->_area31);
+        input >> boxesInnerOffset;
+        level->_offset = offset;
+        level->_length = length;
+        level->_minZoom = static_cast<ZoomLevel>(minZoom);
+        level->_maxZoom = static_cast<ZoomLevel>(maxZoom);
+        level->_boxesInnerOffset = boxesInnerOffset;
+
+        section->_levels.push_back(qMove(level));
+    }
+
+    return section;
+}
+
+void OsmAnd::ObfInfoCache::writeAddressSection( QDataStream& output, const std::shared_ptr<const ObfAddressSectionInfo>& section )
+{
+    writeSectionInfo(output, section);
+    output << section->_latinName;
+
+    output << static_cast<quint32>(section->_addressBlocksSections.size());
+    for(auto itBlocksSection = section->_addressBlocksSections.cbegin(); itBlocksSection != section->_addressBlocksSections.cend(); ++itBlocksSection)
+    {
+        const auto& blocksSection = *itBlocksSection;
+
+        writeSectionInfo(output, blocksSection);
+        output << static_cast<qint32>(blocksSection->_type);
+    }
+}
+
+std::shared_ptr<OsmAnd::ObfAddressSectionInfo> OsmAnd::ObfInfoCache::readAddressSection( QDataStream& input, const std::shared_ptr<ObfInfo>& info )
+{
+    const std::shared_ptr<ObfAddressSectionInfo> section(new ObfAddressSectionInfo(info));
+    readSectionInfo(input, section);
+    input >> section->_latinName;
+
+    quint32 blocksSectionsCount;
+    input >> blocksSectionsCount;
+    for(auto idx = 0u; idx < blocksSectionsCount && input.status() == QDataStream::Ok; idx++)
+    {
+        const std::shared_ptr<ObfAddressBlocksSectionInfo> blocksSection(new ObfAddressBlocksSectionInfo(section, info));
+        readSectionInfo(input, blocksSection);
+
+        qint32 type;
+        input >> type;
+        blocksSection->_type = static_cast<ObfAddressBlockType>(type);
+
+        section->_addressBlocksSections.push_back(qMove(blocksSection));
+    }
+
+    return section;
+}
+
+void OsmAnd::ObfInfoCache::writeRoutingSection( QDataStream& output, const std::shared_ptr<const ObfRoutingSectionInfo>& section )
+{
+    writeSectionInfo(output, section);
+
+    // Encoding rules are indexed by id, so gaps are stored as well
+    const auto& encodingRules = section->_d->_encodingRules;
+    output << static_cast<quint32>(encodingRules.size());
+    for(auto itEncodingRule = encodingRules.cbegin(); itEncodingRule != encodingRules.cend(); ++itEncodingRule)
+    {
+        const auto& encodingRule = *itEncodingRule;
+
+        output << static_cast<bool>(encodingRule);
+        if(!encodingRule)
+            continue;
+        output << static_cast<quint32>(encodingRule->_id) << encodingRule->_tag << encodingRule->_value;
+        output << static_cast<quint32>(encodingRule->_type) << static_cast<quint32>(encodingRule->_parsedValue.asUnsignedInt);
+    }
+
+    output << static_cast<quint32>(section->_d->_borderBoxOffset) << static_cast<quint32>(section->_d->_borderBoxLength);
+    output << static_cast<quint32>(section->_d->_baseBorderBoxOffset) << static_cast<quint32>(section->_d->_baseBorderBoxLength);
+
+    output << static_cast<quint32>(section->_subsections.size());
+    for(auto itSubsection = section->_subsections.cbegin(); itSubsection != section->_subsections.cend(); ++itSubsection)
+        writeRoutingSubsection(output, *itSubsection);
+    output << static_cast<quint32>(section->_baseSubsections.size());
+    for(auto itSubsection = section->_baseSubsections.cbegin(); itSubsection != section->_baseSubsections.cend(); ++itSubsection)
+        writeRoutingSubsection(output, *itSubsection);
+}
+
+std::shared_ptr<OsmAnd::ObfRoutingSectionInfo> OsmAnd::ObfInfoCache::readRoutingSection( QDataStream& input, const std::shared_ptr<ObfInfo>& info )
+{
+    const std::shared_ptr<ObfRoutingSectionInfo> section(new ObfRoutingSectionInfo(info));
+    readSectionInfo(input, section);
+
+    quint32 encodingRulesCount;
+    input >> encodingRulesCount;
+    for(auto idx = 0u; idx < encodingRulesCount && input.status() == QDataStream::Ok; idx++)
+    {
+        bool present;
+        input >> present;
+        if(!present)
+        {
+            section->_d->_encodingRules.push_back(qMove(std::shared_ptr<ObfRoutingSectionInfo_P::EncodingRule>()));
+            continue;
+        }
+
+        const std::shared_ptr<ObfRoutingSectionInfo_P::EncodingRule> encodingRule(new ObfRoutingSectionInfo_P::EncodingRule());
+        quint32 id, type, parsedValue;
+        input >> id >> encodingRule->_tag >> encodingRule->_value >> type >> parsedValue;
+        encodingRule->_id = id;
+        encodingRule->_type = static_cast<ObfRoutingSectionInfo_P::EncodingRule::Type>(type);
+        encodingRule->_parsedValue.asUnsignedInt = parsedValue;
+
+        section->_d->_encodingRules.push_back(qMove(encodingRule));
+    }
+
+    quint32 borderBoxOffset, borderBoxLength, baseBorderBoxOffset, baseBorderBoxLength;
+    input >> borderBoxOffset >> borderBoxLength >> baseBorderBoxOffset >> baseBorderBoxLength;
+    section->_d->_borderBoxOffset = borderBoxOffset;
+    section->_d->_borderBoxLength = borderBoxLength;
+    section->_d->_baseBorderBoxOffset = baseBorderBoxOffset;
+    section->_d->_baseBorderBoxLength = baseBorderBoxLength;
+
+    quint32 subsectionsCount;
+    input >> subsectionsCount;
+    for(auto idx = 0u; idx < subsectionsCount && input.status() == QDataStream::Ok; idx++)
+        section->_subsections.push_back(qMove(readRoutingSubsection(input, section, nullptr)));
+    input >> subsectionsCount;
+    for(auto idx = 0u; idx < subsectionsCount && input.status() == QDataStream::Ok; idx++)
+        section->_baseSubsections.push_back(qMove(readRoutingSubsection(input, section, nullptr)));
+
+    return section;
+}
+
+void OsmAnd::ObfInfoCache::writeRoutingSubsection( QDataStream& output, const std::shared_ptr<const ObfRoutingSubsectionInfo>& subsection )
+{
+    writeSectionInfo(output, subsection);
+    writeArea(output, subsection->_area31);
+    output << static_cast<quint32>(subsection->_dataOffset) << static_cast<quint32>(subsection->_subsectionsOffset);
+
+    // Only subsections that were read while parsing header are stored, rest is loaded on demand as usual
+    output << static_cast<quint32>(subsection->_subsections.size());
+    for(auto itSubsection = subsection->_subsections.cbegin(); itSubsection != subsection->_subsections.cend(); ++itSubsection)
+        writeRoutingSubsection(output, *itSubsection);
+}
+
+std::shared_ptr<OsmAnd::ObfRoutingSubsectionInfo> OsmAnd::ObfInfoCache::readRoutingSubsection( QDataStream& input,
+    const std::shared_ptr<ObfRoutingSectionInfo>& section, const std::shared_ptr<ObfRoutingSubsectionInfo>& parent )
+{
+    const std::shared_ptr<ObfRoutingSubsectionInfo> subsection(parent
+        ? new ObfRoutingSubsectionInfo(parent)
+        : new ObfRoutingSubsectionInfo(section));
+    readSectionInfo(input, subsection);
+    readArea(input, subsection->_area31);
+
+    quint32 dataOffset, subsectionsOffset;
+    input >> dataOffset >> subsectionsOffset;
+    subsection->_dataOffset = dataOffset;
+    subsection->_subsectionsOffset = subsectionsOffset;
+
+    quint32 subsectionsCount;
+    input >> subsectionsCount;
+    for(auto idx = 0u; idx < subsectionsCount && input.status() == QDataStream::Ok; idx++)
+        subsection->_subsections.push_back(qMove(readRoutingSubsection(input, section, subsection)));
+
+    return subsection;
+}
+
+void OsmAnd::ObfInfoCache::writePoiSection( QDataStream& output, const std::shared_ptr<const ObfPoiSectionInfo>& section )
+{
+    writeSectionInfo(output, section);
+    writeArea(output, section->_area31);
+}
+
+std::shared_ptr<OsmAnd::ObfPoiSectionInfo> OsmAnd::ObfInfoCache::readPoiSection( QDataStream& input, const std::shared_ptr<ObfInfo>& info )
+{
+    const std::shared_ptr<ObfPoiSectionInfo> section(new ObfPoiSectionInfo(info));
+    readSectionInfo(input, section);
+    readArea(input, section->_area31);
+
+    return section;
+}
+
+void OsmAnd::ObfInfoCache::writeTransportSection( QDataStream& output, const std::shared_ptr<const ObfTransportSectionInfo>& section )
+{
+    writeSectionInfo(output, section);
+    writeArea(output, section->_area24);
+    output << static_cast<quint32>(section->_stopsOffset) << static_cast<quint32>(section->_stopsLength);
+}
+
+std::shared_ptr<OsmAnd::ObfTransportSectionInfo> OsmAnd::ObfInfoCache::readTransportSection( QDataStream& input, const std::shared_ptr<ObfInfo>& info )
+{
+    const std::shared_ptr<ObfTransportSectionInfo> section(new ObfTransportSectionInfo(info));
+    readSectionInfo(input, section);
+    readArea(input, section->_area24);
+
+    quint32 stopsOffset, stopsLength;
+    input >> stopsOffset >> stopsLength;
+    section->_stopsOffset = stopsOffset;
+    section->_stopsLength = stopsLength;
+
+    return section;
+}
@@ -0,0 +1,94 @@
+/**
+* @file
+*
+* @section LICENSE
+*
+* OsmAnd - Android navigation software based on OSM maps.
+* Copyright (C) 2010-2013  OsmAnd Authors listed in AUTHORS file
+*
+* This program is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+
+* You should have received a copy of the GNU General Public License
+* along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef _OSMAND_CORE_OBF_INFO_CACHE_H_
+#define _OSMAND_CORE_OBF_INFO_CACHE_H_
+
+#include <OsmAndCore/stdlib_common.h>
+
+#include <OsmAndCore/QtExtensions.h>
+#include <QDir>
+#include <QFileInfo>
+#include <QString>
+
+#include <OsmAndCore.h>
+#include <CommonTypes.h>
+
+class QDataStream;
+
+namespace OsmAnd {
+
+    class ObfInfo;
+    class ObfSectionInfo;
+    class ObfMapSectionInfo;
+    class ObfAddressSectionInfo;
+    class ObfRoutingSectionInfo;
+    class ObfRoutingSubsectionInfo;
+    class ObfPoiSectionInfo;
+    class ObfTransportSectionInfo;
+
+    // Stores parsed headers of OBF files, one cache file per OBF file. Cached header is valid only
+    // while size and modification time of OBF file are same as when it was cached
+    class ObfInfoCache
+    {
+        Q_DISABLE_COPY(ObfInfoCache);
+    private:
+        enum {
+            Magic = 0x43494f42, // 'BOIC'
+            FormatVersion = 1,
+        };
+
+        QString getCacheFilename(const QString& obfFilePath) const;
+
+        static void writeArea(QDataStream& output, const AreaI& area);
+        static void readArea(QDataStream& input, AreaI& area);
+        static void writeSectionInfo(QDataStream& output, const std::shared_ptr<const ObfSectionInfo>& section);
+        static void readSectionInfo(QDataStream& input, const std::shared_ptr<ObfSectionInfo>& section);
+
+        static void writeMapSection(QDataStream& output, const std::shared_ptr<const ObfMapSectionInfo>& section);
+        static std::shared_ptr<ObfMapSectionInfo> readMapSection(QDataStream& input, const std::shared_ptr<ObfInfo>& info);
+        static void writeAddressSection(QDataStream& output, const std::shared_ptr<const ObfAddressSectionInfo>& section);
+        static std::shared_ptr<ObfAddressSectionInfo> readAddressSection(QDataStream& input, const std::shared_ptr<ObfInfo>& info);
+        static void writeRoutingSection(QDataStream& output, const std::shared_ptr<const ObfRoutingSectionInfo>& section);
+        static std::shared_ptr<ObfRoutingSectionInfo> readRoutingSection(QDataStream& input, const std::shared_ptr<ObfInfo>& info);
+        static void writeRoutingSubsection(QDataStream& output, const std::shared_ptr<const ObfRoutingSubsectionInfo>& subsection);
+        static std::shared_ptr<ObfRoutingSubsectionInfo> readRoutingSubsection(QDataStream& input,
+            const std::shared_ptr<ObfRoutingSectionInfo>& section, const std::shared_ptr<ObfRoutingSubsectionInfo>& parent);
+        static void writePoiSection(QDataStream& output, const std::shared_ptr<const ObfPoiSectionInfo>& section);
+        static std::shared_ptr<ObfPoiSectionInfo> readPoiSection(QDataStream& input, const std::shared_ptr<ObfInfo>& info);
+        static void writeTransportSection(QDataStream& output, const std::shared_ptr<const ObfTransportSectionInfo>& section);
+        static std::shared_ptr<ObfTransportSectionInfo> readTransportSection(QDataStream& input, const std::shared_ptr<ObfInfo>& info);
+    protected:
+    public:
+        ObfInfoCache(const QDir& directory);
+        virtual ~ObfInfoCache();
+
+        const QDir directory;
+
+        // Returns nullptr if there is no valid cached header for given file
+        std::shared_ptr<ObfInfo> load(const QString& obfFilePath) const;
+        bool save(const QString& obfFilePath, const std::shared_ptr<const ObfInfo>& obfInfo) const;
+    };
+
+} // namespace OsmAnd
+
+#endif // _OSMAND_CORE_OBF_INFO_CACHE_H_
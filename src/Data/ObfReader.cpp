@@ -3,6 +3,7 @@
 
 #include "ObfFile.h"
 #include "ObfFile_P.h"
+#include "ObfInfoCache.h"
 
 #include "QIODeviceInputStream.h"
 #include "QFileDeviceInputStream.h"
@@ -31,30 +32,7 @@ std::shared_ptr<OsmAnd::ObfInfo> OsmAnd::ObfReader::obtainInfo() const
 
     // Open file for reading (if needed)
     if(!_d->_codedInputStream)
-    {
-        if(obfFile)
-        {
-            auto input = new QFile(obfFile->filePath);
-            _d->_input.reset(input);
-        }
-
-        // Create zero-copy input stream
-        gpb::io::ZeroCopyInputStream* zcis = nullptr;
-        if(const auto inputAsFileDevice = std::dynamic_pointer_cast<QFileDevice>(_d->_input))
-        {
-            zcis = new QFileDeviceInputStream(inputAsFileDevice);
-        }
-        else
-        {
-            zcis = new QIODeviceInputStream(_d->_input);
-        }
-        _d->_zeroCopyInputStream.reset(zcis);
-
-        // Create coded input stream wrapper
-        const auto cis = new gpb::io::CodedInputStream(zcis);
-        cis->SetTotalBytesLimit(std::numeric_limits<int>::max(), std::numeric_limits<int>::max());
-        _d->_codedInputStream.reset(cis);
-    }
+        _d->openInput();
 
     if(obfFile)
     {
@@ -62,8 +40,21 @@ std::shared_ptr<OsmAnd::ObfInfo> OsmAnd::ObfReader::obtainInfo() const
 
         if(!obfFile->_d->_obfInfo)
         {
-            const std::shared_ptr<ObfInfo> obfInfo(new ObfInfo());
-            ObfReader_P::readInfo(_d, obfInfo);
+            // Try cached header first, and parse file only if it's missing or outdated
+            const auto& infoCache = obfFile->_d->_infoCache;
+            std::shared_ptr<ObfInfo> obfInfo;
+            if(infoCache)
+                obfInfo = infoCache->load(obfFile->filePath);
+            if(!obfInfo)
+            {
+                obfInfo.reset(new ObfInfo());
+                ObfReader_P::readInfo(_d, obfInfo);
+
+                // Broken files are not cached, so they will be checked again next time
+                if(infoCache && obfInfo->version >= 0)
+                    infoCache->save(obfFile->filePath, obfInfo);
+            }
+            obfInfo->_filePath = obfFile->filePath;
             obfFile->_d->_obfInfo = qMove(obfInfo);
         }
         _d->_obfInfo = obfFile->_d->_obfInfo;
@@ -74,8 +65,32 @@ std::shared_ptr<OsmAnd::ObfInfo> OsmAnd::ObfReader::obtainInfo() const
     {
         const std::shared_ptr<ObfInfo> obfInfo(new ObfInfo());
         ObfReader_P::readInfo(_d, obfInfo);
+        if(const auto inputAsFile = std::dynamic_pointer_cast<QFile>(_d->_input))
+            obfInfo->_filePath = inputAsFile->fileName();
         _d->_obfInfo = qMove(obfInfo);
 
         return _d->_obfInfo;
     }
 }
+
+std::shared_ptr<OsmAnd::ObfReader> OsmAnd::ObfReader::createSiblingReader() const
+{
+    std::shared_ptr<ObfReader> sibling;
+    if(obfFile)
+    {
+        sibling.reset(new ObfReader(obfFile));
+    }
+    else
+    {
+        const auto inputAsFile = std::dynamic_pointer_cast<QFile>(_d->_input);
+        if(!inputAsFile)
+            return nullptr;
+        sibling.reset(new ObfReader(std::shared_ptr<QIODevice>(new QFile(inputAsFile->fileName()))));
+    }
+
+    // Section readers expect input to be open and information to be present
+    const auto obfInfo = obtainInfo();
+    sibling->_d->openInput();
+    sibling->_d->_obfInfo = obfInfo;
+    return sibling;
+}
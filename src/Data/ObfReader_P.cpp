@@ -12,6 +12,10 @@
 #include "ObfPoiSectionInfo.h"
 #include "ObfPoiSectionReader_P.h"
 #include "ObfReaderUtilities.h"
+#include "ObfReader.h"
+#include "ObfFile.h"
+#include "QIODeviceInputStream.h"
+#include "QFileDeviceInputStream.h"
 
 #include "OBF.pb.h"
 #include <google/protobuf/wire_format_lite.h>
@@ -28,6 +32,32 @@ OsmAnd::ObfReader_P::~ObfReader_P()
 
 }
 
+void OsmAnd::ObfReader_P::openInput()
+{
+    if(owner->obfFile)
+    {
+        auto input = new QFile(owner->obfFile->filePath);
+        _input.reset(input);
+    }
+
+    // Create zero-copy input stream
+    gpb::io::ZeroCopyInputStream* zcis = nullptr;
+    if(const auto inputAsFileDevice = std::dynamic_pointer_cast<QFileDevice>(_input))
+    {
+        zcis = new QFileDeviceInputStream(inputAsFileDevice);
+    }
+    else
+    {
+        zcis = new QIODeviceInputStream(_input);
+    }
+    _zeroCopyInputStream.reset(zcis);
+
+    // Create coded input stream wrapper
+    const auto cis = new gpb::io::CodedInputStream(zcis);
+    cis->SetTotalBytesLimit(std::numeric_limits<int>::max(), std::numeric_limits<int>::max());
+    _codedInputStream.reset(cis);
+}
+
 QString OsmAnd::ObfReader_P::transliterate( const QString& input )
 {
     return QString("!transliterate!");
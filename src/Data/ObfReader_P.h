@@ -62,6 +62,7 @@ namespace OsmAnd {
         std::shared_ptr<QIODevice> _input;
         std::shared_ptr<ObfInfo> _obfInfo;
 
+        void openInput();
         QString transliterate(const QString& input);
 
         static void readInfo(const std::unique_ptr<ObfReader_P>& reader, const std::shared_ptr<ObfInfo>& info);
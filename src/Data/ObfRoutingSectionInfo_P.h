@@ -33,6 +33,7 @@
 
 namespace OsmAnd {
 
+    class ObfInfoCache;
     class ObfRoutingSectionReader_P;
     namespace Model {
         STRONG_ENUM_EX(RoadDirection, int32_t);
@@ -95,6 +96,7 @@ namespace OsmAnd {
     friend class OsmAnd::RoutePlanner;
     friend class OsmAnd::RoutePlannerContext;
     friend class OsmAnd::RoutingRulesetContext;
+    friend class OsmAnd::ObfInfoCache;
     };
 
 } // namespace OsmAnd
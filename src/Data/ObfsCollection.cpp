@@ -3,6 +3,7 @@
 
 #include "ObfReader.h"
 #include "ObfDataInterface.h"
+#include "ObfInfoCache.h"
 #include "Logging.h"
 
 OsmAnd::ObfsCollection::ObfsCollection()
@@ -22,7 +23,7 @@ void OsmAnd::ObfsCollection::watchDirectory( const QDir& dir, bool recursive /*=
     entry->dir = dir;
     entry->recursive = recursive;
     _d->_watchedCollection.push_back(qMove(std::shared_ptr<ObfsCollection_P::WatchEntry>(entry)));
-    _d->_watchedCollectionChanged = true;
+    _d->_watchedCollectionVersion.fetchAndAddOrdered(1);
 }
 
 void OsmAnd::ObfsCollection::watchDirectory( const QString& dirPath, bool recursive /*= true*/ )
@@ -37,7 +38,7 @@ void OsmAnd::ObfsCollection::registerExplicitFile( const QFileInfo& fileInfo )
     auto entry = new ObfsCollection_P::ExplicitFileEntry();
     entry->fileInfo = fileInfo;
     _d->_watchedCollection.push_back(qMove(std::shared_ptr<ObfsCollection_P::WatchEntry>(entry)));
-    _d->_watchedCollectionChanged = true;
+    _d->_watchedCollectionVersion.fetchAndAddOrdered(1);
 }
 
 void OsmAnd::ObfsCollection::registerExplicitFile( const QString& filePath )
@@ -45,6 +46,16 @@ void OsmAnd::ObfsCollection::registerExplicitFile( const QString& filePath )
     registerExplicitFile(QFileInfo(filePath));
 }
 
+void OsmAnd::ObfsCollection::setInfoCacheDirectory( const QDir& dir )
+{
+    _d->setInfoCache(std::shared_ptr<const ObfInfoCache>(new ObfInfoCache(dir)));
+}
+
+void OsmAnd::ObfsCollection::setInfoCacheDirectory( const QString& dirPath )
+{
+    setInfoCacheDirectory(QDir(dirPath));
+}
+
 std::shared_ptr<OsmAnd::ObfDataInterface> OsmAnd::ObfsCollection::obtainDataInterface() const
 {
     return _d->obtainDataInterface();
@@ -1,23 +1,128 @@
 #include "ObfsCollection_P.h"
 #include "ObfsCollection.h"
 
+#include <cassert>
+
+#include <QVector>
+#if defined(__linux__)
+#   include <sys/inotify.h>
+#   include <poll.h>
+#   include <unistd.h>
+#   include <fcntl.h>
+#   include <cerrno>
+#endif
+
 #include "ObfReader.h"
 #include "ObfDataInterface.h"
 #include "ObfFile.h"
-#include "Utilities.h"
+#include "ObfFile_P.h"
+#include "ObfInfoCache.h"
+#include "Concurrent.h"
 #include "Logging.h"
 
 OsmAnd::ObfsCollection_P::ObfsCollection_P( ObfsCollection* owner_ )
     : owner(owner_)
     , _watchedCollectionMutex(QMutex::Recursive)
-    , _watchedCollectionChanged(false)
-    , _sourcesMutex(QMutex::Recursive)
-    , _sourcesRefreshedOnce(false)
+    , _watchedCollectionVersion(0)
+    , _refreshedWatchedCollectionVersion(-1)
+    , _inotifyFd(-1)
+    , _refreshTasksCount(0)
+    , _refreshTaskQueued(false)
+    , _fullRefreshRequested(false)
 {
+#if defined(__linux__)
+    _inotifyFd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+    if(_inotifyFd < 0)
+        LogPrintf(LogSeverityLevel::Warning, "Failed to initialize inotify (%d), OBF files changes will not be detected", errno);
+#endif
 }
 
 OsmAnd::ObfsCollection_P::~ObfsCollection_P()
 {
+    // Background refreshes reference this object, so wait for them
+    {
+        QMutexLocker scopedLocker(&_refreshTasksMutex);
+        while(_refreshTasksCount > 0)
+            _refreshTasksCondition.wait(&_refreshTasksMutex);
+    }
+
+#if defined(__linux__)
+    if(_inotifyFd >= 0)
+        close(_inotifyFd);
+#endif
+}
+
+std::shared_ptr<const OsmAnd::ObfsCollection_P::Sources> OsmAnd::ObfsCollection_P::getSourcesSnapshot() const
+{
+    QMutexLocker scopedLocker(&_sourcesSnapshotMutex);
+
+    return _sourcesSnapshot;
+}
+
+void OsmAnd::ObfsCollection_P::publishSourcesSnapshot( const std::shared_ptr<const Sources>& sourcesSnapshot )
+{
+    QMutexLocker scopedLocker(&_sourcesSnapshotMutex);
+
+    _sourcesSnapshot = sourcesSnapshot;
+}
+
+void OsmAnd::ObfsCollection_P::runInParallel( const QList< std::function<void ()> >& jobs )
+{
+    // Background refresh already occupies a worker of this pool, so waiting for other its workers may never end
+    if(Concurrent::pools->localStorage->isCurrentThreadWorker())
+    {
+        for(auto itJob = jobs.cbegin(); itJob != jobs.cend(); ++itJob)
+            (*itJob)();
+        return;
+    }
+
+    QMutex pendingJobsMutex;
+    QWaitCondition pendingJobsCondition;
+    auto pendingJobsCount = jobs.size();
+    for(auto itJob = jobs.cbegin(); itJob != jobs.cend(); ++itJob)
+    {
+        const auto& job = *itJob;
+
+        Concurrent::pools->localStorage->start(new Concurrent::Task(
+            [job]
+            (Concurrent::Task* task, QEventLoop& eventLoop)
+            {
+                job();
+            },
+            nullptr,
+            [&pendingJobsMutex, &pendingJobsCondition, &pendingJobsCount]
+            (Concurrent::Task* task, bool wasCancelled)
+            {
+                QMutexLocker scopedLocker(&pendingJobsMutex);
+                if(--pendingJobsCount == 0)
+                    pendingJobsCondition.wakeAll();
+            }));
+    }
+
+    {
+        QMutexLocker scopedLocker(&pendingJobsMutex);
+        while(pendingJobsCount > 0)
+            pendingJobsCondition.wait(&pendingJobsMutex);
+    }
+}
+
+void OsmAnd::ObfsCollection_P::scanDirectory( const QString& dirPath, const bool recursive, QStringList& outFiles, QStringList& outDirectories )
+{
+    const QDir dir(dirPath);
+    if(!dir.exists())
+        return;
+    outDirectories.push_back(dir.canonicalPath());
+
+    const auto& fileInfoList = dir.entryInfoList(QStringList() << QLatin1String("*.obf"), QDir::Files);
+    for(auto itFileInfo = fileInfoList.cbegin(); itFileInfo != fileInfoList.cend(); ++itFileInfo)
+        outFiles.push_back(itFileInfo->canonicalFilePath());
+
+    if(recursive)
+    {
+        const auto& subdirs = dir.entryInfoList(QStringList(), QDir::AllDirs | QDir::NoDotAndDotDot);
+        for(auto itSubdir = subdirs.cbegin(); itSubdir != subdirs.cend(); ++itSubdir)
+            scanDirectory(itSubdir->absoluteFilePath(), recursive, outFiles, outDirectories);
+    }
 }
 
 void OsmAnd::ObfsCollection_P::refreshSources()
@@ -26,108 +131,461 @@ void OsmAnd::ObfsCollection_P::refreshSources()
     const auto refreshSources_Begin = std::chrono::high_resolution_clock::now();
 #endif
 
-    QMutexLocker scopedLock(&_sourcesMutex);
+    QList< std::shared_ptr<WatchEntry> > watchedCollection;
+    int watchedCollectionVersion;
+    {
+        QMutexLocker scopedLocker(&_watchedCollectionMutex);
+
+        watchedCollection = _watchedCollection;
+        watchedCollectionVersion = _watchedCollectionVersion.load();
+    }
+
+    // Old watches and pending events are irrelevant, since everything is going to be scanned
+    resetFileSystemWatches();
+
+    // Scan all watched entries in parallel
+    QVector<QStringList> filesPerEntry(watchedCollection.size());
+    QVector<QStringList> directoriesPerEntry(watchedCollection.size());
+    QList< std::function<void ()> > scanJobs;
+    for(auto entryIdx = 0; entryIdx < watchedCollection.size(); entryIdx++)
+    {
+        const auto& entry = watchedCollection[entryIdx];
+        auto& outFiles = filesPerEntry[entryIdx];
+        auto& outDirectories = directoriesPerEntry[entryIdx];
+
+        if(entry->type == WatchEntry::WatchedDirectory)
+        {
+            const auto& watchedDirEntry = std::static_pointer_cast<WatchedDirectoryEntry>(entry);
+
+            scanJobs.push_back([watchedDirEntry, &outFiles, &outDirectories]()
+            {
+                scanDirectory(watchedDirEntry->dir.absolutePath(), watchedDirEntry->recursive, outFiles, outDirectories);
+            });
+        }
+        else if(entry->type == WatchEntry::ExplicitFile)
+        {
+            const auto& explicitFileEntry = std::static_pointer_cast<ExplicitFileEntry>(entry);
+
+            // Parent directory is watched to notice when this file is replaced or removed
+            const QFileInfo fileInfo(explicitFileEntry->fileInfo.absoluteFilePath());
+            outDirectories.push_back(fileInfo.absoluteDir().canonicalPath());
+            if(fileInfo.exists())
+                outFiles.push_back(fileInfo.canonicalFilePath());
+        }
+    }
+    runInParallel(scanJobs);
+
+    // Existing ObfFile objects are kept, so their headers are not read again
+    const auto currentSources = getSourcesSnapshot();
+    const std::shared_ptr<Sources> sources(new Sources());
+    QList< std::shared_ptr<ObfFile> > newObfFiles;
+    for(auto entryIdx = 0; entryIdx < watchedCollection.size(); entryIdx++)
+    {
+        const auto& files = filesPerEntry[entryIdx];
+        for(auto itFile = files.cbegin(); itFile != files.cend(); ++itFile)
+        {
+            const auto& obfFilePath = *itFile;
+            if(sources->contains(obfFilePath))
+                continue;
+
+            std::shared_ptr<ObfFile> obfFile;
+            if(currentSources)
+                obfFile = currentSources->value(obfFilePath);
+            if(!obfFile)
+            {
+                obfFile.reset(new ObfFile(obfFilePath));
+                obfFile->_d->_infoCache = _infoCache;
+                newObfFiles.push_back(obfFile);
+            }
+            sources->insert(obfFilePath, obfFile);
+        }
+
+        const auto& directories = directoriesPerEntry[entryIdx];
+        for(auto itDirectory = directories.cbegin(); itDirectory != directories.cend(); ++itDirectory)
+            addFileSystemWatch(*itDirectory);
+    }
+
+    // Headers of new files are obtained before they are published, so readers never wait for them
+    obtainSourcesInfo(newObfFiles);
+    publishSourcesSnapshot(sources);
+    _refreshedWatchedCollectionVersion.store(watchedCollectionVersion);
+
+#if defined(_DEBUG) || defined(DEBUG)
+    const auto refreshSources_End = std::chrono::high_resolution_clock::now();
+    const std::chrono::duration<float> refreshSources_Elapsed = refreshSources_End - refreshSources_Begin;
+    LogPrintf(LogSeverityLevel::Info, "Refreshed OBF sources (%d, %d new) in %fs", sources->size(), newObfFiles.size(), refreshSources_Elapsed.count());
+#endif
+}
+
+void OsmAnd::ObfsCollection_P::refreshSourcesIncrementally( const QSet<QString>& changedDirectories, const QSet<QString>& changedFiles )
+{
+    QList< std::shared_ptr<WatchEntry> > watchedCollection;
+    {
+        QMutexLocker scopedLocker(&_watchedCollectionMutex);
+
+        watchedCollection = _watchedCollection;
+    }
 
-    // Find all files that are present in watched entries
-    QFileInfoList obfs;
+    const auto currentSources = getSourcesSnapshot();
+    const std::shared_ptr<Sources> sources(new Sources(*currentSources));
+    QList< std::shared_ptr<ObfFile> > newObfFiles;
+    for(auto itDirectory = changedDirectories.cbegin(); itDirectory != changedDirectories.cend(); ++itDirectory)
     {
-        QMutexLocker scopedLock(&_watchedCollectionMutex);
+        const auto& dirPath = *itDirectory;
+
+        // Directory that is not watched is either new, or was moved or deleted together with its subdirectories,
+        // so everything under it has to be rescanned
+        const auto subtreeChanged = !_inotifyWatchedDirectories.contains(dirPath);
+        const auto subtreePrefix = dirPath + QLatin1Char('/');
+
+        // Forget all files from this directory, ones that still exist are added back below
+        Sources previousSources;
+        {
+            QMutableHashIterator< QString, std::shared_ptr<ObfFile> > itSource(*sources);
+            while(itSource.hasNext())
+            {
+                itSource.next();
+
+                const auto& obfFilePath = itSource.key();
+                if(QFileInfo(obfFilePath).absolutePath() != dirPath && !(subtreeChanged && obfFilePath.startsWith(subtreePrefix)))
+                    continue;
+                previousSources.insert(itSource.key(), itSource.value());
+                itSource.remove();
+            }
+        }
 
-        for(auto itEntry = _watchedCollection.cbegin(); itEntry != _watchedCollection.cend(); ++itEntry)
+        // Find out which watched entries cover this directory
+        bool covered = false;
+        bool coveredRecursively = false;
+        QStringList files;
+        for(auto itEntry = watchedCollection.cbegin(); itEntry != watchedCollection.cend(); ++itEntry)
         {
             const auto& entry = *itEntry;
 
             if(entry->type == WatchEntry::WatchedDirectory)
             {
                 const auto& watchedDirEntry = std::static_pointer_cast<WatchedDirectoryEntry>(entry);
+                const auto watchedDirPath = watchedDirEntry->dir.canonicalPath();
 
-                Utilities::findFiles(watchedDirEntry->dir, QStringList() << QLatin1String("*.obf"), obfs, watchedDirEntry->recursive);
+                if(dirPath == watchedDirPath)
+                    covered = true;
+                else if(watchedDirEntry->recursive && dirPath.startsWith(watchedDirPath + QLatin1Char('/')))
+                    covered = true;
+                else
+                    continue;
+                coveredRecursively = coveredRecursively || watchedDirEntry->recursive;
             }
             else if(entry->type == WatchEntry::ExplicitFile)
             {
                 const auto& explicitFileEntry = std::static_pointer_cast<ExplicitFileEntry>(entry);
 
-                if(explicitFileEntry->fileInfo.exists())
-                    obfs.push_back(explicitFileEntry->fileInfo);
+                const QFileInfo fileInfo(explicitFileEntry->fileInfo.absoluteFilePath());
+                if(fileInfo.absoluteDir().canonicalPath() == dirPath && fileInfo.exists())
+                    files.push_back(fileInfo.canonicalFilePath());
             }
         }
+
+        if(covered)
+        {
+            QStringList directories;
+            scanDirectory(dirPath, coveredRecursively && subtreeChanged, files, directories);
+            for(auto itSubdirectory = directories.cbegin(); itSubdirectory != directories.cend(); ++itSubdirectory)
+                addFileSystemWatch(*itSubdirectory);
+        }
+
+        for(auto itFile = files.cbegin(); itFile != files.cend(); ++itFile)
+        {
+            const auto& obfFilePath = *itFile;
+            if(sources->contains(obfFilePath))
+                continue;
+
+            // Modified files get new ObfFile, since their headers are no longer valid
+            auto obfFile = previousSources.value(obfFilePath);
+            if(!obfFile || changedFiles.contains(obfFilePath))
+            {
+                obfFile.reset(new ObfFile(obfFilePath));
+                obfFile->_d->_infoCache = _infoCache;
+                newObfFiles.push_back(obfFile);
+            }
+            sources->insert(obfFilePath, obfFile);
+        }
     }
 
-    // For each file in registry, ...
+    obtainSourcesInfo(newObfFiles);
+    publishSourcesSnapshot(sources);
+
+#if defined(_DEBUG) || defined(DEBUG)
+    LogPrintf(LogSeverityLevel::Info, "Refreshed OBF sources in %d changed directories: %d sources (was %d), %d new",
+        changedDirectories.size(), sources->size(), currentSources->size(), newObfFiles.size());
+#endif
+}
+
+void OsmAnd::ObfsCollection_P::obtainSourcesInfo( const QList< std::shared_ptr<ObfFile> >& obfFiles )
+{
+    QList< std::function<void ()> > jobs;
+    for(auto itObfFile = obfFiles.cbegin(); itObfFile != obfFiles.cend(); ++itObfFile)
     {
-        QMutableHashIterator< QString, std::shared_ptr<ObfFile> > itObfFileEntry(_sources);
-        while(itObfFileEntry.hasNext())
+        const auto& obfFile = *itObfFile;
         {
-            itObfFileEntry.next();
+            QMutexLocker scopedLocker(&obfFile->_d->_obfInfoMutex);
 
-            // ... which does not exist, ...
-            if(QFile::exists(itObfFileEntry.key()))
+            if(obfFile->_d->_obfInfo)
                 continue;
-
-            // ... remove entry
-            itObfFileEntry.remove();
         }
+
+        jobs.push_back([obfFile]()
+        {
+            // Either loads header from cache or parses it (and updates cache)
+            ObfReader obfReader(obfFile);
+            obfReader.obtainInfo();
+        });
+    }
+    runInParallel(jobs);
+}
+
+void OsmAnd::ObfsCollection_P::resetFileSystemWatches()
+{
+#if defined(__linux__)
+    if(_inotifyFd < 0)
+        return;
+
+    for(auto itWatch = _inotifyWatches.cbegin(); itWatch != _inotifyWatches.cend(); ++itWatch)
+        inotify_rm_watch(_inotifyFd, itWatch.key());
+    _inotifyWatches.clear();
+    _inotifyWatchedDirectories.clear();
+
+    // Drain pending events
+    char buffer[4096];
+    while(read(_inotifyFd, buffer, sizeof(buffer)) > 0)
+        ;
+#endif
+}
+
+void OsmAnd::ObfsCollection_P::addFileSystemWatch( const QString& dirPath )
+{
+#if defined(__linux__)
+    if(_inotifyFd < 0 || dirPath.isEmpty() || _inotifyWatchedDirectories.contains(dirPath))
+        return;
+
+    const auto wd = inotify_add_watch(_inotifyFd, QFile::encodeName(dirPath).constData(),
+        IN_CREATE | IN_DELETE | IN_CLOSE_WRITE | IN_MOVED_FROM | IN_MOVED_TO | IN_DELETE_SELF | IN_MOVE_SELF | IN_ONLYDIR);
+    if(wd < 0)
+    {
+        LogPrintf(LogSeverityLevel::Warning, "Failed to watch '%s' for changes (%d)", qPrintable(dirPath), errno);
+        return;
     }
+    _inotifyWatches.insert(wd, dirPath);
+    _inotifyWatchedDirectories.insert(dirPath);
+#endif
+}
 
-    // For each file, ...
-    for(auto itObfFileInfo = obfs.cbegin(); itObfFileInfo != obfs.cend(); ++itObfFileInfo)
+void OsmAnd::ObfsCollection_P::removeFileSystemWatches( const QString& dirPath )
+{
+#if defined(__linux__)
+    // Watches of subdirectories follow them to their new location, so their paths are no longer valid
+    const auto subtreePrefix = dirPath + QLatin1Char('/');
+    QMutableHashIterator<int, QString> itWatch(_inotifyWatches);
+    while(itWatch.hasNext())
     {
-        const auto& obfFileInfo = *itObfFileInfo;
+        itWatch.next();
 
-        const auto& obfFilePath = obfFileInfo.canonicalFilePath();
-        auto itObfFileEntry = _sources.constFind(obfFilePath);
+        const auto& watchedDirPath = itWatch.value();
+        if(watchedDirPath != dirPath && !watchedDirPath.startsWith(subtreePrefix))
+            continue;
 
-        // ... which is not yet present in registry, ...
-        if(itObfFileEntry == _sources.cend())
+        inotify_rm_watch(_inotifyFd, itWatch.key());
+        _inotifyWatchedDirectories.remove(watchedDirPath);
+        itWatch.remove();
+    }
+#endif
+}
+
+bool OsmAnd::ObfsCollection_P::hasFileSystemChanges() const
+{
+#if defined(__linux__)
+    if(_inotifyFd < 0)
+        return false;
+
+    pollfd pfd;
+    pfd.fd = _inotifyFd;
+    pfd.events = POLLIN;
+    pfd.revents = 0;
+    return (poll(&pfd, 1, 0) > 0) && (pfd.revents & POLLIN);
+#else
+    return false;
+#endif
+}
+
+bool OsmAnd::ObfsCollection_P::readFileSystemChanges( QSet<QString>& outChangedDirectories, QSet<QString>& outChangedFiles )
+{
+#if defined(__linux__)
+    if(_inotifyFd < 0)
+        return true;
+
+    bool overflow = false;
+    char buffer[4096] __attribute__((aligned(__alignof__(struct inotify_event))));
+    for(;;)
+    {
+        const auto length = read(_inotifyFd, buffer, sizeof(buffer));
+        if(length <= 0)
+            break;
+
+        for(auto ptr = buffer; ptr < buffer + length; )
         {
-            // ... create ObfFile
-            auto obfFile = new ObfFile(obfFilePath);
-            itObfFileEntry = _sources.insert(obfFilePath, std::shared_ptr<ObfFile>(obfFile));
+            const auto event = reinterpret_cast<const inotify_event*>(ptr);
+            ptr += sizeof(inotify_event) + event->len;
+
+            if(event->mask & IN_Q_OVERFLOW)
+            {
+                overflow = true;
+                continue;
+            }
+
+            const auto itWatch = _inotifyWatches.constFind(event->wd);
+            if(itWatch == _inotifyWatches.cend())
+                continue;
+            const auto dirPath = *itWatch;
+
+            // Watched directory itself is gone, so all its files and subdirectories are gone as well
+            if(event->mask & (IN_DELETE_SELF | IN_MOVE_SELF | IN_IGNORED))
+            {
+                outChangedDirectories.insert(dirPath);
+                removeFileSystemWatches(dirPath);
+                continue;
+            }
+            if(event->len == 0)
+                continue;
+
+            const auto name = QFile::decodeName(event->name);
+            const auto path = dirPath + QLatin1Char('/') + name;
+            if(event->mask & IN_ISDIR)
+            {
+                outChangedDirectories.insert(path);
+                if(event->mask & (IN_DELETE | IN_MOVED_FROM))
+                    removeFileSystemWatches(path);
+            }
+            else if(name.endsWith(QLatin1String(".obf"), Qt::CaseInsensitive))
+            {
+                outChangedDirectories.insert(dirPath);
+                if(event->mask & (IN_CLOSE_WRITE | IN_MOVED_TO))
+                    outChangedFiles.insert(path);
+            }
         }
     }
 
-#if defined(_DEBUG) || defined(DEBUG)
-    const auto refreshSources_End = std::chrono::high_resolution_clock::now();
-    const std::chrono::duration<float> refreshSources_Elapsed = refreshSources_End - refreshSources_Begin;
-    LogPrintf(LogSeverityLevel::Info, "Refreshed OBF sources in %fs", refreshSources_Elapsed.count());
+    return !overflow;
+#else
+    return true;
 #endif
+}
+
+void OsmAnd::ObfsCollection_P::scheduleRefresh( const bool fullRefresh )
+{
+    QMutexLocker scopedLocker(&_refreshTasksMutex);
 
-    // Mark that sources were refreshed at least once
-    _sourcesRefreshedOnce = true;
+    _fullRefreshRequested = _fullRefreshRequested || fullRefresh;
+
+    // Queued refresh will pick up all changes made so far
+    if(_refreshTaskQueued)
+        return;
+    _refreshTaskQueued = true;
+    _refreshTasksCount++;
+
+    Concurrent::pools->localStorage->start(new Concurrent::Task(
+        [this]
+        (Concurrent::Task* task, QEventLoop& eventLoop)
+        {
+            performScheduledRefresh();
+        }));
 }
 
-std::shared_ptr<OsmAnd::ObfDataInterface> OsmAnd::ObfsCollection_P::obtainDataInterface()
+void OsmAnd::ObfsCollection_P::performScheduledRefresh()
 {
-    QMutexLocker scopedLock_sourcesMutex(&_sourcesMutex);
-    QMutexLocker scopedLock_watchedEntries(&_watchedCollectionMutex);
+    bool fullRefresh;
+    {
+        QMutexLocker scopedLocker(&_refreshTasksMutex);
+
+        _refreshTaskQueued = false;
+        fullRefresh = _fullRefreshRequested;
+        _fullRefreshRequested = false;
+    }
 
-    // Refresh sources
-    if(!_sourcesRefreshedOnce)
     {
-#if defined(DEBUG) || defined(_DEBUG)
-        LogPrintf(LogSeverityLevel::Info, "Refreshing OBF sources because they were never initialized");
-#endif
+        QMutexLocker scopedLocker(&_refreshMutex);
 
-        // if sources have never been initialized
-        refreshSources();
+        if(fullRefresh || !getSourcesSnapshot())
+        {
+            refreshSources();
+        }
+        else
+        {
+            QSet<QString> changedDirectories;
+            QSet<QString> changedFiles;
+            if(!readFileSystemChanges(changedDirectories, changedFiles))
+                refreshSources();
+            else if(!changedDirectories.isEmpty())
+                refreshSourcesIncrementally(changedDirectories, changedFiles);
+        }
+    }
 
-        // Clear changed flag if it's raised, since it was already processed
-        if(_watchedCollectionChanged)
-            _watchedCollectionChanged = false;
+    {
+        QMutexLocker scopedLocker(&_refreshTasksMutex);
+
+        _refreshTasksCount--;
+        _refreshTasksCondition.wakeAll();
     }
-    else if(_watchedCollectionChanged)
+}
+
+void OsmAnd::ObfsCollection_P::setInfoCache( const std::shared_ptr<const ObfInfoCache>& infoCache )
+{
+    QMutexLocker scopedLocker(&_refreshMutex);
+
+    _infoCache = infoCache;
+
+    if(const auto sourcesSnapshot = getSourcesSnapshot())
     {
+        for(auto itSource = sourcesSnapshot->cbegin(); itSource != sourcesSnapshot->cend(); ++itSource)
+        {
+            const auto& obfFile = itSource.value();
+
+            QMutexLocker scopedLocker(&obfFile->_d->_obfInfoMutex);
+            obfFile->_d->_infoCache = _infoCache;
+        }
+    }
+}
+
+std::shared_ptr<OsmAnd::ObfDataInterface> OsmAnd::ObfsCollection_P::obtainDataInterface()
+{
+    auto sourcesSnapshot = getSourcesSnapshot();
+
+    // Sources are collected synchronously only first time, all later refreshes run in background
+    if(!sourcesSnapshot)
+    {
+        QMutexLocker scopedLocker(&_refreshMutex);
+
+        sourcesSnapshot = getSourcesSnapshot();
+        if(!sourcesSnapshot)
+        {
 #if defined(DEBUG) || defined(_DEBUG)
-        LogPrintf(LogSeverityLevel::Info, "Refreshing OBF sources because watch-collecting was changed");
+            LogPrintf(LogSeverityLevel::Info, "Refreshing OBF sources because they were never initialized");
 #endif
 
-        // if watched collection has changed
-        refreshSources();
-        _watchedCollectionChanged = false;
+            refreshSources();
+            sourcesSnapshot = getSourcesSnapshot();
+        }
+    }
+    else if(_refreshedWatchedCollectionVersion.load() != _watchedCollectionVersion.load())
+    {
+        // Until refresh completes, previous snapshot is used
+        scheduleRefresh(true);
+    }
+    else if(hasFileSystemChanges())
+    {
+        scheduleRefresh(false);
     }
 
     QList< std::shared_ptr<ObfReader> > obfReaders;
-    for(auto itSource = _sources.cbegin(); itSource != _sources.cend(); ++itSource)
+    for(auto itSource = sourcesSnapshot->cbegin(); itSource != sourcesSnapshot->cend(); ++itSource)
     {
         const auto& obfFile = itSource.value();
 
@@ -24,11 +24,16 @@
 #define _OSMAND_CORE_OBFS_COLLECTION_P_H_
 
 #include <OsmAndCore/stdlib_common.h>
+#include <functional>
 
 #include <OsmAndCore/QtExtensions.h>
 #include <QDir>
 #include <QHash>
+#include <QSet>
+#include <QStringList>
 #include <QMutex>
+#include <QWaitCondition>
+#include <QAtomicInt>
 
 #include <OsmAndCore.h>
 #include <OsmAndCore/CommonTypes.h>
@@ -36,6 +41,7 @@
 namespace OsmAnd {
 
     class ObfFile;
+    class ObfInfoCache;
     class ObfDataInterface;
 
     class ObfsCollection;
@@ -83,12 +89,47 @@ namespace OsmAnd {
             QFileInfo fileInfo;
         };
         QList< std::shared_ptr<WatchEntry> > _watchedCollection;
-        bool _watchedCollectionChanged;
-
-        mutable QMutex _sourcesMutex;
-        QHash< QString, std::shared_ptr<ObfFile> > _sources;
-        bool _sourcesRefreshedOnce;
+        QAtomicInt _watchedCollectionVersion;
+        QAtomicInt _refreshedWatchedCollectionVersion;
+
+        // Published sources are never modified: refresh builds new snapshot and replaces current one,
+        // so readers hold the lock only while copying a pointer
+        typedef QHash< QString, std::shared_ptr<ObfFile> > Sources;
+        mutable QMutex _sourcesSnapshotMutex;
+        std::shared_ptr<const Sources> _sourcesSnapshot;
+        std::shared_ptr<const Sources> getSourcesSnapshot() const;
+        void publishSourcesSnapshot(const std::shared_ptr<const Sources>& sourcesSnapshot);
+
+        // All following fields and methods expect refresh lock to be held, so only one refresh runs at a time
+        QMutex _refreshMutex;
+        std::shared_ptr<const ObfInfoCache> _infoCache;
         void refreshSources();
+        void refreshSourcesIncrementally(const QSet<QString>& changedDirectories, const QSet<QString>& changedFiles);
+        void obtainSourcesInfo(const QList< std::shared_ptr<ObfFile> >& obfFiles);
+        static void runInParallel(const QList< std::function<void ()> >& jobs);
+        static void scanDirectory(const QString& dirPath, const bool recursive, QStringList& outFiles, QStringList& outDirectories);
+
+        // Changes in file system are detected using inotify where it's available. Elsewhere sources are
+        // refreshed only when watched collection changes
+        int _inotifyFd;
+        QHash<int, QString> _inotifyWatches;
+        QSet<QString> _inotifyWatchedDirectories;
+        void resetFileSystemWatches();
+        void addFileSystemWatch(const QString& dirPath);
+        void removeFileSystemWatches(const QString& dirPath);
+        bool hasFileSystemChanges() const;
+        bool readFileSystemChanges(QSet<QString>& outChangedDirectories, QSet<QString>& outChangedFiles);
+
+        // Background refreshes
+        mutable QMutex _refreshTasksMutex;
+        QWaitCondition _refreshTasksCondition;
+        unsigned int _refreshTasksCount;
+        bool _refreshTaskQueued;
+        bool _fullRefreshRequested;
+        void scheduleRefresh(const bool fullRefresh);
+        void performScheduledRefresh();
+
+        void setInfoCache(const std::shared_ptr<const ObfInfoCache>& infoCache);
     public:
         virtual ~ObfsCollection_P();
 
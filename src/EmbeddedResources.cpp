@@ -1,8 +1,35 @@
 #include "EmbeddedResources.h"
 #include "EmbeddedResources_private.h"
 
+#include <algorithm>
+
+#include <OsmAndCore/QtExtensions.h>
+#include <QCache>
+#include <QMutex>
+
 #include "Logging.h"
 
+namespace OsmAnd {
+    // Decompressed resources are kept in memory, but not more than this amount of bytes
+    static const int DecompressedResourcesCacheCapacity = 8 * 1024 * 1024;
+
+    static QMutex g_OsmAnd_EmbeddedResources_decompressedCacheMutex;
+    static QCache<QString, QByteArray> g_OsmAnd_EmbeddedResources_decompressedCache(DecompressedResourcesCacheCapacity);
+
+    static const EmbeddedResource* findEmbeddedResource(const QString& name)
+    {
+        const auto itEnd = __bundled_resources + __bundled_resources_count;
+        const auto itResource = std::lower_bound(__bundled_resources, itEnd, name,
+            [](const EmbeddedResource& resource, const QString& name) -> bool
+            {
+                return resource.name < name;
+            });
+        if(itResource == itEnd || itResource->name != name)
+            return nullptr;
+        return itResource;
+    }
+}
+
 OsmAnd::EmbeddedResources::EmbeddedResources()
 {
 }
@@ -11,46 +38,60 @@ OsmAnd::EmbeddedResources::~EmbeddedResources()
 {
 }
 
-QByteArray OsmAnd::EmbeddedResources::decompressResource( const QString& name, bool* ok_ /*= nullptr*/ )
+QByteArray OsmAnd::EmbeddedResources::decompressResource( const QString& name, bool* ok /*= nullptr*/ )
 {
-    bool ok = false;
-    const auto compressedData = getRawResource(name, &ok);
-    if(!ok)
+    const auto resource = findEmbeddedResource(name);
+    if(!resource)
     {
-        if(ok_)
-            *ok_ = false;
+        LogPrintf(LogSeverityLevel::Error, "Embedded resource '%s' was not found", qPrintable(name));
+        if(ok)
+            *ok = false;
         return QByteArray();
     }
+    if(ok)
+        *ok = true;
+
+    // Uncompressed resources are returned without copying
+    if(!resource->isCompressed)
+        return QByteArray::fromRawData(reinterpret_cast<const char*>(resource->data), resource->size);
+
+    {
+        QMutexLocker scopedLocker(&g_OsmAnd_EmbeddedResources_decompressedCacheMutex);
 
-    return qUncompress(compressedData);
+        const auto pCachedData = g_OsmAnd_EmbeddedResources_decompressedCache.object(name);
+        if(pCachedData)
+            return *pCachedData;
+    }
+
+    const auto data = qUncompress(resource->data, resource->size);
+
+    {
+        QMutexLocker scopedLocker(&g_OsmAnd_EmbeddedResources_decompressedCacheMutex);
+
+        // Resources larger than entire cache are simply not cached
+        g_OsmAnd_EmbeddedResources_decompressedCache.insert(name, new QByteArray(data), data.size());
+    }
+
+    return data;
 }
 
 QByteArray OsmAnd::EmbeddedResources::getRawResource( const QString& name, bool* ok /*= nullptr*/ )
 {
-    for(auto idx = 0u; idx < __bundled_resources_count; idx++)
+    const auto resource = findEmbeddedResource(name);
+    if(!resource)
     {
-        if(__bundled_resources[idx].name != name)
-            continue;
-
+        LogPrintf(LogSeverityLevel::Error, "Embedded resource '%s' was not found", qPrintable(name));
         if(ok)
-            *ok = true;
-        return QByteArray(reinterpret_cast<const char*>(__bundled_resources[idx].data), __bundled_resources[idx].size);
+            *ok = false;
+        return QByteArray();
     }
 
-    LogPrintf(LogSeverityLevel::Error, "Embedded resource '%s' was not found", qPrintable(name));
     if(ok)
-        *ok = false;
-    return QByteArray();
+        *ok = true;
+    return QByteArray::fromRawData(reinterpret_cast<const char*>(resource->data), resource->size);
 }
 
 bool OsmAnd::EmbeddedResources::containsResource( const QString& name )
 {
-    for(auto idx = 0u; idx < __bundled_resources_count; idx++)
-    {
-        if(__bundled_resources[idx].name != name)
-            continue;
-
-        return true;
-    }
-    return false;
+    return findEmbeddedResource(name) != nullptr;
 }
@@ -30,8 +30,10 @@ namespace OsmAnd {
         QString name;
         size_t size;
         const uint8_t* data;
+        bool isCompressed;
     };
 
+    // Sorted by name
     extern const EmbeddedResource __bundled_resources[];
     extern const uint32_t __bundled_resources_count;
 
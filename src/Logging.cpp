@@ -3,210 +3,416 @@
 #include <cassert>
 #include <cstdio>
 #include <cstdarg>
+#include <cstring>
 
 #include <QReadWriteLock>
 #include <QFileDevice>
+#include <QMutex>
+#include <QWaitCondition>
+#include <QAtomicInt>
+#include <QByteArray>
+#include <QThreadStorage>
+
+#if defined(ANDROID) || defined(__ANDROID__)
+#   include <android/log.h>
+#elif defined(WIN32)
+#   define WIN32_LEAN_AND_MEAN
+#   include <windows.h>
+#endif
+
+#include "Concurrent.h"
 
 static QReadWriteLock _loggingDeviceLock;
 static std::shared_ptr<QIODevice> _loggingDevice;
 static bool _autoCloseLoggingDevice;
+static QAtomicInt _severityLevelThreshold(static_cast<int>(OsmAnd::LogSeverityLevel::Debug));
+static QAtomicInt _totalDroppedMessagesCount(0);
+// Set by writer destructor during process shutdown, while other threads may still be logging
+static QAtomicInt _asyncLogWriterDestroyed(0);
+// Constructed before writer, so it outlives it
+static QThreadStorage<QByteArray> _formattingBuffers;
+
+// Formats message into buffer, which grows to fit it. Buffer keeps its size, so message is formatted twice
+// only when it's longer than all previous ones formatted into same buffer. Returns length of message
+static int formatMessage(QByteArray& buffer, const char* format, va_list args)
+{
+    if(buffer.isEmpty())
+        buffer.resize(1024);
+
+    va_list argsCopy;
+    va_copy(argsCopy, args);
+    auto length = vsnprintf(buffer.data(), buffer.size(), format, argsCopy);
+    va_end(argsCopy);
+    if(length >= buffer.size())
+    {
+        buffer.resize(length + 1);
+        va_copy(argsCopy, args);
+        length = vsnprintf(buffer.data(), buffer.size(), format, argsCopy);
+        va_end(argsCopy);
+    }
+    if(length < 0)
+    {
+        buffer[0] = '\0';
+        length = 0;
+    }
+    return length;
+}
 
 #if defined(ANDROID) || defined(__ANDROID__)
 
-#include <android/log.h>
-
-OSMAND_CORE_API void OSMAND_CORE_CALL OsmAnd::LogPrintf(OsmAnd::LogSeverityLevel level, const char* format, ...)
+static void writeToSystemLog(const OsmAnd::LogSeverityLevel level, const char* message)
 {
-    va_list args;
-    va_start(args, format);
     int androidLevel;
     switch(level)
     {
-    case LogSeverityLevel::Error:
+    case OsmAnd::LogSeverityLevel::Error:
         androidLevel = ANDROID_LOG_ERROR;
         break;
-    case LogSeverityLevel::Warning:
+    case OsmAnd::LogSeverityLevel::Warning:
         androidLevel = ANDROID_LOG_WARN;
         break;
-    case LogSeverityLevel::Info:
+    case OsmAnd::LogSeverityLevel::Info:
         androidLevel = ANDROID_LOG_INFO;
         break;
-    case LogSeverityLevel::Debug:
+    case OsmAnd::LogSeverityLevel::Debug:
+    default:
         androidLevel = ANDROID_LOG_DEBUG;
         break;
     }
-    __android_log_vprint(androidLevel, "net.osmand:native", format, args);
-    va_end(args);
+    __android_log_write(androidLevel, "net.osmand:native", message);
+}
 
-    // Save to logging device (if such exists)
-    {
-        QReadLocker scopedLocker(&_loggingDeviceLock);
-        if(_loggingDevice)
-        {
-            QString logLine;
+static void flushSystemLog()
+{
+}
 
-            va_list args;
-            va_start(args, format);
-            logLine.vsprintf(format, args);
-            va_end(args);
-            logLine.append(QLatin1String("\n"));
+#else
 
-            _loggingDevice->write(logLine.toUtf8());
-        }
-    }
+static const char* getSeverityLevelPrefix(const OsmAnd::LogSeverityLevel level)
+{
+    if(level == OsmAnd::LogSeverityLevel::Error)
+        return "ERROR: ";
+    else if(level == OsmAnd::LogSeverityLevel::Info)
+        return "INFO: ";
+    else if(level == OsmAnd::LogSeverityLevel::Warning)
+        return "WARN: ";
+    return "DEBUG: ";
 }
 
-OSMAND_CORE_API void OSMAND_CORE_CALL OsmAnd::LogFlush()
+#   if defined(WIN32)
+
+static void writeToSystemLog(const OsmAnd::LogSeverityLevel level, const char* message)
 {
-    // Flush the logging device if supported
+    if(IsDebuggerPresent())
     {
-        QReadLocker scopedLocker(&_loggingDeviceLock);
-        if(_loggingDevice)
-        {
-            if(const auto loggingDevice = std::dynamic_pointer_cast<QFileDevice>(_loggingDevice))
-                loggingDevice->flush();
-        }
-        
+        OutputDebugStringA(getSeverityLevelPrefix(level));
+        OutputDebugStringA(message);
+        OutputDebugStringA("\n");
     }
+    else
+        printf("%s%s\n", getSeverityLevelPrefix(level), message);
+}
+
+static void flushSystemLog()
+{
+    if(!IsDebuggerPresent())
+        fflush(stdout);
 }
 
-#elif defined(__APPLE__) || defined(__linux__)
+#   else
 
-OSMAND_CORE_API void OSMAND_CORE_CALL OsmAnd::LogPrintf(OsmAnd::LogSeverityLevel level, const char* format, ...)
+static void writeToSystemLog(const OsmAnd::LogSeverityLevel level, const char* message)
 {
-    va_list args;
-    va_start(args, format);
-    if(level == LogSeverityLevel::Error)
-        printf("ERROR: ");
-    else if(level == LogSeverityLevel::Info)
-        printf("INFO: ");
-    else if(level == LogSeverityLevel::Warning)
-        printf("WARN: ");
-    else
-        printf("DEBUG: ");
-    vprintf(format, args);
-    printf("\n");
-    va_end(args);
+    printf("%s%s\n", getSeverityLevelPrefix(level), message);
+}
 
-    // Save to logging device (if such exists)
-    {
-        QReadLocker scopedLocker(&_loggingDeviceLock);
-        if(_loggingDevice)
-        {
-            QString logLine;
+static void flushSystemLog()
+{
+    fflush(stdout);
+}
 
-            va_list args;
-            va_start(args, format);
-            logLine.vsprintf(format, args);
-            va_end(args);
-            logLine.append(QLatin1String("\n"));
+#   endif
 
-            _loggingDevice->write(logLine.toUtf8());
-        }
+#endif
+
+static void flushLoggingDevice()
+{
+    QReadLocker scopedLocker(&_loggingDeviceLock);
+    if(_loggingDevice)
+    {
+        if(const auto loggingDevice = std::dynamic_pointer_cast<QFileDevice>(_loggingDevice))
+            loggingDevice->flush();
     }
 }
 
-OSMAND_CORE_API void OSMAND_CORE_CALL OsmAnd::LogFlush()
+namespace
 {
-    fflush(stdout);
-
-    // Flush the logging device if supported
+    // Bounded multiple-producers single-consumer queue of formatted messages, drained by writer thread.
+    // Each entry carries a sequence number that tells whether it's free for producer or ready for consumer.
+    class AsyncLogWriter
     {
-        QReadLocker scopedLocker(&_loggingDeviceLock);
-        if(_loggingDevice)
+    public:
+        enum {
+            // Must be power of 2
+            QueueSize = 1024,
+            InlineMessageLength = 496,
+        };
+    private:
+        struct Entry
+        {
+            QAtomicInt sequence;
+            OsmAnd::LogSeverityLevel level;
+            // Messages that do not fit inline buffer are allocated on heap
+            char* longMessage;
+            char message[InlineMessageLength];
+        };
+        Entry _queue[QueueSize];
+        QAtomicInt _enqueuePosition;
+        QAtomicInt _dequeuePosition;
+        QAtomicInt _droppedMessagesCount;
+
+        QMutex _wakeupMutex;
+        QWaitCondition _wakeupCondition;
+        QWaitCondition _drainedCondition;
+        QAtomicInt _writerIdle;
+        QAtomicInt _stopRequested;
+        std::unique_ptr<OsmAnd::Concurrent::Thread> _thread;
+
+        bool hasPendingEntries() const
         {
-            if(const auto loggingDevice = std::dynamic_pointer_cast<QFileDevice>(_loggingDevice))
-                loggingDevice->flush();
+            const auto position = static_cast<unsigned int>(_dequeuePosition.loadAcquire());
+            const auto& entry = _queue[position & (QueueSize - 1)];
+            return static_cast<unsigned int>(entry.sequence.loadAcquire()) == position + 1;
         }
 
-    }
-}
+        void drain()
+        {
+            QByteArray deviceBuffer;
+            for(;;)
+            {
+                const auto position = static_cast<unsigned int>(_dequeuePosition.loadAcquire());
+                auto& entry = _queue[position & (QueueSize - 1)];
+                if(static_cast<unsigned int>(entry.sequence.loadAcquire()) != position + 1)
+                    break;
+
+                const auto message = entry.longMessage ? entry.longMessage : entry.message;
+                writeToSystemLog(entry.level, message);
+                deviceBuffer.append(message);
+                deviceBuffer.append('\n');
+                delete[] entry.longMessage;
+                entry.longMessage = nullptr;
+
+                // Release entry for producers of next round
+                entry.sequence.storeRelease(static_cast<int>(position + QueueSize));
+                _dequeuePosition.storeRelease(static_cast<int>(position + 1));
+            }
+
+            const auto droppedMessagesCount = _droppedMessagesCount.fetchAndStoreOrdered(0);
+            if(droppedMessagesCount > 0)
+            {
+                char message[64];
+                snprintf(message, sizeof(message), "%d log messages were dropped", droppedMessagesCount);
+                writeToSystemLog(OsmAnd::LogSeverityLevel::Warning, message);
+                deviceBuffer.append(message);
+                deviceBuffer.append('\n');
+            }
+
+            if(!deviceBuffer.isEmpty())
+            {
+                QReadLocker scopedLocker(&_loggingDeviceLock);
+                if(_loggingDevice)
+                    _loggingDevice->write(deviceBuffer);
+            }
+        }
 
-#elif defined(WIN32)
+        void threadProcedure()
+        {
+            for(;;)
+            {
+                drain();
+
+                QMutexLocker scopedLocker(&_wakeupMutex);
+                _drainedCondition.wakeAll();
+                if(_stopRequested.loadAcquire())
+                {
+                    if(hasPendingEntries())
+                        continue;
+                    break;
+                }
+
+                _writerIdle.storeRelease(1);
+                if(!hasPendingEntries())
+                    _wakeupCondition.wait(&_wakeupMutex, 100);
+                _writerIdle.storeRelease(0);
+            }
+        }
+    public:
+        AsyncLogWriter()
+            : _enqueuePosition(0)
+            , _dequeuePosition(0)
+            , _droppedMessagesCount(0)
+            , _writerIdle(0)
+            , _stopRequested(0)
+        {
+            for(unsigned int entryIdx = 0; entryIdx < QueueSize; entryIdx++)
+            {
+                _queue[entryIdx].sequence.storeRelease(static_cast<int>(entryIdx));
+                _queue[entryIdx].longMessage = nullptr;
+            }
+
+            _thread.reset(new OsmAnd::Concurrent::Thread(std::bind(&AsyncLogWriter::threadProcedure, this)));
+            _thread->start();
+        }
+
+        ~AsyncLogWriter()
+        {
+            {
+                QMutexLocker scopedLocker(&_wakeupMutex);
+                _stopRequested.storeRelease(1);
+                _wakeupCondition.wakeAll();
+            }
+            _thread->wait();
+            _thread.reset();
+
+            for(unsigned int entryIdx = 0; entryIdx < QueueSize; entryIdx++)
+                delete[] _queue[entryIdx].longMessage;
+
+            _asyncLogWriterDestroyed.storeRelease(1);
+        }
+
+        void enqueue(const OsmAnd::LogSeverityLevel level, const char* format, va_list args)
+        {
+            // Claim an entry
+            auto position = static_cast<unsigned int>(_enqueuePosition.loadAcquire());
+            Entry* entry;
+            for(;;)
+            {
+                entry = &_queue[position & (QueueSize - 1)];
+                const auto sequence = static_cast<unsigned int>(entry->sequence.loadAcquire());
+                const auto difference = static_cast<int>(sequence - position);
+                if(difference == 0)
+                {
+                    if(_enqueuePosition.testAndSetOrdered(static_cast<int>(position), static_cast<int>(position + 1)))
+                        break;
+                }
+                else if(difference < 0)
+                {
+                    // Queue is full, so writer is behind. Message is dropped instead of blocking the caller
+                    _droppedMessagesCount.ref();
+                    _totalDroppedMessagesCount.ref();
+                    return;
+                }
+                position = static_cast<unsigned int>(_enqueuePosition.loadAcquire());
+            }
+
+            // Format message once in per-thread buffer and copy it into claimed entry
+            entry->level = level;
+            auto& buffer = _formattingBuffers.localData();
+            const auto length = formatMessage(buffer, format, args);
+            if(length < InlineMessageLength)
+                memcpy(entry->message, buffer.constData(), length + 1);
+            else
+            {
+                entry->longMessage = new char[length + 1];
+                memcpy(entry->longMessage, buffer.constData(), length + 1);
+            }
+
+            // Publish entry to writer
+            entry->sequence.storeRelease(static_cast<int>(position + 1));
+
+            if(_writerIdle.loadAcquire())
+            {
+                QMutexLocker scopedLocker(&_wakeupMutex);
+                _wakeupCondition.wakeOne();
+            }
+        }
+
+        void waitUntilDrained()
+        {
+            const auto targetPosition = static_cast<unsigned int>(_enqueuePosition.loadAcquire());
+
+            QMutexLocker scopedLocker(&_wakeupMutex);
+            _wakeupCondition.wakeOne();
+            while(static_cast<int>(targetPosition - static_cast<unsigned int>(_dequeuePosition.loadAcquire())) > 0)
+            {
+                if(_stopRequested.loadAcquire())
+                    break;
+                _drainedCondition.wait(&_wakeupMutex, 100);
+            }
+        }
+    };
 
-#define WIN32_LEAN_AND_MEAN
-#include <windows.h>
+    AsyncLogWriter& getAsyncLogWriter()
+    {
+        static AsyncLogWriter asyncLogWriter;
+        return asyncLogWriter;
+    }
+}
 
 OSMAND_CORE_API void OSMAND_CORE_CALL OsmAnd::LogPrintf(OsmAnd::LogSeverityLevel level, const char* format, ...)
 {
+    if(!IsLogSeverityLevelEnabled(level))
+        return;
+
     va_list args;
     va_start(args, format);
-    
-    if(IsDebuggerPresent())
+    if(!_asyncLogWriterDestroyed.loadAcquire())
     {
-        if(level == LogSeverityLevel::Error)
-            OutputDebugStringA("ERROR: ");
-        else if(level == LogSeverityLevel::Info)
-            OutputDebugStringA("INFO: ");
-        else if(level == LogSeverityLevel::Warning)
-            OutputDebugStringA("WARN: ");
-        else
-            OutputDebugStringA("DEBUG: ");
-
-        int len = vsnprintf(nullptr, 0, format, args);
-        char* buffer = new char[len + 1];
-        vsnprintf(buffer, len, format, args);
-        buffer[len] = 0;
-        OutputDebugStringA(buffer);
-        delete[] buffer;
-
-        OutputDebugStringA("\n");
+        getAsyncLogWriter().enqueue(level, format, args);
     }
     else
     {
-        if(level == LogSeverityLevel::Error)
-            printf("ERROR: ");
-        else if(level == LogSeverityLevel::Info)
-            printf("INFO: ");
-        else if(level == LogSeverityLevel::Warning)
-            printf("WARN: ");
-        else
-            printf("DEBUG: ");
-        vprintf(format, args);
-        printf("\n");
-    }
-    
-    va_end(args);
+        // Writer thread is gone during process shutdown, so write synchronously
+        QByteArray message;
+        message.resize(formatMessage(message, format, args));
 
-    // Save to logging device (if such exists)
-    {
-        QReadLocker scopedLocker(&_loggingDeviceLock);
-        if(_loggingDevice)
+        writeToSystemLog(level, message.constData());
         {
-            QString logLine;
-
-            va_list args;
-            va_start(args, format);
-            logLine.vsprintf(format, args);
-            va_end(args);
-            logLine.append(QLatin1String("\n"));
-
-            _loggingDevice->write(logLine.toUtf8());
+            QReadLocker scopedLocker(&_loggingDeviceLock);
+            if(_loggingDevice)
+                _loggingDevice->write(message.append('\n'));
         }
     }
+    va_end(args);
 }
 
 OSMAND_CORE_API void OSMAND_CORE_CALL OsmAnd::LogFlush()
 {
-    if(!IsDebuggerPresent())
-        fflush(stdout);
+    if(!_asyncLogWriterDestroyed.loadAcquire())
+        getAsyncLogWriter().waitUntilDrained();
+
+    flushSystemLog();
 
     // Flush the logging device if supported
-    {
-        QReadLocker scopedLocker(&_loggingDeviceLock);
-        if(_loggingDevice)
-        {
-            if(const auto loggingDevice = std::dynamic_pointer_cast<QFileDevice>(_loggingDevice))
-                loggingDevice->flush();
-        }
+    flushLoggingDevice();
+}
 
-    }
+OSMAND_CORE_API void OSMAND_CORE_CALL OsmAnd::SetLogSeverityLevelThreshold(const LogSeverityLevel threshold)
+{
+    _severityLevelThreshold.storeRelease(static_cast<int>(threshold));
 }
 
-#endif
+OSMAND_CORE_API OsmAnd::LogSeverityLevel OSMAND_CORE_CALL OsmAnd::GetLogSeverityLevelThreshold()
+{
+    return static_cast<LogSeverityLevel>(_severityLevelThreshold.loadAcquire());
+}
+
+OSMAND_CORE_API bool OSMAND_CORE_CALL OsmAnd::IsLogSeverityLevelEnabled(const LogSeverityLevel level)
+{
+    const auto threshold = static_cast<LogSeverityLevel>(_severityLevelThreshold.loadAcquire());
+    return GetLogSeverityLevelVerbosity(level) <= GetLogSeverityLevelVerbosity(threshold);
+}
+
+OSMAND_CORE_API unsigned int OSMAND_CORE_CALL OsmAnd::GetDroppedLogMessagesCount()
+{
+    return static_cast<unsigned int>(_totalDroppedMessagesCount.loadAcquire());
+}
 
 OSMAND_CORE_API void OSMAND_CORE_CALL OsmAnd::SaveLogsTo(const std::shared_ptr<QIODevice>& outputDevice, const bool autoClose /*= false*/)
 {
+    // Messages queued before this call belong to previous device
+    LogFlush();
+
     QWriteLocker scopedLocker(&_loggingDeviceLock);
 
     assert(outputDevice->isOpen() && outputDevice->isWritable());
@@ -216,6 +422,9 @@ OSMAND_CORE_API void OSMAND_CORE_CALL OsmAnd::SaveLogsTo(const std::shared_ptr<Q
 
 OSMAND_CORE_API void OSMAND_CORE_CALL OsmAnd::StopSavingLogs()
 {
+    // Write all queued messages before device is detached
+    LogFlush();
+
     QWriteLocker scopedLocker(&_loggingDeviceLock);
 
     if(_loggingDevice)
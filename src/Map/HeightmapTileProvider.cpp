@@ -6,6 +6,8 @@ const QString OsmAnd::HeightmapTileProvider::defaultIndexFilename("heightmap.ind
 OsmAnd::HeightmapTileProvider::HeightmapTileProvider( const QDir& dataPath, const QString& indexFilepath/* = QString()*/ )
     : _d(new HeightmapTileProvider_P(this, dataPath, indexFilepath))
 {
+    const auto tileSize = getTileSize();
+    _d->_buffersPool.reset(new HeightmapTileProvider_P::BuffersPool(tileSize*tileSize, 64));
 }
 
 OsmAnd::HeightmapTileProvider::~HeightmapTileProvider()
@@ -2,16 +2,28 @@
 #include "HeightmapTileProvider.h"
 
 #include <cassert>
+#include <cstring>
+#include <limits>
+
+#include <QtEndian>
 
 #include <gdal.h>
 #include <gdal_priv.h>
 #include <cpl_vsi.h>
 
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#   define OSMAND_HEIGHTMAP_SSE2 1
+#   include <emmintrin.h>
+#elif defined(__ARM_NEON__) || defined(__ARM_NEON)
+#   define OSMAND_HEIGHTMAP_NEON 1
+#   include <arm_neon.h>
+#endif
+
 #include "Logging.h"
 
 OsmAnd::HeightmapTileProvider_P::HeightmapTileProvider_P( HeightmapTileProvider* owner_, const QDir& dataPath, const QString& indexFilepath )
     : owner(owner_)
-    , _tileDb(dataPath, indexFilepath)
+    , _tileDb(dataPath, indexFilepath, TileDB::AccessMode::Concurrent)
 {
 }
 
@@ -32,8 +44,208 @@ bool OsmAnd::HeightmapTileProvider_P::obtainTile( const TileId tileId, const Zoo
     }
 
     const auto tileSize = owner->getTileSize();
+    const auto buffer = _buffersPool->obtainBuffer();
+
+    // Most tiles are simple enough to be decoded without GDAL, which is used only for the rest
+    const bool success =
+        decodeTileNatively(data, tileSize, buffer) ||
+        decodeTileUsingGDAL(tileId, zoom, data, tileSize, buffer);
+    if(!success)
+    {
+        _buffersPool->releaseBuffer(buffer);
+        return false;
+    }
+
+    outTile.reset(new PooledElevationDataTile(_buffersPool, buffer, tileSize));
+    return true;
+}
+
+bool OsmAnd::HeightmapTileProvider_P::decodeTileNatively( const QByteArray& data, const uint32_t tileSize, float* outBuffer )
+{
+#if Q_BYTE_ORDER != Q_LITTLE_ENDIAN
+    // Samples are used in-place, so only little-endian hosts are supported
+    return false;
+#else
+    const auto dataSize = static_cast<size_t>(data.size());
+    const auto pData = reinterpret_cast<const uchar*>(data.constData());
+    const auto read16 = [pData](const size_t offset) -> uint32_t
+        {
+            return qFromLittleEndian<quint16>(pData + offset);
+        };
+    const auto read32 = [pData](const size_t offset) -> uint32_t
+        {
+            return qFromLittleEndian<quint32>(pData + offset);
+        };
+
+    // Only classic little-endian TIFF is supported
+    if(dataSize < 8 || pData[0] != 'I' || pData[1] != 'I' || read16(2) != 42)
+        return false;
+    const size_t ifdOffset = read32(4);
+    if(ifdOffset + 2 > dataSize)
+        return false;
+    const auto entriesCount = read16(ifdOffset);
+    if(ifdOffset + 2 + entriesCount*12 > dataSize)
+        return false;
+
+    // Read tags of first image
+    uint32_t width = 0;
+    uint32_t height = 0;
+    uint32_t bitsPerSample = 1;
+    uint32_t samplesPerPixel = 1;
+    uint32_t compression = 1;
+    uint32_t predictor = 1;
+    uint32_t planarConfiguration = 1;
+    uint32_t sampleFormat = 1;
+    uint32_t rowsPerStrip = std::numeric_limits<uint32_t>::max();
+    struct ValuesArray
+    {
+        uint32_t type;
+        uint32_t count;
+        size_t offset;
+    } stripOffsets = { 0, 0, 0 }, stripByteCounts = { 0, 0, 0 };
+    for(unsigned int entryIdx = 0; entryIdx < entriesCount; entryIdx++)
+    {
+        const size_t entryOffset = ifdOffset + 2 + entryIdx*12;
+        const auto tag = read16(entryOffset);
+        const auto type = read16(entryOffset + 2);
+        const auto count = read32(entryOffset + 4);
+
+        // Only SHORT and LONG values are of interest, values that fit 4 bytes are stored in entry itself
+        const size_t valueSize = (type == 3) ? 2 : ((type == 4) ? 4 : 0);
+        const size_t valuesOffset = (static_cast<uint64_t>(valueSize)*count <= 4) ? entryOffset + 8 : read32(entryOffset + 8);
+        const bool isValid = valueSize != 0 && count > 0 && valuesOffset + static_cast<uint64_t>(valueSize)*count <= dataSize;
+        const auto value = isValid ? ((type == 3) ? read16(valuesOffset) : read32(valuesOffset)) : 0;
+
+        switch(tag)
+        {
+        case 256: // ImageWidth
+            width = value;
+            break;
+        case 257: // ImageLength
+            height = value;
+            break;
+        case 258: // BitsPerSample
+            bitsPerSample = value;
+            break;
+        case 259: // Compression
+            compression = value;
+            break;
+        case 273: // StripOffsets
+            stripOffsets.type = type;
+            stripOffsets.count = isValid ? count : 0;
+            stripOffsets.offset = valuesOffset;
+            break;
+        case 277: // SamplesPerPixel
+            samplesPerPixel = value;
+            break;
+        case 278: // RowsPerStrip
+            rowsPerStrip = value;
+            break;
+        case 279: // StripByteCounts
+            stripByteCounts.type = type;
+            stripByteCounts.count = isValid ? count : 0;
+            stripByteCounts.offset = valuesOffset;
+            break;
+        case 284: // PlanarConfiguration
+            planarConfiguration = value;
+            break;
+        case 317: // Predictor
+            predictor = value;
+            break;
+        case 339: // SampleFormat
+            sampleFormat = value;
+            break;
+        case 320: // ColorMap
+        case 322: // TileWidth
+        case 323: // TileLength
+        case 324: // TileOffsets
+        case 325: // TileByteCounts
+            return false;
+        }
+    }
+
+    // Verify that this is a single-band signed 16-bit image of expected size, stored in strips
+    if(width != tileSize || height != tileSize)
+        return false;
+    if(bitsPerSample != 16 || samplesPerPixel != 1 || planarConfiguration != 1 || sampleFormat != 2)
+        return false;
+    if(compression != 1 && compression != 8 && compression != 32946)
+        return false;
+    if(predictor != 1 && predictor != 2)
+        return false;
+    if(rowsPerStrip == 0)
+        return false;
+    rowsPerStrip = qMin(rowsPerStrip, height);
+    const auto stripsCount = (height + rowsPerStrip - 1) / rowsPerStrip;
+    if(stripOffsets.count != stripsCount || stripByteCounts.count != stripsCount)
+        return false;
+
+    const auto readArrayValue = [read16, read32](const ValuesArray& array, const uint32_t index) -> uint32_t
+        {
+            return (array.type == 3) ? read16(array.offset + index*2) : read32(array.offset + index*4);
+        };
+    QByteArray unpackedStrip;
+    for(uint32_t stripIdx = 0; stripIdx < stripsCount; stripIdx++)
+    {
+        const auto stripOffset = readArrayValue(stripOffsets, stripIdx);
+        const auto stripByteCount = readArrayValue(stripByteCounts, stripIdx);
+        if(static_cast<uint64_t>(stripOffset) + stripByteCount > dataSize)
+            return false;
+        const auto rowsInStrip = qMin(rowsPerStrip, height - stripIdx*rowsPerStrip);
+        const auto samplesInStrip = rowsInStrip*width;
+        const auto unpackedSize = samplesInStrip*sizeof(int16_t);
+
+        const int16_t* samples = nullptr;
+        if(compression == 1)
+        {
+            if(stripByteCount < unpackedSize)
+                return false;
+
+            // Unaligned or predicted samples have to be copied first
+            if(predictor == 1 && (stripOffset % sizeof(int16_t)) == 0)
+                samples = reinterpret_cast<const int16_t*>(pData + stripOffset);
+            else
+                unpackedStrip = QByteArray(reinterpret_cast<const char*>(pData + stripOffset), unpackedSize);
+        }
+        else
+        {
+            // qUncompress() expects zlib stream prefixed with big-endian size of uncompressed data
+            QByteArray compressedStrip;
+            compressedStrip.resize(4 + stripByteCount);
+            qToBigEndian<quint32>(unpackedSize, reinterpret_cast<uchar*>(compressedStrip.data()));
+            memcpy(compressedStrip.data() + 4, pData + stripOffset, stripByteCount);
+            unpackedStrip = qUncompress(compressedStrip);
+            if(static_cast<size_t>(unpackedStrip.size()) != unpackedSize)
+                return false;
+        }
+
+        if(!samples)
+        {
+            const auto unpackedSamples = reinterpret_cast<int16_t*>(unpackedStrip.data());
+
+            // Horizontal predictor stores difference to previous sample in a row
+            if(predictor == 2)
+            {
+                for(uint32_t rowIdx = 0; rowIdx < rowsInStrip; rowIdx++)
+                {
+                    auto pSample = unpackedSamples + rowIdx*width;
+                    for(uint32_t columnIdx = 1; columnIdx < width; columnIdx++, pSample++)
+                        pSample[1] = static_cast<int16_t>(static_cast<uint16_t>(pSample[1]) + static_cast<uint16_t>(pSample[0]));
+                }
+            }
 
-    // We have the data, use GDAL to decode this GeoTIFF
+            samples = unpackedSamples;
+        }
+
+        convertInt16ToFloat(samples, outBuffer + stripIdx*rowsPerStrip*width, samplesInStrip);
+    }
+
+    return true;
+#endif
+}
+
+bool OsmAnd::HeightmapTileProvider_P::decodeTileUsingGDAL( const TileId tileId, const ZoomLevel zoom, QByteArray& data, const uint32_t tileSize, float* outBuffer )
+{
     bool success = false;
     QString vmemFilename;
     vmemFilename.sprintf("/vsimem/heightmapTile@%p", data.data());
@@ -71,19 +283,11 @@ bool OsmAnd::HeightmapTileProvider_P::obtainTile( const TileId tileId, const Zoo
             }
             else
             {
-                auto buffer = new float[tileSize*tileSize];
-
-                auto res = dataset->RasterIO(GF_Read, 0, 0, tileSize, tileSize, buffer, tileSize, tileSize, GDT_Float32, 1, nullptr, 0, 0, 0);
+                auto res = dataset->RasterIO(GF_Read, 0, 0, tileSize, tileSize, outBuffer, tileSize, tileSize, GDT_Float32, 1, nullptr, 0, 0, 0);
                 if(res != CE_None)
-                {
-                    delete[] buffer;
                     LogPrintf(LogSeverityLevel::Error, "Failed to decode height tile %dx%d@%d: %s", tileId.x, tileId.y, zoom, CPLGetLastErrorMsg());
-                }
                 else
-                {
-                    outTile.reset(new MapElevationDataTile(buffer, sizeof(float)*tileSize, tileSize));
                     success = true;
-                }
             }
         }
 
@@ -93,3 +297,81 @@ bool OsmAnd::HeightmapTileProvider_P::obtainTile( const TileId tileId, const Zoo
 
     return success;
 }
+
+void OsmAnd::HeightmapTileProvider_P::convertInt16ToFloat( const int16_t* input, float* output, const size_t count )
+{
+    size_t idx = 0;
+#if defined(OSMAND_HEIGHTMAP_SSE2)
+    for(; idx + 8 <= count; idx += 8)
+    {
+        const auto samples = _mm_loadu_si128(reinterpret_cast<const __m128i*>(input + idx));
+
+        // Sign-extend each sample by duplicating it into both halves of 32-bit lane and shifting it back
+        const auto lowSamples = _mm_srai_epi32(_mm_unpacklo_epi16(samples, samples), 16);
+        const auto highSamples = _mm_srai_epi32(_mm_unpackhi_epi16(samples, samples), 16);
+        _mm_storeu_ps(output + idx, _mm_cvtepi32_ps(lowSamples));
+        _mm_storeu_ps(output + idx + 4, _mm_cvtepi32_ps(highSamples));
+    }
+#elif defined(OSMAND_HEIGHTMAP_NEON)
+    for(; idx + 8 <= count; idx += 8)
+    {
+        const auto samples = vld1q_s16(input + idx);
+        vst1q_f32(output + idx, vcvtq_f32_s32(vmovl_s16(vget_low_s16(samples))));
+        vst1q_f32(output + idx + 4, vcvtq_f32_s32(vmovl_s16(vget_high_s16(samples))));
+    }
+#endif
+    for(; idx < count; idx++)
+        output[idx] = static_cast<float>(input[idx]);
+}
+
+OsmAnd::HeightmapTileProvider_P::BuffersPool::BuffersPool( const size_t bufferLength_, const unsigned int maxPooledBuffers_ )
+    : bufferLength(bufferLength_)
+    , maxPooledBuffers(maxPooledBuffers_)
+{
+}
+
+OsmAnd::HeightmapTileProvider_P::BuffersPool::~BuffersPool()
+{
+    for(auto itBuffer = _buffers.cbegin(); itBuffer != _buffers.cend(); ++itBuffer)
+        delete[] *itBuffer;
+}
+
+float* OsmAnd::HeightmapTileProvider_P::BuffersPool::obtainBuffer()
+{
+    {
+        QMutexLocker scopedLocker(&_mutex);
+
+        if(!_buffers.isEmpty())
+            return _buffers.takeLast();
+    }
+
+    return new float[bufferLength];
+}
+
+void OsmAnd::HeightmapTileProvider_P::BuffersPool::releaseBuffer( float* buffer )
+{
+    {
+        QMutexLocker scopedLocker(&_mutex);
+
+        if(static_cast<unsigned int>(_buffers.size()) < maxPooledBuffers)
+        {
+            _buffers.push_back(buffer);
+            return;
+        }
+    }
+
+    delete[] buffer;
+}
+
+OsmAnd::HeightmapTileProvider_P::PooledElevationDataTile::PooledElevationDataTile( const std::shared_ptr<BuffersPool>& pool, float* data, uint32_t size )
+    : MapElevationDataTile(data, sizeof(float)*size, size)
+    , _pool(pool)
+{
+}
+
+OsmAnd::HeightmapTileProvider_P::PooledElevationDataTile::~PooledElevationDataTile()
+{
+    // Return buffer to pool and prevent MapElevationDataTile from deleting it
+    _pool->releaseBuffer(const_cast<float*>(static_cast<const float*>(_data)));
+    _data = nullptr;
+}
@@ -29,6 +29,8 @@
 #include <QMutex>
 #include <QQueue>
 #include <QSet>
+#include <QList>
+#include <QByteArray>
 
 #include <OsmAndCore.h>
 #include <CommonTypes.h>
@@ -47,6 +49,41 @@ namespace OsmAnd {
         HeightmapTileProvider* const owner;
         TileDB _tileDb;
 
+        // Buffers of decoded tiles are returned here once tile is released, to avoid allocation per tile
+        class BuffersPool
+        {
+            Q_DISABLE_COPY(BuffersPool);
+        private:
+            QMutex _mutex;
+            QList<float*> _buffers;
+        public:
+            BuffersPool(const size_t bufferLength, const unsigned int maxPooledBuffers);
+            ~BuffersPool();
+
+            const size_t bufferLength;
+            const unsigned int maxPooledBuffers;
+
+            float* obtainBuffer();
+            void releaseBuffer(float* buffer);
+        };
+        std::shared_ptr<BuffersPool> _buffersPool;
+
+        class PooledElevationDataTile : public MapElevationDataTile
+        {
+        private:
+        protected:
+            const std::shared_ptr<BuffersPool> _pool;
+        public:
+            PooledElevationDataTile(const std::shared_ptr<BuffersPool>& pool, float* data, uint32_t size);
+            virtual ~PooledElevationDataTile();
+        };
+
+        // Decodes single-band Int16 little-endian GeoTIFF with strips that are either uncompressed or
+        // deflated (optionally with horizontal predictor). Returns false for anything else.
+        static bool decodeTileNatively(const QByteArray& data, const uint32_t tileSize, float* outBuffer);
+        static bool decodeTileUsingGDAL(const TileId tileId, const ZoomLevel zoom, QByteArray& data, const uint32_t tileSize, float* outBuffer);
+        static void convertInt16ToFloat(const int16_t* input, float* output, const size_t count);
+
         bool obtainTile(const TileId tileId, const ZoomLevel zoom, std::shared_ptr<const MapTile>& outTile);
     public:
         ~HeightmapTileProvider_P();
@@ -0,0 +1,57 @@
+#include "HillshadeTileProvider.h"
+#include "HillshadeTileProvider_P.h"
+
+#include "IMapElevationDataProvider.h"
+
+OsmAnd::HillshadeTileProvider::HillshadeTileProvider( const std::shared_ptr<IMapElevationDataProvider>& elevationDataProvider_, const uint32_t tileSize_ /*= 256*/, const unsigned int cacheSize_ /*= 128*/ )
+    : _d(new HillshadeTileProvider_P(this, cacheSize_))
+    , elevationDataProvider(elevationDataProvider_)
+    , tileSize(tileSize_)
+    , cacheSize(cacheSize_)
+    , lightAzimuth(_d->_lightAzimuth)
+    , lightAltitude(_d->_lightAltitude)
+    , zFactor(_d->_zFactor)
+{
+}
+
+OsmAnd::HillshadeTileProvider::~HillshadeTileProvider()
+{
+}
+
+void OsmAnd::HillshadeTileProvider::setLightDirection( const float azimuth, const float altitude )
+{
+    {
+        QMutexLocker scopedLocker(&_d->_configurationMutex);
+
+        _d->_lightAzimuth = azimuth;
+        _d->_lightAltitude = altitude;
+        _d->_configurationVersion++;
+    }
+    _d->_hillshadeTilesCache.clear();
+}
+
+void OsmAnd::HillshadeTileProvider::setZFactor( const float zFactor_ )
+{
+    {
+        QMutexLocker scopedLocker(&_d->_configurationMutex);
+
+        _d->_zFactor = zFactor_;
+        _d->_configurationVersion++;
+    }
+    _d->_hillshadeTilesCache.clear();
+}
+
+float OsmAnd::HillshadeTileProvider::getTileDensity() const
+{
+    return 1.0f;
+}
+
+uint32_t OsmAnd::HillshadeTileProvider::getTileSize() const
+{
+    return tileSize;
+}
+
+bool OsmAnd::HillshadeTileProvider::obtainTile( const TileId tileId, const ZoomLevel zoom, std::shared_ptr<const MapTile>& outTile )
+{
+    return _d->obtainTile(tileId, zoom, outTile);
+}
@@ -0,0 +1,402 @@
+#include "HillshadeTileProvider_P.h"
+#include "HillshadeTileProvider.h"
+
+#include <cassert>
+#include <cmath>
+
+#include <SkBitmap.h>
+#include <SkColorPriv.h>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#   define OSMAND_HILLSHADE_SSE2 1
+#   include <emmintrin.h>
+#elif defined(__ARM_NEON__) || defined(__ARM_NEON)
+#   define OSMAND_HILLSHADE_NEON 1
+#   include <arm_neon.h>
+#endif
+
+#include "IMapElevationDataProvider.h"
+#include "Utilities.h"
+#include "Logging.h"
+
+OsmAnd::HillshadeTileProvider_P::HillshadeTileProvider_P( HillshadeTileProvider* owner_, const unsigned int cacheSize )
+    : owner(owner_)
+    , _hillshadeTilesCache(cacheSize)
+    , _elevationTilesCache(cacheSize)
+    , _lightAzimuth(315.0f)
+    , _lightAltitude(45.0f)
+    , _zFactor(1.0f)
+    , _configurationVersion(0)
+{
+}
+
+OsmAnd::HillshadeTileProvider_P::~HillshadeTileProvider_P()
+{
+}
+
+bool OsmAnd::HillshadeTileProvider_P::obtainTile( const TileId tileId, const ZoomLevel zoom, std::shared_ptr<const MapTile>& outTile )
+{
+    if(_hillshadeTilesCache.obtainTile(tileId, zoom, outTile))
+        return true;
+
+    float lightAzimuth;
+    float lightAltitude;
+    float zFactor;
+    unsigned int configurationVersion;
+    {
+        QMutexLocker scopedLocker(&_configurationMutex);
+
+        lightAzimuth = _lightAzimuth;
+        lightAltitude = _lightAltitude;
+        zFactor = _zFactor;
+        configurationVersion = _configurationVersion;
+    }
+
+    // Obtain elevation of each pixel, including 1-pixel border needed by 3x3 kernel
+    QVector<float> grid;
+    if(!fillElevationGrid(tileId, zoom, grid))
+        return false;
+    if(grid.isEmpty())
+    {
+        // There's no elevation data for this tile, so there's nothing to shade
+        outTile.reset();
+        _hillshadeTilesCache.insertTile(tileId, zoom, outTile);
+        return true;
+    }
+
+    const auto tileSize = owner->tileSize;
+    const auto gridSize = tileSize + 2;
+    auto bitmap = new SkBitmap();
+    bitmap->setConfig(SkBitmap::kARGB_8888_Config, tileSize, tileSize);
+    if(!bitmap->allocPixels())
+    {
+        LogPrintf(LogSeverityLevel::Error, "Failed to allocate buffer for hillshade tile %dx%d@%d", tileId.x, tileId.y, zoom);
+
+        delete bitmap;
+
+        return false;
+    }
+
+    const auto azimuthRadians = Utilities::toRadians(lightAzimuth);
+    const auto altitudeRadians = Utilities::toRadians(lightAltitude);
+    const auto lightX = static_cast<float>(std::cos(altitudeRadians) * std::sin(azimuthRadians));
+    const auto lightY = static_cast<float>(std::cos(altitudeRadians) * std::cos(azimuthRadians));
+    const auto lightZ = static_cast<float>(std::sin(altitudeRadians));
+
+    QVector<float> shadeRow(tileSize);
+    for(uint32_t y = 0; y < tileSize; y++)
+    {
+        // Ground distance between pixels varies with latitude, but is constant along the row
+        const auto cellSize = static_cast<float>(Utilities::getMetersPerTileUnit(zoom, tileId.y + (y + 0.5) / tileSize, tileSize));
+
+        const auto pRow = grid.constData() + (y + 1)*gridSize;
+        computeShadeRow(pRow - gridSize, pRow, pRow + gridSize, tileSize, cellSize, zFactor, lightX, lightY, lightZ, shadeRow.data());
+
+        auto pPixel = bitmap->getAddr32(0, y);
+        for(uint32_t x = 0; x < tileSize; x++)
+        {
+            const auto alpha = static_cast<U8CPU>((1.0f - shadeRow[x]) * 255.0f + 0.5f);
+            *(pPixel++) = SkPackARGB32(alpha, 0, 0, 0);
+        }
+    }
+
+    outTile.reset(new MapBitmapTile(bitmap, AlphaChannelData::Present));
+
+    // Tile is cached only if configuration was not changed while it was produced
+    {
+        QMutexLocker scopedLocker(&_configurationMutex);
+
+        if(configurationVersion == _configurationVersion)
+            _hillshadeTilesCache.insertTile(tileId, zoom, outTile);
+    }
+
+    return true;
+}
+
+bool OsmAnd::HillshadeTileProvider_P::obtainElevationTile( const TileId tileId, const ZoomLevel zoom, std::shared_ptr<const MapTile>& outTile )
+{
+    if(_elevationTilesCache.obtainTile(tileId, zoom, outTile))
+        return true;
+
+    if(!owner->elevationDataProvider->obtainTile(tileId, zoom, outTile))
+        return false;
+
+    _elevationTilesCache.insertTile(tileId, zoom, outTile);
+    return true;
+}
+
+bool OsmAnd::HillshadeTileProvider_P::fillElevationGrid( const TileId tileId, const ZoomLevel zoom, QVector<float>& outGrid )
+{
+    // Find elevation data on this zoom or on one of parent zooms
+    std::shared_ptr<const MapTile> sourceTile;
+    TileId sourceTileId;
+    int zoomShift = 0;
+    for(; zoomShift <= MaxElevationDataZoomShift && zoomShift <= zoom; zoomShift++)
+    {
+        sourceTileId.x = tileId.x >> zoomShift;
+        sourceTileId.y = tileId.y >> zoomShift;
+        if(!obtainElevationTile(sourceTileId, static_cast<ZoomLevel>(zoom - zoomShift), sourceTile))
+            return false;
+        if(sourceTile)
+            break;
+    }
+    if(!sourceTile)
+    {
+        outGrid.clear();
+        return true;
+    }
+    const auto sourceZoom = static_cast<ZoomLevel>(zoom - zoomShift);
+    const auto sourceTilesCount = static_cast<int64_t>(1ull << sourceZoom);
+    const int samplesPerTile = sourceTile->size;
+
+    // Elevation samples are pixel-is-area, so sample (i, j) is located at (i + 0.5, j + 0.5) of source tile.
+    // Coordinates below are measured in samples, relative to origin of source tile
+    const auto tileSize = owner->tileSize;
+    const int gridSize = tileSize + 2;
+    const double samplesPerPixel = static_cast<double>(samplesPerTile) / (static_cast<double>(1u << zoomShift) * tileSize);
+    const double originX = (tileId.x - (sourceTileId.x << zoomShift)) * static_cast<double>(samplesPerTile) / (1u << zoomShift);
+    const double originY = (tileId.y - (sourceTileId.y << zoomShift)) * static_cast<double>(samplesPerTile) / (1u << zoomShift);
+    const auto samplePosition = [samplesPerPixel](const double origin, const int pixel) -> double
+        {
+            return origin + (pixel + 0.5) * samplesPerPixel - 0.5;
+        };
+
+    // Collect samples that are needed, taking them from neighbour tiles near borders
+    const auto firstColumn = static_cast<int>(std::floor(samplePosition(originX, -1)));
+    const auto firstRow = static_cast<int>(std::floor(samplePosition(originY, -1)));
+    const auto columnsCount = static_cast<int>(std::floor(samplePosition(originX, tileSize))) + 2 - firstColumn;
+    const auto rowsCount = static_cast<int>(std::floor(samplePosition(originY, tileSize))) + 2 - firstRow;
+    std::shared_ptr<const MapTile> neighbourTiles[3][3];
+    bool neighbourTilesObtained[3][3] = { { false } };
+    const auto floorDiv = [](const int value, const int divisor) -> int
+        {
+            return (value >= 0) ? (value / divisor) : -((-value + divisor - 1) / divisor);
+        };
+    QVector<float> samples(columnsCount * rowsCount);
+    auto pSample = samples.data();
+    for(int row = firstRow; row < firstRow + rowsCount; row++)
+    {
+        for(int column = firstColumn; column < firstColumn + columnsCount; column++)
+        {
+            const auto dx = qBound(-1, floorDiv(column, samplesPerTile), 1);
+            const auto dy = qBound(-1, floorDiv(row, samplesPerTile), 1);
+            auto& tile = neighbourTiles[dy + 1][dx + 1];
+            if(!neighbourTilesObtained[dy + 1][dx + 1])
+            {
+                neighbourTilesObtained[dy + 1][dx + 1] = true;
+
+                const int64_t neighbourY = static_cast<int64_t>(sourceTileId.y) + dy;
+                if(dx == 0 && dy == 0)
+                    tile = sourceTile;
+                else if(neighbourY >= 0 && neighbourY < sourceTilesCount)
+                {
+                    TileId neighbourId;
+                    neighbourId.x = sourceTileId.x + dx;
+                    neighbourId.y = sourceTileId.y + dy;
+                    neighbourId = Utilities::normalizeTileId(neighbourId, sourceZoom);
+                    if(!obtainElevationTile(neighbourId, sourceZoom, tile))
+                        return false;
+                    if(tile && tile->size != sourceTile->size)
+                        tile.reset();
+                }
+            }
+
+            // Without neighbour tile, edge of source tile is extended
+            int localColumn = column - dx*samplesPerTile;
+            int localRow = row - dy*samplesPerTile;
+            const MapTile* pTile = tile.get();
+            if(!pTile)
+            {
+                pTile = sourceTile.get();
+                localColumn = qBound(0, column, samplesPerTile - 1);
+                localRow = qBound(0, row, samplesPerTile - 1);
+            }
+            localRow = qBound(0, localRow, samplesPerTile - 1);
+            const auto pTileRow = reinterpret_cast<const float*>(static_cast<const uint8_t*>(pTile->data) + localRow*pTile->rowLength);
+            *(pSample++) = pTileRow[qBound(0, localColumn, samplesPerTile - 1)];
+        }
+    }
+
+    // Bilinearly interpolate samples to pixels of the grid
+    QVector<int> columnIndices(gridSize);
+    QVector<float> columnWeights(gridSize);
+    for(int x = 0; x < gridSize; x++)
+    {
+        const auto position = samplePosition(originX, x - 1) - firstColumn;
+        columnIndices[x] = qBound(0, static_cast<int>(std::floor(position)), columnsCount - 2);
+        columnWeights[x] = static_cast<float>(position - columnIndices[x]);
+    }
+    outGrid.resize(gridSize * gridSize);
+    auto pOutput = outGrid.data();
+    for(int y = 0; y < gridSize; y++)
+    {
+        const auto position = samplePosition(originY, y - 1) - firstRow;
+        const auto rowIndex = qBound(0, static_cast<int>(std::floor(position)), rowsCount - 2);
+        const auto rowWeight = static_cast<float>(position - rowIndex);
+        const auto pTopRow = samples.constData() + rowIndex*columnsCount;
+        const auto pBottomRow = pTopRow + columnsCount;
+
+        for(int x = 0; x < gridSize; x++)
+        {
+            const auto column = columnIndices[x];
+            const auto columnWeight = columnWeights[x];
+            const auto top = pTopRow[column] + (pTopRow[column + 1] - pTopRow[column]) * columnWeight;
+            const auto bottom = pBottomRow[column] + (pBottomRow[column + 1] - pBottomRow[column]) * columnWeight;
+            *(pOutput++) = top + (bottom - top) * rowWeight;
+        }
+    }
+
+    return true;
+}
+
+void OsmAnd::HillshadeTileProvider_P::computeShadeRow(
+    const float* rowAbove, const float* row, const float* rowBelow, const unsigned int count,
+    const float cellSize, const float zFactor, const float lightX, const float lightY, const float lightZ, float* outShade )
+{
+    // Horn's method: gradient is estimated from 3x3 neighbourhood
+    //  a b c
+    //  d e f
+    //  g h i
+    // Since rows go from north to south, northward gradient is negated
+    const auto k = zFactor / (8.0f * cellSize);
+
+    unsigned int x = 0;
+#if defined(OSMAND_HILLSHADE_SSE2)
+    const auto vK = _mm_set1_ps(k);
+    const auto vTwo = _mm_set1_ps(2.0f);
+    const auto vOne = _mm_set1_ps(1.0f);
+    const auto vZero = _mm_setzero_ps();
+    const auto vLightX = _mm_set1_ps(lightX);
+    const auto vLightY = _mm_set1_ps(lightY);
+    const auto vLightZ = _mm_set1_ps(lightZ);
+    for(; x + 4 <= count; x += 4)
+    {
+        const auto a = _mm_loadu_ps(rowAbove + x);
+        const auto b = _mm_loadu_ps(rowAbove + x + 1);
+        const auto c = _mm_loadu_ps(rowAbove + x + 2);
+        const auto d = _mm_loadu_ps(row + x);
+        const auto f = _mm_loadu_ps(row + x + 2);
+        const auto g = _mm_loadu_ps(rowBelow + x);
+        const auto h = _mm_loadu_ps(rowBelow + x + 1);
+        const auto i = _mm_loadu_ps(rowBelow + x + 2);
+
+        const auto dzdx = _mm_mul_ps(vK, _mm_sub_ps(
+            _mm_add_ps(_mm_add_ps(c, _mm_mul_ps(vTwo, f)), i),
+            _mm_add_ps(_mm_add_ps(a, _mm_mul_ps(vTwo, d)), g)));
+        const auto dzdy = _mm_mul_ps(vK, _mm_sub_ps(
+            _mm_add_ps(_mm_add_ps(g, _mm_mul_ps(vTwo, h)), i),
+            _mm_add_ps(_mm_add_ps(a, _mm_mul_ps(vTwo, b)), c)));
+
+        const auto numerator = _mm_add_ps(_mm_sub_ps(_mm_mul_ps(dzdy, vLightY), _mm_mul_ps(dzdx, vLightX)), vLightZ);
+        const auto denominator = _mm_sqrt_ps(_mm_add_ps(vOne, _mm_add_ps(_mm_mul_ps(dzdx, dzdx), _mm_mul_ps(dzdy, dzdy))));
+        const auto shade = _mm_min_ps(_mm_max_ps(_mm_div_ps(numerator, denominator), vZero), vOne);
+        _mm_storeu_ps(outShade + x, shade);
+    }
+#elif defined(OSMAND_HILLSHADE_NEON)
+    const auto vK = vdupq_n_f32(k);
+    const auto vOne = vdupq_n_f32(1.0f);
+    const auto vZero = vdupq_n_f32(0.0f);
+    const auto vLightX = vdupq_n_f32(lightX);
+    const auto vLightY = vdupq_n_f32(lightY);
+    const auto vLightZ = vdupq_n_f32(lightZ);
+    for(; x + 4 <= count; x += 4)
+    {
+        const auto a = vld1q_f32(rowAbove + x);
+        const auto b = vld1q_f32(rowAbove + x + 1);
+        const auto c = vld1q_f32(rowAbove + x + 2);
+        const auto d = vld1q_f32(row + x);
+        const auto f = vld1q_f32(row + x + 2);
+        const auto g = vld1q_f32(rowBelow + x);
+        const auto h = vld1q_f32(rowBelow + x + 1);
+        const auto i = vld1q_f32(rowBelow + x + 2);
+
+        const auto dzdx = vmulq_f32(vK, vsubq_f32(
+            vaddq_f32(vaddq_f32(c, vaddq_f32(f, f)), i),
+            vaddq_f32(vaddq_f32(a, vaddq_f32(d, d)), g)));
+        const auto dzdy = vmulq_f32(vK, vsubq_f32(
+            vaddq_f32(vaddq_f32(g, vaddq_f32(h, h)), i),
+            vaddq_f32(vaddq_f32(a, vaddq_f32(b, b)), c)));
+
+        const auto numerator = vaddq_f32(vsubq_f32(vmulq_f32(dzdy, vLightY), vmulq_f32(dzdx, vLightX)), vLightZ);
+        const auto squaredLength = vaddq_f32(vOne, vaddq_f32(vmulq_f32(dzdx, dzdx), vmulq_f32(dzdy, dzdy)));
+
+        // Reciprocal square root estimate is refined with two Newton-Raphson steps
+        auto inverseLength = vrsqrteq_f32(squaredLength);
+        inverseLength = vmulq_f32(inverseLength, vrsqrtsq_f32(vmulq_f32(squaredLength, inverseLength), inverseLength));
+        inverseLength = vmulq_f32(inverseLength, vrsqrtsq_f32(vmulq_f32(squaredLength, inverseLength), inverseLength));
+
+        const auto shade = vminq_f32(vmaxq_f32(vmulq_f32(numerator, inverseLength), vZero), vOne);
+        vst1q_f32(outShade + x, shade);
+    }
+#endif
+    for(; x < count; x++)
+    {
+        const auto dzdx = k * ((rowAbove[x + 2] + 2.0f*row[x + 2] + rowBelow[x + 2]) - (rowAbove[x] + 2.0f*row[x] + rowBelow[x]));
+        const auto dzdy = k * ((rowBelow[x] + 2.0f*rowBelow[x + 1] + rowBelow[x + 2]) - (rowAbove[x] + 2.0f*rowAbove[x + 1] + rowAbove[x + 2]));
+
+        const auto shade = (dzdy*lightY - dzdx*lightX + lightZ) / std::sqrt(1.0f + dzdx*dzdx + dzdy*dzdy);
+        outShade[x] = qBound(0.0f, shade, 1.0f);
+    }
+}
+
+OsmAnd::HillshadeTileProvider_P::TilesCache::TilesCache( const unsigned int maxSize_ )
+    : maxSize(maxSize_)
+{
+}
+
+OsmAnd::HillshadeTileProvider_P::TilesCache::~TilesCache()
+{
+}
+
+bool OsmAnd::HillshadeTileProvider_P::TilesCache::obtainTile( const TileId tileId, const ZoomLevel zoom, std::shared_ptr<const MapTile>& outTile )
+{
+    QMutexLocker scopedLocker(&_mutex);
+
+    const auto itEntry = _tiles[zoom].find(tileId);
+    if(itEntry == _tiles[zoom].end())
+        return false;
+    outTile = itEntry->tile;
+
+    // Mark tile as most recently used
+    _usage.splice(_usage.end(), _usage, itEntry->itUsage);
+
+    return true;
+}
+
+void OsmAnd::HillshadeTileProvider_P::TilesCache::insertTile( const TileId tileId, const ZoomLevel zoom, const std::shared_ptr<const MapTile>& tile )
+{
+    if(maxSize == 0)
+        return;
+
+    QMutexLocker scopedLocker(&_mutex);
+
+    auto itEntry = _tiles[zoom].find(tileId);
+    if(itEntry != _tiles[zoom].end())
+    {
+        itEntry->tile = tile;
+        _usage.splice(_usage.end(), _usage, itEntry->itUsage);
+        return;
+    }
+
+    Entry entry;
+    entry.tile = tile;
+    entry.itUsage = _usage.insert(_usage.end(), std::make_pair(zoom, tileId));
+    _tiles[zoom].insert(tileId, entry);
+
+    // Evict least recently used tiles
+    while(_usage.size() > maxSize)
+    {
+        const auto& evictedKey = _usage.front();
+        _tiles[evictedKey.first].remove(evictedKey.second);
+        _usage.pop_front();
+    }
+}
+
+void OsmAnd::HillshadeTileProvider_P::TilesCache::clear()
+{
+    QMutexLocker scopedLocker(&_mutex);
+
+    for(auto itTiles = _tiles.begin(); itTiles != _tiles.end(); ++itTiles)
+        itTiles->clear();
+    _usage.clear();
+}
@@ -0,0 +1,104 @@
+/**
+ * @file
+ *
+ * @section LICENSE
+ *
+ * OsmAnd - Android navigation software based on OSM maps.
+ * Copyright (C) 2010-2013  OsmAnd Authors listed in AUTHORS file
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#ifndef _OSMAND_CORE_HILLSHADE_TILE_PROVIDER_P_H_
+#define _OSMAND_CORE_HILLSHADE_TILE_PROVIDER_P_H_
+
+#include <OsmAndCore/stdlib_common.h>
+#include <array>
+#include <list>
+#include <utility>
+
+#include <OsmAndCore/QtExtensions.h>
+#include <QHash>
+#include <QMutex>
+#include <QVector>
+
+#include <OsmAndCore.h>
+#include <CommonTypes.h>
+#include <IMapTileProvider.h>
+
+namespace OsmAnd {
+
+    class HillshadeTileProvider;
+    class HillshadeTileProvider_P
+    {
+    private:
+    protected:
+        HillshadeTileProvider_P(HillshadeTileProvider* owner, const unsigned int cacheSize);
+
+        HillshadeTileProvider* const owner;
+
+        enum {
+            // Number of parent zoom levels searched for elevation data, if there's none on requested zoom
+            MaxElevationDataZoomShift = 4,
+        };
+
+        // Keeps limited number of most recently used tiles. Null tiles are cached as well
+        class TilesCache
+        {
+            Q_DISABLE_COPY(TilesCache);
+        private:
+            mutable QMutex _mutex;
+            // Least recently used tile is at front. Each entry knows its position, so it's moved in constant time
+            typedef std::list< std::pair<ZoomLevel, TileId> > Usage;
+            struct Entry
+            {
+                std::shared_ptr<const MapTile> tile;
+                Usage::iterator itUsage;
+            };
+            std::array< QHash< TileId, Entry >, ZoomLevelsCount > _tiles;
+            Usage _usage;
+        public:
+            TilesCache(const unsigned int maxSize);
+            ~TilesCache();
+
+            const unsigned int maxSize;
+
+            bool obtainTile(const TileId tileId, const ZoomLevel zoom, std::shared_ptr<const MapTile>& outTile);
+            void insertTile(const TileId tileId, const ZoomLevel zoom, const std::shared_ptr<const MapTile>& tile);
+            void clear();
+        };
+        TilesCache _hillshadeTilesCache;
+        TilesCache _elevationTilesCache;
+
+        mutable QMutex _configurationMutex;
+        float _lightAzimuth;
+        float _lightAltitude;
+        float _zFactor;
+        // Incremented on each configuration change, to avoid caching tiles produced with previous one
+        unsigned int _configurationVersion;
+
+        bool obtainElevationTile(const TileId tileId, const ZoomLevel zoom, std::shared_ptr<const MapTile>& outTile);
+        bool fillElevationGrid(const TileId tileId, const ZoomLevel zoom, QVector<float>& outGrid);
+        static void computeShadeRow(const float* rowAbove, const float* row, const float* rowBelow, const unsigned int count,
+            const float cellSize, const float zFactor, const float lightX, const float lightY, const float lightZ, float* outShade);
+
+        bool obtainTile(const TileId tileId, const ZoomLevel zoom, std::shared_ptr<const MapTile>& outTile);
+    public:
+        virtual ~HillshadeTileProvider_P();
+
+    friend class OsmAnd::HillshadeTileProvider;
+    };
+
+}
+
+#endif // _OSMAND_CORE_HILLSHADE_TILE_PROVIDER_P_H_
@@ -0,0 +1,15 @@
+#include "IOnlineTilesCache.h"
+
+OsmAnd::IOnlineTilesCache::IOnlineTilesCache()
+{
+}
+
+OsmAnd::IOnlineTilesCache::~IOnlineTilesCache()
+{
+}
+
+bool OsmAnd::IOnlineTilesCache::containsTileData( const TileId tileId, const ZoomLevel zoom )
+{
+    QByteArray data;
+    return obtainTileData(tileId, zoom, data);
+}
@@ -165,17 +165,26 @@ bool OsmAnd::MapRenderer::revalidateState()
     // Postprocess internal state
     if(ok)
     {
-        // Sort visible tiles by distance from target
-        qSort(internalState->visibleTiles.begin(), internalState->visibleTiles.end(), [internalState](const TileId& l, const TileId& r) -> bool
+        // Sort visible tiles of each zoom level by distance from target
+        for(auto itVisibleTiles = internalState->visibleTiles.begin(); itVisibleTiles != internalState->visibleTiles.end(); ++itVisibleTiles)
         {
-            const auto lx = l.x - internalState->targetTileId.x;
-            const auto ly = l.y - internalState->targetTileId.y;
-
-            const auto rx = r.x - internalState->targetTileId.x;
-            const auto ry = r.y - internalState->targetTileId.y;
-
-            return (lx*lx + ly*ly) > (rx*rx + ry*ry);
-        });
+            const auto zoomShift = _currentState.zoomBase - itVisibleTiles.key();
+            TileId targetTileId;
+            targetTileId.x = internalState->targetTileId.x >> zoomShift;
+            targetTileId.y = internalState->targetTileId.y >> zoomShift;
+
+            auto& visibleTiles = *itVisibleTiles;
+            qSort(visibleTiles.begin(), visibleTiles.end(), [targetTileId](const TileId& l, const TileId& r) -> bool
+            {
+                const auto lx = l.x - targetTileId.x;
+                const auto ly = l.y - targetTileId.y;
+
+                const auto rx = r.x - targetTileId.x;
+                const auto ry = r.y - targetTileId.y;
+
+                return (lx*lx + ly*ly) > (rx*rx + ry*ry);
+            });
+        }
     }
 
     // Frame is being invalidated anyways, since a refresh is needed due to state change (successful or not)
@@ -407,10 +416,17 @@ bool OsmAnd::MapRenderer::prePrepareFrame()
     // Get set of tiles that are unique: visible tiles may contain same tiles, but wrapped
     const auto internalState = getInternalStateRef();
     _uniqueTiles.clear();
-    for(auto itTileId = internalState->visibleTiles.cbegin(); itTileId != internalState->visibleTiles.cend(); ++itTileId)
+    for(auto itVisibleTiles = internalState->visibleTiles.cbegin(); itVisibleTiles != internalState->visibleTiles.cend(); ++itVisibleTiles)
     {
-        const auto& tileId = *itTileId;
-        _uniqueTiles.insert(Utilities::normalizeTileId(tileId, _currentState.zoomBase));
+        const auto zoom = itVisibleTiles.key();
+        const auto& visibleTiles = itVisibleTiles.value();
+        auto& uniqueTiles = _uniqueTiles[zoom];
+
+        for(auto itTileId = visibleTiles.cbegin(); itTileId != visibleTiles.cend(); ++itTileId)
+        {
+            const auto& tileId = *itTileId;
+            uniqueTiles.insert(Utilities::normalizeTileId(tileId, zoom));
+        }
     }
 
     // Validate resources
@@ -720,7 +736,11 @@ unsigned int OsmAnd::MapRenderer::getVisibleTilesCount() const
 {
     QReadLocker scopedLocker(&_internalStateLock);
 
-    return getInternalStateRef()->visibleTiles.size();
+    unsigned int visibleTilesCount = 0u;
+    const auto& visibleTiles = getInternalStateRef()->visibleTiles;
+    for(auto itVisibleTiles = visibleTiles.cbegin(); itVisibleTiles != visibleTiles.cend(); ++itVisibleTiles)
+        visibleTilesCount += itVisibleTiles->size();
+    return visibleTilesCount;
 }
 
 unsigned int OsmAnd::MapRenderer::getSymbolsCount() const
@@ -81,7 +81,7 @@ namespace OsmAnd
         void gpuWorkerThreadProcedure();
 
         // General:
-        QSet<TileId> _uniqueTiles;
+        MapRendererResources::TilesPerZoom _uniqueTiles;
         std::unique_ptr<GPUAPI> _gpuAPI;
         void invalidateFrame();
         Qt::HANDLE _renderThreadId;
@@ -111,7 +111,9 @@ namespace OsmAnd
 
             TileId targetTileId;
             PointF targetInTileOffsetN;
-            QList<TileId> visibleTiles;
+
+            // Visible tiles grouped by zoom level. Tiles far from camera may have zoom lower than base zoom
+            QMap< ZoomLevel, QList<TileId> > visibleTiles;
         };
         virtual const InternalState* getInternalStateRef() const = 0;
         virtual InternalState* getInternalStateRef() = 0;
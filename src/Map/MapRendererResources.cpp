@@ -26,7 +26,7 @@ OsmAnd::MapRendererResources::MapRendererResources(MapRenderer* const owner_)
     , unavailableTileStub(_unavailableTileStub)
 {
 #if defined(DEBUG) || defined(_DEBUG)
-    LogPrintf(LogSeverityLevel::Info, "Map renderer will use max %d worker thread(s) to process requests", _resourcesRequestWorkersPool.maxThreadCount());
+    LogPrintf(LogSeverityLevel::Info, "Map renderer will use max %d worker thread(s) to process requests", Concurrent::pools->mapResources->getThreadsCount());
 #endif
     // Raster resources collections are special, so preallocate them
     {
@@ -286,7 +286,7 @@ void OsmAnd::MapRendererResources::updateBindings(const MapRendererState& state,
     }
 }
 
-void OsmAnd::MapRendererResources::updateActiveZone(const QSet<TileId>& tiles, const ZoomLevel zoom)
+void OsmAnd::MapRendererResources::updateActiveZone(const TilesPerZoom& tiles, const ZoomLevel zoom)
 {
     // Lock worker wakeup mutex
     QMutexLocker scopedLocker(&_workerThreadWakeupMutex);
@@ -339,7 +339,7 @@ void OsmAnd::MapRendererResources::workerThreadProcedure()
     while(_workerThreadIsAlive)
     {
         // Local copy of active zone
-        QSet<TileId> activeTiles;
+        TilesPerZoom activeTiles;
         ZoomLevel activeZoom;
 
         // Wait until we're unblocked by host
@@ -363,7 +363,13 @@ void OsmAnd::MapRendererResources::workerThreadProcedure()
     _workerThreadId = nullptr;
 }
 
-void OsmAnd::MapRendererResources::requestNeededResources(const QSet<TileId>& tiles, const ZoomLevel zoom)
+void OsmAnd::MapRendererResources::requestNeededResources(const TilesPerZoom& tiles, const ZoomLevel zoom)
+{
+    for(auto itTiles = tiles.cbegin(); itTiles != tiles.cend(); ++itTiles)
+        requestNeededResources(itTiles.value(), itTiles.key(), itTiles.key() == zoom);
+}
+
+void OsmAnd::MapRendererResources::requestNeededResources(const QSet<TileId>& tiles, const ZoomLevel zoom, const bool symbolsNeeded)
 {
     // Request missing resources
     for(auto itTileId = tiles.cbegin(); itTileId != tiles.cend(); ++itTileId)
@@ -386,6 +392,10 @@ void OsmAnd::MapRendererResources::requestNeededResources(const QSet<TileId>& ti
                 if(!isDataSourceAvailableFor(resourcesCollection))
                     continue;
 
+                // Symbols are needed only for tiles of base zoom
+                if(resourcesCollection->type == ResourceType::Symbols && !symbolsNeeded)
+                    continue;
+
                 // Obtain a resource entry and if it's state is "Unknown", create a task that will
                 // request resource data
                 std::shared_ptr<BaseTiledResource> resource;
@@ -489,7 +499,7 @@ void OsmAnd::MapRendererResources::requestNeededResources(const QSet<TileId>& ti
                 resource->setState(ResourceState::Requested);
 
                 // Finally start the request
-                _resourcesRequestWorkersPool.start(asyncTask);
+                Concurrent::pools->mapResources->start(asyncTask);
             }
         }
     }
@@ -530,7 +540,7 @@ void OsmAnd::MapRendererResources::validateResourcesOfType(const ResourceType ty
     }
 }
 
-void OsmAnd::MapRendererResources::updateResources(const QSet<TileId>& tiles, const ZoomLevel zoom)
+void OsmAnd::MapRendererResources::updateResources(const TilesPerZoom& tiles, const ZoomLevel zoom)
 {
     // Before requesting missing tiled resources, clean up cache to free some space
     cleanupJunkResources(tiles, zoom);
@@ -682,7 +692,7 @@ unsigned int OsmAnd::MapRendererResources::uploadResources(const unsigned int li
     return totalUploaded;
 }
 
-void OsmAnd::MapRendererResources::cleanupJunkResources(const QSet<TileId>& tiles, const ZoomLevel zoom)
+void OsmAnd::MapRendererResources::cleanupJunkResources(const TilesPerZoom& tiles, const ZoomLevel zoom)
 {
     // Use aggressive cache cleaning: remove all tiled resources that are not needed
     for(auto itResourcesCollections = _storage.cbegin(); itResourcesCollections != _storage.cend(); ++itResourcesCollections)
@@ -698,13 +708,32 @@ void OsmAnd::MapRendererResources::cleanupJunkResources(const QSet<TileId>& tile
                 continue;
 
             const auto dataSourceAvailable = isDataSourceAvailableFor(resourcesCollection);
+            const auto onlyBaseZoomNeeded = (resourcesCollection->type == ResourceType::Symbols);
 
-            resourcesCollection->removeEntries([this, dataSourceAvailable, tiles, zoom](const std::shared_ptr<BaseTiledResource>& entry, bool& cancel) -> bool
+            // Tiles of other zoom levels that are used as a fallback for not-yet-uploaded needed tiles
+            // are kept in GPU until exact tiles arrive
+            std::array< QSet<TileId>, ZoomLevelsCount > fallbackTiles;
+            if(dataSourceAvailable && resourcesCollection->type == ResourceType::RasterMap)
+                collectFallbackTiles(resourcesCollection, tiles, fallbackTiles);
+
+            resourcesCollection->removeEntries([this, dataSourceAvailable, onlyBaseZoomNeeded, &tiles, zoom, &fallbackTiles](const std::shared_ptr<BaseTiledResource>& entry, bool& cancel) -> bool
             {
                 // Skip cleaning if this tiled resource is needed
-                if((tiles.contains(entry->tileId) && entry->zoom == zoom) && dataSourceAvailable)
+                const auto itTiles = tiles.constFind(entry->zoom);
+                const auto isNeeded =
+                    (itTiles != tiles.cend() && itTiles->contains(entry->tileId)) &&
+                    (!onlyBaseZoomNeeded || entry->zoom == zoom);
+                if(isNeeded && dataSourceAvailable)
                     return false;
 
+                // Skip cleaning if this tiled resource is used as fallback and is still in GPU
+                if(fallbackTiles[entry->zoom].contains(entry->tileId))
+                {
+                    const auto state = entry->getState();
+                    if(state == ResourceState::Uploaded || state == ResourceState::IsBeingUsed)
+                        return false;
+                }
+
                 if(entry->setStateIf(ResourceState::Uploaded, ResourceState::UnloadPending))
                 {
                     // If resource is not needed anymore, change its state to "UnloadPending",
@@ -744,7 +773,7 @@ void OsmAnd::MapRendererResources::cleanupJunkResources(const QSet<TileId>& tile
 
                 // Following situations are ignored
                 const auto state = entry->getState();
-                if(state == ResourceState::Uploading || state == ResourceState::UnloadPending || state == ResourceState::Unloading)
+                if(state == ResourceState::Uploading || state == ResourceState::IsBeingUsed || state == ResourceState::UnloadPending || state == ResourceState::Unloading)
                     return false;
                 
                 assert(false);
@@ -754,6 +783,146 @@ void OsmAnd::MapRendererResources::cleanupJunkResources(const QSet<TileId>& tile
     }
 }
 
+void OsmAnd::MapRendererResources::collectFallbackTiles(
+    const std::shared_ptr<TiledResourcesCollection>& collection,
+    const TilesPerZoom& tiles, std::array< QSet<TileId>, ZoomLevelsCount >& outFallbackTiles) const
+{
+    for(auto itTiles = tiles.cbegin(); itTiles != tiles.cend(); ++itTiles)
+    {
+        const auto zoom = itTiles.key();
+        const auto& zoomTiles = itTiles.value();
+
+        for(auto itTileId = zoomTiles.cbegin(); itTileId != zoomTiles.cend(); ++itTileId)
+            collectFallbackTiles(collection, *itTileId, zoom, outFallbackTiles);
+    }
+}
+
+void OsmAnd::MapRendererResources::collectFallbackTiles(
+    const std::shared_ptr<TiledResourcesCollection>& collection,
+    const TileId tileId, const ZoomLevel zoom, std::array< QSet<TileId>, ZoomLevelsCount >& outFallbackTiles) const
+{
+    // Fallback is needed only for tiles that are going to arrive, but are not yet in GPU
+    std::shared_ptr<BaseTiledResource> entry;
+    if(collection->obtainEntry(entry, tileId, zoom))
+    {
+        const auto state = entry->getState();
+        if(state == ResourceState::Uploaded || state == ResourceState::IsBeingUsed || state == ResourceState::Unavailable)
+            return;
+    }
+
+    // Keep closest ancestor that is in GPU
+    auto ancestorTileId = tileId;
+    for(int zoomDelta = 1; zoomDelta <= MaxFallbackAncestorZoomDelta && zoom - zoomDelta >= ZoomLevel::MinZoomLevel; zoomDelta++)
+    {
+        ancestorTileId.x >>= 1;
+        ancestorTileId.y >>= 1;
+        const auto ancestorZoom = static_cast<ZoomLevel>(zoom - zoomDelta);
+
+        if(!isResourceUploaded(collection, ancestorTileId, ancestorZoom))
+            continue;
+
+        outFallbackTiles[ancestorZoom].insert(ancestorTileId);
+        break;
+    }
+
+    // Keep descendants only if all of them are in GPU, since partial coverage is of no use
+    if(zoom == ZoomLevel::MaxZoomLevel)
+        return;
+    const auto descendantsZoom = static_cast<ZoomLevel>(zoom + 1);
+    TileId descendantsTileIds[4];
+    bool allDescendantsUploaded = true;
+    for(int descendantIdx = 0; descendantIdx < 4 && allDescendantsUploaded; descendantIdx++)
+    {
+        auto& descendantTileId = descendantsTileIds[descendantIdx];
+        descendantTileId.x = (tileId.x << 1) + (descendantIdx & 1);
+        descendantTileId.y = (tileId.y << 1) + (descendantIdx >> 1);
+
+        allDescendantsUploaded = isResourceUploaded(collection, descendantTileId, descendantsZoom);
+    }
+    if(!allDescendantsUploaded)
+        return;
+    for(int descendantIdx = 0; descendantIdx < 4; descendantIdx++)
+        outFallbackTiles[descendantsZoom].insert(descendantsTileIds[descendantIdx]);
+}
+
+bool OsmAnd::MapRendererResources::isResourceUploaded(const std::shared_ptr<const TiledResourcesCollection>& collection, const TileId tileId, const ZoomLevel zoom)
+{
+    std::shared_ptr<BaseTiledResource> entry;
+    if(!collection->obtainEntry(entry, tileId, zoom))
+        return false;
+
+    const auto state = entry->getState();
+    return (state == ResourceState::Uploaded || state == ResourceState::IsBeingUsed);
+}
+
+bool OsmAnd::MapRendererResources::captureResourceInGPU(
+    const std::shared_ptr<const TiledResourcesCollection>& collection, const TileId tileId, const ZoomLevel zoom,
+    std::shared_ptr<const GPUAPI::ResourceInGPU>& outResourceInGPU)
+{
+    std::shared_ptr<BaseTiledResource> entry;
+    if(!collection->obtainEntry(entry, tileId, zoom))
+        return false;
+    if(entry->type != ResourceType::RasterMap && entry->type != ResourceType::ElevationData)
+        return false;
+    const auto resource = std::static_pointer_cast<MapTileResource>(entry);
+
+    // Check state and capture GPU resource
+    if(!resource->setStateIf(ResourceState::Uploaded, ResourceState::IsBeingUsed))
+        return false;
+    outResourceInGPU = resource->resourceInGPU;
+    resource->setState(ResourceState::Uploaded);
+
+    return static_cast<bool>(outResourceInGPU);
+}
+
+bool OsmAnd::MapRendererResources::obtainAncestorFallback(
+    const std::shared_ptr<const TiledResourcesCollection>& collection, const TileId tileId, const ZoomLevel zoom,
+    std::shared_ptr<const GPUAPI::ResourceInGPU>& outResourceInGPU, PointF& outTexCoordsOffset, float& outTexCoordsScale) const
+{
+    auto ancestorTileId = tileId;
+    for(int zoomDelta = 1; zoomDelta <= MaxFallbackAncestorZoomDelta && zoom - zoomDelta >= ZoomLevel::MinZoomLevel; zoomDelta++)
+    {
+        ancestorTileId.x >>= 1;
+        ancestorTileId.y >>= 1;
+
+        if(!captureResourceInGPU(collection, ancestorTileId, static_cast<ZoomLevel>(zoom - zoomDelta), outResourceInGPU))
+            continue;
+
+        // Tile occupies a sub-rectangle of ancestor tile
+        const auto subdivisionsPerSide = 1u << zoomDelta;
+        const auto subdivisionMask = subdivisionsPerSide - 1;
+        outTexCoordsScale = 1.0f / static_cast<float>(subdivisionsPerSide);
+        outTexCoordsOffset.x = static_cast<float>(static_cast<uint32_t>(tileId.x) & subdivisionMask) * outTexCoordsScale;
+        outTexCoordsOffset.y = static_cast<float>(static_cast<uint32_t>(tileId.y) & subdivisionMask) * outTexCoordsScale;
+
+        return true;
+    }
+
+    return false;
+}
+
+bool OsmAnd::MapRendererResources::obtainDescendantsFallback(
+    const std::shared_ptr<const TiledResourcesCollection>& collection, const TileId tileId, const ZoomLevel zoom,
+    std::array< std::shared_ptr<const GPUAPI::ResourceInGPU>, 4 >& outResourcesInGPU) const
+{
+    if(zoom == ZoomLevel::MaxZoomLevel)
+        return false;
+
+    // Descendants are stored in row-major order: top-left, top-right, bottom-left, bottom-right
+    const auto descendantsZoom = static_cast<ZoomLevel>(zoom + 1);
+    for(int descendantIdx = 0; descendantIdx < 4; descendantIdx++)
+    {
+        TileId descendantTileId;
+        descendantTileId.x = (tileId.x << 1) + (descendantIdx & 1);
+        descendantTileId.y = (tileId.y << 1) + (descendantIdx >> 1);
+
+        if(!captureResourceInGPU(collection, descendantTileId, descendantsZoom, outResourcesInGPU[descendantIdx]))
+            return false;
+    }
+
+    return true;
+}
+
 void OsmAnd::MapRendererResources::releaseResourcesFrom(const std::shared_ptr<TiledResourcesCollection>& collection)
 {
     // Remove all tiles, releasing associated GPU resources
@@ -834,6 +1003,13 @@ void OsmAnd::MapRendererResources::syncResourcesInGPU(
     const auto resourcesUploaded = uploadResources(limitUploads, outMoreUploadsThanLimitAvailable);
     if(outResourcesUploaded)
         *outResourcesUploaded = resourcesUploaded;
+
+    // Newly uploaded resources may replace fallback resources, so let worker release them
+    if(resourcesUploaded > 0)
+    {
+        QMutexLocker scopedLocker(&_workerThreadWakeupMutex);
+        _workerThreadWakeup.wakeAll();
+    }
 }
 
 std::shared_ptr<const OsmAnd::MapRendererResources::TiledResourcesCollection> OsmAnd::MapRendererResources::getCollection(const ResourceType type, const std::shared_ptr<IMapProvider>& provider) const
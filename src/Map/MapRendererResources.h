@@ -28,9 +28,9 @@
 
 #include <OsmAndCore/QtExtensions.h>
 #include <QList>
+#include <QMap>
 #include <QHash>
 #include <QSet>
-#include <QThreadPool>
 #include <QReadWriteLock>
 #include <QWaitCondition>
 
@@ -180,6 +180,9 @@ namespace OsmAnd
 
         typedef std::array< QList< std::shared_ptr<TiledResourcesCollection> >, ResourceTypesCount > TiledResourcesStorage;
 
+        // Set of tiles that may span several zoom levels
+        typedef QMap< ZoomLevel, QSet<TileId> > TilesPerZoom;
+
         // Resource of map tile
         class MapTileResource : public BaseTiledResource
         {
@@ -252,7 +255,6 @@ namespace OsmAnd
     private:
         // Resource-requests related:
         const Concurrent::TaskHost::Bridge _taskHostBridge;
-        QThreadPool _resourcesRequestWorkersPool;
         class ResourceRequestTask : public Concurrent::HostedTask
         {
             Q_DISABLE_COPY(ResourceRequestTask);
@@ -294,11 +296,19 @@ namespace OsmAnd
         void validateResourcesOfType(const ResourceType type);
 
         // Resources management:
-        QSet<TileId> _activeTiles;
+        TilesPerZoom _activeTiles;
         ZoomLevel _activeZoom;
-        void updateResources(const QSet<TileId>& tiles, const ZoomLevel zoom);
-        void requestNeededResources(const QSet<TileId>& tiles, const ZoomLevel zoom);
-        void cleanupJunkResources(const QSet<TileId>& tiles, const ZoomLevel zoom);
+        void updateResources(const TilesPerZoom& tiles, const ZoomLevel zoom);
+        void requestNeededResources(const TilesPerZoom& tiles, const ZoomLevel zoom);
+        void requestNeededResources(const QSet<TileId>& tiles, const ZoomLevel zoom, const bool symbolsNeeded);
+        void cleanupJunkResources(const TilesPerZoom& tiles, const ZoomLevel zoom);
+        void collectFallbackTiles(const std::shared_ptr<TiledResourcesCollection>& collection,
+            const TilesPerZoom& tiles, std::array< QSet<TileId>, ZoomLevelsCount >& outFallbackTiles) const;
+        void collectFallbackTiles(const std::shared_ptr<TiledResourcesCollection>& collection,
+            const TileId tileId, const ZoomLevel zoom, std::array< QSet<TileId>, ZoomLevelsCount >& outFallbackTiles) const;
+        static bool isResourceUploaded(const std::shared_ptr<const TiledResourcesCollection>& collection, const TileId tileId, const ZoomLevel zoom);
+        static bool captureResourceInGPU(const std::shared_ptr<const TiledResourcesCollection>& collection, const TileId tileId, const ZoomLevel zoom,
+            std::shared_ptr<const GPUAPI::ResourceInGPU>& outResourceInGPU);
         unsigned int unloadResources();
         unsigned int uploadResources(const unsigned int limit = 0u, bool* const outMoreThanLimitAvailable = nullptr);
         void releaseResourcesFrom(const std::shared_ptr<TiledResourcesCollection>& collection);
@@ -325,7 +335,7 @@ namespace OsmAnd
         bool uploadSymbolToGPU(const std::shared_ptr<const MapSymbol>& mapSymbol, std::shared_ptr<const GPUAPI::ResourceInGPU>& outResourceInGPU);
 
         void updateBindings(const MapRendererState& state, const uint32_t updatedMask);
-        void updateActiveZone(const QSet<TileId>& tiles, const ZoomLevel zoom);
+        void updateActiveZone(const TilesPerZoom& tiles, const ZoomLevel zoom);
         void syncResourcesInGPU(
             const unsigned int limitUploads = 0u,
             bool* const outMoreUploadsThanLimitAvailable = nullptr,
@@ -342,6 +352,15 @@ namespace OsmAnd
 
         std::shared_ptr<const TiledResourcesCollection> getCollection(const ResourceType type, const std::shared_ptr<IMapProvider>& ofProvider) const;
 
+        // Fallback for tiles that are not yet uploaded to GPU:
+        enum {
+            MaxFallbackAncestorZoomDelta = 5,
+        };
+        bool obtainAncestorFallback(const std::shared_ptr<const TiledResourcesCollection>& collection, const TileId tileId, const ZoomLevel zoom,
+            std::shared_ptr<const GPUAPI::ResourceInGPU>& outResourceInGPU, PointF& outTexCoordsOffset, float& outTexCoordsScale) const;
+        bool obtainDescendantsFallback(const std::shared_ptr<const TiledResourcesCollection>& collection, const TileId tileId, const ZoomLevel zoom,
+            std::array< std::shared_ptr<const GPUAPI::ResourceInGPU>, 4 >& outResourcesInGPU) const;
+
         QMutex& getSymbolsMapMutex() const;
         const SymbolsMap& getSymbolsMap() const;
         unsigned int getSymbolsCount() const;
@@ -9,11 +9,12 @@
 #include "MapStyleRule.h"
 #include "Logging.h"
 
-OsmAnd::MapStyle::MapStyle( MapStyles* styles_, const QString& resourcePath_, const bool isEmbedded_ )
+OsmAnd::MapStyle::MapStyle( MapStyles* styles_, const QString& resourcePath_, const bool isEmbedded_, const bool isCompiled_ /*= false*/ )
     : _d(new MapStyle_P(this))
     , styles(styles_)
     , resourcePath(resourcePath_)
     , isEmbedded(isEmbedded_)
+    , isCompiled(isCompiled_)
     , title(_d->_title)
     , name(_d->_name)
     , parentName(_d->_parentName)
@@ -102,6 +103,11 @@ void OsmAnd::MapStyle::dump( MapStyleRulesetType type, const QString& prefix /*=
     }
 }
 
+bool OsmAnd::MapStyle::saveCompiled( const QString& filePath ) const
+{
+    return _d->saveCompiled(filePath);
+}
+
 static QMutex g_OsmAnd_MapStyle_builtinValueDefinitionsMutex;
 static std::shared_ptr<const OsmAnd::MapStyleBuiltinValueDefinitions> g_OsmAnd_MapStyle_builtinValueDefinitions;
 
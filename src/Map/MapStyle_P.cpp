@@ -10,6 +10,10 @@
 #include <QBuffer>
 #include <QFileInfo>
 #include <QStack>
+#include <QSet>
+#include <QVector>
+#include <QFile>
+#include <QSaveFile>
 
 #include "MapStyles.h"
 #include "MapStyleRule.h"
@@ -22,6 +26,7 @@
 
 OsmAnd::MapStyle_P::MapStyle_P( MapStyle* owner_ )
     : owner(owner_)
+    , _isLoaded(false)
     , _builtinValueDefs(MapStyle::getBuiltinValueDefinitions())
     , _firstNonBuiltinValueDefinitionIndex(0)
     , _stringsIdBase(0)
@@ -35,6 +40,9 @@ OsmAnd::MapStyle_P::~MapStyle_P()
 
 bool OsmAnd::MapStyle_P::parseMetadata()
 {
+    if(owner->isCompiled)
+        return loadCompiledMetadata();
+
     if(owner->isEmbedded)
     {
         QXmlStreamReader data(EmbeddedResources::decompressResource(owner->resourcePath));
@@ -103,6 +111,9 @@ bool OsmAnd::MapStyle_P::resolveDependencies()
 
 bool OsmAnd::MapStyle_P::parse()
 {
+    if(owner->isCompiled)
+        return loadCompiled();
+
     if(owner->isEmbedded)
     {
         QXmlStreamReader data(EmbeddedResources::decompressResource(owner->resourcePath));
@@ -739,3 +750,383 @@ uint64_t OsmAnd::MapStyle_P::encodeRuleId( uint32_t tag, uint32_t value )
 {
     return (static_cast<uint64_t>(tag) << RuleIdTagShift) | value;
 }
+
+bool OsmAnd::MapStyle_P::loadCompiledMetadata()
+{
+    QFile imageFile(owner->resourcePath);
+    if(!imageFile.open(QIODevice::ReadOnly))
+        return false;
+    QDataStream input(&imageFile);
+    input.setVersion(QDataStream::Qt_5_0);
+    bool ok = loadCompiledMetadata(input);
+    imageFile.close();
+    return ok;
+}
+
+bool OsmAnd::MapStyle_P::loadCompiledMetadata( QDataStream& input )
+{
+    quint32 magic;
+    quint32 formatVersion;
+    input >> magic >> formatVersion;
+    if(input.status() != QDataStream::Ok || magic != CompiledMagic || formatVersion != CompiledFormatVersion)
+    {
+        OsmAnd::LogPrintf(OsmAnd::LogSeverityLevel::Error, "'%s' is not a compiled map style image", qPrintable(owner->resourcePath));
+        return false;
+    }
+
+    // Compiled style has everything inherited already merged, so it's always standalone
+    input >> _title >> _name;
+    _parentName.clear();
+
+    return input.status() == QDataStream::Ok;
+}
+
+bool OsmAnd::MapStyle_P::loadCompiled()
+{
+    QFile imageFile(owner->resourcePath);
+    if(!imageFile.open(QIODevice::ReadOnly))
+        return false;
+
+    // Image is mapped into memory instead of being read through buffered I/O
+    const auto imageSize = imageFile.size();
+    const auto pImage = imageFile.map(0, imageSize);
+    if(!pImage)
+    {
+        QDataStream input(&imageFile);
+        input.setVersion(QDataStream::Qt_5_0);
+        return loadCompiled(input);
+    }
+    const auto image = QByteArray::fromRawData(reinterpret_cast<const char*>(pImage), imageSize);
+    QDataStream input(image);
+    input.setVersion(QDataStream::Qt_5_0);
+    bool ok = loadCompiled(input);
+    imageFile.unmap(pImage);
+    imageFile.close();
+    return ok;
+}
+
+bool OsmAnd::MapStyle_P::loadCompiled( QDataStream& input )
+{
+    if(!loadCompiledMetadata(input))
+        return false;
+
+    _parent.reset();
+    _parsetimeConstants.clear();
+    _attributes.clear();
+    _pointRules.clear();
+    _lineRules.clear();
+    _polygonRules.clear();
+    _textRules.clear();
+    _orderRules.clear();
+    _valuesDefinitions.clear();
+    registerBuiltinValueDefinitions();
+    const auto builtinValuesDefinitions = _valuesDefinitions;
+
+    // Strings table covers whole style chain, so IDs stay exactly the same as in original style
+    quint32 count;
+    input >> count;
+    _stringsIdBase = 0;
+    _stringsLUT.clear();
+    _stringsRevLUT.clear();
+    _stringsLUT.reserve(count);
+    _stringsRevLUT.reserve(count);
+    for(auto idx = 0u; idx < count && input.status() == QDataStream::Ok; idx++)
+    {
+        QString value;
+        input >> value;
+        registerString(value);
+    }
+
+    // Value definitions: builtin ones are referenced by name, configurable ones are stored completely
+    QVector< std::shared_ptr<const MapStyleValueDefinition> > valuesDefinitions;
+    input >> count;
+    valuesDefinitions.reserve(count);
+    for(auto idx = 0u; idx < count && input.status() == QDataStream::Ok; idx++)
+    {
+        bool isBuiltin;
+        QString name;
+        input >> isBuiltin >> name;
+        if(isBuiltin)
+        {
+            auto itValueDefinition = builtinValuesDefinitions.constFind(name);
+            if(itValueDefinition == builtinValuesDefinitions.cend())
+            {
+                OsmAnd::LogPrintf(OsmAnd::LogSeverityLevel::Error, "Compiled map style references unknown builtin value '%s'", qPrintable(name));
+                return false;
+            }
+            valuesDefinitions.push_back(*itValueDefinition);
+        }
+        else
+        {
+            quint32 dataType;
+            QString title;
+            QString description;
+            QStringList possibleValues;
+            input >> dataType >> title >> description >> possibleValues;
+            valuesDefinitions.push_back(std::shared_ptr<const MapStyleValueDefinition>(new MapStyleConfigurableInputValue(
+                static_cast<MapStyleValueDataType>(dataType),
+                name,
+                title,
+                description,
+                possibleValues)));
+        }
+    }
+    input >> count;
+    for(auto idx = 0u; idx < count && input.status() == QDataStream::Ok; idx++)
+    {
+        quint32 valueDefinitionIndex;
+        input >> valueDefinitionIndex;
+        if(valueDefinitionIndex >= static_cast<quint32>(valuesDefinitions.size()))
+            return false;
+        const auto& valueDefinition = valuesDefinitions[valueDefinitionIndex];
+        _valuesDefinitions.insert(valueDefinition->name, valueDefinition);
+    }
+
+    // Rules are stored flattened, so all of them are created first and linked afterwards
+    QVector< std::shared_ptr<MapStyleRule> > rules;
+    input >> count;
+    if(input.status() != QDataStream::Ok)
+        return false;
+    rules.reserve(count);
+    for(auto idx = 0u; idx < count; idx++)
+        rules.push_back(std::shared_ptr<MapStyleRule>(new MapStyleRule(owner, QHash< QString, QString >())));
+    for(auto itRule = rules.cbegin(); itRule != rules.cend() && input.status() == QDataStream::Ok; ++itRule)
+    {
+        const auto& rule = *itRule;
+
+        quint32 valuesCount;
+        input >> valuesCount;
+        rule->_d->_values.reserve(valuesCount);
+        rule->_d->_resolvedValueDefinitions.reserve(valuesCount);
+        for(auto idx = 0u; idx < valuesCount && input.status() == QDataStream::Ok; idx++)
+        {
+            quint32 valueDefinitionIndex;
+            MapStyleValue value;
+            quint64 rawValue;
+            input >> valueDefinitionIndex >> value.isComplex >> rawValue;
+            if(valueDefinitionIndex >= static_cast<quint32>(valuesDefinitions.size()))
+                return false;
+            value.asSimple.asUInt64 = rawValue;
+
+            const auto& valueDefinition = valuesDefinitions[valueDefinitionIndex];
+            rule->_d->_resolvedValueDefinitions.insert(valueDefinition->name, valueDefinition);
+            rule->_d->_values.insert(valueDefinition, value);
+        }
+
+        QList< std::shared_ptr<MapStyleRule> >* const childrenLists[] = { &rule->_d->_ifElseChildren, &rule->_d->_ifChildren };
+        for(auto childrenList : childrenLists)
+        {
+            quint32 childrenCount;
+            input >> childrenCount;
+            for(auto idx = 0u; idx < childrenCount && input.status() == QDataStream::Ok; idx++)
+            {
+                quint32 childIndex;
+                input >> childIndex;
+                if(childIndex >= static_cast<quint32>(rules.size()))
+                    return false;
+                childrenList->push_back(rules[childIndex]);
+            }
+        }
+    }
+
+    const MapStyleRulesetType rulesetTypes[] = {
+        MapStyleRulesetType::Point,
+        MapStyleRulesetType::Polyline,
+        MapStyleRulesetType::Polygon,
+        MapStyleRulesetType::Text,
+        MapStyleRulesetType::Order,
+    };
+    for(auto rulesetType : rulesetTypes)
+    {
+        auto& ruleset = obtainRulesRef(rulesetType);
+
+        input >> count;
+        for(auto idx = 0u; idx < count && input.status() == QDataStream::Ok; idx++)
+        {
+            quint64 ruleId;
+            quint32 ruleIndex;
+            input >> ruleId >> ruleIndex;
+            if(ruleIndex >= static_cast<quint32>(rules.size()))
+                return false;
+            ruleset.insert(ruleId, rules[ruleIndex]);
+        }
+    }
+
+    input >> count;
+    for(auto idx = 0u; idx < count && input.status() == QDataStream::Ok; idx++)
+    {
+        QString name;
+        quint32 ruleIndex;
+        input >> name >> ruleIndex;
+        if(ruleIndex >= static_cast<quint32>(rules.size()))
+            return false;
+        _attributes.insert(name, rules[ruleIndex]);
+    }
+
+    if(input.status() != QDataStream::Ok)
+    {
+        OsmAnd::LogPrintf(OsmAnd::LogSeverityLevel::Error, "Compiled map style image '%s' is truncated", qPrintable(owner->resourcePath));
+        return false;
+    }
+
+    return true;
+}
+
+bool OsmAnd::MapStyle_P::saveCompiled( const QString& filePath ) const
+{
+    // Style that was only registered has no rules yet, and its image would be empty
+    if(!_isLoaded)
+    {
+        OsmAnd::LogPrintf(OsmAnd::LogSeverityLevel::Error, "Map style '%s' has to be obtained before it's compiled", qPrintable(_name));
+        return false;
+    }
+
+    QSaveFile imageFile(filePath);
+    if(!imageFile.open(QIODevice::WriteOnly | QIODevice::Truncate))
+        return false;
+    QDataStream output(&imageFile);
+    output.setVersion(QDataStream::Qt_5_0);
+    if(!writeCompiled(output))
+    {
+        imageFile.cancelWriting();
+        return false;
+    }
+
+    return imageFile.commit();
+}
+
+bool OsmAnd::MapStyle_P::writeCompiled( QDataStream& output ) const
+{
+    const MapStyleRulesetType rulesetTypes[] = {
+        MapStyleRulesetType::Point,
+        MapStyleRulesetType::Polyline,
+        MapStyleRulesetType::Polygon,
+        MapStyleRulesetType::Text,
+        MapStyleRulesetType::Order,
+    };
+
+    // Flatten rules graph: same rule may be referenced from several rulesets, groups or parent styles
+    QList< std::shared_ptr<const MapStyleRule> > rules;
+    QHash< const MapStyleRule*, uint32_t > rulesIndices;
+    QStack< std::shared_ptr<const MapStyleRule> > pendingRules;
+    for(auto rulesetType : rulesetTypes)
+    {
+        const auto& ruleset = obtainRulesRef(rulesetType);
+        for(auto itRule = ruleset.cbegin(); itRule != ruleset.cend(); ++itRule)
+            pendingRules.push(*itRule);
+    }
+    for(auto itAttribute = _attributes.cbegin(); itAttribute != _attributes.cend(); ++itAttribute)
+        pendingRules.push(*itAttribute);
+    while(!pendingRules.isEmpty())
+    {
+        const auto rule = pendingRules.pop();
+        if(rulesIndices.contains(rule.get()))
+            continue;
+
+        rulesIndices.insert(rule.get(), rules.size());
+        rules.push_back(rule);
+
+        for(auto itChild = rule->_d->_ifElseChildren.cbegin(); itChild != rule->_d->_ifElseChildren.cend(); ++itChild)
+            pendingRules.push(*itChild);
+        for(auto itChild = rule->_d->_ifChildren.cbegin(); itChild != rule->_d->_ifChildren.cend(); ++itChild)
+            pendingRules.push(*itChild);
+    }
+
+    // Collect value definitions used by rules, plus ones visible by name through whole style chain
+    QList< std::shared_ptr<const MapStyleValueDefinition> > valuesDefinitions;
+    QHash< const MapStyleValueDefinition*, uint32_t > valuesDefinitionsIndices;
+    const auto collectValueDefinition =
+        [&valuesDefinitions, &valuesDefinitionsIndices](const std::shared_ptr<const MapStyleValueDefinition>& valueDefinition) -> uint32_t
+        {
+            auto itIndex = valuesDefinitionsIndices.constFind(valueDefinition.get());
+            if(itIndex != valuesDefinitionsIndices.cend())
+                return *itIndex;
+
+            const uint32_t index = valuesDefinitions.size();
+            valuesDefinitionsIndices.insert(valueDefinition.get(), index);
+            valuesDefinitions.push_back(valueDefinition);
+            return index;
+        };
+    QList< uint32_t > visibleValuesDefinitions;
+    QSet< QString > visibleNames;
+    for(auto style = this; style; style = style->_parent ? style->_parent->_d.get() : nullptr)
+    {
+        for(auto itValueDefinition = style->_valuesDefinitions.cbegin(); itValueDefinition != style->_valuesDefinitions.cend(); ++itValueDefinition)
+        {
+            if(visibleNames.contains(itValueDefinition.key()))
+                continue;
+            visibleNames.insert(itValueDefinition.key());
+
+            // Name is resolved the same way it would be resolved by original style
+            std::shared_ptr<const MapStyleValueDefinition> valueDefinition;
+            if(owner->resolveValueDefinition(itValueDefinition.key(), valueDefinition))
+                visibleValuesDefinitions.push_back(collectValueDefinition(valueDefinition));
+        }
+    }
+    for(auto itRule = rules.cbegin(); itRule != rules.cend(); ++itRule)
+    {
+        const auto& values = (*itRule)->_d->_values;
+        for(auto itValue = values.cbegin(); itValue != values.cend(); ++itValue)
+            collectValueDefinition(itValue.key());
+    }
+
+    output << static_cast<quint32>(CompiledMagic) << static_cast<quint32>(CompiledFormatVersion);
+    output << _title << _name;
+
+    const uint32_t stringsCount = _stringsIdBase + _stringsLUT.size();
+    output << stringsCount;
+    for(auto id = 0u; id < stringsCount; id++)
+        output << lookupStringValue(id);
+
+    output << static_cast<quint32>(valuesDefinitions.size());
+    for(auto itValueDefinition = valuesDefinitions.cbegin(); itValueDefinition != valuesDefinitions.cend(); ++itValueDefinition)
+    {
+        const auto& valueDefinition = *itValueDefinition;
+
+        const auto configurableInputValue = dynamic_cast<const MapStyleConfigurableInputValue*>(valueDefinition.get());
+        output << (configurableInputValue == nullptr) << valueDefinition->name;
+        if(configurableInputValue)
+        {
+            output << static_cast<quint32>(configurableInputValue->dataType);
+            output << configurableInputValue->title << configurableInputValue->description << configurableInputValue->possibleValues;
+        }
+    }
+    output << static_cast<quint32>(visibleValuesDefinitions.size());
+    for(auto itIndex = visibleValuesDefinitions.cbegin(); itIndex != visibleValuesDefinitions.cend(); ++itIndex)
+        output << *itIndex;
+
+    output << static_cast<quint32>(rules.size());
+    for(auto itRule = rules.cbegin(); itRule != rules.cend(); ++itRule)
+    {
+        const auto& rule = *itRule;
+
+        output << static_cast<quint32>(rule->_d->_values.size());
+        for(auto itValue = rule->_d->_values.cbegin(); itValue != rule->_d->_values.cend(); ++itValue)
+        {
+            const auto& value = *itValue;
+            output << valuesDefinitionsIndices[itValue.key().get()] << value.isComplex << static_cast<quint64>(value.asSimple.asUInt64);
+        }
+
+        output << static_cast<quint32>(rule->_d->_ifElseChildren.size());
+        for(auto itChild = rule->_d->_ifElseChildren.cbegin(); itChild != rule->_d->_ifElseChildren.cend(); ++itChild)
+            output << rulesIndices[itChild->get()];
+        output << static_cast<quint32>(rule->_d->_ifChildren.size());
+        for(auto itChild = rule->_d->_ifChildren.cbegin(); itChild != rule->_d->_ifChildren.cend(); ++itChild)
+            output << rulesIndices[itChild->get()];
+    }
+
+    for(auto rulesetType : rulesetTypes)
+    {
+        const auto& ruleset = obtainRulesRef(rulesetType);
+
+        output << static_cast<quint32>(ruleset.size());
+        for(auto itRule = ruleset.cbegin(); itRule != ruleset.cend(); ++itRule)
+            output << static_cast<quint64>(itRule.key()) << rulesIndices[itRule->get()];
+    }
+
+    output << static_cast<quint32>(_attributes.size());
+    for(auto itAttribute = _attributes.cbegin(); itAttribute != _attributes.cend(); ++itAttribute)
+        output << itAttribute.key() << rulesIndices[itAttribute->get()];
+
+    return output.status() == QDataStream::Ok;
+}
@@ -30,6 +30,7 @@
 #include <QXmlStreamReader>
 #include <QHash>
 #include <QMap>
+#include <QDataStream>
 
 #include <OsmAndCore.h>
 #include <MapStyle.h>
@@ -49,6 +50,14 @@ namespace OsmAnd {
         bool parseMetadata(QXmlStreamReader& xmlReader);
         bool parse(QXmlStreamReader& xmlReader);
 
+        enum : uint32_t {
+            CompiledMagic = 0x49534d42, // 'BMSI'
+            CompiledFormatVersion = 1,
+        };
+        bool loadCompiledMetadata(QDataStream& input);
+        bool loadCompiled(QDataStream& input);
+        bool writeCompiled(QDataStream& output) const;
+
         void registerBuiltinValueDefinitions();
         void registerBuiltinValueDefinition(const std::shared_ptr<const MapStyleValueDefinition>& pValueDefinition);
         std::shared_ptr<const MapStyleValueDefinition> registerValue(const MapStyleValueDefinition* pValueDefinition);
@@ -65,6 +74,13 @@ namespace OsmAnd {
         bool parseMetadata();
         bool parse();
 
+        bool loadCompiledMetadata();
+        bool loadCompiled();
+        bool saveCompiled(const QString& filePath) const;
+
+        // Set by MapStyles once style is parsed and everything inherited is merged into it
+        bool _isLoaded;
+
         QString _title;
 
         QString _name;
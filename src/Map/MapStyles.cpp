@@ -15,6 +15,11 @@ bool OsmAnd::MapStyles::registerStyle( const QString& filePath )
     return _d->registerStyle(filePath);
 }
 
+bool OsmAnd::MapStyles::registerCompiledStyle( const QString& filePath )
+{
+    return _d->registerCompiledStyle(filePath);
+}
+
 bool OsmAnd::MapStyles::obtainStyle( const QString& name, std::shared_ptr<const OsmAnd::MapStyle>& outStyle )
 {
     return _d->obtainStyle(name, outStyle);
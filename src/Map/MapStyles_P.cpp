@@ -45,6 +45,21 @@ bool OsmAnd::MapStyles_P::registerStyle( const QString& filePath )
     return true;
 }
 
+bool OsmAnd::MapStyles_P::registerCompiledStyle( const QString& filePath )
+{
+    std::shared_ptr<MapStyle> style(new MapStyle(owner, filePath, false, true));
+    if(!style->_d->parseMetadata())
+        return false;
+
+    // Compiled image may replace source style it was compiled from (like embedded one), unless that was already loaded
+    const auto itOtherStyle = _styles.constFind(style->name);
+    if(itOtherStyle != _styles.cend() && ((*itOtherStyle)->isCompiled || (*itOtherStyle)->_d->_isLoaded))
+        return false;
+    _styles.insert(style->name, style);
+
+    return true;
+}
+
 bool OsmAnd::MapStyles_P::obtainStyle( const QString& name, std::shared_ptr<const OsmAnd::MapStyle>& outStyle )
 {
     auto itStyle = _styles.constFind(name);
@@ -52,6 +67,18 @@ bool OsmAnd::MapStyles_P::obtainStyle( const QString& name, std::shared_ptr<cons
         return false;
 
     auto style = *itStyle;
+
+    // Compiled style already contains everything inherited from parent styles
+    if(style->isCompiled)
+    {
+        if(!style->_d->parse())
+            return false;
+
+        style->_d->_isLoaded = true;
+        outStyle = style;
+        return true;
+    }
+
     if(!style->isStandalone() && !style->areDependenciesResolved())
     {
         if(!style->_d->resolveDependencies())
@@ -67,6 +94,7 @@ bool OsmAnd::MapStyles_P::obtainStyle( const QString& name, std::shared_ptr<cons
     if(!style->isStandalone())
         style->_d->mergeInherited();
 
+    style->_d->_isLoaded = true;
     outStyle = style;
     return true;
 }
@@ -48,6 +48,7 @@ namespace OsmAnd {
 
         bool registerEmbeddedStyle(const QString& resourceName);
         bool registerStyle(const QString& filePath);
+        bool registerCompiledStyle(const QString& filePath);
         bool obtainStyle(const QString& name, std::shared_ptr<const OsmAnd::MapStyle>& outStyle);
     public:
         virtual ~MapStyles_P();
@@ -2,22 +2,18 @@
 #include "OfflineMapDataProvider.h"
 
 #include <cassert>
-#if defined(_DEBUG) || defined(DEBUG)
-#   include <chrono>
-#endif
 
 #include "OfflineMapDataTile.h"
 #include "OfflineMapDataTile_P.h"
 #include "ObfsCollection.h"
 #include "ObfDataInterface.h"
 #include "ObfMapSectionInfo.h"
-#if defined(_DEBUG) || defined(DEBUG)
-#   include "ObfMapSectionReader_Metrics.h"
-#   include "Rasterizer_Metrics.h"
-#endif
+#include "ObfMapSectionReader_Metrics.h"
+#include "Rasterizer_Metrics.h"
 #include "MapObject.h"
 #include "Rasterizer.h"
 #include "Utilities.h"
+#include "Tracing.h"
 #include "Logging.h"
 
 OsmAnd::OfflineMapDataProvider_P::OfflineMapDataProvider_P( OfflineMapDataProvider* owner_ )
@@ -59,19 +55,12 @@ void OsmAnd::OfflineMapDataProvider_P::obtainTile( const TileId tileId, const Zo
         }
     }
 
-#if defined(_DEBUG) || defined(DEBUG)
-    const auto total_Begin = std::chrono::high_resolution_clock::now();
-#endif
+    Tracing::Span totalSpan("obtainMapDataTile", "map");
 
     // Obtain OBF data interface
-#if defined(_DEBUG) || defined(DEBUG)
-    const auto obtainDataInterface_Begin = std::chrono::high_resolution_clock::now();
-#endif
+    Tracing::Span obtainDataInterfaceSpan("obtainDataInterface", "obf");
     const auto& dataInterface = owner->obfsCollection->obtainDataInterface();
-#if defined(_DEBUG) || defined(DEBUG)
-    const auto obtainDataInterface_End = std::chrono::high_resolution_clock::now();
-    const std::chrono::duration<float> obtainDataInterface_Elapsed = obtainDataInterface_End - obtainDataInterface_Begin;
-#endif
+    obtainDataInterfaceSpan.end();
 
     // Get bounding box that covers this tile
     const auto tileBBox31 = Utilities::tileBoundingBox31(tileId, zoom);
@@ -80,23 +69,12 @@ void OsmAnd::OfflineMapDataProvider_P::obtainTile( const TileId tileId, const Zo
     QList< std::shared_ptr<const Model::MapObject> > sharedMapObjects;
     QList< std::shared_ptr<const Model::MapObject> > mapObjects;
     MapFoundationType tileFoundation;
-#if defined(_DEBUG) || defined(DEBUG)
-    float dataFilter = 0.0f;
-    const auto dataRead_Begin = std::chrono::high_resolution_clock::now();
+    Tracing::Span dataReadSpan("readMapObjects", "obf");
     ObfMapSectionReader_Metrics::Metric_loadMapObjects dataRead_Metric;
-#endif
     const auto& cacheLevel = _mapObjectsCache[zoom];
     dataInterface->obtainMapObjects(&mapObjects, &tileFoundation, tileBBox31, zoom, nullptr,
-#if defined(_DEBUG) || defined(DEBUG)
-        [&cacheLevel, &sharedMapObjects, &dataFilter](const std::shared_ptr<const ObfMapSectionInfo>& section, const uint64_t id, const AreaI& bbox) -> bool
-#else
         [&cacheLevel, &sharedMapObjects](const std::shared_ptr<const ObfMapSectionInfo>& section, const uint64_t id, const AreaI& bbox) -> bool
-#endif
         {
-#if defined(_DEBUG) || defined(DEBUG)
-            const auto dataFilter_Begin = std::chrono::high_resolution_clock::now();
-#endif
-
             // Otherwise, this map object is surely shared, but a check is needed if it was already loaded
             {
                 QReadLocker scopedLocker(&cacheLevel._lock);
@@ -109,39 +87,30 @@ void OsmAnd::OfflineMapDataProvider_P::obtainTile( const TileId tileId, const Zo
                     {
                         // If map object is already in shared objects cache and is available, use that one
                         sharedMapObjects.push_back(qMove(mapObject));
-
-#if defined(_DEBUG) || defined(DEBUG)
-                        const auto dataFilter_End = std::chrono::high_resolution_clock::now();
-                        const std::chrono::duration<float> dataRead_Elapsed = dataFilter_End - dataFilter_Begin;
-                        dataFilter += dataRead_Elapsed.count();
-#endif
-
                         return false;
                     }
                 }
             }
 
-#if defined(_DEBUG) || defined(DEBUG)
-            const auto dataFilter_End = std::chrono::high_resolution_clock::now();
-            const std::chrono::duration<float> dataRead_Elapsed = dataFilter_End - dataFilter_Begin;
-            dataFilter += dataRead_Elapsed.count();
-#endif
-
             return true;
         },
-#if defined(_DEBUG) || defined(DEBUG)
-        &dataRead_Metric
-#else
-        nullptr
-#endif
-    );
-
-#if defined(_DEBUG) || defined(DEBUG)
-    const auto dataRead_End = std::chrono::high_resolution_clock::now();
-    const std::chrono::duration<float> dataRead_Elapsed = dataRead_End - dataRead_Begin;
+        dataReadSpan.isActive() ? &dataRead_Metric : nullptr);
+    if(dataReadSpan.isActive())
+    {
+        dataReadSpan.setDetails(QString(
+            "%1x%2@%3: %4 unique, %5 shared; "
+            "visitedNodes = %6, acceptedNodes = %7, mapObjectsBlocksRead = %8, visitedMapObjects = %9, acceptedMapObjects = %10")
+            .arg(tileId.x).arg(tileId.y).arg(zoom)
+            .arg(mapObjects.size()).arg(sharedMapObjects.size())
+            .arg(dataRead_Metric.visitedNodes)
+            .arg(dataRead_Metric.acceptedNodes)
+            .arg(dataRead_Metric.mapObjectsBlocksRead)
+            .arg(dataRead_Metric.visitedMapObjects)
+            .arg(dataRead_Metric.acceptedMapObjects));
+    }
+    dataReadSpan.end();
 
-    const auto dataIdsProcess_Begin = std::chrono::high_resolution_clock::now();
-#endif
+    Tracing::Span dataIdsProcessSpan("processMapObjectsIds", "map");
 
     // Add all shared map objects to cache
     for(auto itMapObject = mapObjects.begin(); itMapObject != mapObjects.end(); ++itMapObject)
@@ -179,13 +148,10 @@ void OsmAnd::OfflineMapDataProvider_P::obtainTile( const TileId tileId, const Zo
         }
     }
 
-#if defined(_DEBUG) || defined(DEBUG)
-    const auto dataIdsProcess_End = std::chrono::high_resolution_clock::now();
-    const std::chrono::duration<float> dataIdsProcess_Elapsed = dataIdsProcess_End - dataIdsProcess_Begin;
+    dataIdsProcessSpan.end();
 
-    Rasterizer_Metrics::Metric_prepareContext dataProcess_metric;
-    const auto dataProcess_Begin = std::chrono::high_resolution_clock::now();
-#endif
+    Tracing::Span dataProcessSpan("prepareRasterizerContext", "style");
+    Rasterizer_Metrics::Metric_prepareContext dataProcess_Metric;
 
     // Prepare data for the tile
     const auto sharedMapObjectsCount = sharedMapObjects.size();
@@ -195,17 +161,25 @@ void OsmAnd::OfflineMapDataProvider_P::obtainTile( const TileId tileId, const Zo
     bool nothingToRasterize = false;
     std::shared_ptr<RasterizerContext> rasterizerContext(new RasterizerContext(owner->rasterizerEnvironment, owner->rasterizerSharedContext));
     Rasterizer::prepareContext(*rasterizerContext, tileBBox31, zoom, tileFoundation, mapObjects, &nothingToRasterize, nullptr,
-#if defined(_DEBUG) || defined(DEBUG)
-        &dataProcess_metric
-#else
-        nullptr
-#endif
-    );
-
-#if defined(_DEBUG) || defined(DEBUG)
-    const auto dataProcess_End = std::chrono::high_resolution_clock::now();
-    const std::chrono::duration<float> dataProcess_Elapsed = dataProcess_End - dataProcess_Begin;
-#endif
+        dataProcessSpan.isActive() ? &dataProcess_Metric : nullptr);
+    if(dataProcessSpan.isActive())
+    {
+        dataProcessSpan.setDetails(QString(
+            "%1x%2@%3: orderEvaluations = %4, polygonEvaluations = %5, polylineEvaluations = %6, pointEvaluations = %7, "
+            "primitives = %8/%9/%10, polygonizedCoastlines = %11, simplificationVertices = %12->%13")
+            .arg(tileId.x).arg(tileId.y).arg(zoom)
+            .arg(dataProcess_Metric.orderEvaluations)
+            .arg(dataProcess_Metric.polygonEvaluations)
+            .arg(dataProcess_Metric.polylineEvaluations)
+            .arg(dataProcess_Metric.pointEvaluations)
+            .arg(dataProcess_Metric.polygonPrimitives)
+            .arg(dataProcess_Metric.polylinePrimitives)
+            .arg(dataProcess_Metric.pointPrimitives)
+            .arg(dataProcess_Metric.polygonizedCoastlines)
+            .arg(dataProcess_Metric.simplificationVerticesIn)
+            .arg(dataProcess_Metric.simplificationVerticesOut));
+    }
+    dataProcessSpan.end();
 
     // Create tile
     const auto newTile = new OfflineMapDataTile(tileId, zoom, tileFoundation, mapObjects, rasterizerContext, nothingToRasterize);
@@ -225,89 +199,10 @@ void OsmAnd::OfflineMapDataProvider_P::obtainTile( const TileId tileId, const Zo
         tileEntry->_loadedCondition.wakeAll();
     }
 
-#if defined(_DEBUG) || defined(DEBUG)
-    const auto total_End = std::chrono::high_resolution_clock::now();
-    const std::chrono::duration<float> total_Elapsed = total_End - total_Begin;
-
-    LogPrintf(LogSeverityLevel::Info,
-        "%d map objects (%d unique, %d shared) from %dx%d@%d in %fs:\n"
-        "\topen %fs\n"
-        "\tread %fs (filter-by-id %fs):\n"
-        "\t - visitedLevels = %d\n"
-        "\t - acceptedLevels = %d\n"
-        "\t - visitedNodes = %d\n"
-        "\t - acceptedNodes = %d\n"
-        "\t - elapsedTimeForNodes = %fs\n"
-        "\t - mapObjectsBlocksRead = %d\n"
-        "\t - visitedMapObjects = %d\n"
-        "\t - acceptedMapObjects = %d\n"
-        "\t - elapsedTimeForMapObjectsBlocks = %fs\n"
-        "\t - elapsedTimeForOnlyVisitedMapObjects = %fs\n"
-        "\t - elapsedTimeForOnlyAcceptedMapObjects = %fs\n"
-        "\t - average time per 1K only-visited map objects = %fms\n"
-        "\t - average time per 1K only-accepted map objects = %fms\n"
-        "\tprocess-ids %fs\n"
-        "\tprocess-content %fs:\n"
-        "\t - elapsedTimeForSortingObjects = %fs\n"
-        "\t - elapsedTimeForPolygonizingCoastlines = %fs\n"
-        "\t - polygonizedCoastlines = %d\n"
-        "\t - elapsedTimeForObtainingPrimitives = %fs\n"
-        "\t - elapsedTimeForOrderEvaluation = %fs\n"
-        "\t - orderEvaluations = %d\n"
-        "\t - average time per 1K order evaluations = %fms\n"
-        "\t - elapsedTimeForPolygonEvaluation = %fs\n"
-        "\t - polygonEvaluations = %d\n"
-        "\t - average time per 1K polygon evaluations = %fms\n"
-        "\t - polygonPrimitives = %d\n"
-        "\t - elapsedTimeForPolylineEvaluation = %fs\n"
-        "\t - polylineEvaluations = %d\n"
-        "\t - average time per 1K polyline evaluations = %fms\n"
-        "\t - polylinePrimitives = %d\n"
-        "\t - elapsedTimeForPointEvaluation = %fs\n"
-        "\t - pointEvaluations = %d\n"
-        "\t - average time per 1K point evaluations = %fms\n"
-        "\t - pointPrimitives = %d\n"
-        "\t - elapsedTimeForObtainingPrimitivesSymbols = %fs",
-        mapObjects.size(), mapObjects.size() - sharedMapObjectsCount, sharedMapObjectsCount,
-        tileId.x, tileId.y, zoom,
-        total_Elapsed.count(),
-        obtainDataInterface_Elapsed.count(),
-        dataRead_Elapsed.count(), dataFilter,
-        dataRead_Metric.visitedLevels,
-        dataRead_Metric.acceptedLevels,
-        dataRead_Metric.visitedNodes,
-        dataRead_Metric.acceptedNodes,
-        dataRead_Metric.elapsedTimeForNodes,
-        dataRead_Metric.mapObjectsBlocksRead,
-        dataRead_Metric.visitedMapObjects,
-        dataRead_Metric.acceptedMapObjects,
-        dataRead_Metric.elapsedTimeForMapObjectsBlocks,
-        dataRead_Metric.elapsedTimeForOnlyVisitedMapObjects,
-        dataRead_Metric.elapsedTimeForOnlyAcceptedMapObjects,
-        (dataRead_Metric.elapsedTimeForOnlyVisitedMapObjects * 1000.0f) / (static_cast<float>(dataRead_Metric.visitedMapObjects - dataRead_Metric.acceptedMapObjects) / 1000.0f),
-        (dataRead_Metric.elapsedTimeForOnlyAcceptedMapObjects * 1000.0f) / (static_cast<float>(dataRead_Metric.acceptedMapObjects) / 1000.0f),
-        dataIdsProcess_Elapsed.count(),
-        dataProcess_Elapsed.count(),
-        dataProcess_metric.elapsedTimeForSortingObjects,
-        dataProcess_metric.elapsedTimeForPolygonizingCoastlines,
-        dataProcess_metric.polygonizedCoastlines,
-        dataProcess_metric.elapsedTimeForObtainingPrimitives,
-        dataProcess_metric.elapsedTimeForOrderEvaluation,
-        dataProcess_metric.orderEvaluations,
-        (dataProcess_metric.elapsedTimeForOrderEvaluation * 1000.0f / static_cast<float>(dataProcess_metric.orderEvaluations)) * 1000.0f,
-        dataProcess_metric.elapsedTimeForPolygonEvaluation,
-        dataProcess_metric.polygonEvaluations,
-        (dataProcess_metric.elapsedTimeForPolygonEvaluation * 1000.0f / static_cast<float>(dataProcess_metric.polygonEvaluations)) * 1000.0f,
-        dataProcess_metric.polygonPrimitives,
-        dataProcess_metric.elapsedTimeForPolylineEvaluation,
-        dataProcess_metric.polylineEvaluations,
-        (dataProcess_metric.elapsedTimeForPolylineEvaluation * 1000.0f / static_cast<float>(dataProcess_metric.polylineEvaluations)) * 1000.0f,
-        dataProcess_metric.polylinePrimitives,
-        dataProcess_metric.elapsedTimeForPointEvaluation,
-        dataProcess_metric.pointEvaluations,
-        (dataProcess_metric.elapsedTimeForPointEvaluation * 1000.0f / static_cast<float>(dataProcess_metric.pointEvaluations)) * 1000.0f,
-        dataProcess_metric.pointPrimitives,
-        dataProcess_metric.elapsedTimeForObtainingPrimitivesSymbols);
-#endif
+    if(totalSpan.isActive())
+    {
+        totalSpan.setDetails(QString("%1x%2@%3: %4 map objects (%5 shared)")
+            .arg(tileId.x).arg(tileId.y).arg(zoom)
+            .arg(mapObjects.size()).arg(sharedMapObjectsCount));
+    }
 }
-
@@ -1,9 +1,16 @@
 #include "OfflineMapRasterTileProvider_Software.h"
 #include "OfflineMapRasterTileProvider_Software_P.h"
 
-OsmAnd::OfflineMapRasterTileProvider_Software::OfflineMapRasterTileProvider_Software( const std::shared_ptr<OfflineMapDataProvider>& dataProvider_, const uint32_t outputTileSize /*= 256*/, const float density /*= 1.0f*/)
+#include "RasterizationSurfacesPool.h"
+
+OsmAnd::OfflineMapRasterTileProvider_Software::OfflineMapRasterTileProvider_Software(
+    const std::shared_ptr<OfflineMapDataProvider>& dataProvider_,
+    const uint32_t outputTileSize /*= 256*/,
+    const float density /*= 1.0f*/,
+    const std::shared_ptr<RasterizationSurfacesPool>& surfacesPool_ /*= nullptr*/)
     : _d(new OfflineMapRasterTileProvider_Software_P(this, outputTileSize, density))
     , dataProvider(dataProvider_)
+    , surfacesPool(surfacesPool_ ? surfacesPool_ : std::shared_ptr<RasterizationSurfacesPool>(new RasterizationSurfacesPool()))
 {
 }
 
@@ -2,9 +2,6 @@
 #include "OfflineMapRasterTileProvider_Software.h"
 
 #include <cassert>
-#if defined(_DEBUG) || defined(DEBUG)
-#   include <chrono>
-#endif
 
 #include <SkStream.h>
 #include <SkBitmap.h>
@@ -20,7 +17,10 @@
 #include "Rasterizer.h"
 #include "RasterizerContext.h"
 #include "RasterizerEnvironment.h"
+#include "RasterizationSurfacesPool.h"
+#include "RasterizationSurfacesPool_P.h"
 #include "Utilities.h"
+#include "Tracing.h"
 #include "Logging.h"
 
 OsmAnd::OfflineMapRasterTileProvider_Software_P::OfflineMapRasterTileProvider_Software_P( OfflineMapRasterTileProvider_Software* owner_, const uint32_t outputTileSize_, const float density_ )
@@ -46,65 +46,44 @@ bool OsmAnd::OfflineMapRasterTileProvider_Software_P::obtainTile(const TileId ti
         return true;
     }
 
-#if defined(_DEBUG) || defined(DEBUG)
-    const auto dataRasterization_Begin = std::chrono::high_resolution_clock::now();
-#endif
-
-    // Allocate rasterization target
-    auto rasterizationSurface = new SkBitmap();
-    rasterizationSurface->setConfig(SkBitmap::kARGB_8888_Config, outputTileSize, outputTileSize);
-    if(!rasterizationSurface->allocPixels())
-    {
-        delete rasterizationSurface;
-
-        LogPrintf(LogSeverityLevel::Error, "Failed to allocate buffer for ARGB8888 rasterization surface %dx%d", outputTileSize, outputTileSize);
-        return false;
-    }
-    SkBitmapDevice rasterizationTarget(*rasterizationSurface);
-
-    // Create rasterization canvas
-    SkCanvas canvas(&rasterizationTarget);
+    Tracing::Span rasterizationSpan("rasterizeMap", "raster");
 
     // Perform actual rendering
+    std::shared_ptr<RasterizationSurfacesPool_P::Surface> surface;
     if(!dataTile->nothingToRasterize)
     {
+        // Obtain rasterization target from pool. Pixel buffer goes back to pool once tile releases it
+        surface = owner->surfacesPool->_d->obtainSurface(outputTileSize, outputTileSize, SkBitmap::kARGB_8888_Config);
+        if(!surface)
+            return false;
+
         Rasterizer rasterizer(dataTile->rasterizerContext);
-        rasterizer.rasterizeMap(canvas);
+        rasterizer.rasterizeMap(*surface->canvas);
     }
 
-#if defined(_DEBUG) || defined(DEBUG)
-    const auto dataRasterization_End = std::chrono::high_resolution_clock::now();
-    const std::chrono::duration<float> dataRasterization_Elapsed = dataRasterization_End - dataRasterization_Begin;
-    if(!dataTile->nothingToRasterize)
+    if(rasterizationSpan.isActive())
     {
-        LogPrintf(LogSeverityLevel::Info,
-            "%d map objects in %dx%d@%d: rasterization %fs",
-            dataTile->mapObjects.count(), tileId.x, tileId.y, zoom, dataRasterization_Elapsed.count());
+        rasterizationSpan.setDetails(QString("%1x%2@%3: %4 map objects%5")
+            .arg(tileId.x).arg(tileId.y).arg(zoom)
+            .arg(dataTile->mapObjects.count())
+            .arg(dataTile->nothingToRasterize ? QLatin1String(", nothing to rasterize") : QLatin1String("")));
     }
-    else
-    {
-        LogPrintf(LogSeverityLevel::Info,
-            "%d map objects in %dx%d@%d: nothing to rasterize (%fs)",
-            dataTile->mapObjects.count(), tileId.x, tileId.y, zoom, dataRasterization_Elapsed.count());
-    }
-#endif
+    rasterizationSpan.end();
 
     // If there is no data to rasterize, tell that this tile is not available
     if(dataTile->nothingToRasterize)
     {
-        delete rasterizationSurface;
-
         outTile.reset();
         return true;
     }
 
     // Or supply newly rasterized tile
-    auto tile = new Tile(rasterizationSurface, dataTile);
+    auto tile = new Tile(std::shared_ptr<const SkBitmap>(surface, &surface->bitmap()), dataTile);
     outTile.reset(tile);
     return true;
 }
 
-OsmAnd::OfflineMapRasterTileProvider_Software_P::Tile::Tile( SkBitmap* bitmap, const std::shared_ptr<const OfflineMapDataTile>& dataTile_ )
+OsmAnd::OfflineMapRasterTileProvider_Software_P::Tile::Tile( const std::shared_ptr<const SkBitmap>& bitmap, const std::shared_ptr<const OfflineMapDataTile>& dataTile_ )
     : MapBitmapTile(bitmap, AlphaChannelData::NotPresent)
     , _dataTile(dataTile_)
     , dataTile(_dataTile)
@@ -117,5 +96,6 @@ OsmAnd::OfflineMapRasterTileProvider_Software_P::Tile::~Tile()
 
 void OsmAnd::OfflineMapRasterTileProvider_Software_P::Tile::releaseNonRetainedData()
 {
+    // This returns pixel buffer to surfaces pool, if it's the last reference
     _bitmap.reset();
 }
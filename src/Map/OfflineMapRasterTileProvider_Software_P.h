@@ -79,7 +79,7 @@ namespace OsmAnd {
             const std::shared_ptr<const OfflineMapDataTile> _dataTile;
         protected:
         public:
-            Tile(SkBitmap* bitmap, const std::shared_ptr<const OfflineMapDataTile>& dataTile);
+            Tile(const std::shared_ptr<const SkBitmap>& bitmap, const std::shared_ptr<const OfflineMapDataTile>& dataTile);
             virtual ~Tile();
 
             const std::shared_ptr<const OfflineMapDataTile>& dataTile;
@@ -3,6 +3,8 @@
 
 #include <cassert>
 
+#include "OnlineTilesFilesCache.h"
+
 #include "Logging.h"
 
 OsmAnd::OnlineMapRasterTileProvider::OnlineMapRasterTileProvider(
@@ -16,6 +18,7 @@ OsmAnd::OnlineMapRasterTileProvider::OnlineMapRasterTileProvider(
     : _d(new OnlineMapRasterTileProvider_P(this))
     , localCachePath(_d->_localCachePath)
     , networkAccessAllowed(_d->_networkAccessAllowed)
+    , neighboursPrefetchEnabled(_d->_prefetchNeighbours)
     , id(id_)
     , urlPattern(urlPattern_)
     , minZoom(minZoom_)
@@ -25,6 +28,8 @@ OsmAnd::OnlineMapRasterTileProvider::OnlineMapRasterTileProvider(
     , alphaChannelData(alphaChannelData_)
 {
     _d->_localCachePath = QDir(QDir::current().filePath(id));
+    _d->_localCache.reset(new OnlineTilesFilesCache(_d->_localCachePath));
+    _d->_downloader.reset(new OnlineTilesDownloader(urlPattern, maxConcurrentDownloads));
 }
 
 OsmAnd::OnlineMapRasterTileProvider::~OnlineMapRasterTileProvider()
@@ -35,6 +40,19 @@ void OsmAnd::OnlineMapRasterTileProvider::setLocalCachePath( const QDir& localCa
 {
     QMutexLocker scopedLocker(&_d->_localCachePathMutex);
     _d->_localCachePath = localCachePath;
+    _d->_localCache.reset(new OnlineTilesFilesCache(localCachePath));
+}
+
+void OsmAnd::OnlineMapRasterTileProvider::setLocalCache( const std::shared_ptr<IOnlineTilesCache>& localCache )
+{
+    QMutexLocker scopedLocker(&_d->_localCachePathMutex);
+    _d->_localCache = localCache;
+}
+
+std::shared_ptr<OsmAnd::IOnlineTilesCache> OsmAnd::OnlineMapRasterTileProvider::getLocalCache() const
+{
+    QMutexLocker scopedLocker(&_d->_localCachePathMutex);
+    return _d->_localCache;
 }
 
 void OsmAnd::OnlineMapRasterTileProvider::setNetworkAccessPermission( bool allowed )
@@ -42,6 +60,16 @@ void OsmAnd::OnlineMapRasterTileProvider::setNetworkAccessPermission( bool allow
     _d->_networkAccessAllowed = allowed;
 }
 
+void OsmAnd::OnlineMapRasterTileProvider::setNeighboursPrefetch( bool enabled )
+{
+    _d->_prefetchNeighbours = enabled;
+}
+
+void OsmAnd::OnlineMapRasterTileProvider::cancelDownloadsExcept( const QSet<TileId>& tiles, const ZoomLevel zoom )
+{
+    _d->_downloader->cancelAllExcept(tiles, zoom);
+}
+
 bool OsmAnd::OnlineMapRasterTileProvider::obtainTile( const TileId tileId, const ZoomLevel zoom, std::shared_ptr<const MapTile>& outTile )
 {
     // Check provider can supply this zoom level
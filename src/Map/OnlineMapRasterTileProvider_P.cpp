@@ -5,21 +5,18 @@
 
 #include <OsmAndCore/QtExtensions.h>
 #include <QCoreApplication>
-#include <QNetworkRequest>
-#include <QNetworkReply>
-#include <QFile>
 
 #include <SkStream.h>
 #include <SkImageDecoder.h>
 
-#include "Network.h"
+#include "Concurrent.h"
 #include "Logging.h"
 
 OsmAnd::OnlineMapRasterTileProvider_P::OnlineMapRasterTileProvider_P( OnlineMapRasterTileProvider* owner_ )
     : owner(owner_)
-    , _currentDownloadsCounter(0)
     , _localCachePath(QDir::current())
     , _networkAccessAllowed(true)
+    , _prefetchNeighbours(false)
 {
 }
 
@@ -34,32 +31,28 @@ bool OsmAnd::OnlineMapRasterTileProvider_P::obtainTile( const TileId tileId, con
     lockTile(tileId, zoom);
 
     // Check if requested tile is already in local storage.
-    const auto tileLocalRelativePath =
-        QString::number(zoom) + QDir::separator() +
-        QString::number(tileId.x) + QDir::separator() +
-        QString::number(tileId.y) + QLatin1String(".tile");
-    QFileInfo localFile;
+    std::shared_ptr<IOnlineTilesCache> localCache;
     {
         QMutexLocker scopedLocker(&_localCachePathMutex);
-        localFile.setFile(_localCachePath.filePath(tileLocalRelativePath));
+        localCache = _localCache;
     }
-    if(localFile.exists())
+    QByteArray cachedData;
+    if(localCache && localCache->obtainTileData(tileId, zoom, cachedData))
     {
         // Since tile is in local storage, it's safe to unmark it as being processed
         unlockTile(tileId, zoom);
 
-        // If local file is empty, it means that requested tile does not exist (has no data)
-        if(localFile.size() == 0)
+        // If cached data is empty, it means that requested tile does not exist (has no data)
+        if(cachedData.isEmpty())
         {
             outTile.reset();
             return true;
         }
 
         auto bitmap = new SkBitmap();
-        SkFILEStream fileStream(qPrintable(localFile.absoluteFilePath()));
-        if(!SkImageDecoder::DecodeStream(&fileStream, bitmap, SkBitmap::Config::kNo_Config, SkImageDecoder::kDecodePixels_Mode))
+        if(!SkImageDecoder::DecodeMemory(cachedData.constData(), cachedData.size(), bitmap, SkBitmap::Config::kNo_Config, SkImageDecoder::kDecodePixels_Mode))
         {
-            LogPrintf(LogSeverityLevel::Error, "Failed to decode tile file '%s'", qPrintable(localFile.absoluteFilePath()));
+            LogPrintf(LogSeverityLevel::Error, "Failed to decode cached tile %dx%d@%d", tileId.x, tileId.y, zoom);
 
             delete bitmap;
 
@@ -87,96 +80,54 @@ bool OsmAnd::OnlineMapRasterTileProvider_P::obtainTile( const TileId tileId, con
         return false;
     }
 
-    // Check if there is free download slot. If all download slots are used, wait for one to be freed
-    if(owner->maxConcurrentDownloads > 0)
-    {
-        QMutexLocker scopedLocker(&_currentDownloadsCounterMutex);
-
-        while(_currentDownloadsCounter >= owner->maxConcurrentDownloads)
-            _currentDownloadsCounterChanged.wait(&_currentDownloadsCounterMutex);
-
-        _currentDownloadsCounter++;
-    }
-
-    // Perform synchronous download
-    auto tileUrl = owner->urlPattern;
-    tileUrl
-        .replace(QLatin1String("${zoom}"), QString::number(zoom))
-        .replace(QLatin1String("${x}"), QString::number(tileId.x))
-        .replace(QLatin1String("${y}"), QString::number(tileId.y));
-    const auto networkReply = Network::Downloader::download(tileUrl);
+    // Perform download. Concurrent requests for the same tile are served by single network request
+    const auto& downloader = _downloader;
+    const auto tileUrl = downloader->getTileUrl(tileId, zoom).toString();
+    QByteArray data;
+    const auto downloadResult = downloader->download(tileId, zoom, data);
 
-    // Free download slot
+    // 404 means that this tile does not exist, so mark it as non-existent in local cache
+    if(downloadResult == OnlineTilesDownloader::Result::NotFound)
     {
-        QMutexLocker scopedLocker(&_currentDownloadsCounterMutex);
+        if(localCache && !localCache->storeTileData(tileId, zoom, QByteArray()))
+            LogPrintf(LogSeverityLevel::Error, "Failed to mark tile %dx%d@%d as non-existent", tileId.x, tileId.y, zoom);
 
-        _currentDownloadsCounter--;
-        _currentDownloadsCounterChanged.wakeAll();
+        // Unlock the tile
+        unlockTile(tileId, zoom);
+        outTile.reset();
+        return true;
     }
-
-    // Ensure that all directories are created in path to local tile
-    localFile.dir().mkpath(localFile.dir().absolutePath());
-
-    // If there was error, check what the error was
-    auto networkError = networkReply->error();
-    if(networkError != QNetworkReply::NetworkError::NoError)
+    else if(downloadResult != OnlineTilesDownloader::Result::Downloaded)
     {
-        const auto httpStatus = networkReply->attribute(QNetworkRequest::HttpStatusCodeAttribute).toInt();
-
-        LogPrintf(LogSeverityLevel::Warning, "Failed to download tile from %s (HTTP status %d)", qPrintable(tileUrl), httpStatus);
-
-        // 404 means that this tile does not exist, so create a zero file
-        if(httpStatus == 404)
-        {
-            // Save to a file
-            QFile tileFile(localFile.absoluteFilePath());
-            if(tileFile.open(QIODevice::WriteOnly | QIODevice::Truncate))
-            {
-                tileFile.close();
-
-                // Unlock the tile
-                unlockTile(tileId, zoom);
-                networkReply->deleteLater();
-                return true;
-            }
-            else
-            {
-                LogPrintf(LogSeverityLevel::Error, "Failed to mark tile as non-existent with empty file '%s'", qPrintable(localFile.absoluteFilePath()));
-
-                // Unlock the tile
-                unlockTile(tileId, zoom);
-                return false;
-            }
-        }
-
         // Unlock the tile
         unlockTile(tileId, zoom);
         return false;
     }
 
-    // Save data to a file
 #if defined(_DEBUG) || defined(DEBUG)
     LogPrintf(LogSeverityLevel::Info, "Downloaded tile from %s", qPrintable(tileUrl));
 #endif
-    const auto& data = networkReply->readAll();
 
-    // Save to a file
-    QFile tileFile(localFile.absoluteFilePath());
-    if(tileFile.open(QIODevice::WriteOnly | QIODevice::Truncate))
+    // Save to local cache
+    if(localCache)
     {
-        tileFile.write(data);
-        tileFile.close();
-
+        if(localCache->storeTileData(tileId, zoom, data))
+        {
 #if defined(_DEBUG) || defined(DEBUG)
-        LogPrintf(LogSeverityLevel::Info, "Saved tile from %s to %s", qPrintable(tileUrl), qPrintable(localFile.absoluteFilePath()));
+            LogPrintf(LogSeverityLevel::Info, "Saved tile from %s to local cache", qPrintable(tileUrl));
 #endif
+        }
+        else
+            LogPrintf(LogSeverityLevel::Error, "Failed to save tile from %s to local cache", qPrintable(tileUrl));
     }
-    else
-        LogPrintf(LogSeverityLevel::Error, "Failed to save tile to '%s'", qPrintable(localFile.absoluteFilePath()));
 
     // Unlock tile, since local storage work is done
     unlockTile(tileId, zoom);
 
+    // Since this tile had to be downloaded, it's likely that its neighbours will be requested soon
+    if(_prefetchNeighbours)
+        prefetchNeighbours(downloader, localCache, tileId, zoom);
+
     // Decode in-memory
     auto bitmap = new SkBitmap();
     if(!SkImageDecoder::DecodeMemory(data.data(), data.size(), bitmap, SkBitmap::Config::kNo_Config, SkImageDecoder::kDecodePixels_Mode))
@@ -215,3 +166,53 @@ void OsmAnd::OnlineMapRasterTileProvider_P::unlockTile( const TileId tileId, con
 
     _waitUntilAnyTileIsProcessed.wakeAll();
 }
+
+void OsmAnd::OnlineMapRasterTileProvider_P::prefetchNeighbours( const std::shared_ptr<OnlineTilesDownloader>& downloader, const std::shared_ptr<IOnlineTilesCache>& localCache, const TileId tileId, const ZoomLevel zoom )
+{
+    // Prefetched tiles are useless without a place to store them
+    if(!localCache)
+        return;
+
+    const auto tilesCount = static_cast<int64_t>(1ull << zoom);
+    for(int dy = -1; dy <= 1; dy++)
+    {
+        for(int dx = -1; dx <= 1; dx++)
+        {
+            if(dx == 0 && dy == 0)
+                continue;
+
+            const int64_t x = static_cast<int64_t>(tileId.x) + dx;
+            const int64_t y = static_cast<int64_t>(tileId.y) + dy;
+            if(x < 0 || x >= tilesCount || y < 0 || y >= tilesCount)
+                continue;
+            TileId neighbourId;
+            neighbourId.x = static_cast<int32_t>(x);
+            neighbourId.y = static_cast<int32_t>(y);
+
+            // Skip tiles that are being processed or are already cached
+            {
+                QMutexLocker scopedLocker(&_tilesInProcessMutex);
+
+                if(_tilesInProcess[zoom].contains(neighbourId))
+                    continue;
+            }
+            if(localCache->containsTileData(neighbourId, zoom))
+                continue;
+
+            // Prefetched data is stored to local cache from local storage pool, to keep network thread free
+            downloader->prefetch(neighbourId, zoom,
+                [localCache](const TileId tileId, const ZoomLevel zoom, const OnlineTilesDownloader::Result result, const QByteArray& data)
+                {
+                    if(result != OnlineTilesDownloader::Result::Downloaded && result != OnlineTilesDownloader::Result::NotFound)
+                        return;
+
+                    Concurrent::pools->localStorage->start(new Concurrent::Task(
+                        [localCache, tileId, zoom, data](Concurrent::Task* task, QEventLoop& eventLoop)
+                        {
+                            if(!localCache->storeTileData(tileId, zoom, data))
+                                LogPrintf(LogSeverityLevel::Error, "Failed to save prefetched tile %dx%d@%d to local cache", tileId.x, tileId.y, zoom);
+                        }));
+                });
+        }
+    }
+}
@@ -37,6 +37,8 @@
 #include <OsmAndCore.h>
 #include <CommonTypes.h>
 #include <IMapBitmapTileProvider.h>
+#include <IOnlineTilesCache.h>
+#include <OnlineTilesDownloader.h>
 
 namespace OsmAnd {
 
@@ -49,13 +51,13 @@ namespace OsmAnd {
 
         const OnlineMapRasterTileProvider* owner;
 
-        mutable QMutex _currentDownloadsCounterMutex;
-        uint32_t _currentDownloadsCounter;
-        QWaitCondition _currentDownloadsCounterChanged;
+        std::shared_ptr<OnlineTilesDownloader> _downloader;
 
         mutable QMutex _localCachePathMutex;
         QDir _localCachePath;
+        std::shared_ptr<IOnlineTilesCache> _localCache;
         bool _networkAccessAllowed;
+        bool _prefetchNeighbours;
 
         mutable QMutex _tilesInProcessMutex;
         std::array< QSet< TileId >, ZoomLevelsCount > _tilesInProcess;
@@ -64,6 +66,8 @@ namespace OsmAnd {
         bool obtainTile(const TileId tileId, const ZoomLevel zoom, std::shared_ptr<const MapTile>& outTile);
         void lockTile(const TileId tileId, const ZoomLevel zoom);
         void unlockTile(const TileId tileId, const ZoomLevel zoom);
+        void prefetchNeighbours(const std::shared_ptr<OnlineTilesDownloader>& downloader, const std::shared_ptr<IOnlineTilesCache>& localCache,
+            const TileId tileId, const ZoomLevel zoom);
     public:
         virtual ~OnlineMapRasterTileProvider_P();
 
@@ -0,0 +1,51 @@
+#include "OnlineTilesDownloader.h"
+#include "OnlineTilesDownloader_P.h"
+
+OsmAnd::OnlineTilesDownloader::OnlineTilesDownloader( const QString& urlPattern_, const uint32_t maxConcurrentDownloads_ /*= 1*/, const QString& userAgent_ /*= QLatin1String("OsmAnd Core")*/ )
+    : _d(new OnlineTilesDownloader_P(this))
+    , urlPattern(urlPattern_)
+    , maxConcurrentDownloads(maxConcurrentDownloads_)
+    , userAgent(userAgent_)
+{
+    _d->start();
+}
+
+OsmAnd::OnlineTilesDownloader::~OnlineTilesDownloader()
+{
+    _d->stop();
+}
+
+QUrl OsmAnd::OnlineTilesDownloader::getTileUrl( const TileId tileId, const ZoomLevel zoom ) const
+{
+    auto tileUrl = urlPattern;
+    tileUrl
+        .replace(QLatin1String("${zoom}"), QString::number(zoom))
+        .replace(QLatin1String("${x}"), QString::number(tileId.x))
+        .replace(QLatin1String("${y}"), QString::number(tileId.y));
+    return QUrl(tileUrl);
+}
+
+OsmAnd::OnlineTilesDownloader::Result OsmAnd::OnlineTilesDownloader::download( const TileId tileId, const ZoomLevel zoom, QByteArray& outData, const IQueryController* const controller /*= nullptr*/ )
+{
+    return _d->download(tileId, zoom, outData, controller);
+}
+
+bool OsmAnd::OnlineTilesDownloader::prefetch( const TileId tileId, const ZoomLevel zoom, const PrefetchCallback callback )
+{
+    return _d->prefetch(tileId, zoom, callback);
+}
+
+void OsmAnd::OnlineTilesDownloader::cancel( const TileId tileId, const ZoomLevel zoom )
+{
+    _d->cancel(tileId, zoom);
+}
+
+void OsmAnd::OnlineTilesDownloader::cancelAllExcept( const QSet<TileId>& tiles, const ZoomLevel zoom )
+{
+    _d->cancelAllExcept(tiles, zoom);
+}
+
+void OsmAnd::OnlineTilesDownloader::cancelAll()
+{
+    _d->cancelAll();
+}
@@ -0,0 +1,392 @@
+#include "OnlineTilesDownloader_P.h"
+#include "OnlineTilesDownloader.h"
+
+#include <cassert>
+
+#include <QCoreApplication>
+#include <QNetworkRequest>
+
+#include "IQueryController.h"
+#include "QMainThreadTaskHost.h"
+#include "QMainThreadTaskEvent.h"
+#include "Logging.h"
+
+OsmAnd::OnlineTilesDownloader_P::OnlineTilesDownloader_P( OnlineTilesDownloader* owner_ )
+    : owner(owner_)
+    , _activeRequestsCount(0)
+    , _threadTaskHost(nullptr)
+    , _threadEventLoop(nullptr)
+    , _networkAccessManager(nullptr)
+{
+}
+
+OsmAnd::OnlineTilesDownloader_P::~OnlineTilesDownloader_P()
+{
+}
+
+OsmAnd::OnlineTilesDownloader_P::Request::Request( const TileId tileId_, const ZoomLevel zoom_ )
+    : tileId(tileId_)
+    , zoom(zoom_)
+    , waitersCount(0)
+    , isStarted(false)
+    , isFinished(false)
+    , cancellationRequested(false)
+    , result(OnlineTilesDownloader::Result::Failed)
+    , reply(nullptr)
+    , redirectsCount(0)
+{
+}
+
+void OsmAnd::OnlineTilesDownloader_P::start()
+{
+    QMutexLocker scopedLocker(&_requestsMutex);
+
+    _thread.reset(new Concurrent::Thread(std::bind(&OnlineTilesDownloader_P::threadProcedure, this)));
+    _thread->start();
+
+    // Wait until network thread is ready to accept requests
+    while(!_threadTaskHost)
+        _threadStateChanged.wait(&_requestsMutex);
+}
+
+void OsmAnd::OnlineTilesDownloader_P::stop()
+{
+    {
+        QMutexLocker scopedLocker(&_requestsMutex);
+
+        if(_threadTaskHost)
+        {
+            const auto eventLoop = _threadEventLoop;
+            postToThread([eventLoop]()
+                {
+                    eventLoop->quit();
+                });
+        }
+    }
+
+    _thread->wait();
+    _thread.reset();
+}
+
+void OsmAnd::OnlineTilesDownloader_P::threadProcedure()
+{
+    QEventLoop eventLoop;
+    QNetworkAccessManager networkAccessManager;
+    QMainThreadTaskHost taskHost;
+
+    {
+        QMutexLocker scopedLocker(&_requestsMutex);
+
+        _threadEventLoop = &eventLoop;
+        _networkAccessManager = &networkAccessManager;
+        _threadTaskHost = &taskHost;
+        _threadStateChanged.wakeAll();
+    }
+
+    eventLoop.exec();
+
+    // Since no more events will be processed, all requests that are still alive are cancelled
+    {
+        QMutexLocker scopedLocker(&_requestsMutex);
+
+        _threadTaskHost = nullptr;
+        _networkAccessManager = nullptr;
+        _threadEventLoop = nullptr;
+
+        QList< std::shared_ptr<Request> > aliveRequests;
+        for(auto itRequests = _requests.cbegin(); itRequests != _requests.cend(); ++itRequests)
+            aliveRequests.append(itRequests->values());
+        for(auto itRequest = aliveRequests.cbegin(); itRequest != aliveRequests.cend(); ++itRequest)
+            finishRequest(*itRequest, OnlineTilesDownloader::Result::Cancelled, QByteArray());
+        _requestedQueue.clear();
+        _prefetchQueue.clear();
+        _activeRequestsCount = 0;
+    }
+}
+
+void OsmAnd::OnlineTilesDownloader_P::postToThread( const std::function<void ()> task )
+{
+    assert(_threadTaskHost != nullptr);
+
+    QCoreApplication::postEvent(_threadTaskHost, new QMainThreadTaskEvent(task));
+}
+
+void OsmAnd::OnlineTilesDownloader_P::enqueueRequest( const std::shared_ptr<Request>& request, const bool isPrefetch )
+{
+    if(isPrefetch)
+        _prefetchQueue.push_back(request);
+    else
+        _requestedQueue.push_back(request);
+
+    postToThread(std::bind(&OnlineTilesDownloader_P::processQueue, this));
+}
+
+void OsmAnd::OnlineTilesDownloader_P::finishRequest( const std::shared_ptr<Request>& request, const OnlineTilesDownloader::Result result, const QByteArray& data )
+{
+    request->isFinished = true;
+    request->result = result;
+    request->data = data;
+
+    auto& requests = _requests[request->zoom];
+    const auto itRequest = requests.find(request->tileId);
+    if(itRequest != requests.end() && *itRequest == request)
+        requests.erase(itRequest);
+
+    _requestFinishedCondition.wakeAll();
+}
+
+void OsmAnd::OnlineTilesDownloader_P::cancelRequest( const std::shared_ptr<Request>& request )
+{
+    if(request->isFinished)
+        return;
+
+    // Request that was not yet started is simply removed from queue
+    if(!request->isStarted)
+    {
+        _requestedQueue.removeOne(request);
+        _prefetchQueue.removeOne(request);
+        finishRequest(request, OnlineTilesDownloader::Result::Cancelled, QByteArray());
+        return;
+    }
+
+    // Request that is being downloaded has to be aborted from network thread
+    if(request->cancellationRequested)
+        return;
+    request->cancellationRequested = true;
+    postToThread([this, request]()
+        {
+            QNetworkReply* reply = nullptr;
+            {
+                QMutexLocker scopedLocker(&_requestsMutex);
+
+                // Request may have been joined by another waiter since cancellation was requested
+                if(request->cancellationRequested)
+                    reply = request->reply;
+            }
+
+            // Abort emits finished() synchronously, so it must be called without lock
+            if(reply)
+                reply->abort();
+        });
+}
+
+void OsmAnd::OnlineTilesDownloader_P::processQueue()
+{
+    QList< std::shared_ptr<Request> > requestsToStart;
+    {
+        QMutexLocker scopedLocker(&_requestsMutex);
+
+        // Network thread is shutting down
+        if(!_threadTaskHost)
+            return;
+
+        while(owner->maxConcurrentDownloads == 0 || _activeRequestsCount < owner->maxConcurrentDownloads)
+        {
+            std::shared_ptr<Request> request;
+            if(!_requestedQueue.isEmpty())
+                request = _requestedQueue.takeFirst();
+            else if(!_prefetchQueue.isEmpty())
+                request = _prefetchQueue.takeFirst();
+            else
+                break;
+
+            request->isStarted = true;
+            _activeRequestsCount++;
+            requestsToStart.push_back(request);
+        }
+    }
+
+    for(auto itRequest = requestsToStart.cbegin(); itRequest != requestsToStart.cend(); ++itRequest)
+    {
+        const auto& request = *itRequest;
+        startRequest(request, owner->getTileUrl(request->tileId, request->zoom));
+    }
+}
+
+void OsmAnd::OnlineTilesDownloader_P::startRequest( const std::shared_ptr<Request>& request, const QUrl& url )
+{
+    // Since all requests are issued through the same network access manager, connections
+    // to each host are kept alive and reused by subsequent requests
+    QNetworkRequest networkRequest;
+    networkRequest.setUrl(url);
+    networkRequest.setRawHeader("User-Agent", owner->userAgent.toLocal8Bit());
+
+    const auto reply = _networkAccessManager->get(networkRequest);
+    request->reply = reply;
+    QObject::connect(reply, &QNetworkReply::finished, [this, request]()
+        {
+            onRequestFinished(request);
+        });
+}
+
+void OsmAnd::OnlineTilesDownloader_P::onRequestFinished( const std::shared_ptr<Request>& request )
+{
+    const auto reply = request->reply;
+    request->reply = nullptr;
+    reply->deleteLater();
+
+    const auto networkError = reply->error();
+
+    // Follow redirect, unless request was cancelled meanwhile
+    if(networkError == QNetworkReply::NetworkError::NoError)
+    {
+        const auto redirectUrl = reply->attribute(QNetworkRequest::RedirectionTargetAttribute).toUrl();
+        if(!redirectUrl.isEmpty() && request->redirectsCount < MaxRedirectsCount)
+        {
+            bool followRedirect;
+            {
+                QMutexLocker scopedLocker(&_requestsMutex);
+                followRedirect = _threadTaskHost && !request->cancellationRequested;
+            }
+
+            if(followRedirect)
+            {
+                request->redirectsCount++;
+                startRequest(request, reply->url().resolved(redirectUrl));
+                return;
+            }
+        }
+    }
+
+    auto result = OnlineTilesDownloader::Result::Failed;
+    QByteArray data;
+    if(networkError == QNetworkReply::NetworkError::NoError)
+    {
+        result = OnlineTilesDownloader::Result::Downloaded;
+        data = reply->readAll();
+    }
+    else if(networkError == QNetworkReply::NetworkError::OperationCanceledError)
+    {
+        result = OnlineTilesDownloader::Result::Cancelled;
+    }
+    else
+    {
+        const auto httpStatus = reply->attribute(QNetworkRequest::HttpStatusCodeAttribute).toInt();
+        if(httpStatus == 404)
+            result = OnlineTilesDownloader::Result::NotFound;
+        else
+            LogPrintf(LogSeverityLevel::Warning, "Failed to download tile from %s (HTTP status %d)", qPrintable(reply->url().toString()), httpStatus);
+    }
+
+    OnlineTilesDownloader::PrefetchCallback prefetchCallback;
+    {
+        QMutexLocker scopedLocker(&_requestsMutex);
+
+        // Request was already cancelled by shutdown of network thread
+        if(request->isFinished)
+            return;
+
+        _activeRequestsCount--;
+        if(request->waitersCount == 0)
+            prefetchCallback = request->prefetchCallback;
+        finishRequest(request, result, data);
+    }
+
+    if(prefetchCallback)
+        prefetchCallback(request->tileId, request->zoom, result, data);
+
+    processQueue();
+}
+
+OsmAnd::OnlineTilesDownloader::Result OsmAnd::OnlineTilesDownloader_P::download( const TileId tileId, const ZoomLevel zoom, QByteArray& outData, const IQueryController* const controller )
+{
+    QMutexLocker scopedLocker(&_requestsMutex);
+
+    if(!_threadTaskHost)
+        return OnlineTilesDownloader::Result::Cancelled;
+
+    // Join request for same tile if there is one, or create new one
+    auto request = _requests[zoom].value(tileId);
+    if(!request)
+    {
+        request.reset(new Request(tileId, zoom));
+        _requests[zoom].insert(tileId, request);
+        enqueueRequest(request, false);
+    }
+    else if(!request->isStarted && request->prefetchCallback)
+    {
+        // Prefetched tile is now requested, so it gains priority
+        if(_prefetchQueue.removeOne(request))
+            enqueueRequest(request, false);
+    }
+    request->prefetchCallback = nullptr;
+    request->cancellationRequested = false;
+    request->waitersCount++;
+
+    while(!request->isFinished)
+    {
+        if(controller && controller->isAborted())
+            break;
+
+        if(controller)
+            _requestFinishedCondition.wait(&_requestsMutex, 100);
+        else
+            _requestFinishedCondition.wait(&_requestsMutex);
+    }
+    request->waitersCount--;
+
+    // If nobody else waits for the tile, there's no need to continue downloading it
+    if(!request->isFinished)
+    {
+        if(request->waitersCount == 0)
+            cancelRequest(request);
+        return OnlineTilesDownloader::Result::Cancelled;
+    }
+
+    outData = request->data;
+    return request->result;
+}
+
+bool OsmAnd::OnlineTilesDownloader_P::prefetch( const TileId tileId, const ZoomLevel zoom, const OnlineTilesDownloader::PrefetchCallback callback )
+{
+    QMutexLocker scopedLocker(&_requestsMutex);
+
+    if(!_threadTaskHost || _requests[zoom].contains(tileId))
+        return false;
+
+    const std::shared_ptr<Request> request(new Request(tileId, zoom));
+    request->prefetchCallback = callback;
+    _requests[zoom].insert(tileId, request);
+    enqueueRequest(request, true);
+
+    return true;
+}
+
+void OsmAnd::OnlineTilesDownloader_P::cancel( const TileId tileId, const ZoomLevel zoom )
+{
+    QMutexLocker scopedLocker(&_requestsMutex);
+
+    const auto request = _requests[zoom].value(tileId);
+    if(!request)
+        return;
+
+    // Waiters are woken up with Result::Cancelled when request finishes
+    cancelRequest(request);
+}
+
+void OsmAnd::OnlineTilesDownloader_P::cancelAllExcept( const QSet<TileId>& tiles, const ZoomLevel zoom )
+{
+    QMutexLocker scopedLocker(&_requestsMutex);
+
+    const auto requests = _requests[zoom].values();
+    for(auto itRequest = requests.cbegin(); itRequest != requests.cend(); ++itRequest)
+    {
+        const auto& request = *itRequest;
+        if(tiles.contains(request->tileId))
+            continue;
+
+        cancelRequest(request);
+    }
+}
+
+void OsmAnd::OnlineTilesDownloader_P::cancelAll()
+{
+    QMutexLocker scopedLocker(&_requestsMutex);
+
+    for(auto itRequests = _requests.cbegin(); itRequests != _requests.cend(); ++itRequests)
+    {
+        const auto requests = itRequests->values();
+        for(auto itRequest = requests.cbegin(); itRequest != requests.cend(); ++itRequest)
+            cancelRequest(*itRequest);
+    }
+}
@@ -0,0 +1,125 @@
+/**
+* @file
+*
+* @section LICENSE
+*
+* OsmAnd - Android navigation software based on OSM maps.
+* Copyright (C) 2010-2013  OsmAnd Authors listed in AUTHORS file
+*
+* This program is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+
+* You should have received a copy of the GNU General Public License
+* along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+#ifndef _OSMAND_CORE_ONLINE_TILES_DOWNLOADER_P_H_
+#define _OSMAND_CORE_ONLINE_TILES_DOWNLOADER_P_H_
+
+#include <OsmAndCore/stdlib_common.h>
+#include <array>
+
+#include <OsmAndCore/QtExtensions.h>
+#include <QHash>
+#include <QList>
+#include <QUrl>
+#include <QMutex>
+#include <QWaitCondition>
+#include <QEventLoop>
+#include <QNetworkAccessManager>
+#include <QNetworkReply>
+
+#include <OsmAndCore.h>
+#include <CommonTypes.h>
+#include <Concurrent.h>
+#include <OnlineTilesDownloader.h>
+
+namespace OsmAnd
+{
+    class IQueryController;
+    class QMainThreadTaskHost;
+
+    class OnlineTilesDownloader;
+    class OnlineTilesDownloader_P
+    {
+    private:
+    protected:
+        OnlineTilesDownloader_P(OnlineTilesDownloader* owner);
+
+        OnlineTilesDownloader* const owner;
+
+        enum {
+            MaxRedirectsCount = 5,
+        };
+
+        struct Request
+        {
+            Request(const TileId tileId, const ZoomLevel zoom);
+
+            const TileId tileId;
+            const ZoomLevel zoom;
+
+            // Number of threads blocked in download() on this request
+            unsigned int waitersCount;
+            // Set only while request was made only by prefetch()
+            OnlineTilesDownloader::PrefetchCallback prefetchCallback;
+
+            bool isStarted;
+            bool isFinished;
+            bool cancellationRequested;
+            OnlineTilesDownloader::Result result;
+            QByteArray data;
+
+            // Accessed only from network thread
+            QNetworkReply* reply;
+            unsigned int redirectsCount;
+        };
+
+        mutable QMutex _requestsMutex;
+        QWaitCondition _requestFinishedCondition;
+        std::array< QHash< TileId, std::shared_ptr<Request> >, ZoomLevelsCount > _requests;
+        QList< std::shared_ptr<Request> > _requestedQueue;
+        QList< std::shared_ptr<Request> > _prefetchQueue;
+        unsigned int _activeRequestsCount;
+
+        std::unique_ptr<Concurrent::Thread> _thread;
+        QWaitCondition _threadStateChanged;
+        QMainThreadTaskHost* _threadTaskHost;
+        QEventLoop* _threadEventLoop;
+        QNetworkAccessManager* _networkAccessManager;
+
+        void start();
+        void stop();
+        void threadProcedure();
+
+        // Following methods require _requestsMutex to be locked
+        void postToThread(const std::function<void ()> task);
+        void enqueueRequest(const std::shared_ptr<Request>& request, const bool isPrefetch);
+        void finishRequest(const std::shared_ptr<Request>& request, const OnlineTilesDownloader::Result result, const QByteArray& data);
+        void cancelRequest(const std::shared_ptr<Request>& request);
+
+        // Following methods are executed in network thread
+        void processQueue();
+        void startRequest(const std::shared_ptr<Request>& request, const QUrl& url);
+        void onRequestFinished(const std::shared_ptr<Request>& request);
+
+        OnlineTilesDownloader::Result download(const TileId tileId, const ZoomLevel zoom, QByteArray& outData, const IQueryController* const controller);
+        bool prefetch(const TileId tileId, const ZoomLevel zoom, const OnlineTilesDownloader::PrefetchCallback callback);
+        void cancel(const TileId tileId, const ZoomLevel zoom);
+        void cancelAllExcept(const QSet<TileId>& tiles, const ZoomLevel zoom);
+        void cancelAll();
+    public:
+        virtual ~OnlineTilesDownloader_P();
+
+    friend class OsmAnd::OnlineTilesDownloader;
+    };
+
+} // namespace OsmAnd
+
+#endif // _OSMAND_CORE_ONLINE_TILES_DOWNLOADER_P_H_
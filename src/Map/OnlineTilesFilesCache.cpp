@@ -0,0 +1,68 @@
+#include "OnlineTilesFilesCache.h"
+
+#include <OsmAndCore/QtExtensions.h>
+#include <QFile>
+#include <QFileInfo>
+
+#include "Logging.h"
+
+OsmAnd::OnlineTilesFilesCache::OnlineTilesFilesCache( const QDir& path_ )
+    : path(path_)
+{
+}
+
+OsmAnd::OnlineTilesFilesCache::~OnlineTilesFilesCache()
+{
+}
+
+QString OsmAnd::OnlineTilesFilesCache::getTileFilename( const TileId tileId, const ZoomLevel zoom ) const
+{
+    const auto tileRelativePath =
+        QString::number(zoom) + QDir::separator() +
+        QString::number(tileId.x) + QDir::separator() +
+        QString::number(tileId.y) + QLatin1String(".tile");
+    return path.filePath(tileRelativePath);
+}
+
+bool OsmAnd::OnlineTilesFilesCache::containsTileData( const TileId tileId, const ZoomLevel zoom )
+{
+    return QFile::exists(getTileFilename(tileId, zoom));
+}
+
+bool OsmAnd::OnlineTilesFilesCache::obtainTileData( const TileId tileId, const ZoomLevel zoom, QByteArray& outData )
+{
+    QFile tileFile(getTileFilename(tileId, zoom));
+    if(!tileFile.exists())
+        return false;
+
+    if(!tileFile.open(QIODevice::ReadOnly))
+    {
+        LogPrintf(LogSeverityLevel::Error, "Failed to read tile file '%s'", qPrintable(tileFile.fileName()));
+        return false;
+    }
+    // If local file is empty, it means that requested tile does not exist (has no data)
+    outData = tileFile.readAll();
+    tileFile.close();
+
+    return true;
+}
+
+bool OsmAnd::OnlineTilesFilesCache::storeTileData( const TileId tileId, const ZoomLevel zoom, const QByteArray& data )
+{
+    const QFileInfo tileFileInfo(getTileFilename(tileId, zoom));
+
+    // Ensure that all directories are created in path to local tile
+    tileFileInfo.dir().mkpath(tileFileInfo.dir().absolutePath());
+
+    QFile tileFile(tileFileInfo.absoluteFilePath());
+    if(!tileFile.open(QIODevice::WriteOnly | QIODevice::Truncate))
+    {
+        LogPrintf(LogSeverityLevel::Error, "Failed to save tile to '%s'", qPrintable(tileFile.fileName()));
+        return false;
+    }
+    if(!data.isEmpty())
+        tileFile.write(data);
+    tileFile.close();
+
+    return true;
+}
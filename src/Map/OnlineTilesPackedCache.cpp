@@ -0,0 +1,64 @@
+#include "OnlineTilesPackedCache.h"
+#include "OnlineTilesPackedCache_P.h"
+
+OsmAnd::OnlineTilesPackedCache::OnlineTilesPackedCache( const QDir& path_, const uint64_t sizeLimit_ /*= 0*/ )
+    : _d(new OnlineTilesPackedCache_P(this))
+    , path(path_)
+    , sizeLimit(sizeLimit_)
+{
+    _d->open();
+}
+
+OsmAnd::OnlineTilesPackedCache::~OnlineTilesPackedCache()
+{
+    _d->waitForCompaction();
+    _d->close();
+}
+
+uint64_t OsmAnd::OnlineTilesPackedCache::getSize() const
+{
+    QReadLocker scopedLocker(&_d->_lock);
+
+    return _d->_liveBytes;
+}
+
+unsigned int OsmAnd::OnlineTilesPackedCache::getTilesCount() const
+{
+    QReadLocker scopedLocker(&_d->_lock);
+
+    unsigned int count = 0;
+    for(auto itEntries = _d->_entries.cbegin(); itEntries != _d->_entries.cend(); ++itEntries)
+        count += itEntries->size();
+    return count;
+}
+
+bool OsmAnd::OnlineTilesPackedCache::flush()
+{
+    QWriteLocker scopedLocker(&_d->_lock);
+
+    return _d->saveIndex();
+}
+
+bool OsmAnd::OnlineTilesPackedCache::compact()
+{
+    _d->waitForCompaction();
+
+    QWriteLocker scopedLocker(&_d->_lock);
+
+    return _d->compact();
+}
+
+bool OsmAnd::OnlineTilesPackedCache::containsTileData( const TileId tileId, const ZoomLevel zoom )
+{
+    return _d->containsTileData(tileId, zoom);
+}
+
+bool OsmAnd::OnlineTilesPackedCache::obtainTileData( const TileId tileId, const ZoomLevel zoom, QByteArray& outData )
+{
+    return _d->obtainTileData(tileId, zoom, outData);
+}
+
+bool OsmAnd::OnlineTilesPackedCache::storeTileData( const TileId tileId, const ZoomLevel zoom, const QByteArray& data )
+{
+    return _d->storeTileData(tileId, zoom, data);
+}
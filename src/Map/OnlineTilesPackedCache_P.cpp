@@ -0,0 +1,656 @@
+#include "OnlineTilesPackedCache_P.h"
+#include "OnlineTilesPackedCache.h"
+
+#include <cassert>
+#include <algorithm>
+
+#include <OsmAndCore/QtExtensions.h>
+#include <QDataStream>
+#include <QFileInfo>
+#include <QVector>
+
+#include "Concurrent.h"
+#include "Logging.h"
+
+OsmAnd::OnlineTilesPackedCache_P::OnlineTilesPackedCache_P( OnlineTilesPackedCache* owner_ )
+    : owner(owner_)
+    , _mappedData(nullptr)
+    , _packSize(0)
+    , _packCapacity(0)
+    , _liveBytes(0)
+    , _deadBytes(0)
+    , _accessClock(0)
+    , _indexIsDirty(false)
+    , _storesSinceIndexSave(0)
+    , _packGeneration(0)
+    , _isCompacting(false)
+{
+}
+
+OsmAnd::OnlineTilesPackedCache_P::~OnlineTilesPackedCache_P()
+{
+}
+
+QString OsmAnd::OnlineTilesPackedCache_P::getPackFilename() const
+{
+    return owner->path.filePath(QLatin1String("tiles.pack"));
+}
+
+QString OsmAnd::OnlineTilesPackedCache_P::getIndexFilename() const
+{
+    return owner->path.filePath(QLatin1String("tiles.idx"));
+}
+
+bool OsmAnd::OnlineTilesPackedCache_P::open()
+{
+    owner->path.mkpath(owner->path.absolutePath());
+
+    _packFile.setFileName(getPackFilename());
+    if(!_packFile.open(QIODevice::ReadWrite))
+    {
+        LogPrintf(LogSeverityLevel::Error, "Failed to open tiles pack '%s'", qPrintable(_packFile.fileName()));
+        return false;
+    }
+    // Pack file may be larger than data it holds, since it's grown ahead of appends
+    _packCapacity = _packFile.size();
+    _packSize = 0;
+    if(!remap())
+        return false;
+
+    // Records appended after index was saved are recovered by scanning rest of the pack.
+    // Without valid index, whole pack has to be scanned
+    if(!loadIndex())
+    {
+        for(auto itEntries = _entries.begin(); itEntries != _entries.end(); ++itEntries)
+            itEntries->clear();
+        _packSize = 0;
+        _liveBytes = 0;
+        _deadBytes = 0;
+        _accessClock.store(0);
+        _indexIsDirty = true;
+    }
+
+    return scanPack(_packSize);
+}
+
+void OsmAnd::OnlineTilesPackedCache_P::close()
+{
+    if(!_packFile.isOpen())
+        return;
+
+    if(_indexIsDirty)
+        saveIndex();
+
+    if(_mappedData)
+    {
+        _packFile.unmap(_mappedData);
+        _mappedData = nullptr;
+    }
+
+    // Unused capacity is not kept on disk
+    _packFile.resize(_packSize);
+    _packCapacity = _packSize;
+    _packFile.close();
+}
+
+bool OsmAnd::OnlineTilesPackedCache_P::remap()
+{
+    if(_mappedData)
+    {
+        _packFile.unmap(_mappedData);
+        _mappedData = nullptr;
+    }
+
+    // Empty file can not be mapped
+    if(_packCapacity == 0)
+        return true;
+
+    _mappedData = _packFile.map(0, _packCapacity);
+    if(!_mappedData)
+    {
+        LogPrintf(LogSeverityLevel::Error, "Failed to map tiles pack '%s'", qPrintable(_packFile.fileName()));
+        return false;
+    }
+
+    return true;
+}
+
+bool OsmAnd::OnlineTilesPackedCache_P::reserve( const uint64_t requiredCapacity )
+{
+    if(requiredCapacity <= _packCapacity)
+        return _mappedData != nullptr;
+
+    // Capacity grows geometrically, so that pack is remapped only a few times while it grows
+    uint64_t newCapacity = qMax<uint64_t>(_packCapacity, MinPackCapacity);
+    while(newCapacity < requiredCapacity)
+        newCapacity *= 2;
+
+    // Unmap before resizing, since some platforms don't allow to change size of mapped file
+    if(_mappedData)
+    {
+        _packFile.unmap(_mappedData);
+        _mappedData = nullptr;
+    }
+
+    if(!_packFile.resize(newCapacity))
+    {
+        LogPrintf(LogSeverityLevel::Error, "Failed to grow tiles pack '%s' to %llu bytes", qPrintable(_packFile.fileName()), newCapacity);
+        remap();
+        return false;
+    }
+    _packCapacity = newCapacity;
+
+    return remap();
+}
+
+bool OsmAnd::OnlineTilesPackedCache_P::loadIndex()
+{
+    QFile indexFile(getIndexFilename());
+    if(!indexFile.open(QIODevice::ReadOnly))
+        return false;
+    QDataStream input(&indexFile);
+
+    quint32 magic;
+    quint32 version;
+    quint64 packSize;
+    quint64 deadBytes;
+    quint32 entriesCount;
+    input >> magic >> version >> packSize >> deadBytes >> entriesCount;
+    if(input.status() != QDataStream::Ok || magic != IndexMagic || version != IndexVersion || packSize > _packCapacity)
+        return false;
+
+    qint64 maxLastAccess = 0;
+    for(quint32 entryIdx = 0; entryIdx < entriesCount; entryIdx++)
+    {
+        quint8 zoom;
+        qint32 x;
+        qint32 y;
+        quint64 offset;
+        quint32 size;
+        qint64 lastAccess;
+        input >> zoom >> x >> y >> offset >> size >> lastAccess;
+        if(input.status() != QDataStream::Ok || zoom > MaxZoomLevel || offset + sizeof(RecordHeader) + size > packSize)
+            return false;
+
+        TileId tileId;
+        tileId.x = x;
+        tileId.y = y;
+        auto& entry = _entries[zoom][tileId];
+        entry.offset = offset;
+        entry.size = size;
+        entry.lastAccess.store(lastAccess);
+
+        _liveBytes += sizeof(RecordHeader) + size;
+        maxLastAccess = qMax(maxLastAccess, lastAccess);
+    }
+    _packSize = packSize;
+    _deadBytes = deadBytes;
+    _accessClock.store(maxLastAccess);
+
+    return true;
+}
+
+bool OsmAnd::OnlineTilesPackedCache_P::scanPack( const uint64_t fromOffset )
+{
+    if(fromOffset == 0 && _packCapacity > 0)
+        LogPrintf(LogSeverityLevel::Info, "Scanning tiles pack '%s'...", qPrintable(_packFile.fileName()));
+
+    uint64_t offset = fromOffset;
+    while(offset + sizeof(RecordHeader) <= _packCapacity)
+    {
+        RecordHeader header;
+        memcpy(&header, _mappedData + offset, sizeof(RecordHeader));
+        if(header.magic != RecordMagic || header.zoom < MinZoomLevel || header.zoom > MaxZoomLevel || offset + sizeof(RecordHeader) + header.size > _packCapacity)
+            break;
+
+        TileId tileId;
+        tileId.x = header.x;
+        tileId.y = header.y;
+        auto& entries = _entries[header.zoom];
+        auto itEntry = entries.find(tileId);
+        if(itEntry != entries.end())
+            removeEntry(entries, itEntry);
+
+        // Pack is in order of writing, which is the best approximation of usage order that is available
+        auto& entry = entries[tileId];
+        entry.offset = offset;
+        entry.size = header.size;
+        entry.lastAccess.store(_accessClock.fetchAndAddOrdered(1) + 1);
+        _liveBytes += sizeof(RecordHeader) + header.size;
+
+        offset += sizeof(RecordHeader) + header.size;
+    }
+
+    // Anything after last complete record is unused capacity or incomplete record left by interrupted write,
+    // and is overwritten by next append
+    if(fromOffset != 0 && offset != fromOffset)
+    {
+        LogPrintf(LogSeverityLevel::Info, "Recovered %llu bytes of tiles appended to pack '%s' after index was saved",
+            offset - fromOffset, qPrintable(_packFile.fileName()));
+    }
+    if(offset != fromOffset)
+        _indexIsDirty = true;
+    _packSize = offset;
+
+    return true;
+}
+
+bool OsmAnd::OnlineTilesPackedCache_P::saveIndex()
+{
+    const auto indexFilename = getIndexFilename();
+    const auto tempIndexFilename = indexFilename + QLatin1String(".tmp");
+    _storesSinceIndexSave = 0;
+
+    QFile indexFile(tempIndexFilename);
+    if(!indexFile.open(QIODevice::WriteOnly | QIODevice::Truncate))
+    {
+        LogPrintf(LogSeverityLevel::Error, "Failed to save tiles pack index '%s'", qPrintable(indexFilename));
+        return false;
+    }
+    QDataStream output(&indexFile);
+
+    quint32 entriesCount = 0;
+    for(auto itEntries = _entries.cbegin(); itEntries != _entries.cend(); ++itEntries)
+        entriesCount += itEntries->size();
+    output << quint32(IndexMagic) << quint32(IndexVersion) << quint64(_packSize) << quint64(_deadBytes) << entriesCount;
+
+    for(int zoom = MinZoomLevel; zoom <= MaxZoomLevel; zoom++)
+    {
+        const auto& entries = _entries[zoom];
+        for(auto itEntry = entries.cbegin(); itEntry != entries.cend(); ++itEntry)
+        {
+            TileId tileId;
+            tileId = itEntry.key();
+            output << quint8(zoom) << qint32(tileId.x) << qint32(tileId.y) << quint64(itEntry->offset) << quint32(itEntry->size) << qint64(itEntry->lastAccess.load());
+        }
+    }
+    indexFile.close();
+    if(output.status() != QDataStream::Ok)
+        return false;
+
+    // Replace old index only with fully written one
+    QFile::remove(indexFilename);
+    if(!QFile::rename(tempIndexFilename, indexFilename))
+        return false;
+
+    _indexIsDirty = false;
+    return true;
+}
+
+bool OsmAnd::OnlineTilesPackedCache_P::append( const TileId tileId, const ZoomLevel zoom, const QByteArray& data )
+{
+    RecordHeader header;
+    header.magic = RecordMagic;
+    header.zoom = zoom;
+    header.x = tileId.x;
+    header.y = tileId.y;
+    header.size = data.size();
+
+    const auto recordSize = sizeof(RecordHeader) + data.size();
+    if(!reserve(_packSize + recordSize))
+    {
+        LogPrintf(LogSeverityLevel::Error, "Failed to append tile to pack '%s'", qPrintable(_packFile.fileName()));
+        return false;
+    }
+
+    // Record is written through mapping. Data goes before header, so that interrupted write never
+    // leaves a record that looks complete to scanPack()
+    if(!data.isEmpty())
+        memcpy(_mappedData + _packSize + sizeof(RecordHeader), data.constData(), data.size());
+    memcpy(_mappedData + _packSize, &header, sizeof(RecordHeader));
+
+    auto& entries = _entries[zoom];
+    auto itEntry = entries.find(tileId);
+    if(itEntry != entries.end())
+        removeEntry(entries, itEntry);
+
+    auto& entry = entries[tileId];
+    entry.offset = _packSize;
+    entry.size = data.size();
+    entry.lastAccess.store(_accessClock.fetchAndAddOrdered(1) + 1);
+
+    _packSize += recordSize;
+    _liveBytes += recordSize;
+    _indexIsDirty = true;
+
+    return true;
+}
+
+void OsmAnd::OnlineTilesPackedCache_P::removeEntry( QHash< uint64_t, Entry >& entries, const QHash< uint64_t, Entry >::iterator& itEntry )
+{
+    const auto recordSize = sizeof(RecordHeader) + itEntry->size;
+    _liveBytes -= recordSize;
+    _deadBytes += recordSize;
+    entries.erase(itEntry);
+    _indexIsDirty = true;
+}
+
+void OsmAnd::OnlineTilesPackedCache_P::evictLeastRecentlyUsed()
+{
+    if(owner->sizeLimit == 0 || _liveBytes <= owner->sizeLimit)
+        return;
+
+    struct Candidate
+    {
+        int zoom;
+        uint64_t key;
+        qint64 lastAccess;
+    };
+    QVector<Candidate> candidates;
+    for(int zoom = MinZoomLevel; zoom <= MaxZoomLevel; zoom++)
+    {
+        const auto& entries = _entries[zoom];
+        for(auto itEntry = entries.cbegin(); itEntry != entries.cend(); ++itEntry)
+        {
+            Candidate candidate;
+            candidate.zoom = zoom;
+            candidate.key = itEntry.key();
+            candidate.lastAccess = itEntry->lastAccess.load();
+            candidates.push_back(candidate);
+        }
+    }
+    std::sort(candidates.begin(), candidates.end(), [](const Candidate& l, const Candidate& r) -> bool
+    {
+        return l.lastAccess < r.lastAccess;
+    });
+
+    // Evict a bit more than needed, to avoid evicting on each store
+    const auto targetSize = owner->sizeLimit - owner->sizeLimit / 10;
+    for(auto itCandidate = candidates.cbegin(); itCandidate != candidates.cend() && _liveBytes > targetSize; ++itCandidate)
+    {
+        auto& entries = _entries[itCandidate->zoom];
+        auto itEntry = entries.find(itCandidate->key);
+        if(itEntry != entries.end())
+            removeEntry(entries, itEntry);
+    }
+}
+
+void OsmAnd::OnlineTilesPackedCache_P::collectLiveRecords( QVector<LiveRecord>& outRecords, const uint64_t fromOffset ) const
+{
+    for(int zoom = MinZoomLevel; zoom <= MaxZoomLevel; zoom++)
+    {
+        const auto& entries = _entries[zoom];
+        for(auto itEntry = entries.cbegin(); itEntry != entries.cend(); ++itEntry)
+        {
+            if(itEntry->offset < fromOffset)
+                continue;
+
+            LiveRecord record;
+            record.zoom = zoom;
+            record.key = itEntry.key();
+            record.offset = itEntry->offset;
+            record.size = itEntry->size;
+            outRecords.push_back(record);
+        }
+    }
+
+    // Records are copied in order of their offsets, so that neighbouring tiles stay close
+    std::sort(outRecords.begin(), outRecords.end(), [](const LiveRecord& l, const LiveRecord& r) -> bool
+    {
+        return l.offset < r.offset;
+    });
+}
+
+bool OsmAnd::OnlineTilesPackedCache_P::writeRecord( QFile& output, const LiveRecord& record ) const
+{
+    const auto recordSize = sizeof(RecordHeader) + record.size;
+    return output.write(reinterpret_cast<const char*>(_mappedData + record.offset), recordSize) == static_cast<qint64>(recordSize);
+}
+
+bool OsmAnd::OnlineTilesPackedCache_P::replacePack( const QString& compactedPackFilename, const QHash<uint64_t, uint64_t>& compactedOffsets, const uint64_t compactedSize )
+{
+    const auto packFilename = getPackFilename();
+
+    // Every live record has to be present in compacted pack, while records removed after they were copied
+    // remain there as dead data
+    std::array< QHash< uint64_t, Entry >, ZoomLevelsCount > compactedEntries;
+    uint64_t compactedLiveBytes = 0;
+    for(int zoom = MinZoomLevel; zoom <= MaxZoomLevel; zoom++)
+    {
+        const auto& entries = _entries[zoom];
+        for(auto itEntry = entries.cbegin(); itEntry != entries.cend(); ++itEntry)
+        {
+            const auto itCompactedOffset = compactedOffsets.constFind(itEntry->offset);
+            assert(itCompactedOffset != compactedOffsets.cend());
+
+            auto& compactedEntry = compactedEntries[zoom][itEntry.key()];
+            compactedEntry.offset = *itCompactedOffset;
+            compactedEntry.size = itEntry->size;
+            compactedEntry.lastAccess.store(itEntry->lastAccess.load());
+            compactedLiveBytes += sizeof(RecordHeader) + itEntry->size;
+        }
+    }
+
+    // Old index describes old pack, so it's removed before pack is replaced in case process dies in between
+    QFile::remove(getIndexFilename());
+
+    // Swap pack files
+    if(_mappedData)
+    {
+        _packFile.unmap(_mappedData);
+        _mappedData = nullptr;
+    }
+    _packFile.close();
+    _packGeneration++;
+    QFile::remove(packFilename);
+    if(!QFile::rename(compactedPackFilename, packFilename))
+    {
+        LogPrintf(LogSeverityLevel::Error, "Failed to replace tiles pack '%s'", qPrintable(packFilename));
+        for(auto itEntries = _entries.begin(); itEntries != _entries.end(); ++itEntries)
+            itEntries->clear();
+        _liveBytes = 0;
+        _deadBytes = 0;
+        _packSize = 0;
+        _packCapacity = 0;
+        _packFile.open(QIODevice::ReadWrite | QIODevice::Truncate);
+        return false;
+    }
+
+    LogPrintf(LogSeverityLevel::Info, "Compacted tiles pack '%s' from %llu to %llu bytes", qPrintable(packFilename), _packSize, compactedSize);
+
+    _entries = qMove(compactedEntries);
+    _packSize = compactedSize;
+    _packCapacity = compactedSize;
+    _liveBytes = compactedLiveBytes;
+    _deadBytes = compactedSize - compactedLiveBytes;
+    if(!_packFile.open(QIODevice::ReadWrite) || !remap())
+        return false;
+
+    return saveIndex();
+}
+
+bool OsmAnd::OnlineTilesPackedCache_P::compact()
+{
+    if(_deadBytes == 0)
+        return true;
+
+    const auto packFilename = getPackFilename();
+    const auto compactedPackFilename = packFilename + QLatin1String(".compact");
+
+    QFile compactedPackFile(compactedPackFilename);
+    if(!compactedPackFile.open(QIODevice::WriteOnly | QIODevice::Truncate))
+    {
+        LogPrintf(LogSeverityLevel::Error, "Failed to compact tiles pack '%s'", qPrintable(packFilename));
+        return false;
+    }
+
+    QVector<LiveRecord> liveRecords;
+    collectLiveRecords(liveRecords, 0);
+
+    QHash<uint64_t, uint64_t> compactedOffsets;
+    uint64_t compactedSize = 0;
+    for(auto itRecord = liveRecords.cbegin(); itRecord != liveRecords.cend(); ++itRecord)
+    {
+        if(!writeRecord(compactedPackFile, *itRecord))
+        {
+            LogPrintf(LogSeverityLevel::Error, "Failed to compact tiles pack '%s'", qPrintable(packFilename));
+            compactedPackFile.close();
+            compactedPackFile.remove();
+            return false;
+        }
+
+        compactedOffsets.insert(itRecord->offset, compactedSize);
+        compactedSize += sizeof(RecordHeader) + itRecord->size;
+    }
+    compactedPackFile.close();
+
+    return replacePack(compactedPackFilename, compactedOffsets, compactedSize);
+}
+
+void OsmAnd::OnlineTilesPackedCache_P::scheduleCompaction()
+{
+    {
+        QMutexLocker scopedLocker(&_compactionMutex);
+
+        if(_isCompacting)
+            return;
+        _isCompacting = true;
+    }
+
+    Concurrent::pools->localStorage->start(new Concurrent::Task(
+        [this]
+        (Concurrent::Task* task, QEventLoop& eventLoop)
+        {
+            compactInBackground();
+        }));
+}
+
+void OsmAnd::OnlineTilesPackedCache_P::compactInBackground()
+{
+    // Explicit compact() may run while this one is copying, so they don't share file
+    const auto packFilename = getPackFilename();
+    const auto compactedPackFilename = packFilename + QLatin1String(".compacting");
+
+    QFile compactedPackFile(compactedPackFilename);
+    bool ok = compactedPackFile.open(QIODevice::WriteOnly | QIODevice::Truncate);
+
+    // Records are never changed in place, so snapshot of live ones stays valid until pack is replaced
+    QVector<LiveRecord> liveRecords;
+    uint64_t snapshotPackSize = 0;
+    unsigned int packGeneration = 0;
+    if(ok)
+    {
+        QReadLocker scopedLocker(&_lock);
+
+        ok = _packFile.isOpen();
+        collectLiveRecords(liveRecords, 0);
+        snapshotPackSize = _packSize;
+        packGeneration = _packGeneration;
+    }
+
+    // Copy is made in batches, since waiting writer would block all readers for the whole copy otherwise
+    QHash<uint64_t, uint64_t> compactedOffsets;
+    uint64_t compactedSize = 0;
+    for(auto recordIdx = 0; ok && recordIdx < liveRecords.size(); )
+    {
+        QReadLocker scopedLocker(&_lock);
+
+        ok = _packGeneration == packGeneration;
+        const auto batchEnd = qMin(recordIdx + static_cast<int>(CompactionBatchSize), liveRecords.size());
+        for(; ok && recordIdx < batchEnd; recordIdx++)
+        {
+            const auto& record = liveRecords[recordIdx];
+            ok = writeRecord(compactedPackFile, record);
+
+            compactedOffsets.insert(record.offset, compactedSize);
+            compactedSize += sizeof(RecordHeader) + record.size;
+        }
+    }
+
+    if(ok)
+    {
+        QWriteLocker scopedLocker(&_lock);
+
+        // Tiles stored while copying are few, so they are copied under write lock along with swap of packs
+        ok = _packGeneration == packGeneration && _packFile.isOpen();
+        QVector<LiveRecord> appendedRecords;
+        if(ok)
+            collectLiveRecords(appendedRecords, snapshotPackSize);
+        for(auto itRecord = appendedRecords.cbegin(); ok && itRecord != appendedRecords.cend(); ++itRecord)
+        {
+            ok = writeRecord(compactedPackFile, *itRecord);
+
+            compactedOffsets.insert(itRecord->offset, compactedSize);
+            compactedSize += sizeof(RecordHeader) + itRecord->size;
+        }
+        compactedPackFile.close();
+
+        if(ok)
+            replacePack(compactedPackFilename, compactedOffsets, compactedSize);
+    }
+
+    if(!ok)
+    {
+        LogPrintf(LogSeverityLevel::Warning, "Background compaction of tiles pack '%s' was not completed", qPrintable(packFilename));
+        compactedPackFile.close();
+        compactedPackFile.remove();
+    }
+
+    {
+        QMutexLocker scopedLocker(&_compactionMutex);
+
+        _isCompacting = false;
+        _compactionFinished.wakeAll();
+    }
+}
+
+void OsmAnd::OnlineTilesPackedCache_P::waitForCompaction()
+{
+    QMutexLocker scopedLocker(&_compactionMutex);
+
+    while(_isCompacting)
+        _compactionFinished.wait(&_compactionMutex);
+}
+
+bool OsmAnd::OnlineTilesPackedCache_P::containsTileData( const TileId tileId, const ZoomLevel zoom ) const
+{
+    QReadLocker scopedLocker(&_lock);
+
+    // Unlike obtainTileData(), this doesn't count as access to tile
+    return _entries[zoom].contains(tileId);
+}
+
+bool OsmAnd::OnlineTilesPackedCache_P::obtainTileData( const TileId tileId, const ZoomLevel zoom, QByteArray& outData )
+{
+    QReadLocker scopedLocker(&_lock);
+
+    const auto& entries = _entries[zoom];
+    const auto itEntry = entries.constFind(tileId);
+    if(itEntry == entries.cend() || !_mappedData)
+        return false;
+    const auto& entry = *itEntry;
+
+    entry.lastAccess.store(_accessClock.fetchAndAddOrdered(1) + 1);
+
+    // Data has to be copied, since mapping may change once lock is released
+    if(entry.size == 0)
+        outData.clear();
+    else
+        outData = QByteArray(reinterpret_cast<const char*>(_mappedData + entry.offset + sizeof(RecordHeader)), entry.size);
+
+    return true;
+}
+
+bool OsmAnd::OnlineTilesPackedCache_P::storeTileData( const TileId tileId, const ZoomLevel zoom, const QByteArray& data )
+{
+    QWriteLocker scopedLocker(&_lock);
+
+    if(!_packFile.isOpen())
+        return false;
+
+    if(!append(tileId, zoom, data))
+        return false;
+    _storesSinceIndexSave++;
+    evictLeastRecentlyUsed();
+
+    // Overwritten tiles leave dead records even without size limit, so compaction doesn't depend on eviction.
+    // Pack is rewritten in background, so that readers are not blocked for duration of copy
+    if(_deadBytes > _liveBytes && _deadBytes >= MinDeadBytesToCompact)
+        scheduleCompaction();
+
+    // Index is saved periodically, so that after crash only records appended since then have to be scanned
+    if(_indexIsDirty && _storesSinceIndexSave >= IndexSaveInterval)
+        saveIndex();
+
+    return true;
+}
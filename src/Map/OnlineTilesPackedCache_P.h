@@ -0,0 +1,143 @@
+/**
+* @file
+*
+* @section LICENSE
+*
+* OsmAnd - Android navigation software based on OSM maps.
+* Copyright (C) 2010-2013  OsmAnd Authors listed in AUTHORS file
+*
+* This program is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+
+* You should have received a copy of the GNU General Public License
+* along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef _OSMAND_CORE_ONLINE_TILES_PACKED_CACHE_P_H_
+#define _OSMAND_CORE_ONLINE_TILES_PACKED_CACHE_P_H_
+
+#include <OsmAndCore/stdlib_common.h>
+#include <array>
+
+#include <OsmAndCore/QtExtensions.h>
+#include <QHash>
+#include <QFile>
+#include <QReadWriteLock>
+#include <QMutex>
+#include <QWaitCondition>
+#include <QAtomicInteger>
+#include <QVector>
+
+#include <OsmAndCore.h>
+#include <CommonTypes.h>
+
+namespace OsmAnd
+{
+    class OnlineTilesPackedCache;
+    class OnlineTilesPackedCache_P
+    {
+    private:
+        // Each tile in pack file is stored as this header followed by data
+        struct RecordHeader
+        {
+            uint32_t magic;
+            int32_t zoom;
+            int32_t x;
+            int32_t y;
+            uint32_t size;
+        };
+        enum {
+            RecordMagic = 0x4b505452, // 'RTPK'
+            IndexMagic = 0x49505452, // 'RTPI'
+            IndexVersion = 2,
+
+            // Pack file is grown at least by this size, to remap it only few times
+            MinPackCapacity = 1 << 20,
+            // Pack is not compacted for less than this amount of dead data
+            MinDeadBytesToCompact = 1 << 20,
+            // Number of stores after which index is saved, to limit amount of pack scanned after crash
+            IndexSaveInterval = 1024,
+            // Number of records copied by background compaction per read lock
+            CompactionBatchSize = 256,
+        };
+
+        struct Entry
+        {
+            uint64_t offset;
+            uint32_t size;
+            mutable QAtomicInteger<qint64> lastAccess;
+        };
+
+        struct LiveRecord
+        {
+            int zoom;
+            uint64_t key;
+            uint64_t offset;
+            uint32_t size;
+        };
+    protected:
+        OnlineTilesPackedCache_P(OnlineTilesPackedCache* owner);
+
+        OnlineTilesPackedCache* const owner;
+
+        mutable QReadWriteLock _lock;
+        QFile _packFile;
+        uchar* _mappedData;
+        uint64_t _packSize;
+        uint64_t _packCapacity;
+        std::array< QHash< uint64_t, Entry >, ZoomLevelsCount > _entries;
+        uint64_t _liveBytes;
+        uint64_t _deadBytes;
+        QAtomicInteger<qint64> _accessClock;
+        bool _indexIsDirty;
+        unsigned int _storesSinceIndexSave;
+        // Changed each time pack file is replaced, so that background compaction can detect it
+        unsigned int _packGeneration;
+
+        QMutex _compactionMutex;
+        QWaitCondition _compactionFinished;
+        bool _isCompacting;
+
+        QString getPackFilename() const;
+        QString getIndexFilename() const;
+
+        // All following methods expect write lock to be held
+        bool open();
+        void close();
+        bool remap();
+        bool reserve(const uint64_t requiredCapacity);
+        bool loadIndex();
+        bool scanPack(const uint64_t fromOffset);
+        bool saveIndex();
+        bool append(const TileId tileId, const ZoomLevel zoom, const QByteArray& data);
+        void removeEntry(QHash< uint64_t, Entry >& entries, const QHash< uint64_t, Entry >::iterator& itEntry);
+        void evictLeastRecentlyUsed();
+        void collectLiveRecords(QVector<LiveRecord>& outRecords, const uint64_t fromOffset) const;
+        bool writeRecord(QFile& output, const LiveRecord& record) const;
+        bool replacePack(const QString& compactedPackFilename, const QHash<uint64_t, uint64_t>& compactedOffsets, const uint64_t compactedSize);
+        bool compact();
+        void scheduleCompaction();
+
+        // Following methods expect no lock to be held
+        void compactInBackground();
+        void waitForCompaction();
+
+        bool containsTileData(const TileId tileId, const ZoomLevel zoom) const;
+        bool obtainTileData(const TileId tileId, const ZoomLevel zoom, QByteArray& outData);
+        bool storeTileData(const TileId tileId, const ZoomLevel zoom, const QByteArray& data);
+    public:
+        virtual ~OnlineTilesPackedCache_P();
+
+    friend class OsmAnd::OnlineTilesPackedCache;
+    };
+
+} // namespace OsmAnd
+
+#endif // _OSMAND_CORE_ONLINE_TILES_PACKED_CACHE_P_H_
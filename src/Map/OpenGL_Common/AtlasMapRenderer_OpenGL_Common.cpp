@@ -24,6 +24,7 @@
 #include "OpenGL_Common/Utilities_OpenGL_Common.h"
 
 const float OsmAnd::AtlasMapRenderer_OpenGL_Common::_zNear = 0.1f;
+const float OsmAnd::AtlasMapRenderer_OpenGL_Common::_lodDistanceFactor = 2.0f;
 
 OsmAnd::AtlasMapRenderer_OpenGL_Common::AtlasMapRenderer_OpenGL_Common()
     : _tilePatchIndicesCount(0)
@@ -156,6 +157,8 @@ void OsmAnd::AtlasMapRenderer_OpenGL_Common::initializeRasterMapStage()
         "                                                                                                                   ""\n"
         // Parameters: per-tile data
         "uniform ivec2 param_vs_tileCoordsOffset;                                                                           ""\n"
+        "uniform vec4 param_vs_tilePatchSubRectN;                                                                           ""\n"
+        "uniform float param_vs_tileScale;                                                                                  ""\n"
         "uniform float param_vs_elevationData_k;                                                                            ""\n"
         "uniform float param_vs_elevationData_upperMetersPerUnit;                                                           ""\n"
         "uniform float param_vs_elevationData_lowerMetersPerUnit;                                                           ""\n"
@@ -170,30 +173,40 @@ void OsmAnd::AtlasMapRenderer_OpenGL_Common::initializeRasterMapStage()
         "    float tilePaddingN;                                                                                            ""\n"
         "    int slotsPerSide;                                                                                              ""\n"
         "    int slotIndex;                                                                                                 ""\n"
+        "    vec4 texCoordsOffsetAndScale;                                                                                  ""\n"
         "};                                                                                                                 ""\n"
         "uniform RasterLayerTile param_vs_rasterTileLayers[%RasterLayersCount%];                                            ""\n"
         "#if VERTEX_TEXTURE_FETCH_SUPPORTED                                                                                 ""\n"
         "    uniform RasterLayerTile param_vs_elevationTileLayer;                                                           ""\n"
         "#endif // !VERTEX_TEXTURE_FETCH_SUPPORTED                                                                          ""\n"
         "                                                                                                                   ""\n"
-        "void calculateTextureCoordinates(in RasterLayerTile tileLayer, out vec2 outTexCoords)                              ""\n"
+        "void calculateTextureCoordinates(in RasterLayerTile tileLayer, in vec2 tileTexCoordsN, out vec2 outTexCoords)      ""\n"
         "{                                                                                                                  ""\n"
         "    int rowIndex = tileLayer.slotIndex / tileLayer.slotsPerSide;                                                   ""\n"
         "    int colIndex = tileLayer.slotIndex - rowIndex * tileLayer.slotsPerSide;                                        ""\n"
         "                                                                                                                   ""\n"
         "    float texCoordRescale = (tileLayer.tileSizeN - 2.0 * tileLayer.tilePaddingN) / tileLayer.tileSizeN;            ""\n"
+        "    vec2 layerTexCoordsN = tileLayer.texCoordsOffsetAndScale.xy +                                                  ""\n"
+        "        tileTexCoordsN * tileLayer.texCoordsOffsetAndScale.zw;                                                     ""\n"
         "                                                                                                                   ""\n"
         "    outTexCoords.s = float(colIndex) * tileLayer.tileSizeN;                                                        ""\n"
-        "    outTexCoords.s += tileLayer.tilePaddingN + (in_vs_vertexTexCoords.s * tileLayer.tileSizeN) * texCoordRescale;  ""\n"
+        "    outTexCoords.s += tileLayer.tilePaddingN + (layerTexCoordsN.s * tileLayer.tileSizeN) * texCoordRescale;        ""\n"
         "                                                                                                                   ""\n"
         "    outTexCoords.t = float(rowIndex) * tileLayer.tileSizeN;                                                        ""\n"
-        "    outTexCoords.t += tileLayer.tilePaddingN + (in_vs_vertexTexCoords.t * tileLayer.tileSizeN) * texCoordRescale;  ""\n"
+        "    outTexCoords.t += tileLayer.tilePaddingN + (layerTexCoordsN.t * tileLayer.tileSizeN) * texCoordRescale;        ""\n"
         "}                                                                                                                  ""\n"
         "                                                                                                                   ""\n"
         "void main()                                                                                                        ""\n"
         "{                                                                                                                  ""\n"
         "    vec4 v = vec4(in_vs_vertexPosition.x, 0.0, in_vs_vertexPosition.y, 1.0);                                       ""\n"
         "                                                                                                                   ""\n"
+        //   Tile patch may cover only a part of the tile
+        "    v.xz = param_vs_tilePatchSubRectN.xy * %TileSize3D%.0 + v.xz * param_vs_tilePatchSubRectN.zw;                  ""\n"
+        "    vec2 tileTexCoordsN = param_vs_tilePatchSubRectN.xy + in_vs_vertexTexCoords * param_vs_tilePatchSubRectN.zw;   ""\n"
+        "                                                                                                                   ""\n"
+        //   Tile of lower zoom covers several tiles of base zoom
+        "    v.xz *= param_vs_tileScale;                                                                                    ""\n"
+        "                                                                                                                   ""\n"
         //   Shift vertex to it's proper position
         "    float xOffset = float(param_vs_tileCoordsOffset.x) - param_vs_targetInTilePosN.x;                              ""\n"
         "    v.x += xOffset * %TileSize3D%.0;                                                                               ""\n"
@@ -207,7 +220,7 @@ void OsmAnd::AtlasMapRenderer_OpenGL_Common::initializeRasterMapStage()
         "    if(abs(param_vs_elevationData_k) > 0.0)                                                                        ""\n"
         "    {                                                                                                              ""\n"
         "        float metersToUnits = mix(param_vs_elevationData_upperMetersPerUnit,                                       ""\n"
-        "            param_vs_elevationData_lowerMetersPerUnit, in_vs_vertexTexCoords.t);                                   ""\n"
+        "            param_vs_elevationData_lowerMetersPerUnit, tileTexCoordsN.t);                                          ""\n"
         "                                                                                                                   ""\n"
         //       Calculate texcoords for elevation data (pixel-is-area)
         "        float heightInMeters;                                                                                      ""\n"
@@ -215,6 +228,7 @@ void OsmAnd::AtlasMapRenderer_OpenGL_Common::initializeRasterMapStage()
         "        vec2 elevationDataTexCoords;                                                                               ""\n"
         "        calculateTextureCoordinates(                                                                               ""\n"
         "            param_vs_elevationTileLayer,                                                                           ""\n"
+        "            tileTexCoordsN,                                                                                        ""\n"
         "            elevationDataTexCoords);                                                                               ""\n"
         "        heightInMeters = SAMPLE_TEXTURE_2D(param_vs_elevationData_sampler, elevationDataTexCoords).r;              ""\n"
         "#else // !VERTEX_TEXTURE_FETCH_SUPPORTED                                                                           ""\n"
@@ -241,6 +255,7 @@ void OsmAnd::AtlasMapRenderer_OpenGL_Common::initializeRasterMapStage()
     const auto& vertexShader_perRasterLayerTexCoordsProcessing = QString::fromLatin1(
         "    calculateTextureCoordinates(                                                                                   ""\n"
         "        param_vs_rasterTileLayers[%rasterLayerId%],                                                                ""\n"
+        "        tileTexCoordsN,                                                                                            ""\n"
         "        v2f_texCoordsPerLayer[%rasterLayerId%]);                                                                   ""\n"
         "                                                                                                                   ""\n");
 
@@ -375,6 +390,8 @@ void OsmAnd::AtlasMapRenderer_OpenGL_Common::initializeRasterMapStage()
             gpuAPI->findVariableLocation(stageVariation.program, stageVariation.vs.param.scaleToRetainProjectedSize, "param_vs_scaleToRetainProjectedSize", GLShaderVariableType::Uniform);
         }
         gpuAPI->findVariableLocation(stageVariation.program, stageVariation.vs.param.tileCoordsOffset, "param_vs_tileCoordsOffset", GLShaderVariableType::Uniform);
+        gpuAPI->findVariableLocation(stageVariation.program, stageVariation.vs.param.tilePatchSubRectN, "param_vs_tilePatchSubRectN", GLShaderVariableType::Uniform);
+        gpuAPI->findVariableLocation(stageVariation.program, stageVariation.vs.param.tileScale, "param_vs_tileScale", GLShaderVariableType::Uniform);
         gpuAPI->findVariableLocation(stageVariation.program, stageVariation.vs.param.elevationData_k, "param_vs_elevationData_k", GLShaderVariableType::Uniform);
         gpuAPI->findVariableLocation(stageVariation.program, stageVariation.vs.param.elevationData_upperMetersPerUnit, "param_vs_elevationData_upperMetersPerUnit", GLShaderVariableType::Uniform);
         gpuAPI->findVariableLocation(stageVariation.program, stageVariation.vs.param.elevationData_lowerMetersPerUnit, "param_vs_elevationData_lowerMetersPerUnit", GLShaderVariableType::Uniform);
@@ -385,6 +402,7 @@ void OsmAnd::AtlasMapRenderer_OpenGL_Common::initializeRasterMapStage()
             gpuAPI->findVariableLocation(stageVariation.program, stageVariation.vs.param.elevationTileLayer.tilePaddingN, "param_vs_elevationTileLayer.tilePaddingN", GLShaderVariableType::Uniform);
             gpuAPI->findVariableLocation(stageVariation.program, stageVariation.vs.param.elevationTileLayer.slotsPerSide, "param_vs_elevationTileLayer.slotsPerSide", GLShaderVariableType::Uniform);
             gpuAPI->findVariableLocation(stageVariation.program, stageVariation.vs.param.elevationTileLayer.slotIndex, "param_vs_elevationTileLayer.slotIndex", GLShaderVariableType::Uniform);
+            gpuAPI->findVariableLocation(stageVariation.program, stageVariation.vs.param.elevationTileLayer.texCoordsOffsetAndScale, "param_vs_elevationTileLayer.texCoordsOffsetAndScale", GLShaderVariableType::Uniform);
         }
         for(int layerId = 0; layerId < maxActiveMapLayers; layerId++)
         {
@@ -399,6 +417,7 @@ void OsmAnd::AtlasMapRenderer_OpenGL_Common::initializeRasterMapStage()
                 gpuAPI->findVariableLocation(stageVariation.program, layerStruct.tilePaddingN, layerStructName + ".tilePaddingN", GLShaderVariableType::Uniform);
                 gpuAPI->findVariableLocation(stageVariation.program, layerStruct.slotsPerSide, layerStructName + ".slotsPerSide", GLShaderVariableType::Uniform);
                 gpuAPI->findVariableLocation(stageVariation.program, layerStruct.slotIndex, layerStructName + ".slotIndex", GLShaderVariableType::Uniform);
+                gpuAPI->findVariableLocation(stageVariation.program, layerStruct.texCoordsOffsetAndScale, layerStructName + ".texCoordsOffsetAndScale", GLShaderVariableType::Uniform);
             }
 
             // Fragment shader
@@ -526,6 +545,12 @@ void OsmAnd::AtlasMapRenderer_OpenGL_Common::renderRasterMapStage()
         glUniform1f(stageVariation.vs.param.elevationData_k, 0.0f);
         GL_CHECK_RESULT;
     }
+    else if(gpuAPI->isSupported_vertexShaderTextureLookup)
+    {
+        // Elevation data is never substituted, so it always covers entire tile
+        glUniform4f(stageVariation.vs.param.elevationTileLayer.texCoordsOffsetAndScale, 0.0f, 0.0f, 1.0f, 1.0f);
+        GL_CHECK_RESULT;
+    }
     bool elevationVertexAttribArrayEnabled = false;
     if(!gpuAPI->isSupported_vertexShaderTextureLookup)
     {
@@ -533,70 +558,238 @@ void OsmAnd::AtlasMapRenderer_OpenGL_Common::renderRasterMapStage()
         GL_CHECK_RESULT;
     }
 
-    // For each visible tile, render it
-    for(auto itTileId = _internalState.visibleTiles.cbegin(); itTileId != _internalState.visibleTiles.cend(); ++itTileId)
+    // For each visible tile, render it. Tiles of lower zooms go first, since these are farther from camera
+    for(auto itVisibleTiles = _internalState.visibleTiles.cbegin(); itVisibleTiles != _internalState.visibleTiles.cend(); ++itVisibleTiles)
     {
-        const auto& tileId = *itTileId;
+        const auto zoom = itVisibleTiles.key();
+        const auto& visibleTiles = itVisibleTiles.value();
 
-        // Get normalized tile index
-        auto tileIdN = Utilities::normalizeTileId(tileId, currentState.zoomBase);
-
-        // Set tile coordinates offset
-        glUniform2i(stageVariation.vs.param.tileCoordsOffset,
-            tileId.x - _internalState.targetTileId.x,
-            tileId.y - _internalState.targetTileId.y);
+        // Tile of lower zoom covers several tiles of base zoom
+        const auto zoomShift = currentState.zoomBase - zoom;
+        const auto tileScale = static_cast<float>(1u << zoomShift);
+        glUniform1f(stageVariation.vs.param.tileScale, tileScale);
         GL_CHECK_RESULT;
 
-        // Set elevation data
-        bool appliedElevationVertexAttribArray = false;
-        if(elevationDataEnabled)
+        for(auto itTileId = visibleTiles.cbegin(); itTileId != visibleTiles.cend(); ++itTileId)
         {
-            const auto resourcesCollection = getResources().getCollection(ResourceType::ElevationData, currentState.elevationDataProvider);
+            const auto& tileId = *itTileId;
+
+            // Get normalized tile index
+            auto tileIdN = Utilities::normalizeTileId(tileId, zoom);
 
-            // Obtain tile entry by normalized tile coordinates, since tile may repeat several times
-            std::shared_ptr< const GPUAPI::ResourceInGPU > gpuResource;
-            std::shared_ptr<Resources::BaseTiledResource> resource_;
-            if(resourcesCollection->obtainEntry(resource_, tileIdN, currentState.zoomBase))
+            // Set tile coordinates offset (in tiles of base zoom)
+            glUniform2i(stageVariation.vs.param.tileCoordsOffset,
+                tileId.x * (1 << zoomShift) - _internalState.targetTileId.x,
+                tileId.y * (1 << zoomShift) - _internalState.targetTileId.y);
+            GL_CHECK_RESULT;
+
+            // Set elevation data
+            bool appliedElevationVertexAttribArray = false;
+            if(elevationDataEnabled)
             {
-                const auto resource = std::static_pointer_cast<Resources::MapTileResource>(resource_);
+                const auto resourcesCollection = getResources().getCollection(ResourceType::ElevationData, currentState.elevationDataProvider);
 
-                // Check state and obtain GPU resource
-                if(resource->setStateIf(ResourceState::Uploaded, ResourceState::IsBeingUsed))
+                // Obtain tile entry by normalized tile coordinates, since tile may repeat several times
+                std::shared_ptr< const GPUAPI::ResourceInGPU > gpuResource;
+                std::shared_ptr<Resources::BaseTiledResource> resource_;
+                if(resourcesCollection->obtainEntry(resource_, tileIdN, zoom))
                 {
-                    // Capture GPU resource
-                    gpuResource = resource->resourceInGPU;
+                    const auto resource = std::static_pointer_cast<Resources::MapTileResource>(resource_);
 
-                    resource->setState(ResourceState::Uploaded);
+                    // Check state and obtain GPU resource
+                    if(resource->setStateIf(ResourceState::Uploaded, ResourceState::IsBeingUsed))
+                    {
+                        // Capture GPU resource
+                        gpuResource = resource->resourceInGPU;
+
+                        resource->setState(ResourceState::Uploaded);
+                    }
                 }
-            }
             
-            if(!gpuResource)
+                if(!gpuResource)
+                {
+                    // We have no elevation data, so we can not do anything
+                    glUniform1f(stageVariation.vs.param.elevationData_k, 0.0f);
+                    GL_CHECK_RESULT;
+                }
+                else
+                {
+                    glUniform1f(stageVariation.vs.param.elevationData_k, currentState.elevationDataScaleFactor);
+                    GL_CHECK_RESULT;
+
+                    // Tile of lower zoom is scaled, so each unit covers more meters
+                    const auto upperMetersPerUnit = Utilities::getMetersPerTileUnit(zoom, tileIdN.y, TileSize3D) / tileScale;
+                    glUniform1f(stageVariation.vs.param.elevationData_upperMetersPerUnit, upperMetersPerUnit);
+                    const auto lowerMetersPerUnit = Utilities::getMetersPerTileUnit(zoom, tileIdN.y + 1, TileSize3D) / tileScale;
+                    glUniform1f(stageVariation.vs.param.elevationData_lowerMetersPerUnit, lowerMetersPerUnit);
+
+                    const auto& perTile_vs = stageVariation.vs.param.elevationTileLayer;
+
+                    if(gpuAPI->isSupported_vertexShaderTextureLookup)
+                    {
+                        glActiveTexture(GL_TEXTURE0);
+                        GL_CHECK_RESULT;
+
+                        glBindTexture(GL_TEXTURE_2D, static_cast<GLuint>(reinterpret_cast<intptr_t>(gpuResource->refInGPU)));
+                        GL_CHECK_RESULT;
+
+                        gpuAPI->applyTextureBlockToTexture(GL_TEXTURE_2D, GL_TEXTURE0);
+
+                        if(gpuResource->type == GPUAPI::ResourceInGPU::Type::SlotOnAtlasTexture)
+                        {
+                            const auto tileOnAtlasTexture = std::static_pointer_cast<const GPUAPI::SlotOnAtlasTextureInGPU>(gpuResource);
+
+                            glUniform1i(perTile_vs.slotIndex, tileOnAtlasTexture->slotIndex);
+                            GL_CHECK_RESULT;
+                            glUniform1f(perTile_vs.tileSizeN, tileOnAtlasTexture->atlasTexture->tileSizeN);
+                            GL_CHECK_RESULT;
+                            glUniform1f(perTile_vs.tilePaddingN, tileOnAtlasTexture->atlasTexture->uHalfTexelSizeN);
+                            GL_CHECK_RESULT;
+                            glUniform1i(perTile_vs.slotsPerSide, tileOnAtlasTexture->atlasTexture->slotsPerSide);
+                            GL_CHECK_RESULT;
+                        }
+                        else
+                        {
+                            const auto& texture = std::static_pointer_cast<const GPUAPI::TextureInGPU>(gpuResource);
+
+                            glUniform1i(perTile_vs.slotIndex, 0);
+                            GL_CHECK_RESULT;
+                            glUniform1f(perTile_vs.tileSizeN, 1.0f);
+                            GL_CHECK_RESULT;
+                            glUniform1f(perTile_vs.tilePaddingN, texture->uHalfTexelSizeN);
+                            GL_CHECK_RESULT;
+                            glUniform1i(perTile_vs.slotsPerSide, 1);
+                            GL_CHECK_RESULT;
+                        }
+                    }
+                    else
+                    {
+                        assert(gpuResource->type == GPUAPI::ResourceInGPU::Type::ArrayBuffer);
+
+                        const auto& arrayBuffer = std::static_pointer_cast<const GPUAPI::ArrayBufferInGPU>(gpuResource);
+                        assert(arrayBuffer->itemsCount == currentConfiguration.heixelsPerTileSide*currentConfiguration.heixelsPerTileSide);
+
+                        if(!elevationVertexAttribArrayEnabled)
+                        {
+                            glEnableVertexAttribArray(stageVariation.vs.in.vertexElevation);
+                            GL_CHECK_RESULT;
+
+                            elevationVertexAttribArrayEnabled = true;
+                        }
+
+                        glBindBuffer(GL_ARRAY_BUFFER, static_cast<GLuint>(reinterpret_cast<intptr_t>(gpuResource->refInGPU)));
+                        GL_CHECK_RESULT;
+
+                        glVertexAttribPointer(stageVariation.vs.in.vertexElevation, 1, GL_FLOAT, GL_FALSE, sizeof(float), nullptr);
+                        GL_CHECK_RESULT;
+                        appliedElevationVertexAttribArray = true;
+                    }
+                }
+            }
+
+            // Resolve GPU resource of each layer of this tile. If exact tile is not yet in GPU,
+            // use a sub-rectangle of an ancestor tile or a set of descendant tiles instead
+            RasterLayerTileResources layersResources[RasterMapLayersCount];
+            bool useDescendants = false;
+            for(int layerIdx = 0, layerId = static_cast<int>(RasterMapLayerId::BaseLayer), layerLinearIdx = -1; layerIdx < RasterMapLayersCount; layerIdx++, layerId++)
             {
-                // We have no elevation data, so we can not do anything
-                glUniform1f(stageVariation.vs.param.elevationData_k, 0.0f);
-                GL_CHECK_RESULT;
+                if(!currentState.rasterLayerProviders[layerId])
+                    continue;
+                layerLinearIdx++;
+
+                // Get resources collection
+                const auto resourcesCollection = getResources().getCollection(ResourceType::RasterMap, currentState.rasterLayerProviders[layerId]);
+                auto& layerResources = layersResources[layerLinearIdx];
+
+                // Obtain tile entry by normalized tile coordinates, since tile may repeat several times
+                std::shared_ptr<Resources::BaseTiledResource> resource_;
+                if(resourcesCollection->obtainEntry(resource_, tileIdN, zoom))
+                {
+                    const auto resource = std::static_pointer_cast<Resources::MapTileResource>(resource_);
+
+                    // Check state and obtain GPU resource
+                    if(resource->setStateIf(ResourceState::Uploaded, ResourceState::IsBeingUsed))
+                    {
+                        // Capture GPU resource
+                        layerResources.gpuResource = resource->resourceInGPU;
+
+                        resource->setState(ResourceState::Uploaded);
+                    }
+                    else if(resource->getState() == ResourceState::Unavailable)
+                        layerResources.gpuResource = getResources().unavailableTileStub;
+                }
+                if(layerResources.gpuResource)
+                    continue;
+
+                // Descendants can not be used when elevation is passed per-vertex, since patch vertices are shared by entire tile
+                if((!elevationDataEnabled || gpuAPI->isSupported_vertexShaderTextureLookup) &&
+                    getResources().obtainDescendantsFallback(resourcesCollection, tileIdN, zoom, layerResources.descendantsGpuResources))
+                {
+                    useDescendants = true;
+                    continue;
+                }
+
+                if(!getResources().obtainAncestorFallback(resourcesCollection, tileIdN, zoom,
+                    layerResources.gpuResource, layerResources.texCoordsOffset, layerResources.texCoordsScale))
+                {
+                    // Nothing to show instead, so tile is still being processed
+                    layerResources.gpuResource = getResources().processingTileStub;
+                }
             }
-            else
+
+            // If any layer uses descendants, draw tile as 4 quadrants, otherwise as a whole
+            const auto tilePatchSubdivisionsPerSide = useDescendants ? 2 : 1;
+            const auto tilePatchScale = 1.0f / static_cast<float>(tilePatchSubdivisionsPerSide);
+            for(int quadrantIdx = 0; quadrantIdx < tilePatchSubdivisionsPerSide*tilePatchSubdivisionsPerSide; quadrantIdx++)
             {
-                glUniform1f(stageVariation.vs.param.elevationData_k, currentState.elevationDataScaleFactor);
+                const auto quadrantCol = quadrantIdx % tilePatchSubdivisionsPerSide;
+                const auto quadrantRow = quadrantIdx / tilePatchSubdivisionsPerSide;
+                const PointF tilePatchOffset(static_cast<float>(quadrantCol) * tilePatchScale, static_cast<float>(quadrantRow) * tilePatchScale);
+
+                glUniform4f(stageVariation.vs.param.tilePatchSubRectN, tilePatchOffset.x, tilePatchOffset.y, tilePatchScale, tilePatchScale);
                 GL_CHECK_RESULT;
 
-                const auto upperMetersPerUnit = Utilities::getMetersPerTileUnit(currentState.zoomBase, tileIdN.y, TileSize3D);
-                glUniform1f(stageVariation.vs.param.elevationData_upperMetersPerUnit, upperMetersPerUnit);
-                const auto lowerMetersPerUnit = Utilities::getMetersPerTileUnit(currentState.zoomBase, tileIdN.y + 1, TileSize3D);
-                glUniform1f(stageVariation.vs.param.elevationData_lowerMetersPerUnit, lowerMetersPerUnit);
+                // We need to pass each layer of this tile to shader
+                for(int layerIdx = 0, layerId = static_cast<int>(RasterMapLayerId::BaseLayer), layerLinearIdx = -1; layerIdx < RasterMapLayersCount; layerIdx++, layerId++)
+                {
+                    if(!currentState.rasterLayerProviders[layerId])
+                        continue;
+                    layerLinearIdx++;
 
-                const auto& perTile_vs = stageVariation.vs.param.elevationTileLayer;
+                    const auto& perTile_vs = stageVariation.vs.param.rasterTileLayers[layerLinearIdx];
+                    const auto& perTile_fs = stageVariation.fs.param.rasterTileLayers[layerLinearIdx];
+                    const auto samplerIndex = (gpuAPI->isSupported_vertexShaderTextureLookup ? 1 : 0) + layerLinearIdx;
+                    const auto& layerResources = layersResources[layerLinearIdx];
 
-                if(gpuAPI->isSupported_vertexShaderTextureLookup)
-                {
-                    glActiveTexture(GL_TEXTURE0);
+                    std::shared_ptr< const GPUAPI::ResourceInGPU > gpuResource;
+                    if(layerResources.gpuResource)
+                    {
+                        gpuResource = layerResources.gpuResource;
+
+                        glUniform4f(perTile_vs.texCoordsOffsetAndScale,
+                            layerResources.texCoordsOffset.x, layerResources.texCoordsOffset.y,
+                            layerResources.texCoordsScale, layerResources.texCoordsScale);
+                        GL_CHECK_RESULT;
+                    }
+                    else
+                    {
+                        // Descendant tile covers exactly one quadrant, so map tile texture coordinates onto it
+                        gpuResource = layerResources.descendantsGpuResources[quadrantIdx];
+
+                        glUniform4f(perTile_vs.texCoordsOffsetAndScale, -static_cast<float>(quadrantCol), -static_cast<float>(quadrantRow), 2.0f, 2.0f);
+                        GL_CHECK_RESULT;
+                    }
+
+                    glUniform1f(perTile_fs.k, currentState.rasterLayerOpacity[layerId]);
+                    GL_CHECK_RESULT;
+
+                    glActiveTexture(GL_TEXTURE0 + samplerIndex);
                     GL_CHECK_RESULT;
 
                     glBindTexture(GL_TEXTURE_2D, static_cast<GLuint>(reinterpret_cast<intptr_t>(gpuResource->refInGPU)));
                     GL_CHECK_RESULT;
 
-                    gpuAPI->applyTextureBlockToTexture(GL_TEXTURE_2D, GL_TEXTURE0);
+                    gpuAPI->applyTextureBlockToTexture(GL_TEXTURE_2D, GL_TEXTURE0 + samplerIndex);
 
                     if(gpuResource->type == GPUAPI::ResourceInGPU::Type::SlotOnAtlasTexture)
                     {
@@ -606,137 +799,36 @@ void OsmAnd::AtlasMapRenderer_OpenGL_Common::renderRasterMapStage()
                         GL_CHECK_RESULT;
                         glUniform1f(perTile_vs.tileSizeN, tileOnAtlasTexture->atlasTexture->tileSizeN);
                         GL_CHECK_RESULT;
-                        glUniform1f(perTile_vs.tilePaddingN, tileOnAtlasTexture->atlasTexture->uHalfTexelSizeN);
+                        glUniform1f(perTile_vs.tilePaddingN, tileOnAtlasTexture->atlasTexture->tilePaddingN);
                         GL_CHECK_RESULT;
                         glUniform1i(perTile_vs.slotsPerSide, tileOnAtlasTexture->atlasTexture->slotsPerSide);
                         GL_CHECK_RESULT;
                     }
                     else
                     {
-                        const auto& texture = std::static_pointer_cast<const GPUAPI::TextureInGPU>(gpuResource);
-
                         glUniform1i(perTile_vs.slotIndex, 0);
                         GL_CHECK_RESULT;
                         glUniform1f(perTile_vs.tileSizeN, 1.0f);
                         GL_CHECK_RESULT;
-                        glUniform1f(perTile_vs.tilePaddingN, texture->uHalfTexelSizeN);
+                        glUniform1f(perTile_vs.tilePaddingN, 0.0f);
                         GL_CHECK_RESULT;
                         glUniform1i(perTile_vs.slotsPerSide, 1);
                         GL_CHECK_RESULT;
                     }
                 }
-                else
-                {
-                    assert(gpuResource->type == GPUAPI::ResourceInGPU::Type::ArrayBuffer);
-
-                    const auto& arrayBuffer = std::static_pointer_cast<const GPUAPI::ArrayBufferInGPU>(gpuResource);
-                    assert(arrayBuffer->itemsCount == currentConfiguration.heixelsPerTileSide*currentConfiguration.heixelsPerTileSide);
-
-                    if(!elevationVertexAttribArrayEnabled)
-                    {
-                        glEnableVertexAttribArray(stageVariation.vs.in.vertexElevation);
-                        GL_CHECK_RESULT;
-
-                        elevationVertexAttribArrayEnabled = true;
-                    }
-
-                    glBindBuffer(GL_ARRAY_BUFFER, static_cast<GLuint>(reinterpret_cast<intptr_t>(gpuResource->refInGPU)));
-                    GL_CHECK_RESULT;
-
-                    glVertexAttribPointer(stageVariation.vs.in.vertexElevation, 1, GL_FLOAT, GL_FALSE, sizeof(float), nullptr);
-                    GL_CHECK_RESULT;
-                    appliedElevationVertexAttribArray = true;
-                }
-            }
-        }
-
-        // We need to pass each layer of this tile to shader
-        for(int layerIdx = 0, layerId = static_cast<int>(RasterMapLayerId::BaseLayer), layerLinearIdx = -1; layerIdx < RasterMapLayersCount; layerIdx++, layerId++)
-        {
-            if(!currentState.rasterLayerProviders[layerId])
-                continue;
-            layerLinearIdx++;
-
-            // Get resources collection
-            const auto resourcesCollection = getResources().getCollection(ResourceType::RasterMap, currentState.rasterLayerProviders[layerId]);
-
-            const auto& perTile_vs = stageVariation.vs.param.rasterTileLayers[layerLinearIdx];
-            const auto& perTile_fs = stageVariation.fs.param.rasterTileLayers[layerLinearIdx];
-            const auto samplerIndex = (gpuAPI->isSupported_vertexShaderTextureLookup ? 1 : 0) + layerLinearIdx;
-
-            // Obtain tile entry by normalized tile coordinates, since tile may repeat several times
-            std::shared_ptr< const GPUAPI::ResourceInGPU > gpuResource;
-            std::shared_ptr<Resources::BaseTiledResource> resource_;
-            if(resourcesCollection->obtainEntry(resource_, tileIdN, currentState.zoomBase))
-            {
-                const auto resource = std::static_pointer_cast<Resources::MapTileResource>(resource_);
 
-                // Check state and obtain GPU resource
-                if(resource->setStateIf(ResourceState::Uploaded, ResourceState::IsBeingUsed))
+                if(!appliedElevationVertexAttribArray && elevationVertexAttribArrayEnabled)
                 {
-                    // Capture GPU resource
-                    gpuResource = resource->resourceInGPU;
+                    elevationVertexAttribArrayEnabled = false;
 
-                    resource->setState(ResourceState::Uploaded);
+                    glDisableVertexAttribArray(stageVariation.vs.in.vertexElevation);
+                    GL_CHECK_RESULT;
                 }
-                else if(resource->getState() == ResourceState::Unavailable)
-                    gpuResource = getResources().unavailableTileStub;
-                else
-                    gpuResource = getResources().processingTileStub;
-            }
-            else
-            {
-                // No resource entry means that it's not yet processed
-                gpuResource = getResources().processingTileStub;
-            }
-
-            glUniform1f(perTile_fs.k, currentState.rasterLayerOpacity[layerId]);
-            GL_CHECK_RESULT;
-
-            glActiveTexture(GL_TEXTURE0 + samplerIndex);
-            GL_CHECK_RESULT;
 
-            glBindTexture(GL_TEXTURE_2D, static_cast<GLuint>(reinterpret_cast<intptr_t>(gpuResource->refInGPU)));
-            GL_CHECK_RESULT;
-
-            gpuAPI->applyTextureBlockToTexture(GL_TEXTURE_2D, GL_TEXTURE0 + samplerIndex);
-
-            if(gpuResource->type == GPUAPI::ResourceInGPU::Type::SlotOnAtlasTexture)
-            {
-                const auto tileOnAtlasTexture = std::static_pointer_cast<const GPUAPI::SlotOnAtlasTextureInGPU>(gpuResource);
-
-                glUniform1i(perTile_vs.slotIndex, tileOnAtlasTexture->slotIndex);
-                GL_CHECK_RESULT;
-                glUniform1f(perTile_vs.tileSizeN, tileOnAtlasTexture->atlasTexture->tileSizeN);
-                GL_CHECK_RESULT;
-                glUniform1f(perTile_vs.tilePaddingN, tileOnAtlasTexture->atlasTexture->tilePaddingN);
-                GL_CHECK_RESULT;
-                glUniform1i(perTile_vs.slotsPerSide, tileOnAtlasTexture->atlasTexture->slotsPerSide);
+                glDrawElements(GL_TRIANGLES, _tilePatchIndicesCount, GL_UNSIGNED_SHORT, nullptr);
                 GL_CHECK_RESULT;
             }
-            else
-            {
-                glUniform1i(perTile_vs.slotIndex, 0);
-                GL_CHECK_RESULT;
-                glUniform1f(perTile_vs.tileSizeN, 1.0f);
-                GL_CHECK_RESULT;
-                glUniform1f(perTile_vs.tilePaddingN, 0.0f);
-                GL_CHECK_RESULT;
-                glUniform1i(perTile_vs.slotsPerSide, 1);
-                GL_CHECK_RESULT;
-            }
-        }
-
-        if(!appliedElevationVertexAttribArray && elevationVertexAttribArrayEnabled)
-        {
-            elevationVertexAttribArrayEnabled = false;
-
-            glDisableVertexAttribArray(stageVariation.vs.in.vertexElevation);
-            GL_CHECK_RESULT;
         }
-
-        glDrawElements(GL_TRIANGLES, _tilePatchIndicesCount, GL_UNSIGNED_SHORT, nullptr);
-        GL_CHECK_RESULT;
     }
 
     // Disable textures
@@ -1699,45 +1791,90 @@ void OsmAnd::AtlasMapRenderer_OpenGL_Common::computeVisibleTileset(InternalState
         PointF(ip[3].x + internalState->targetInTileOffsetN.x, ip[3].y + internalState->targetInTileOffsetN.y),
     };
 
-    //NOTE: so far scanline does not work exactly as expected, so temporary switch to old implementation
+    // Visible area on the ground is a convex quadrilateral, but intersection points are not ordered.
+    // Order them around center, so that area can be tested for intersection with tiles
+    glm::vec2 visibleArea[4] =
     {
-        QSet<TileId> visibleTiles;
-        PointI p0(qFloor(p[0].x), qFloor(p[0].y));
-        PointI p1(qFloor(p[1].x), qFloor(p[1].y));
-        PointI p2(qFloor(p[2].x), qFloor(p[2].y));
-        PointI p3(qFloor(p[3].x), qFloor(p[3].y));
-
-        const auto xMin = qMin(qMin(p0.x, p1.x), qMin(p2.x, p3.x));
-        const auto xMax = qMax(qMax(p0.x, p1.x), qMax(p2.x, p3.x));
-        const auto yMin = qMin(qMin(p0.y, p1.y), qMin(p2.y, p3.y));
-        const auto yMax = qMax(qMax(p0.y, p1.y), qMax(p2.y, p3.y));
-        for(auto x = xMin; x <= xMax; x++)
+        glm::vec2(p[0].x, p[0].y),
+        glm::vec2(p[1].x, p[1].y),
+        glm::vec2(p[2].x, p[2].y),
+        glm::vec2(p[3].x, p[3].y),
+    };
+    const auto visibleAreaCenter = (visibleArea[0] + visibleArea[1] + visibleArea[2] + visibleArea[3]) / 4.0f;
+    qSort(visibleArea, visibleArea + 4, [visibleAreaCenter](const glm::vec2& l, const glm::vec2& r) -> bool
+    {
+        return qAtan2(l.y - visibleAreaCenter.y, l.x - visibleAreaCenter.x) < qAtan2(r.y - visibleAreaCenter.y, r.x - visibleAreaCenter.x);
+    });
+
+    // Camera position in same coordinates as visible area
+    const glm::vec3 eyeN(
+        eye_g.x / static_cast<float>(TileSize3D) + internalState->targetInTileOffsetN.x,
+        eye_g.y / static_cast<float>(TileSize3D),
+        eye_g.z / static_cast<float>(TileSize3D) + internalState->targetInTileOffsetN.y);
+
+    // Tiles farther than this distance from camera do not need base zoom detail. Each time distance doubles,
+    // zoom may be decreased by one
+    const auto lodDistanceN = (internalState->distanceFromCameraToTarget * _lodDistanceFactor) / static_cast<float>(TileSize3D);
+    const auto maxZoomShift = qMin(static_cast<int>(MaxVisibleTilesZoomShift), static_cast<int>(state.zoomBase - ZoomLevel::MinZoomLevel));
+
+    // Start from root tiles of lowest allowed zoom that cover bounding box of visible area
+    const auto& targetTileId = internalState->targetTileId;
+    const auto xMin = qFloor(qMin(qMin(p[0].x, p[1].x), qMin(p[2].x, p[3].x))) + targetTileId.x;
+    const auto xMax = qFloor(qMax(qMax(p[0].x, p[1].x), qMax(p[2].x, p[3].x))) + targetTileId.x;
+    const auto yMin = qFloor(qMin(qMin(p[0].y, p[1].y), qMin(p[2].y, p[3].y))) + targetTileId.y;
+    const auto yMax = qFloor(qMax(qMax(p[0].y, p[1].y), qMax(p[2].y, p[3].y))) + targetTileId.y;
+    QList< std::pair<TileId, int> > pendingTiles;
+    for(auto x = xMin >> maxZoomShift; x <= (xMax >> maxZoomShift); x++)
+    {
+        for(auto y = yMin >> maxZoomShift; y <= (yMax >> maxZoomShift); y++)
         {
-            for(auto y = yMin; y <= yMax; y++)
+            TileId tileId;
+            tileId.x = x;
+            tileId.y = y;
+
+            pendingTiles.push_back(std::make_pair(tileId, maxZoomShift));
+        }
+    }
+
+    // Subdivide tiles that are too close to camera for their zoom
+    QMap< ZoomLevel, QList<TileId> > visibleTiles;
+    while(!pendingTiles.isEmpty())
+    {
+        const auto pendingTile = pendingTiles.takeLast();
+        const auto& tileId = pendingTile.first;
+        const auto zoomShift = pendingTile.second;
+
+        // Tile bounds in tiles of base zoom, relative to target tile
+        const auto tileSizeN = 1 << zoomShift;
+        const glm::vec2 tileMin(
+            static_cast<float>(tileId.x * tileSizeN - targetTileId.x),
+            static_cast<float>(tileId.y * tileSizeN - targetTileId.y));
+        const glm::vec2 tileMax = tileMin + static_cast<float>(tileSizeN);
+        if(!Utilities_OpenGL_Common::convexPolygonIntersectsRect(visibleArea, 4, tileMin, tileMax))
+            continue;
+
+        if(zoomShift > 0)
+        {
+            const auto closestPoint = glm::clamp(glm::vec2(eyeN.x, eyeN.z), tileMin, tileMax);
+            const auto distanceN = glm::length(glm::vec3(closestPoint.x - eyeN.x, eyeN.y, closestPoint.y - eyeN.z));
+            if(distanceN < lodDistanceN * static_cast<float>(tileSizeN))
             {
-                TileId tileId;
-                tileId.x = x + internalState->targetTileId.x;
-                tileId.y = y + internalState->targetTileId.y;
+                for(int childIdx = 0; childIdx < 4; childIdx++)
+                {
+                    TileId childTileId;
+                    childTileId.x = (tileId.x << 1) + (childIdx & 1);
+                    childTileId.y = (tileId.y << 1) + (childIdx >> 1);
 
-                visibleTiles.insert(tileId);
+                    pendingTiles.push_back(std::make_pair(childTileId, zoomShift - 1));
+                }
+                continue;
             }
         }
 
-        internalState->visibleTiles = visibleTiles.toList();
+        visibleTiles[static_cast<ZoomLevel>(state.zoomBase - zoomShift)].push_back(tileId);
     }
-    /*
-    //TODO: Find visible tiles using scanline fill
-    _visibleTiles.clear();
-    Utilities::scanlineFillPolygon(4, &p[0],
-    [this, pC](const PointI& point)
-    {
-    TileId tileId;
-    tileId.x = point.x;// + _targetTile.x;
-    tileId.y = point.y;// + _targetTile.y;
 
-    _visibleTiles.insert(tileId);
-    });
-    */
+    internalState->visibleTiles = visibleTiles;
 }
 
 bool OsmAnd::AtlasMapRenderer_OpenGL_Common::postInitializeRendering()
@@ -1894,6 +2031,16 @@ float OsmAnd::AtlasMapRenderer_OpenGL_Common::getScaledTileSizeOnScreen()
     return getReferenceTileSizeOnScreen(state) * internalState.tileScaleFactor;
 }
 
+bool OsmAnd::AtlasMapRenderer_OpenGL_Common::obtainVisibleTileset( QMap< ZoomLevel, QList<TileId> >& outVisibleTiles )
+{
+    InternalState internalState;
+    if(!updateInternalState(&internalState, state))
+        return false;
+
+    outVisibleTiles = internalState.visibleTiles;
+    return true;
+}
+
 bool OsmAnd::AtlasMapRenderer_OpenGL_Common::getLocationFromScreenPoint( const PointI& screenPoint, PointI& location31 )
 {
     PointI64 location;
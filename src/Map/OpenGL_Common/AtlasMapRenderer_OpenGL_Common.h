@@ -23,6 +23,7 @@
 #define _OSMAND_CORE_ATLAS_MAP_RENDERER_OPENGL_COMMON_H_
 
 #include <OsmAndCore/stdlib_common.h>
+#include <array>
 
 #include <glm/glm.hpp>
 
@@ -44,9 +45,12 @@ namespace OsmAnd {
 
         enum {
             DefaultReferenceTileSizeOnScreen = 256,
+            MaxVisibleTilesZoomShift = 5,
         };
 
         const static float _zNear;
+        // Distance from camera (relative to distance to target) up to which tiles of base zoom are used
+        const static float _lodDistanceFactor;
 
         struct InternalState : public AtlasMapRenderer::InternalState
         {
@@ -130,6 +134,8 @@ namespace OsmAnd {
 
                         // Per-tile data
                         GLint tileCoordsOffset;
+                        GLint tilePatchSubRectN;
+                        GLint tileScale;
                         GLint elevationData_k;
                         GLint elevationData_sampler;
                         GLint elevationData_upperMetersPerUnit;
@@ -142,6 +148,7 @@ namespace OsmAnd {
                             GLint tilePaddingN;
                             GLint slotsPerSide;
                             GLint slotIndex;
+                            GLint texCoordsOffsetAndScale;
                         } elevationTileLayer, rasterTileLayers[RasterMapLayersCount];
                     } param;
                 } vs;
@@ -161,6 +168,19 @@ namespace OsmAnd {
                 } fs;
             } variations[RasterMapLayersCount];
         } _rasterMapStage;
+        struct RasterLayerTileResources
+        {
+            RasterLayerTileResources()
+                : texCoordsOffset(0.0f, 0.0f)
+                , texCoordsScale(1.0f)
+            {}
+
+            // Either exact (or ancestor, or stub) resource, or 4 descendants
+            std::shared_ptr< const GPUAPI::ResourceInGPU > gpuResource;
+            PointF texCoordsOffset;
+            float texCoordsScale;
+            std::array< std::shared_ptr< const GPUAPI::ResourceInGPU >, 4 > descendantsGpuResources;
+        };
         void initializeRasterMapStage();
         void renderRasterMapStage();
         void releaseRasterMapStage();
@@ -271,6 +291,7 @@ namespace OsmAnd {
 
         virtual float getReferenceTileSizeOnScreen();
         virtual float getScaledTileSizeOnScreen();
+        virtual bool obtainVisibleTileset(QMap< ZoomLevel, QList<TileId> >& outVisibleTiles);
         virtual bool getLocationFromScreenPoint(const PointI& screenPoint, PointI& location31);
         virtual bool getLocationFromScreenPoint(const PointI& screenPoint, PointI64& location);
     };
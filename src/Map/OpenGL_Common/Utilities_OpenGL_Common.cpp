@@ -43,3 +43,55 @@ OSMAND_CORE_API bool OSMAND_CORE_CALL OsmAnd::Utilities_OpenGL_Common::lineSegme
     lineX = line0 + d*lineD;
     return true;
 }
+
+OSMAND_CORE_API bool OSMAND_CORE_CALL OsmAnd::Utilities_OpenGL_Common::convexPolygonIntersectsRect( const glm::vec2* const polygon, const unsigned int verticesCount, const glm::vec2& rectMin, const glm::vec2& rectMax )
+{
+    // Separating axis test: rect axes first, since these are the cheapest
+    glm::vec2 polygonMin = polygon[0];
+    glm::vec2 polygonMax = polygon[0];
+    for(auto vertexIdx = 1u; vertexIdx < verticesCount; vertexIdx++)
+    {
+        polygonMin = glm::min(polygonMin, polygon[vertexIdx]);
+        polygonMax = glm::max(polygonMax, polygon[vertexIdx]);
+    }
+    if(polygonMax.x < rectMin.x || polygonMin.x > rectMax.x || polygonMax.y < rectMin.y || polygonMin.y > rectMax.y)
+        return false;
+
+    // Then normals of polygon edges
+    const glm::vec2 rectVertices[4] =
+    {
+        glm::vec2(rectMin.x, rectMin.y),
+        glm::vec2(rectMax.x, rectMin.y),
+        glm::vec2(rectMax.x, rectMax.y),
+        glm::vec2(rectMin.x, rectMax.y),
+    };
+    for(auto vertexIdx = 0u; vertexIdx < verticesCount; vertexIdx++)
+    {
+        const auto& v0 = polygon[vertexIdx];
+        const auto& v1 = polygon[(vertexIdx + 1) % verticesCount];
+        const glm::vec2 axis(v0.y - v1.y, v1.x - v0.x);
+
+        auto polygonProjectionMin = glm::dot(axis, polygon[0]);
+        auto polygonProjectionMax = polygonProjectionMin;
+        for(auto otherVertexIdx = 1u; otherVertexIdx < verticesCount; otherVertexIdx++)
+        {
+            const auto projection = glm::dot(axis, polygon[otherVertexIdx]);
+            polygonProjectionMin = qMin(polygonProjectionMin, projection);
+            polygonProjectionMax = qMax(polygonProjectionMax, projection);
+        }
+
+        auto rectProjectionMin = glm::dot(axis, rectVertices[0]);
+        auto rectProjectionMax = rectProjectionMin;
+        for(auto rectVertexIdx = 1u; rectVertexIdx < 4; rectVertexIdx++)
+        {
+            const auto projection = glm::dot(axis, rectVertices[rectVertexIdx]);
+            rectProjectionMin = qMin(rectProjectionMin, projection);
+            rectProjectionMax = qMax(rectProjectionMax, projection);
+        }
+
+        if(polygonProjectionMax < rectProjectionMin || polygonProjectionMin > rectProjectionMax)
+            return false;
+    }
+
+    return true;
+}
@@ -36,6 +36,7 @@ namespace OsmAnd {
         OSMAND_CORE_API float OSMAND_CORE_CALL calculateCameraDistance( const glm::mat4& P, const AreaI& viewport, const float Ax, const float Sx, const float k );
         OSMAND_CORE_API bool OSMAND_CORE_CALL rayIntersectPlane( const glm::vec3& planeN, const glm::vec3& planeO, const glm::vec3& rayD, const glm::vec3& rayO, float& distance );
         OSMAND_CORE_API bool OSMAND_CORE_CALL lineSegmentIntersectPlane( const glm::vec3& planeN, const glm::vec3& planeO, const glm::vec3& line0, const glm::vec3& line1, glm::vec3& lineX );
+        OSMAND_CORE_API bool OSMAND_CORE_CALL convexPolygonIntersectsRect( const glm::vec2* const polygon, const unsigned int verticesCount, const glm::vec2& rectMin, const glm::vec2& rectMax );
     }
 
 }
@@ -0,0 +1,26 @@
+#include "RasterizationSurfacesPool.h"
+#include "RasterizationSurfacesPool_P.h"
+
+OsmAnd::RasterizationSurfacesPool::RasterizationSurfacesPool( const unsigned int maxPooledSurfaces_ /*= 32*/ )
+    : _d(new RasterizationSurfacesPool_P(this, maxPooledSurfaces_))
+    , maxPooledSurfaces(maxPooledSurfaces_)
+{
+}
+
+OsmAnd::RasterizationSurfacesPool::~RasterizationSurfacesPool()
+{
+}
+
+OsmAnd::RasterizationSurfacesPool::Metrics OsmAnd::RasterizationSurfacesPool::getMetrics() const
+{
+    QMutexLocker scopedLocker(&_d->_storage->_mutex);
+
+    return _d->_storage->_metrics;
+}
+
+void OsmAnd::RasterizationSurfacesPool::clear()
+{
+    QMutexLocker scopedLocker(&_d->_storage->_mutex);
+
+    _d->_storage->clear();
+}
@@ -0,0 +1,156 @@
+#include "RasterizationSurfacesPool_P.h"
+#include "RasterizationSurfacesPool.h"
+
+#include <cassert>
+
+#include <SkBitmapDevice.h>
+#include <SkCanvas.h>
+#include <SkPixelRef.h>
+
+#include "Logging.h"
+
+OsmAnd::RasterizationSurfacesPool_P::RasterizationSurfacesPool_P( RasterizationSurfacesPool* const owner_, const unsigned int maxPooledSurfaces )
+    : _storage(new Storage(maxPooledSurfaces))
+    , owner(owner_)
+{
+}
+
+OsmAnd::RasterizationSurfacesPool_P::~RasterizationSurfacesPool_P()
+{
+    QMutexLocker scopedLocker(&_storage->_mutex);
+
+    _storage->clear();
+}
+
+uint64_t OsmAnd::RasterizationSurfacesPool_P::makeKey( const uint32_t width, const uint32_t height, const SkBitmap::Config config )
+{
+    assert(width <= 0xFFFF && height <= 0xFFFF);
+
+    return (static_cast<uint64_t>(config) << 32) | (static_cast<uint64_t>(width) << 16) | static_cast<uint64_t>(height);
+}
+
+std::shared_ptr<OsmAnd::RasterizationSurfacesPool_P::Surface> OsmAnd::RasterizationSurfacesPool_P::obtainSurface( const uint32_t width, const uint32_t height, const SkBitmap::Config config )
+{
+    const auto key = makeKey(width, height, config);
+    const std::weak_ptr<Storage> storageWeakRef(_storage);
+    const auto deleter = [storageWeakRef](Surface* surface)
+    {
+        releaseSurface(storageWeakRef, surface);
+    };
+
+    // Try to reuse surface from pool
+    {
+        QMutexLocker scopedLocker(&_storage->_mutex);
+
+        auto itSurfaces = _storage->_surfaces.find(key);
+        if(itSurfaces != _storage->_surfaces.end() && !itSurfaces->isEmpty())
+        {
+            const auto surface = itSurfaces->takeLast();
+            assert(!surface->isShared());
+
+            _storage->_metrics.reusedSurfaces++;
+            _storage->_metrics.pooledSurfaces--;
+            _storage->_metrics.pooledBytes -= surface->bitmap().getSize();
+
+            // Reset state that previous user could have left
+            surface->canvas->restoreToCount(1);
+            surface->canvas->resetMatrix();
+
+            return std::shared_ptr<Surface>(surface, deleter);
+        }
+    }
+
+    // Otherwise allocate new one
+    SkBitmap bitmap;
+    bitmap.setConfig(config, width, height);
+    if(!bitmap.allocPixels())
+    {
+        LogPrintf(LogSeverityLevel::Error, "Failed to allocate buffer for rasterization surface %dx%d", width, height);
+        return nullptr;
+    }
+    const auto surface = new Surface(key);
+    const auto device = new SkBitmapDevice(bitmap);
+    surface->canvas = new SkCanvas(device);
+    device->unref();
+
+    {
+        QMutexLocker scopedLocker(&_storage->_mutex);
+
+        _storage->_metrics.allocatedSurfaces++;
+    }
+
+    return std::shared_ptr<Surface>(surface, deleter);
+}
+
+void OsmAnd::RasterizationSurfacesPool_P::releaseSurface( const std::weak_ptr<Storage>& storageWeakRef, Surface* surface )
+{
+    const auto storage = storageWeakRef.lock();
+    if(!storage)
+    {
+        delete surface;
+        return;
+    }
+
+    {
+        QMutexLocker scopedLocker(&storage->_mutex);
+
+        // If someone still holds a shallow copy of surface bitmap, its pixels can not be
+        // overwritten by next user of this surface
+        if(surface->isShared())
+        {
+            storage->_metrics.sharedSurfaces++;
+        }
+        else if(storage->_metrics.pooledSurfaces < storage->maxPooledSurfaces)
+        {
+            storage->_surfaces[surface->key].push_back(surface);
+
+            storage->_metrics.returnedSurfaces++;
+            storage->_metrics.pooledSurfaces++;
+            storage->_metrics.pooledBytes += surface->bitmap().getSize();
+            return;
+        }
+        else
+        {
+            storage->_metrics.discardedSurfaces++;
+        }
+    }
+
+    delete surface;
+}
+
+void OsmAnd::RasterizationSurfacesPool_P::Storage::clear()
+{
+    for(auto itSurfaces = _surfaces.cbegin(); itSurfaces != _surfaces.cend(); ++itSurfaces)
+    {
+        const auto& surfaces = *itSurfaces;
+        for(auto itSurface = surfaces.cbegin(); itSurface != surfaces.cend(); ++itSurface)
+            delete *itSurface;
+    }
+    _surfaces.clear();
+
+    _metrics.pooledSurfaces = 0;
+    _metrics.pooledBytes = 0;
+}
+
+OsmAnd::RasterizationSurfacesPool_P::Surface::Surface( const uint64_t key_ )
+    : key(key_)
+    , canvas(nullptr)
+{
+}
+
+OsmAnd::RasterizationSurfacesPool_P::Surface::~Surface()
+{
+    if(canvas)
+        canvas->unref();
+}
+
+const SkBitmap& OsmAnd::RasterizationSurfacesPool_P::Surface::bitmap() const
+{
+    return canvas->getDevice()->accessBitmap(false);
+}
+
+bool OsmAnd::RasterizationSurfacesPool_P::Surface::isShared() const
+{
+    const auto pixelRef = bitmap().pixelRef();
+    return pixelRef && !pixelRef->unique();
+}
@@ -0,0 +1,98 @@
+/**
+* @file
+*
+* @section LICENSE
+*
+* OsmAnd - Android navigation software based on OSM maps.
+* Copyright (C) 2010-2013  OsmAnd Authors listed in AUTHORS file
+*
+* This program is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+
+* You should have received a copy of the GNU General Public License
+* along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef _OSMAND_CORE_RASTERIZATION_SURFACES_POOL_P_H_
+#define _OSMAND_CORE_RASTERIZATION_SURFACES_POOL_P_H_
+
+#include <OsmAndCore/stdlib_common.h>
+
+#include <OsmAndCore/QtExtensions.h>
+#include <QHash>
+#include <QList>
+#include <QMutex>
+
+#include <SkBitmap.h>
+
+#include <OsmAndCore.h>
+#include <RasterizationSurfacesPool.h>
+
+class SkCanvas;
+
+namespace OsmAnd
+{
+    class RasterizationSurfacesPool;
+    class RasterizationSurfacesPool_P
+    {
+    public:
+        class Surface
+        {
+            Q_DISABLE_COPY(Surface);
+        private:
+        protected:
+        public:
+            Surface(const uint64_t key);
+            ~Surface();
+
+            const uint64_t key;
+            SkCanvas* canvas;
+
+            // Pixels are owned by canvas device only, so that any SkBitmap copy made outside
+            // of pool is visible as additional reference to pixel storage
+            const SkBitmap& bitmap() const;
+            bool isShared() const;
+        };
+    private:
+        // Pooled surfaces are stored separately from pool itself, since surfaces may be
+        // returned after pool was destroyed
+        struct Storage
+        {
+            Storage(const unsigned int maxPooledSurfaces_)
+                : maxPooledSurfaces(maxPooledSurfaces_)
+            {}
+
+            const unsigned int maxPooledSurfaces;
+
+            mutable QMutex _mutex;
+            QHash< uint64_t, QList< Surface* > > _surfaces;
+            RasterizationSurfacesPool::Metrics _metrics;
+
+            void clear();
+        };
+        const std::shared_ptr<Storage> _storage;
+
+        static uint64_t makeKey(const uint32_t width, const uint32_t height, const SkBitmap::Config config);
+        static void releaseSurface(const std::weak_ptr<Storage>& storage, Surface* surface);
+    protected:
+        RasterizationSurfacesPool_P(RasterizationSurfacesPool* const owner, const unsigned int maxPooledSurfaces);
+
+        RasterizationSurfacesPool* const owner;
+    public:
+        ~RasterizationSurfacesPool_P();
+
+        std::shared_ptr<Surface> obtainSurface(const uint32_t width, const uint32_t height, const SkBitmap::Config config);
+
+    friend class OsmAnd::RasterizationSurfacesPool;
+    };
+
+} // namespace OsmAnd
+
+#endif // _OSMAND_CORE_RASTERIZATION_SURFACES_POOL_P_H_
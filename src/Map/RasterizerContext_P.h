@@ -58,6 +58,7 @@ namespace OsmAnd {
         AreaI _area31;
         ZoomLevel _zoom;
         double _tileDivisor;
+        double _simplificationTolerance31;
         uint32_t _shadowLevelMin;
         uint32_t _shadowLevelMax;
 
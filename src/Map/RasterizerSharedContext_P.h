@@ -25,6 +25,7 @@
 
 #include <OsmAndCore/stdlib_common.h>
 #include <array>
+#include <list>
 
 #include <OsmAndCore/QtExtensions.h>
 #include <QtGlobal>
@@ -61,6 +62,26 @@ namespace OsmAnd
             QHash< uint64_t, std::shared_ptr< const Rasterizer_P::SymbolsGroup > > _cache;
         };
         std::array<SymbolsCacheLevel, ZoomLevelsCount> _symbolsCacheLevels;
+
+        struct CoastlinesCacheLevel
+        {
+            CoastlinesCacheLevel()
+                : _verticesCount(0)
+            {}
+
+            mutable QReadWriteLock _lock;
+            // Oldest entry is at front. Each entry knows its position, so it's replaced in constant time
+            typedef std::list<uint64_t> InsertionOrder;
+            struct Entry
+            {
+                std::shared_ptr< const Rasterizer_P::PolygonizedCoastlines > coastlines;
+                InsertionOrder::iterator itInsertionOrder;
+            };
+            QHash< uint64_t, Entry > _cache;
+            InsertionOrder _insertionOrder;
+            unsigned int _verticesCount;
+        };
+        std::array<CoastlinesCacheLevel, ZoomLevelsCount> _coastlinesCacheLevels;
     public:
         virtual ~RasterizerSharedContext_P();
 
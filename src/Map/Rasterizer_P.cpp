@@ -21,8 +21,10 @@
 #include "MapTypes.h"
 #include "MapObject.h"
 #include "ObfMapSectionInfo.h"
+#include "ObfInfo.h"
 #include "IQueryController.h"
 #include "Utilities.h"
+#include "Tracing.h"
 #include "Logging.h"
 
 #include <SkBitmapDevice.h>
@@ -60,6 +62,10 @@ void OsmAnd::Rasterizer_P::prepareContext(
 
     context._tileDivisor = Utilities::getPowZoom(31 - zoom);
 
+    // Geometry is simplified to half a pixel of reference tile, scaled by display density
+    context._simplificationTolerance31 = 0.5 * context._tileDivisor /
+        (static_cast<double>(SimplificationReferenceTileSize) * env.owner->displayDensityFactor);
+
     context._zoom = zoom;
     context._area31 = area31;
 
@@ -122,32 +128,16 @@ void OsmAnd::Rasterizer_P::prepareContext(
     }
 
     // Polygonize coastlines
-    bool fillEntireArea = true;
-    bool addBasemapCoastlines = true;
+    Tracing::Span polygonizeCoastlinesSpan("polygonizeCoastlines", "style");
     const bool detailedLandData = zoom >= DetailedLandDataZoom && !detailedmapMapObjects.isEmpty();
-    if(!detailedmapCoastlineObjects.empty())
-    {
-        const bool coastlinesWereAdded = polygonizeCoastlines(env, context,
-            detailedmapCoastlineObjects,
-            polygonizedCoastlineObjects,
-            !basemapCoastlineObjects.isEmpty(),
-            true);
-        fillEntireArea = !coastlinesWereAdded && fillEntireArea;
-        addBasemapCoastlines = (!coastlinesWereAdded && !detailedLandData) || zoom <= BasemapZoom;
-    }
-    else
-    {
-        addBasemapCoastlines = !detailedLandData;
-    }
-    if(addBasemapCoastlines)
-    {
-        const bool coastlinesWereAdded = polygonizeCoastlines(env, context,
-            basemapCoastlineObjects,
-            polygonizedCoastlineObjects,
-            false,
-            true);
-        fillEntireArea = !coastlinesWereAdded && fillEntireArea;
-    }
+    const auto polygonizedCoastlines = obtainPolygonizedCoastlines(env, context,
+        detailedmapCoastlineObjects,
+        basemapCoastlineObjects,
+        detailedLandData,
+        metric);
+    const bool fillEntireArea = polygonizedCoastlines->fillEntireArea;
+    polygonizedCoastlineObjects = polygonizedCoastlines->mapObjects;
+    polygonizeCoastlinesSpan.end();
 
     // Update metric
     if(metric)
@@ -217,12 +207,14 @@ void OsmAnd::Rasterizer_P::prepareContext(
     if(metric)
         obtainPrimitives_begin = std::chrono::high_resolution_clock::now();
 
-    // Obtain primitives
+    // Obtain primitives, this is where style rules are evaluated
+    Tracing::Span obtainPrimitivesSpan("obtainPrimitives", "style");
     obtainPrimitives(env, context, detailedmapMapObjects, controller, metric);
     if(zoom <= BasemapZoom || detailedDataMissing)
         obtainPrimitives(env, context, basemapMapObjects, controller, metric);
     obtainPrimitives(env, context, polygonizedCoastlineObjects, controller, metric);
     sortAndFilterPrimitives(env, context);
+    obtainPrimitivesSpan.end();
     if(controller && controller->isAborted())
     {
         context.clear();
@@ -242,7 +234,9 @@ void OsmAnd::Rasterizer_P::prepareContext(
         obtainPrimitivesSymbols_begin = std::chrono::high_resolution_clock::now();
 
     // Obtain symbols from primitives
+    Tracing::Span obtainPrimitivesSymbolsSpan("obtainPrimitivesSymbols", "style");
     obtainPrimitivesSymbols(env, context, controller);
+    obtainPrimitivesSymbolsSpan.end();
 
     // Update metric
     if(metric)
@@ -590,6 +584,10 @@ void OsmAnd::Rasterizer_P::obtainPrimitives(
             }
         }
 
+        // Simplify geometry only once per group, since group is cached per zoom
+        if(!constructedGroup->polygons.isEmpty() || !constructedGroup->polylines.isEmpty())
+            simplifyPrimitivesGroup(context, constructedGroup, metric);
+
         // Add this group to shared cache
         if(!isMapObjectGenerated && context.owner->sharedContext)
         {
@@ -624,6 +622,55 @@ void OsmAnd::Rasterizer_P::obtainPrimitives(
     }
 }
 
+void OsmAnd::Rasterizer_P::simplifyPrimitivesGroup(
+    const RasterizerContext_P& context,
+    PrimitivesGroup* const group,
+    Rasterizer_Metrics::Metric_prepareContext* const metric)
+{
+    const auto& mapObject = group->mapObject;
+
+    // Update metric
+    std::chrono::high_resolution_clock::time_point simplification_begin;
+    if(metric)
+        simplification_begin = std::chrono::high_resolution_clock::now();
+
+    // Polygons are checked to be closed, so simplified outer ring is valid only if it still has an area
+    const auto isPolygon = !group->polygons.isEmpty();
+    Utilities::simplifyPolyline(mapObject->points31, context._simplificationTolerance31, group->points31);
+    if(isPolygon && group->points31.size() < 4)
+        group->points31 = mapObject->points31;
+
+    unsigned int verticesIn = mapObject->points31.size();
+    unsigned int verticesOut = group->points31.size();
+    if(isPolygon)
+    {
+        for(auto itPolygon = mapObject->innerPolygonsPoints31.cbegin(); itPolygon != mapObject->innerPolygonsPoints31.cend(); ++itPolygon)
+        {
+            const auto& polygon = *itPolygon;
+            verticesIn += polygon.size();
+
+            QVector< PointI > simplifiedPolygon;
+            Utilities::simplifyPolyline(polygon, context._simplificationTolerance31, simplifiedPolygon);
+
+            // Inner polygon that collapsed is smaller than a pixel, so it's not visible at all
+            if(simplifiedPolygon.size() < 4)
+                continue;
+
+            verticesOut += simplifiedPolygon.size();
+            group->innerPolygonsPoints31.push_back(qMove(simplifiedPolygon));
+        }
+    }
+
+    // Update metric
+    if(metric)
+    {
+        const std::chrono::duration<float> simplification_elapsed = std::chrono::high_resolution_clock::now() - simplification_begin;
+        metric->elapsedTimeForSimplification += simplification_elapsed.count();
+        metric->simplificationVerticesIn += verticesIn;
+        metric->simplificationVerticesOut += verticesOut;
+    }
+}
+
 void OsmAnd::Rasterizer_P::sortAndFilterPrimitives(
     const RasterizerEnvironment_P& env, RasterizerContext_P& context)
 {
@@ -1305,14 +1352,20 @@ void OsmAnd::Rasterizer_P::rasterizePolygon(
     if(!updatePaint(*primitive->evaluationResult, PaintValuesSet::Set_0, true))
         return;
 
+    // Use geometry simplified for current zoom, if available
+    const auto group = primitive->group.lock();
+    const auto useSimplified = group && !group->points31.isEmpty();
+    const auto& points31 = useSimplified ? group->points31 : primitive->mapObject->points31;
+    const auto& innerPolygonsPoints31 = useSimplified ? group->innerPolygonsPoints31 : primitive->mapObject->innerPolygonsPoints31;
+
     SkPath path;
     bool containsAtLeastOnePoint = false;
     int pointIdx = 0;
     PointF vertex;
     int bounds = 0;
     QVector< PointF > outsideBounds;
-    const auto pointsCount = primitive->mapObject->points31.size();
-    auto pPoint = primitive->mapObject->points31.constData();
+    const auto pointsCount = points31.size();
+    auto pPoint = points31.constData();
     for(auto pointIdx = 0; pointIdx < pointsCount; pointIdx++, pPoint++)
     {
         calculateVertex(*pPoint, vertex);
@@ -1359,10 +1412,10 @@ void OsmAnd::Rasterizer_P::rasterizePolygon(
             return;
     }
 
-    if(!primitive->mapObject->innerPolygonsPoints31.isEmpty())
+    if(!innerPolygonsPoints31.isEmpty())
     {
         path.setFillType(SkPath::kEvenOdd_FillType);
-        for(auto itPolygon = primitive->mapObject->innerPolygonsPoints31.cbegin(); itPolygon != primitive->mapObject->innerPolygonsPoints31.cend(); ++itPolygon)
+        for(auto itPolygon = innerPolygonsPoints31.cbegin(); itPolygon != innerPolygonsPoints31.cend(); ++itPolygon)
         {
             const auto& polygon = *itPolygon;
 
@@ -1421,14 +1474,18 @@ void OsmAnd::Rasterizer_P::rasterizePolyline(
             oneway = -1;
     }
 
+    // Use geometry simplified for current zoom, if available
+    const auto group = primitive->group.lock();
+    const auto& points31 = (group && !group->points31.isEmpty()) ? group->points31 : primitive->mapObject->points31;
+
     SkPath path;
     int pointIdx = 0;
     bool intersect = false;
     int prevCross = 0;
     PointF vertex, middleVertex;
-    const auto pointsCount = primitive->mapObject->points31.size();
+    const auto pointsCount = points31.size();
     const auto middleIdx = pointsCount / 2;
-    auto pPoint = primitive->mapObject->points31.constData();
+    auto pPoint = points31.constData();
     for(pointIdx = 0; pointIdx < pointsCount; pointIdx++, pPoint++)
     {
         calculateVertex(*pPoint, vertex);
@@ -1584,6 +1641,168 @@ bool OsmAnd::Rasterizer_P::contains( const QVector< PointF >& vertices, const Po
     return intersections % 2 == 1;
 }
 
+std::shared_ptr<const OsmAnd::Rasterizer_P::PolygonizedCoastlines> OsmAnd::Rasterizer_P::obtainPolygonizedCoastlines(
+    const RasterizerEnvironment_P& env, const RasterizerContext_P& context,
+    const QList< std::shared_ptr<const OsmAnd::Model::MapObject> >& detailedmapCoastlineObjects,
+    const QList< std::shared_ptr<const OsmAnd::Model::MapObject> >& basemapCoastlineObjects,
+    const bool detailedLandData,
+    Rasterizer_Metrics::Metric_prepareContext* const metric)
+{
+    const auto zoom = context._zoom;
+
+    // Only areas that exactly match a tile can be cached, since polygons are clipped by area
+    TileId tileId;
+    tileId.x = context._area31.left >> (ZoomLevel31 - zoom);
+    tileId.y = context._area31.top >> (ZoomLevel31 - zoom);
+    const auto isCacheable =
+        context.owner->sharedContext &&
+        Utilities::tileBoundingBox31(tileId, zoom) == context._area31;
+
+    // Signature covers all source coastlines, so any change in set of OBFs invalidates cached entry
+    const auto signature = computeCoastlinesSignature(detailedmapCoastlineObjects, basemapCoastlineObjects, detailedLandData);
+
+    if(isCacheable)
+    {
+        const auto& coastlinesCacheLevel = context.owner->sharedContext->_d->_coastlinesCacheLevels[zoom];
+
+        QReadLocker scopedLocker(&coastlinesCacheLevel._lock);
+
+        const auto itCachedEntry = coastlinesCacheLevel._cache.constFind(tileId);
+        if(itCachedEntry != coastlinesCacheLevel._cache.cend() && itCachedEntry->coastlines->signature == signature)
+        {
+            // Update metric
+            if(metric)
+                metric->polygonizedCoastlinesCacheHits++;
+
+            return itCachedEntry->coastlines;
+        }
+    }
+
+    const auto constructedEntry = new PolygonizedCoastlines();
+    std::shared_ptr<const PolygonizedCoastlines> entry(constructedEntry);
+    constructedEntry->signature = signature;
+
+    bool fillEntireArea = true;
+    bool addBasemapCoastlines = true;
+    if(!detailedmapCoastlineObjects.empty())
+    {
+        const bool coastlinesWereAdded = polygonizeCoastlines(env, context,
+            detailedmapCoastlineObjects,
+            constructedEntry->mapObjects,
+            !basemapCoastlineObjects.isEmpty(),
+            true);
+        fillEntireArea = !coastlinesWereAdded && fillEntireArea;
+        addBasemapCoastlines = (!coastlinesWereAdded && !detailedLandData) || zoom <= BasemapZoom;
+    }
+    else
+    {
+        addBasemapCoastlines = !detailedLandData;
+    }
+    if(addBasemapCoastlines)
+    {
+        const bool coastlinesWereAdded = polygonizeCoastlines(env, context,
+            basemapCoastlineObjects,
+            constructedEntry->mapObjects,
+            false,
+            true);
+        fillEntireArea = !coastlinesWereAdded && fillEntireArea;
+    }
+    constructedEntry->fillEntireArea = fillEntireArea;
+
+    constructedEntry->verticesCount = 0;
+    for(auto itMapObject = constructedEntry->mapObjects.cbegin(); itMapObject != constructedEntry->mapObjects.cend(); ++itMapObject)
+    {
+        const auto& mapObject = *itMapObject;
+
+        constructedEntry->verticesCount += mapObject->points31.size();
+        for(auto itPolygon = mapObject->innerPolygonsPoints31.cbegin(); itPolygon != mapObject->innerPolygonsPoints31.cend(); ++itPolygon)
+            constructedEntry->verticesCount += itPolygon->size();
+    }
+
+    // Entries that alone exceed the limit are never cached
+    if(!isCacheable || constructedEntry->verticesCount > CoastlinesCacheLevelVerticesLimit)
+        return entry;
+
+    auto& coastlinesCacheLevel = context.owner->sharedContext->_d->_coastlinesCacheLevels[zoom];
+    {
+        QWriteLocker scopedLocker(&coastlinesCacheLevel._lock);
+
+        // Replace previous (outdated or concurrently inserted) entry, if any
+        const auto itPreviousEntry = coastlinesCacheLevel._cache.find(tileId);
+        if(itPreviousEntry != coastlinesCacheLevel._cache.end())
+        {
+            coastlinesCacheLevel._verticesCount -= itPreviousEntry->coastlines->verticesCount;
+            coastlinesCacheLevel._insertionOrder.erase(itPreviousEntry->itInsertionOrder);
+            coastlinesCacheLevel._cache.erase(itPreviousEntry);
+        }
+
+        // Evict oldest entries until there's enough room. Entries still in use by contexts stay alive
+        while(!coastlinesCacheLevel._insertionOrder.empty() &&
+            coastlinesCacheLevel._verticesCount + constructedEntry->verticesCount > CoastlinesCacheLevelVerticesLimit)
+        {
+            const auto evictedTileId = coastlinesCacheLevel._insertionOrder.front();
+            coastlinesCacheLevel._insertionOrder.pop_front();
+            const auto evictedEntry = coastlinesCacheLevel._cache.take(evictedTileId);
+            coastlinesCacheLevel._verticesCount -= evictedEntry.coastlines->verticesCount;
+        }
+
+        RasterizerSharedContext_P::CoastlinesCacheLevel::Entry cacheEntry;
+        cacheEntry.coastlines = entry;
+        cacheEntry.itInsertionOrder = coastlinesCacheLevel._insertionOrder.insert(coastlinesCacheLevel._insertionOrder.end(), tileId);
+        coastlinesCacheLevel._cache.insert(tileId, cacheEntry);
+        coastlinesCacheLevel._verticesCount += constructedEntry->verticesCount;
+    }
+
+    return entry;
+}
+
+uint64_t OsmAnd::Rasterizer_P::computeCoastlinesSignature(
+    const QList< std::shared_ptr<const OsmAnd::Model::MapObject> >& detailedmapCoastlineObjects,
+    const QList< std::shared_ptr<const OsmAnd::Model::MapObject> >& basemapCoastlineObjects,
+    const bool detailedLandData)
+{
+    // FNV-1a over identity of source coastlines. Order of objects is stable for same set of OBFs.
+    // Sections are identified by file and offset, since section objects are recreated when OBFs are reloaded
+    uint64_t signature = 14695981039346656037ull;
+    const auto combine = [&signature](const uint64_t value)
+    {
+        signature ^= value;
+        signature *= 1099511628211ull;
+    };
+
+    // Objects of same section go one after another, so identity is computed once per section
+    const ObfMapSectionInfo* lastSection = nullptr;
+    uint64_t lastSectionIdentity = 0;
+    const auto combineMapObject = [&combine, &lastSection, &lastSectionIdentity](const std::shared_ptr<const OsmAnd::Model::MapObject>& mapObject)
+    {
+        const auto section = mapObject->section.get();
+        if(section != lastSection)
+        {
+            lastSection = section;
+            lastSectionIdentity = 0;
+            if(section)
+            {
+                const auto obfInfo = section->owner.lock();
+                lastSectionIdentity = (static_cast<uint64_t>(obfInfo ? qHash(obfInfo->filePath) : 0) << 32) | section->offset;
+            }
+        }
+
+        combine(mapObject->id);
+        combine(lastSectionIdentity);
+        combine(mapObject->points31.size());
+    };
+
+    combine(detailedLandData ? 1 : 0);
+    combine(detailedmapCoastlineObjects.size());
+    for(auto itMapObject = detailedmapCoastlineObjects.cbegin(); itMapObject != detailedmapCoastlineObjects.cend(); ++itMapObject)
+        combineMapObject(*itMapObject);
+    combine(basemapCoastlineObjects.size());
+    for(auto itMapObject = basemapCoastlineObjects.cbegin(); itMapObject != basemapCoastlineObjects.cend(); ++itMapObject)
+        combineMapObject(*itMapObject);
+
+    return signature;
+}
+
 bool OsmAnd::Rasterizer_P::polygonizeCoastlines(
     const RasterizerEnvironment_P& env, const RasterizerContext_P& context,
     const QList< std::shared_ptr<const OsmAnd::Model::MapObject> >& coastlines,
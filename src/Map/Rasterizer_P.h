@@ -72,6 +72,25 @@ namespace OsmAnd {
             const RasterizerEnvironment_P& env, RasterizerContext_P& context,
             const ZoomLevel zoom);
 
+        struct PolygonizedCoastlines
+        {
+            // Signature of source coastlines, used to detect that source data has changed
+            uint64_t signature;
+
+            bool fillEntireArea;
+            unsigned int verticesCount;
+            QList< std::shared_ptr<const Model::MapObject> > mapObjects;
+        };
+        static std::shared_ptr<const PolygonizedCoastlines> obtainPolygonizedCoastlines(
+            const RasterizerEnvironment_P& env, const RasterizerContext_P& context,
+            const QList< std::shared_ptr<const OsmAnd::Model::MapObject> >& detailedmapCoastlineObjects,
+            const QList< std::shared_ptr<const OsmAnd::Model::MapObject> >& basemapCoastlineObjects,
+            const bool detailedLandData,
+            Rasterizer_Metrics::Metric_prepareContext* const metric);
+        static uint64_t computeCoastlinesSignature(
+            const QList< std::shared_ptr<const OsmAnd::Model::MapObject> >& detailedmapCoastlineObjects,
+            const QList< std::shared_ptr<const OsmAnd::Model::MapObject> >& basemapCoastlineObjects,
+            const bool detailedLandData);
         static bool polygonizeCoastlines(
             const RasterizerEnvironment_P& env, const RasterizerContext_P& context,
             const QList< std::shared_ptr<const OsmAnd::Model::MapObject> >& coastlines,
@@ -94,6 +113,8 @@ namespace OsmAnd {
 
         enum {
             PolygonAreaCutoffLowerThreshold = 75,
+            SimplificationReferenceTileSize = 256,
+            CoastlinesCacheLevelVerticesLimit = 256 * 1024,
             BasemapZoom = 11,
             DetailedLandDataZoom = 14,
         };
@@ -125,6 +146,10 @@ namespace OsmAnd {
             QVector< std::shared_ptr<const Primitive> > polygons;
             QVector< std::shared_ptr<const Primitive> > polylines;
             QVector< std::shared_ptr<const Primitive> > points;
+
+            // Geometry of map object simplified for zoom of this group
+            QVector< PointI > points31;
+            QList< QVector< PointI > > innerPolygonsPoints31;
         };
 
         struct Primitive
@@ -155,6 +180,10 @@ namespace OsmAnd {
             const QList< std::shared_ptr<const OsmAnd::Model::MapObject> >& source,
             const IQueryController* const controller,
             Rasterizer_Metrics::Metric_prepareContext* const metric);
+        static void simplifyPrimitivesGroup(
+            const RasterizerContext_P& context,
+            PrimitivesGroup* const group,
+            Rasterizer_Metrics::Metric_prepareContext* const metric);
         static void sortAndFilterPrimitives(
             const RasterizerEnvironment_P& env, RasterizerContext_P& context);
         static void filterOutHighwaysByDensity(
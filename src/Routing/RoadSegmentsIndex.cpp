@@ -0,0 +1,248 @@
+#include "RoadSegmentsIndex.h"
+
+#include <cassert>
+#include <cmath>
+#include <queue>
+#include <algorithm>
+
+#include <OsmAndCore/QtExtensions.h>
+#include <QSet>
+
+#include "Road.h"
+#include "Utilities.h"
+
+OsmAnd::RoadSegmentsIndex::RoadSegmentsIndex( const QList< std::shared_ptr<const Model::Road> >& roads )
+{
+    _roads.reserve(roads.size());
+    for(auto itRoad = roads.cbegin(); itRoad != roads.cend(); ++itRoad)
+    {
+        const auto& road = *itRoad;
+        if(road->points.size() <= 1)
+            continue;
+
+        const uint32_t roadIndex = _roads.size();
+        _roads.push_back(road);
+
+        for(auto pointIdx = 1; pointIdx < road->points.size(); pointIdx++)
+        {
+            const auto& prevPoint = road->points[pointIdx - 1];
+            const auto& point = road->points[pointIdx];
+
+            Segment segment;
+            segment.roadIndex = roadIndex;
+            segment.pointIndex = pointIdx;
+            segment.bbox31.left = qMin(prevPoint.x, point.x);
+            segment.bbox31.right = qMax(prevPoint.x, point.x);
+            segment.bbox31.top = qMin(prevPoint.y, point.y);
+            segment.bbox31.bottom = qMax(prevPoint.y, point.y);
+            _segments.push_back(segment);
+        }
+    }
+
+    build();
+}
+
+OsmAnd::RoadSegmentsIndex::~RoadSegmentsIndex()
+{
+}
+
+void OsmAnd::RoadSegmentsIndex::build()
+{
+    if(_segments.isEmpty())
+        return;
+
+    // Leaf level: segments are sorted into vertical slices by X of center, and each slice by Y of center,
+    // so that every leaf covers a compact area
+    const auto centerX = [](const Segment& segment) -> int64_t
+        {
+            return static_cast<int64_t>(segment.bbox31.left) + segment.bbox31.right;
+        };
+    const auto centerY = [](const Segment& segment) -> int64_t
+        {
+            return static_cast<int64_t>(segment.bbox31.top) + segment.bbox31.bottom;
+        };
+    const auto segmentsCount = _segments.size();
+    const auto leavesCount = (segmentsCount + NodeCapacity - 1) / NodeCapacity;
+    const auto slicesCount = static_cast<int>(std::ceil(std::sqrt(static_cast<double>(leavesCount))));
+    const auto sliceSize = slicesCount * NodeCapacity;
+    std::sort(_segments.begin(), _segments.end(),
+        [centerX](const Segment& l, const Segment& r) -> bool
+        {
+            return centerX(l) < centerX(r);
+        });
+    for(auto sliceStart = 0; sliceStart < segmentsCount; sliceStart += sliceSize)
+    {
+        const auto sliceEnd = qMin(sliceStart + sliceSize, segmentsCount);
+        std::sort(_segments.begin() + sliceStart, _segments.begin() + sliceEnd,
+            [centerY](const Segment& l, const Segment& r) -> bool
+            {
+                return centerY(l) < centerY(r);
+            });
+    }
+
+    _nodes.reserve(leavesCount * 2);
+    for(auto firstSegment = 0; firstSegment < segmentsCount; firstSegment += NodeCapacity)
+    {
+        Node node;
+        node.isLeaf = true;
+        node.firstChild = firstSegment;
+        node.childrenCount = qMin<int>(NodeCapacity, segmentsCount - firstSegment);
+        node.bbox31 = _segments[firstSegment].bbox31;
+        for(auto idx = 1u; idx < node.childrenCount; idx++)
+            node.bbox31.enlarge(_segments[firstSegment + idx].bbox31);
+        _nodes.push_back(node);
+    }
+
+    // Upper levels: leaves are already spatially ordered, so consecutive nodes are simply grouped
+    auto levelStart = 0;
+    auto levelEnd = _nodes.size();
+    while(levelEnd - levelStart > 1)
+    {
+        for(auto firstChild = levelStart; firstChild < levelEnd; firstChild += NodeCapacity)
+        {
+            Node node;
+            node.isLeaf = false;
+            node.firstChild = firstChild;
+            node.childrenCount = qMin<int>(NodeCapacity, levelEnd - firstChild);
+            node.bbox31 = _nodes[firstChild].bbox31;
+            for(auto idx = 1u; idx < node.childrenCount; idx++)
+                node.bbox31.enlarge(_nodes[firstChild + idx].bbox31);
+            _nodes.push_back(node);
+        }
+
+        levelStart = levelEnd;
+        levelEnd = _nodes.size();
+    }
+}
+
+bool OsmAnd::RoadSegmentsIndex::isEmpty() const
+{
+    return _nodes.isEmpty();
+}
+
+unsigned int OsmAnd::RoadSegmentsIndex::findNearest(
+    const uint32_t x31, const uint32_t y31,
+    const unsigned int maxRoadsCount,
+    QList<Hit>& outHits,
+    const RoadFilter filter /*= nullptr*/ ) const
+{
+    if(_nodes.isEmpty() || maxRoadsCount == 0)
+        return 0;
+
+    // Best-first traversal: nodes are keyed by distance to their bbox, segments by exact distance.
+    // Since bbox distance never exceeds distance to anything inside it, segments are popped in order of distance
+    struct Entry
+    {
+        double sqDistance;
+        uint32_t index;
+        bool isSegment;
+        uint32_t x31;
+        uint32_t y31;
+
+        bool operator>(const Entry& r) const
+        {
+            return sqDistance > r.sqDistance;
+        }
+    };
+    std::priority_queue< Entry, std::vector<Entry>, std::greater<Entry> > queue;
+
+    Entry rootEntry;
+    rootEntry.index = _nodes.size() - 1;
+    rootEntry.sqDistance = _nodes[rootEntry.index].bbox31.sqDistanceTo(x31, y31);
+    rootEntry.isSegment = false;
+    queue.push(rootEntry);
+
+    QSet<uint32_t> processedRoads;
+    unsigned int hitsCount = 0;
+    while(!queue.empty() && hitsCount < maxRoadsCount)
+    {
+        const auto entry = queue.top();
+        queue.pop();
+
+        if(entry.isSegment)
+        {
+            const auto& segment = _segments[entry.index];
+            if(processedRoads.contains(segment.roadIndex))
+                continue;
+            processedRoads.insert(segment.roadIndex);
+
+            const auto& road = _roads[segment.roadIndex];
+            if(filter && !filter(road))
+                continue;
+
+            Hit hit;
+            hit.road = road;
+            hit.pointIndex = segment.pointIndex;
+            hit.sqDistance = entry.sqDistance;
+            hit.x31 = entry.x31;
+            hit.y31 = entry.y31;
+            outHits.push_back(hit);
+            hitsCount++;
+            continue;
+        }
+
+        const auto& node = _nodes[entry.index];
+        for(auto childIdx = node.firstChild; childIdx < node.firstChild + node.childrenCount; childIdx++)
+        {
+            Entry childEntry;
+            childEntry.index = childIdx;
+            childEntry.isSegment = node.isLeaf;
+            if(node.isLeaf)
+            {
+                const auto& segment = _segments[childIdx];
+                const auto& points = _roads[segment.roadIndex]->points;
+                childEntry.sqDistance = projectOnSegment(
+                    points[segment.pointIndex - 1], points[segment.pointIndex],
+                    x31, y31,
+                    childEntry.x31, childEntry.y31);
+            }
+            else
+                childEntry.sqDistance = _nodes[childIdx].bbox31.sqDistanceTo(x31, y31);
+            queue.push(childEntry);
+        }
+    }
+
+    return hitsCount;
+}
+
+double OsmAnd::RoadSegmentsIndex::projectOnSegment(
+    const PointI& a, const PointI& b,
+    const uint32_t x31, const uint32_t y31,
+    uint32_t& outX31, uint32_t& outY31 )
+{
+    const auto sqLength = Utilities::squareDistance31(b.x, b.y, a.x, a.y);
+    const auto projection = Utilities::projection31(a.x, a.y, b.x, b.y, x31, y31);
+    if(projection < 0)
+    {
+        outX31 = a.x;
+        outY31 = a.y;
+    }
+    else if(projection >= sqLength)
+    {
+        outX31 = b.x;
+        outY31 = b.y;
+    }
+    else
+    {
+        const auto factor = projection / sqLength;
+        outX31 = a.x + (b.x - a.x) * factor;
+        outY31 = a.y + (b.y - a.y) * factor;
+    }
+
+    return Utilities::squareDistance31(outX31, outY31, x31, y31);
+}
+
+void OsmAnd::RoadSegmentsIndex::BBox31::enlarge( const BBox31& other )
+{
+    left = qMin(left, other.left);
+    top = qMin(top, other.top);
+    right = qMax(right, other.right);
+    bottom = qMax(bottom, other.bottom);
+}
+
+double OsmAnd::RoadSegmentsIndex::BBox31::sqDistanceTo( const int32_t x31, const int32_t y31 ) const
+{
+    const auto dx = Utilities::x31toMeters(x31 < left ? left - x31 : (x31 > right ? x31 - right : 0));
+    const auto dy = Utilities::y31toMeters(y31 < top ? top - y31 : (y31 > bottom ? y31 - bottom : 0));
+    return dx * dx + dy * dy;
+}
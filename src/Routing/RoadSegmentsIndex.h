@@ -0,0 +1,120 @@
+/**
+* @file
+*
+* @section LICENSE
+*
+* OsmAnd - Android navigation software based on OSM maps.
+* Copyright (C) 2010-2013  OsmAnd Authors listed in AUTHORS file
+*
+* This program is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+
+* You should have received a copy of the GNU General Public License
+* along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef _OSMAND_CORE_ROAD_SEGMENTS_INDEX_H_
+#define _OSMAND_CORE_ROAD_SEGMENTS_INDEX_H_
+
+#include <OsmAndCore/stdlib_common.h>
+#include <functional>
+
+#include <OsmAndCore/QtExtensions.h>
+#include <QList>
+#include <QVector>
+
+#include <OsmAndCore.h>
+#include <CommonTypes.h>
+
+namespace OsmAnd {
+
+    namespace Model {
+        class Road;
+    }
+
+    // Packed R-tree over segments of roads, bulk-loaded using Sort-Tile-Recursive algorithm.
+    // Index is immutable: it's rebuilt from scratch if set of roads changes
+    class RoadSegmentsIndex
+    {
+        Q_DISABLE_COPY(RoadSegmentsIndex);
+    public:
+        struct Hit
+        {
+            std::shared_ptr<const Model::Road> road;
+            // Index of end point of closest segment
+            uint32_t pointIndex;
+            double sqDistance;
+            // Projection of query point on closest segment
+            uint32_t x31;
+            uint32_t y31;
+        };
+        typedef std::function<bool (const std::shared_ptr<const Model::Road>& road)> RoadFilter;
+    private:
+        enum {
+            NodeCapacity = 16,
+        };
+
+        struct BBox31
+        {
+            int32_t left;
+            int32_t top;
+            int32_t right;
+            int32_t bottom;
+
+            void enlarge(const BBox31& other);
+            double sqDistanceTo(const int32_t x31, const int32_t y31) const;
+        };
+
+        struct Segment
+        {
+            BBox31 bbox31;
+            uint32_t roadIndex;
+            uint32_t pointIndex;
+        };
+
+        struct Node
+        {
+            BBox31 bbox31;
+            uint32_t firstChild;
+            uint32_t childrenCount;
+            bool isLeaf;
+        };
+
+        QVector< std::shared_ptr<const Model::Road> > _roads;
+        QVector< Segment > _segments;
+        // Nodes are stored level by level, root is the last one
+        QVector< Node > _nodes;
+
+        void build();
+    protected:
+    public:
+        RoadSegmentsIndex(const QList< std::shared_ptr<const Model::Road> >& roads);
+        virtual ~RoadSegmentsIndex();
+
+        bool isEmpty() const;
+
+        // Finds up to maxRoadsCount closest roads (each reported once, by its closest segment), sorted by distance.
+        // Roads rejected by filter are skipped. Returns number of hits appended to outHits
+        unsigned int findNearest(
+            const uint32_t x31, const uint32_t y31,
+            const unsigned int maxRoadsCount,
+            QList<Hit>& outHits,
+            const RoadFilter filter = nullptr) const;
+
+        // Returns square distance (in meters) from point to segment [a, b] and point of projection
+        static double projectOnSegment(
+            const PointI& a, const PointI& b,
+            const uint32_t x31, const uint32_t y31,
+            uint32_t& outX31, uint32_t& outY31);
+    };
+
+} // namespace OsmAnd
+
+#endif // _OSMAND_CORE_ROAD_SEGMENTS_INDEX_H_
@@ -14,6 +14,9 @@
 #include "Logging.h"
 #include "Utilities.h"
 #include "PlainQueryFilter.h"
+#include "Concurrent.h"
+#include "RoadSegmentsIndex.h"
+#include "RoutingTilesPrefetcher.h"
 
 OsmAnd::RoutePlanner::RoutePlanner()
 {
@@ -30,80 +33,169 @@ bool OsmAnd::RoutePlanner::findClosestRoadPoint(
     uint32_t* closestPointIndex /*= nullptr*/,
     double* sqDistanceToClosestPoint /*= nullptr*/,
     uint32_t* _rx31 /*= nullptr*/, uint32_t* _ry31 /*= nullptr*/ )
+{
+    QList<ClosestRoadPoint> closestPoints;
+    if(!findClosestRoadPoints(context, latitude, longitude, 1, closestPoints))
+        return false;
+
+    const auto& closestPoint = closestPoints.first();
+    if(closestRoad)
+        *closestRoad = closestPoint.road;
+    if(closestPointIndex)
+        *closestPointIndex = closestPoint.pointIndex;
+    if(sqDistanceToClosestPoint)
+        *sqDistanceToClosestPoint = closestPoint.sqDistance;
+    if(_rx31)
+        *_rx31 = closestPoint.x31;
+    if(_ry31)
+        *_ry31 = closestPoint.y31;
+    return true;
+}
+
+bool OsmAnd::RoutePlanner::findClosestRoadPoints(
+    OsmAnd::RoutePlannerContext* context,
+    double latitude, double longitude,
+    unsigned int maxRoadsCount,
+    QList<ClosestRoadPoint>& outPoints,
+    const std::function<bool (const std::shared_ptr<const OsmAnd::Model::Road>& road)>& filter /*= nullptr*/ )
 {
     const auto x31 = Utilities::get31TileNumberX(longitude);
     const auto y31 = Utilities::get31TileNumberY(latitude);
 
-    QList< std::shared_ptr<const Model::Road> > roads;
-    loadRoads(context, x31, y31, 17, roads);
-    if(roads.isEmpty())
-        loadRoads(context, x31, y31, 15, roads);
+    if(findClosestRoadPointsAround(context, x31, y31, 17, maxRoadsCount, outPoints, filter) > 0)
+        return true;
+    return findClosestRoadPointsAround(context, x31, y31, 15, maxRoadsCount, outPoints, filter) > 0;
+}
+
+unsigned int OsmAnd::RoutePlanner::snapToRoads(
+    OsmAnd::RoutePlannerContext* context,
+    const QList< std::pair<double, double> >& points,
+    QVector<ClosestRoadPoint>& outPoints,
+    const std::function<bool (const std::shared_ptr<const OsmAnd::Model::Road>& road)>& filter /*= nullptr*/ )
+{
+    outPoints.fill(ClosestRoadPoint(), points.size());
+
+    // Process points tile by tile, so that loaded tiles and built indices are reused
+    // by consecutive queries and are not evicted in between
+    QVector< std::pair<uint64_t, int> > order;
+    order.reserve(points.size());
+    for(auto pointIdx = 0; pointIdx < points.size(); pointIdx++)
+    {
+        const auto& point = points[pointIdx];
+        const auto x31 = Utilities::get31TileNumberX(point.second);
+        const auto y31 = Utilities::get31TileNumberY(point.first);
+        order.push_back(std::make_pair(getRoutingTileId(context, x31, y31, true), pointIdx));
+    }
+    qSort(order);
 
-    std::shared_ptr<const OsmAnd::Model::Road> minDistanceRoad;
-    uint32_t minDistancePointIdx;
-    double minSqDistance = std::numeric_limits<double>::max();
-    uint32_t min31x, min31y;
-    for(auto itRoad = roads.cbegin(); itRoad != roads.cend(); ++itRoad)
+    unsigned int snappedCount = 0;
+    QList<ClosestRoadPoint> closestPoints;
+    for(auto itEntry = order.cbegin(); itEntry != order.cend(); ++itEntry)
     {
-        auto road = *itRoad;
-        if(road->points.size() <= 1)
+        const auto pointIdx = itEntry->second;
+        const auto& point = points[pointIdx];
+
+        closestPoints.clear();
+        if(!findClosestRoadPoints(context, point.first, point.second, 1, closestPoints, filter))
             continue;
 
-        for(auto idx = 1; idx < road->points.size(); idx++)
-        {
-            const auto& cpx31 = road->points[idx].x;
-            const auto& cpy31 = road->points[idx].y;
-            const auto& ppx31 = road->points[idx - 1].x;
-            const auto& ppy31 = road->points[idx - 1].y;
+        outPoints[pointIdx] = closestPoints.first();
+        snappedCount++;
+    }
 
-            auto sqDistance = Utilities::squareDistance31(cpx31, cpy31, ppx31, ppy31);
+    return snappedCount;
+}
 
-            uint32_t rx31;
-            uint32_t ry31;
-            auto projection = Utilities::projection31(ppx31, ppy31, cpx31, cpy31, x31, y31);
-            if (projection < 0)
-            {
-                rx31 = ppx31;
-                ry31 = ppy31;
-            }
-            else if (projection >= sqDistance)
-            {
-                rx31 = cpx31;
-                ry31 = cpy31;
-            }
-            else
+unsigned int OsmAnd::RoutePlanner::findClosestRoadPointsAround(
+    RoutePlannerContext* context,
+    uint32_t x31, uint32_t y31,
+    uint32_t zoomAround,
+    unsigned int maxRoadsCount,
+    QList<ClosestRoadPoint>& outPoints,
+    const std::function<bool (const std::shared_ptr<const Model::Road>& road)>& filter )
+{
+    QList<ClosestRoadPoint> candidates;
+    QSet<const RoutePlannerContext::RoutingSubsectionContext*> processedSubsections;
+    QList<RoadSegmentsIndex::Hit> hits;
+    // Each tile is queried right after it was loaded, since loading of next tile may unload previous ones
+    visitRoutingTilesAround(context, x31, y31, zoomAround,
+        [&](const uint64_t tileId)
+        {
+            // Roads of loaded subsections are looked up in their segment indices
+            const auto itIndexedSubsectionContexts = context->_indexedSubsectionsContexts.constFind(tileId);
+            assert(itIndexedSubsectionContexts != context->_indexedSubsectionsContexts.cend());
+            for(auto itSubsectionContext = itIndexedSubsectionContexts->cbegin(); itSubsectionContext != itIndexedSubsectionContexts->cend(); ++itSubsectionContext)
             {
-                const auto& factor = projection / sqDistance;
-                rx31 = ppx31 + (cpx31 - ppx31) * factor;
-                ry31 = ppy31 + (cpy31 - ppy31) * factor;
+                const auto& subsectionContext = *itSubsectionContext;
+                if(processedSubsections.contains(subsectionContext.get()))
+                    continue;
+                processedSubsections.insert(subsectionContext.get());
+
+                hits.clear();
+                subsectionContext->obtainSegmentsIndex()->findNearest(x31, y31, maxRoadsCount, hits, filter);
+                for(auto itHit = hits.cbegin(); itHit != hits.cend(); ++itHit)
+                {
+                    const auto& hit = *itHit;
+
+                    ClosestRoadPoint candidate;
+                    candidate.road = hit.road;
+                    candidate.pointIndex = hit.pointIndex;
+                    candidate.sqDistance = hit.sqDistance;
+                    candidate.x31 = hit.x31;
+                    candidate.y31 = hit.y31;
+                    candidates.push_back(candidate);
+                }
             }
-            sqDistance = Utilities::squareDistance31(rx31, ry31, x31, y31);
-            if (!road || sqDistance < minSqDistance)
+
+            // Few roads cached in tile (split by previous snapping) are checked directly
+            const auto itRoadsInTile = context->_cachedRoadsInTiles.constFind(tileId);
+            if(itRoadsInTile == context->_cachedRoadsInTiles.cend())
+                return;
+            for(auto itRoad = itRoadsInTile->cbegin(); itRoad != itRoadsInTile->cend(); ++itRoad)
             {
-                minDistanceRoad = road;
-                minDistancePointIdx = idx;
-                minSqDistance = sqDistance;
-                min31x = rx31;
-                min31y = ry31;
+                const std::shared_ptr<const Model::Road> road = *itRoad;
+                if(road->points.size() <= 1 || (filter && !filter(road)))
+                    continue;
+
+                ClosestRoadPoint candidate;
+                candidate.road = road;
+                for(auto pointIdx = 1; pointIdx < road->points.size(); pointIdx++)
+                {
+                    uint32_t rx31;
+                    uint32_t ry31;
+                    const auto sqDistance = RoadSegmentsIndex::projectOnSegment(road->points[pointIdx - 1], road->points[pointIdx], x31, y31, rx31, ry31);
+                    if(sqDistance >= candidate.sqDistance)
+                        continue;
+
+                    candidate.pointIndex = pointIdx;
+                    candidate.sqDistance = sqDistance;
+                    candidate.x31 = rx31;
+                    candidate.y31 = ry31;
+                }
+                candidates.push_back(candidate);
             }
-        }
-    }
+        });
 
-    if (minDistanceRoad)
+    // Same road may come from several subsections or tiles, so keep only its closest occurrence
+    qStableSort(candidates.begin(), candidates.end(),
+        [](const ClosestRoadPoint& l, const ClosestRoadPoint& r) -> bool
+        {
+            return l.sqDistance < r.sqDistance;
+        });
+    QSet<uint64_t> reportedRoads;
+    unsigned int pointsCount = 0;
+    for(auto itCandidate = candidates.cbegin(); itCandidate != candidates.cend() && pointsCount < maxRoadsCount; ++itCandidate)
     {
-        if(closestRoad)
-            *closestRoad = minDistanceRoad;
-        if(closestPointIndex)
-            *closestPointIndex = minDistancePointIdx;
-        if(sqDistanceToClosestPoint)
-            *sqDistanceToClosestPoint = minSqDistance;
-        if(_rx31)
-            *_rx31 = min31x;
-        if(_ry31)
-            *_ry31 = min31y;
-        return true;
+        const auto& candidate = *itCandidate;
+        if(reportedRoads.contains(candidate.road->id))
+            continue;
+        reportedRoads.insert(candidate.road->id);
+
+        outPoints.push_back(candidate);
+        pointsCount++;
     }
-    return false;
+
+    return pointsCount;
 }
 
 bool OsmAnd::RoutePlanner::findClosestRouteSegment( OsmAnd::RoutePlannerContext* context, double latitude, double longitude, std::shared_ptr<OsmAnd::RoutePlannerContext::RouteCalculationSegment>& routeSegment )
@@ -146,6 +238,15 @@ void OsmAnd::RoutePlanner::cacheRoad( RoutePlannerContext* context, const std::s
 }
 
 void OsmAnd::RoutePlanner::loadRoads( RoutePlannerContext* context, uint32_t x31, uint32_t y31, uint32_t zoomAround, QList< std::shared_ptr<const Model::Road> >& roads )
+{
+    visitRoutingTilesAround(context, x31, y31, zoomAround,
+        [context, &roads](const uint64_t tileId)
+        {
+            loadRoadsFromTile(context, tileId, roads);
+        });
+}
+
+void OsmAnd::RoutePlanner::visitRoutingTilesAround( RoutePlannerContext* context, uint32_t x31, uint32_t y31, uint32_t zoomAround, const std::function<void (const uint64_t tileId)>& visitor )
 {
     auto coordinatesShift = 1 << (31 - context->_roadTilesLoadingZoomLevel);
     uint32_t t;
@@ -167,7 +268,7 @@ void OsmAnd::RoutePlanner::loadRoads( RoutePlannerContext* context, uint32_t x31
             auto tileId = getRoutingTileId(context, x31+i*coordinatesShift, y31+j*coordinatesShift, false);
             if(processedTiles.contains(tileId))
                 continue;
-            loadRoadsFromTile(context, tileId, roads);
+            visitor(tileId);
             processedTiles.insert(tileId);
         }
     }
@@ -309,16 +410,42 @@ void OsmAnd::RoutePlanner::loadSubregionContext( RoutePlannerContext::RoutingSub
         context->owner->_routeStatistics->timeToLoadBegin = std::chrono::steady_clock::now();
     }
     context->markLoaded();
-    ObfRoutingSectionReader::loadSubsectionData(context->origin, context->subsection, nullptr, nullptr, nullptr,
-        [=] (const std::shared_ptr<const OsmAnd::Model::Road>& road)
+
+    // Use roads decoded in background if subsection was prefetched, and read them in place otherwise
+    QList< std::shared_ptr<const Model::Road> > prefetchedRoads;
+    bool prefetchDropped = false;
+    const auto& prefetcher = context->owner->_tilesPrefetcher;
+    if(prefetcher && prefetcher->take(context->subsection.get(), prefetchedRoads, &prefetchDropped))
+    {
+        for(auto itRoad = prefetchedRoads.cbegin(); itRoad != prefetchedRoads.cend(); ++itRoad)
         {
+            const auto& road = *itRoad;
             if(!context->owner->profileContext->acceptsRoad(road))
-                return false;
+                continue;
 
             context->registerRoad(road);
-            return false;
         }
-    );
+
+        if(context->owner->_routeStatistics)
+            context->owner->_routeStatistics->prefetchHits++;
+    }
+    else
+    {
+        // Subsection that was still queued is read in place, so its prefetch is wasted
+        if(prefetchDropped && context->owner->_routeStatistics)
+            context->owner->_routeStatistics->prefetchWasted++;
+
+        ObfRoutingSectionReader::loadSubsectionData(context->origin, context->subsection, nullptr, nullptr, nullptr,
+            [=] (const std::shared_ptr<const OsmAnd::Model::Road>& road)
+            {
+                if(!context->owner->profileContext->acceptsRoad(road))
+                    return false;
+
+                context->registerRoad(road);
+                return false;
+            }
+        );
+    }
 
     if(context->owner->_routeStatistics) {
         context->owner->_routeStatistics->timeToLoad += (uint64_t) (
@@ -335,6 +462,81 @@ void OsmAnd::RoutePlanner::loadSubregionContext( RoutePlannerContext::RoutingSub
     }
 }
 
+void OsmAnd::RoutePlanner::prefetchRoutingTiles( RoutePlannerContext::CalculationContext* context, const PointI& frontierPoint, const PointI& goalPoint )
+{
+    const auto owner = context->owner;
+    const auto& prefetcher = owner->_tilesPrefetcher;
+    if(!prefetcher)
+        return;
+
+    const auto tileSize31 = 1u << (31 - owner->_roadTilesLoadingZoomLevel);
+    const double dx = static_cast<double>(goalPoint.x) - frontierPoint.x;
+    const double dy = static_cast<double>(goalPoint.y) - frontierPoint.y;
+    const auto length = qSqrt(dx*dx + dy*dy);
+    // Tiles around goal are loaded by search itself
+    if(length < tileSize31)
+        return;
+
+    // Corridor is made of tiles along straight line from frontier to its goal, widened by one tile to each side
+    QSet<uint64_t> corridorTilesIds;
+    for(auto step = 1u; step <= owner->_prefetchTilesAhead; step++)
+    {
+        const auto ratio = qMin(1.0, (step * tileSize31) / length);
+        const auto x31 = frontierPoint.x + dx * ratio;
+        const auto y31 = frontierPoint.y + dy * ratio;
+
+        for(auto xShift = -1; xShift <= 1; xShift++)
+        {
+            for(auto yShift = -1; yShift <= 1; yShift++)
+            {
+                const auto shiftedX31 = x31 + xShift * static_cast<double>(tileSize31);
+                const auto shiftedY31 = y31 + yShift * static_cast<double>(tileSize31);
+                if(shiftedX31 < 0 || shiftedY31 < 0 || shiftedX31 >= std::numeric_limits<int32_t>::max() || shiftedY31 >= std::numeric_limits<int32_t>::max())
+                    continue;
+                const auto tileX31 = static_cast<uint32_t>(shiftedX31);
+                const auto tileY31 = static_cast<uint32_t>(shiftedY31);
+
+                const auto tileId = getRoutingTileId(owner, tileX31, tileY31, true);
+                if(corridorTilesIds.contains(tileId))
+                    continue;
+                corridorTilesIds.insert(tileId);
+
+                auto itIndexedSubsectionContexts = owner->_indexedSubsectionsContexts.constFind(tileId);
+                if(itIndexedSubsectionContexts == owner->_indexedSubsectionsContexts.cend())
+                {
+                    QList< std::shared_ptr<RoutePlannerContext::RoutingSubsectionContext> > subsectionContexts;
+                    loadTileHeader(owner, tileX31, tileY31, subsectionContexts);
+                    itIndexedSubsectionContexts = owner->_indexedSubsectionsContexts.insert(tileId, subsectionContexts);
+                }
+
+                for(auto itSubsectionContext = itIndexedSubsectionContexts->cbegin(); itSubsectionContext != itIndexedSubsectionContexts->cend(); ++itSubsectionContext)
+                {
+                    const auto& subsectionContext = *itSubsectionContext;
+                    if(subsectionContext->isLoaded())
+                        continue;
+
+                    if(prefetcher->prefetch(subsectionContext->origin, subsectionContext->subsection) && owner->_routeStatistics)
+                        owner->_routeStatistics->prefetchedTiles++;
+                }
+            }
+        }
+
+        if(ratio >= 1.0)
+            break;
+    }
+}
+
+void OsmAnd::RoutePlanner::cancelTilesPrefetch( RoutePlannerContext::CalculationContext* context )
+{
+    const auto& prefetcher = context->owner->_tilesPrefetcher;
+    if(!prefetcher)
+        return;
+
+    const auto wastedCount = prefetcher->cancel();
+    if(context->owner->_routeStatistics)
+        context->owner->_routeStatistics->prefetchWasted += wastedCount;
+}
+
 OsmAnd::RouteCalculationResult OsmAnd::RoutePlanner::calculateRoute(
     OsmAnd::RoutePlannerContext* context,
     const QList< std::pair<double, double> >& points,
@@ -438,6 +640,71 @@ OsmAnd::RouteCalculationResult OsmAnd::RoutePlanner::calculateRoute(
     return calculateRoute(calculationContext.get(), routeCalculationSegments[0], routeCalculationSegments[1], leftSideNavigation, controller);
 }
 
+OsmAnd::RouteCalculationResult OsmAnd::RoutePlanner::recalculateRoute(
+    OsmAnd::RoutePlannerContext* context,
+    double latitude,
+    double longitude,
+    bool leftSideNavigation,
+    const IQueryController* const controller /*= nullptr*/)
+{
+    assert(context != nullptr);
+
+    const auto previousRoute = context->_previouslyCalculatedRoute;
+    if(previousRoute.isEmpty())
+        return OsmAnd::RouteCalculationResult("There is no previously calculated route");
+
+    // Part of previous route before its point closest to new position is already passed
+    const PointI position31(Utilities::get31TileNumberX(longitude), Utilities::get31TileNumberY(latitude));
+    auto closestSegmentIdx = 0;
+    auto closestDistance = std::numeric_limits<double>::max();
+    for(int segmentIdx = 0; segmentIdx < previousRoute.size(); segmentIdx++)
+    {
+        const auto& segment = previousRoute[segmentIdx];
+        const auto positive = segment->startPointIndex < segment->endPointIndex;
+        for(auto pointIdx = segment->startPointIndex; ; positive ? pointIdx++ : pointIdx--)
+        {
+            const auto distance = Utilities::distance31(position31, segment->road->points[pointIdx]);
+            if(distance < closestDistance)
+            {
+                closestDistance = distance;
+                closestSegmentIdx = segmentIdx;
+            }
+            if(pointIdx == segment->endPointIndex)
+                break;
+        }
+    }
+
+    const auto& lastSegment = previousRoute.last();
+    const auto& target31 = lastSegment->road->points[lastSegment->endPointIndex];
+    std::shared_ptr<RoutePlannerContext::RouteCalculationSegment> from;
+    if(!findClosestRouteSegment(context, latitude, longitude, from))
+        return OsmAnd::RouteCalculationResult("Start point was not found");
+    std::shared_ptr<RoutePlannerContext::RouteCalculationSegment> to;
+    if(!findClosestRouteSegment(context, Utilities::get31LatitudeY(target31.y), Utilities::get31LongitudeX(target31.x), to))
+        return OsmAnd::RouteCalculationResult("End point was not found");
+
+    context->_previouslyCalculatedRoute = previousRoute.mid(closestSegmentIdx);
+    std::unique_ptr<RoutePlannerContext::CalculationContext> calculationContext(new RoutePlannerContext::CalculationContext(context));
+    calculationContext->_partialRecalculation = true;
+    auto result = calculateRoute(calculationContext.get(), from, to, leftSideNavigation, controller);
+    if(!result.list.isEmpty() || !calculationContext->_partialRecalculation || (controller && controller->isAborted()))
+    {
+        if(result.list.isEmpty())
+            context->_previouslyCalculatedRoute = previousRoute;
+        return result;
+    }
+
+    // Rest of previous route was not reached (or can not be joined), so calculate whole route
+    LogPrintf(LogSeverityLevel::Debug, "Partial route recalculation failed (%s), calculating whole route", qPrintable(result.warnMessage));
+    from.reset(new RoutePlannerContext::RouteCalculationSegment(from->road, from->pointIndex));
+    to.reset(new RoutePlannerContext::RouteCalculationSegment(to->road, to->pointIndex));
+    calculationContext.reset(new RoutePlannerContext::CalculationContext(context));
+    result = calculateRoute(calculationContext.get(), from, to, leftSideNavigation, controller);
+    if(result.list.isEmpty())
+        context->_previouslyCalculatedRoute = previousRoute;
+    return result;
+}
+
 void OsmAnd::RoutePlanner::printDebugInformation(OsmAnd::RoutePlannerContext::CalculationContext* ctx, int directSegmentSize, int reverseSegmentSize,
            std::shared_ptr<RoutePlannerContext::RouteCalculationSegment> finalSegment) {
 
@@ -451,6 +718,8 @@ void OsmAnd::RoutePlanner::printDebugInformation(OsmAnd::RoutePlannerContext::Ca
         LogPrintf(LogSeverityLevel::Debug, "Current loaded tiles %d, maximum %d : " , ctx->owner->getCurrentlyLoadedTiles(), st->maxLoadedTiles);
                 LogPrintf(LogSeverityLevel::Debug, "Loaded tiles %u (distinct %u), unloaded tiles %u, loaded more than once same tiles %u",
                           st->loadedTiles, st->distinctLoadedTiles, st->unloadedTiles, st->loadedPrevUnloadedTiles);
+        LogPrintf(LogSeverityLevel::Debug, "Prefetched tiles %u, used %u, wasted %u",
+            st->prefetchedTiles, st->prefetchHits, st->prefetchWasted);
         LogPrintf(LogSeverityLevel::Debug, "D-Queue size %d, R-Queue size %d", directSegmentSize, reverseSegmentSize);
         LogPrintf(LogSeverityLevel::Debug, "Routing calculated time distance %f", finalSegment->_distanceFromStart);
         LogFlush();
@@ -480,6 +749,9 @@ OsmAnd::RouteCalculationResult OsmAnd::RoutePlanner::calculateRoute(
        context->owner->_routeStatistics->timeToCalculate = 0;
        context->owner->_routeStatistics->forwardIterations = 0;
        context->owner->_routeStatistics->backwardIterations = 0;
+       context->owner->_routeStatistics->prefetchedTiles = 0;
+       context->owner->_routeStatistics->prefetchHits = 0;
+       context->owner->_routeStatistics->prefetchWasted = 0;
        context->owner->_routeStatistics->timeToCalculateBegin = std::chrono::steady_clock::now();
     }
 
@@ -521,6 +793,7 @@ OsmAnd::RouteCalculationResult OsmAnd::RoutePlanner::calculateRoute(
     
     auto to = to_;
     const auto runRecalculation = checkPartialRecalculationPossible(context, visitedOppositeSegments, to);
+    context->_partialRecalculation = runRecalculation;
     
     // for start : f(start) = g(start) + h(start) = 0 + h(start) = h(start)
     auto estimatedDistance = estimateTimeDistance(context, context->_targetPoint, context->_startPoint);
@@ -534,6 +807,13 @@ OsmAnd::RouteCalculationResult OsmAnd::RoutePlanner::calculateRoute(
     graphDirectSegments.push(from);
     graphReverseSegments.push(to);
 
+    // Start decoding tiles that both searches are heading to, and refresh that corridor as frontiers move
+    static const uint32_t tilesPrefetchInterval = 64;
+    uint32_t iterationsCount = 0;
+    prefetchRoutingTiles(context, context->_startPoint, context->_targetPoint);
+    if(!runRecalculation)
+        prefetchRoutingTiles(context, context->_targetPoint, context->_startPoint);
+
     // Extract & analyze segment with min(f(x)) from queue while final segment is not found
     bool reverseSearch = false;
     bool initialized = false;
@@ -648,6 +928,17 @@ OsmAnd::RouteCalculationResult OsmAnd::RoutePlanner::calculateRoute(
 
         pGraphSegments = reverseSearch ? &graphReverseSegments : &graphDirectSegments;
 
+        if(++iterationsCount % tilesPrefetchInterval == 0)
+        {
+            const auto& directTop = graphDirectSegments.top();
+            prefetchRoutingTiles(context, directTop->road->points[directTop->pointIndex], context->_targetPoint);
+            if(!runRecalculation)
+            {
+                const auto& reverseTop = graphReverseSegments.top();
+                prefetchRoutingTiles(context, reverseTop->road->points[reverseTop->pointIndex], context->_startPoint);
+            }
+        }
+
         // Check if route calculation has been aborted
         if(controller && controller->isAborted())
             return OsmAnd::RouteCalculationResult("Aborted");
@@ -655,9 +946,28 @@ OsmAnd::RouteCalculationResult OsmAnd::RoutePlanner::calculateRoute(
 
     if(!finalSegment)
         return OsmAnd::RouteCalculationResult("Route could not be calculated");
+    cancelTilesPrefetch(context);
     printDebugInformation(context, graphDirectSegments.size(), graphReverseSegments.size(), finalSegment);
 
-    return prepareResult(context, finalSegment, leftSideNavigation);
+    // Length of previous route reused after the point where forward search has reached it
+    auto reusedDistance = 0.0f;
+    if(runRecalculation)
+    {
+        const auto& opposite = dynamic_cast<RoutePlannerContext::RouteCalculationFinalSegment*>(finalSegment.get())->opposite;
+        auto startPointIndex = opposite->parentEndPointIndex;
+        for(auto segment = opposite->parent; segment; segment = segment->parent)
+        {
+            const auto positive = startPointIndex < segment->pointIndex;
+            for(auto pointIdx = startPointIndex; pointIdx != segment->pointIndex; positive ? pointIdx++ : pointIdx--)
+                reusedDistance += Utilities::distance31(segment->road->points[pointIdx], segment->road->points[positive ? pointIdx + 1 : pointIdx - 1]);
+            startPointIndex = segment->parentEndPointIndex;
+        }
+    }
+
+    auto result = prepareResult(context, finalSegment, leftSideNavigation);
+    if(!result.list.isEmpty())
+        result.reusedDistance = reusedDistance;
+    return result;
 }
 
 void OsmAnd::RoutePlanner::loadBorderPoints( OsmAnd::RoutePlannerContext::CalculationContext* context )
@@ -1295,9 +1605,17 @@ bool OsmAnd::RoutePlanner::checkPartialRecalculationPossible(
     QMap<uint64_t, std::shared_ptr<RoutePlannerContext::RouteCalculationSegment> >& visitedOppositeSegments,
     std::shared_ptr<RoutePlannerContext::RouteCalculationSegment>& outSegment)
 {
+    if(!context->_partialRecalculation)
+        return false;
     if(context->owner->_previouslyCalculatedRoute.isEmpty() || qFuzzyCompare(context->owner->_partialRecalculationDistanceLimit, 0))
         return false;
 
+    // Previous route should lead to the same target
+    const auto& lastPrevRouteSegment = context->owner->_previouslyCalculatedRoute.last();
+    const auto& prevTarget31 = lastPrevRouteSegment->road->points[lastPrevRouteSegment->endPointIndex];
+    if(Utilities::distance31(prevTarget31, outSegment->road->points[outSegment->pointIndex]) > 1.0)
+        return false;
+
     QList< std::shared_ptr<RouteSegment> > filteredPreviousRoute;
     auto threshold = 0.0f;
     for(auto itPrevRouteSegment = context->owner->_previouslyCalculatedRoute.cbegin(); itPrevRouteSegment != context->owner->_previouslyCalculatedRoute.cend(); ++itPrevRouteSegment)
@@ -1312,31 +1630,60 @@ bool OsmAnd::RoutePlanner::checkPartialRecalculationPossible(
 
     if(filteredPreviousRoute.isEmpty())
         return false;
-    
-    return false;
-    /*
-    TODO:
-    std::shared_ptr<RoutePlannerContext::RouteCalculationSegment> previousSegment;
-    for(auto itPrevRouteSegment = filteredPreviousRoute.cbegin(); itPrevRouteSegment != filteredPreviousRoute.cend(); ++itPrevRouteSegment)
-    {
-        auto prevRouteSegment = *itPrevRouteSegment;
 
-        std::shared_ptr<RoutePlannerContext::RouteCalculationSegment> segment(new RoutePlannerContext::RouteCalculationSegment(prevRouteSegment.getObject(), prevRouteSegment.getEndPointIndex()));
-        
-        if(previousSegment)
+    // Rest of previous route is registered as already visited by reverse search: every point of it is linked
+    // to the target through the chain of previous route segments, and time to target is known.
+    // So forward search is finished as soon as it reaches any point of previous route
+    std::shared_ptr<RoutePlannerContext::RouteCalculationSegment> nextSegment;
+    uint32_t nextSegmentStartPointIndex = 0;
+    auto timeToTarget = 0.0f;
+    for(auto itPrevRouteSegment = filteredPreviousRoute.cend(); itPrevRouteSegment != filteredPreviousRoute.cbegin(); )
+    {
+        const auto& prevRouteSegment = *(--itPrevRouteSegment);
+        const auto& road = prevRouteSegment->road;
+        const auto positive = prevRouteSegment->startPointIndex < prevRouteSegment->endPointIndex;
+
+        std::shared_ptr<RoutePlannerContext::RouteCalculationSegment> segment(new RoutePlannerContext::RouteCalculationSegment(road, prevRouteSegment->endPointIndex));
+        segment->_parent = nextSegment;
+        segment->_parentEndPointIndex = nextSegmentStartPointIndex;
+        segment->_distanceFromStart = timeToTarget;
+        if(!nextSegment)
+            outSegment = segment;
+
+        auto segmentLength = 0.0f;
+        for(auto pointIdx = prevRouteSegment->startPointIndex; pointIdx != prevRouteSegment->endPointIndex; positive ? pointIdx++ : pointIdx--)
+            segmentLength += Utilities::distance31(road->points[pointIdx], road->points[positive ? pointIdx + 1 : pointIdx - 1]);
+
+        // Walk segment from its end to start, so that closest to target entry is kept for each interval
+        auto distanceToSegmentEnd = 0.0f;
+        for(auto pointIdx = prevRouteSegment->endPointIndex; pointIdx != prevRouteSegment->startPointIndex; positive ? pointIdx-- : pointIdx++)
         {
-            previousSegment.setParentRoute(segment);
-            previousSegment.setParentSegmentEnd(prevRouteSegment.getStartPointIndex());
-            boolean positive = rr.getStartPointIndex() < rr.getEndPointIndex();
-            long t = calculateRoutePointId(rr.getObject(), positive ? rr.getEndPointIndex() - 1 : rr.getEndPointIndex(),
-                positive);
-            visitedOppositeSegments.put(t, segment);
+            const auto intervalId = positive ? pointIdx - 1 : pointIdx;
+            const auto id = encodeRoutePointId(road, intervalId, !positive);
+            if(!visitedOppositeSegments.contains(id))
+            {
+                auto entry = segment;
+                if(pointIdx != prevRouteSegment->endPointIndex)
+                {
+                    entry.reset(new RoutePlannerContext::RouteCalculationSegment(road, pointIdx));
+                    entry->_parent = segment;
+                    entry->_parentEndPointIndex = pointIdx;
+                    entry->_distanceFromStart = timeToTarget;
+                    if(segmentLength > 0.0f)
+                        entry->_distanceFromStart += prevRouteSegment->time * distanceToSegmentEnd / segmentLength;
+                }
+                visitedOppositeSegments.insert(id, entry);
+            }
+
+            distanceToSegmentEnd += Utilities::distance31(road->points[pointIdx], road->points[positive ? pointIdx - 1 : pointIdx + 1]);
         }
 
-        previousSegment = segment;
+        nextSegment = segment;
+        nextSegmentStartPointIndex = prevRouteSegment->startPointIndex;
+        timeToTarget += prevRouteSegment->time;
     }
-    outSegment = previousSegment;
-    return true;*/
+
+    return true;
 }
 
 void OsmAnd::RoutePlanner::updateDistanceForBorderPoints( RoutePlannerContext::CalculationContext* context, const PointI& sPoint, bool isDistanceToStart )
@@ -1494,3 +1841,1404 @@ double OsmAnd::RoutePlanner::h(
     auto res = distanceToFinalPoint / context->owner->profileContext->profile->maxDefaultSpeed;
     return res;
 }
+
+struct OsmAnd::RoutePlanner::RouteMatrixGraph
+{
+    struct RoadInfo
+    {
+        bool forwardAllowed;
+        bool backwardAllowed;
+        float speed;
+        QHash<uint32_t, float> obstaclesTime;
+    };
+
+    struct Anchor
+    {
+        std::shared_ptr<const Model::Road> road;
+        // Index of segment end point, segment starts at (pointIndex - 1)
+        uint32_t pointIndex;
+        PointI projection;
+    };
+
+    struct TargetAttachment
+    {
+        int targetIndex;
+        float distance;
+    };
+
+    struct QueueEntry
+    {
+        float time;
+        float distance;
+        // Index of target, or -1 if this entry is a road point
+        int targetIndex;
+        std::shared_ptr<const Model::Road> road;
+        uint32_t pointIndex;
+    };
+
+    struct QueueEntryComparator
+    {
+        bool operator()(const QueueEntry& l, const QueueEntry& r) const
+        {
+            return l.time > r.time;
+        }
+    };
+
+    typedef QVector< std::pair< std::shared_ptr<const Model::Road>, uint32_t > > Junction;
+
+    RouteMatrixGraph(RoutePlannerContext* context_)
+        : context(context_)
+        , memoryLimitExceeded(0)
+    {
+    }
+
+    RoutePlannerContext* const context;
+
+    // RoutePlannerContext (tiles loading and ruleset evaluation) is not thread-safe
+    QMutex contextMutex;
+
+    mutable QReadWriteLock cacheLock;
+    QHash<uint64_t, std::shared_ptr<const RoadInfo> > roadsInfo;
+    QHash<uint64_t, Junction> junctions;
+    QAtomicInt memoryLimitExceeded;
+
+    QVector<Anchor> targets;
+    QHash<uint64_t, QList<TargetAttachment> > targetsAttachments;
+
+    std::shared_ptr<const RoadInfo> obtainRoadInfo(const std::shared_ptr<const Model::Road>& road)
+    {
+        {
+            QReadLocker scopedLocker(&cacheLock);
+
+            const auto itRoadInfo = roadsInfo.constFind(road->id);
+            if(itRoadInfo != roadsInfo.cend())
+                return *itRoadInfo;
+        }
+
+        const std::shared_ptr<RoadInfo> roadInfo(new RoadInfo());
+        {
+            QMutexLocker scopedLocker(&contextMutex);
+
+            const auto direction = context->profileContext->getDirection(road);
+            roadInfo->forwardAllowed = (direction == Model::RoadDirection::TwoWay || direction == Model::RoadDirection::OneWayReverse);
+            roadInfo->backwardAllowed = (direction == Model::RoadDirection::TwoWay || direction == Model::RoadDirection::OneWayForward);
+
+            // Same speed as used by calculateTimeWithObstacles()
+            const auto priority = context->profileContext->getSpeedPriority(road);
+            auto speed = context->profileContext->getSpeed(road) * priority;
+            if(qFuzzyCompare(speed, 0.0f))
+                speed = context->profileContext->profile->minDefaultSpeed * priority;
+            if(speed > context->profileContext->profile->maxDefaultSpeed)
+                speed = context->profileContext->profile->maxDefaultSpeed;
+            roadInfo->speed = speed;
+
+            for(auto itPointTypes = road->pointsTypes.cbegin(); itPointTypes != road->pointsTypes.cend(); ++itPointTypes)
+            {
+                const auto obstacleTime = context->profileContext->getRoutingObstaclesExtraTime(road, itPointTypes.key());
+                if(!qFuzzyIsNull(obstacleTime))
+                    roadInfo->obstaclesTime.insert(itPointTypes.key(), obstacleTime);
+            }
+        }
+
+        QWriteLocker scopedLocker(&cacheLock);
+        auto itRoadInfo = roadsInfo.constFind(road->id);
+        if(itRoadInfo == roadsInfo.cend())
+            itRoadInfo = roadsInfo.insert(road->id, roadInfo);
+        return *itRoadInfo;
+    }
+
+    Junction obtainJunction(const PointI& point)
+    {
+        const uint64_t id = (static_cast<uint64_t>(point.x) << 31) | point.y;
+        {
+            QReadLocker scopedLocker(&cacheLock);
+
+            const auto itJunction = junctions.constFind(id);
+            if(itJunction != junctions.cend())
+                return *itJunction;
+        }
+
+        Junction junction;
+        {
+            QMutexLocker scopedLocker(&contextMutex);
+
+            auto segment = loadRouteCalculationSegment(context, point.x, point.y);
+            while(segment)
+            {
+                junction.push_back(std::make_pair(segment->road, segment->pointIndex));
+                segment = segment->next;
+            }
+
+            if(context->getCurrentEstimatedSize() > context->_memoryUsageLimit)
+                memoryLimitExceeded.fetchAndStoreOrdered(1);
+        }
+
+        QWriteLocker scopedLocker(&cacheLock);
+        auto itJunction = junctions.constFind(id);
+        if(itJunction == junctions.cend())
+            itJunction = junctions.insert(id, junction);
+        return *itJunction;
+    }
+
+    // Shared caches are dropped once they hold more junctions than this
+    enum { MaxCachedJunctions = 1 << 18 };
+
+    // Lets graph that serves many independent searches (like traces of matchTraces()) release memory between them.
+    // Tiles unused by running searches are unloaded, memory limit is re-evaluated and shared caches are dropped
+    // if they grew too large. Searches running at the same time are not affected, since caches are read by value
+    void trim()
+    {
+        {
+            QMutexLocker scopedLocker(&contextMutex);
+
+            if(context->getCurrentEstimatedSize() > context->_memoryUsageLimit)
+                context->unloadUnusedTiles(context->_memoryUsageLimit);
+            memoryLimitExceeded.fetchAndStoreOrdered(context->getCurrentEstimatedSize() > context->_memoryUsageLimit ? 1 : 0);
+        }
+
+        QWriteLocker scopedLocker(&cacheLock);
+        if(junctions.size() > MaxCachedJunctions)
+        {
+            junctions.clear();
+            roadsInfo.clear();
+        }
+    }
+
+    bool snap(const std::pair<double, double>& point, Anchor& outAnchor)
+    {
+        QMutexLocker scopedLocker(&contextMutex);
+
+        uint32_t x31, y31;
+        if(!findClosestRoadPoint(context, point.first, point.second, &outAnchor.road, &outAnchor.pointIndex, nullptr, &x31, &y31))
+            return false;
+        outAnchor.projection.x = x31;
+        outAnchor.projection.y = y31;
+        return true;
+    }
+
+    void snapCandidates(const std::pair<double, double>& point, const unsigned int count, const double maxDistance, QVector<Anchor>& outAnchors, QVector<double>& outDistances)
+    {
+        QList<ClosestRoadPoint> closestPoints;
+        {
+            QMutexLocker scopedLocker(&contextMutex);
+
+            if(!findClosestRoadPoints(context, point.first, point.second, count, closestPoints))
+                return;
+        }
+
+        const auto sqMaxDistance = maxDistance * maxDistance;
+        for(auto itClosestPoint = closestPoints.cbegin(); itClosestPoint != closestPoints.cend(); ++itClosestPoint)
+        {
+            const auto& closestPoint = *itClosestPoint;
+            if(closestPoint.sqDistance > sqMaxDistance)
+                break;
+
+            Anchor anchor;
+            anchor.road = closestPoint.road;
+            anchor.pointIndex = closestPoint.pointIndex;
+            anchor.projection.x = closestPoint.x31;
+            anchor.projection.y = closestPoint.y31;
+            outAnchors.push_back(anchor);
+            outDistances.push_back(qSqrt(closestPoint.sqDistance));
+        }
+    }
+
+    void attachTargets()
+    {
+        attachTargets(targets, targetsAttachments);
+    }
+
+    void attachTargets(const QVector<Anchor>& targets, QHash<uint64_t, QList<TargetAttachment> >& targetsAttachments)
+    {
+        for(int targetIndex = 0; targetIndex < targets.size(); targetIndex++)
+        {
+            const auto& target = targets[targetIndex];
+            if(!target.road)
+                continue;
+            const auto roadInfo = obtainRoadInfo(target.road);
+
+            // Target can be reached from segment start when moving forward, and from segment end when moving backward
+            if(roadInfo->forwardAllowed)
+            {
+                TargetAttachment attachment;
+                attachment.targetIndex = targetIndex;
+                attachment.distance = Utilities::distance31(target.road->points[target.pointIndex - 1], target.projection);
+                targetsAttachments[encodeRoutePointId(target.road, target.pointIndex - 1, true)].push_back(attachment);
+            }
+            if(roadInfo->backwardAllowed)
+            {
+                TargetAttachment attachment;
+                attachment.targetIndex = targetIndex;
+                attachment.distance = Utilities::distance31(target.road->points[target.pointIndex], target.projection);
+                targetsAttachments[encodeRoutePointId(target.road, target.pointIndex, true)].push_back(attachment);
+            }
+        }
+    }
+
+    bool searchFromSource(const Anchor& source, float* const outTimes, float* const outDistances, const IQueryController* const controller, QString& outWarning)
+    {
+        return search(source, targets, targetsAttachments, std::numeric_limits<float>::max(), outTimes, outDistances, controller, outWarning);
+    }
+
+    // Search is not expanded beyond maxDistance (meters), targets farther than that are left unreached
+    bool search(
+        const Anchor& source,
+        const QVector<Anchor>& targets,
+        const QHash<uint64_t, QList<TargetAttachment> >& targetsAttachments,
+        const float maxDistance,
+        float* const outTimes, float* const outDistances,
+        const IQueryController* const controller,
+        QString& outWarning)
+    {
+        std::priority_queue<QueueEntry, std::vector<QueueEntry>, QueueEntryComparator> queue;
+        QHash<uint64_t, float> bestTimes;
+        QSet<uint64_t> settled;
+        QVector<bool> targetsSettled(targets.size(), false);
+        int remainingTargets = 0;
+        for(auto itTarget = targets.cbegin(); itTarget != targets.cend(); ++itTarget)
+        {
+            if(itTarget->road)
+                remainingTargets++;
+        }
+
+        const auto enqueue =
+            [&queue, &bestTimes, &settled, maxDistance]
+            (const std::shared_ptr<const Model::Road>& road, const uint32_t pointIndex, const float time, const float distance)
+            {
+                if(distance > maxDistance)
+                    return;
+                const auto id = encodeRoutePointId(road, pointIndex, true);
+                if(settled.contains(id))
+                    return;
+                const auto itBestTime = bestTimes.find(id);
+                if(itBestTime != bestTimes.end() && *itBestTime <= time)
+                    return;
+                bestTimes[id] = time;
+
+                QueueEntry entry;
+                entry.time = time;
+                entry.distance = distance;
+                entry.targetIndex = -1;
+                entry.road = road;
+                entry.pointIndex = pointIndex;
+                queue.push(entry);
+            };
+        const auto enqueueTarget =
+            [&queue, &targetsSettled, maxDistance]
+            (const int targetIndex, const float time, const float distance)
+            {
+                if(targetsSettled[targetIndex] || distance > maxDistance)
+                    return;
+
+                QueueEntry entry;
+                entry.time = time;
+                entry.distance = distance;
+                entry.targetIndex = targetIndex;
+                entry.pointIndex = 0;
+                queue.push(entry);
+            };
+
+        // Start from projection on source segment towards both of its ends (if allowed)
+        const auto sourceRoadInfo = obtainRoadInfo(source.road);
+        const auto& sourceSegmentStart = source.road->points[source.pointIndex - 1];
+        const auto& sourceSegmentEnd = source.road->points[source.pointIndex];
+        if(sourceRoadInfo->forwardAllowed)
+        {
+            const float distance = Utilities::distance31(source.projection, sourceSegmentEnd);
+            enqueue(source.road, source.pointIndex, distance / sourceRoadInfo->speed, distance);
+        }
+        if(sourceRoadInfo->backwardAllowed)
+        {
+            const float distance = Utilities::distance31(source.projection, sourceSegmentStart);
+            enqueue(source.road, source.pointIndex - 1, distance / sourceRoadInfo->speed, distance);
+        }
+
+        // Targets that lie on the same segment as source can be reached directly
+        for(int targetIndex = 0; targetIndex < targets.size(); targetIndex++)
+        {
+            const auto& target = targets[targetIndex];
+            if(!target.road || target.road->id != source.road->id || target.pointIndex != source.pointIndex)
+                continue;
+
+            const float sourceOffset = Utilities::distance31(sourceSegmentStart, source.projection);
+            const float targetOffset = Utilities::distance31(sourceSegmentStart, target.projection);
+            if((targetOffset >= sourceOffset && sourceRoadInfo->forwardAllowed) || (targetOffset <= sourceOffset && sourceRoadInfo->backwardAllowed))
+            {
+                const auto distance = qAbs(targetOffset - sourceOffset);
+                enqueueTarget(targetIndex, distance / sourceRoadInfo->speed, distance);
+            }
+        }
+
+        unsigned int iterations = 0;
+        while(!queue.empty() && remainingTargets > 0)
+        {
+            const auto entry = queue.top();
+            queue.pop();
+
+            if(entry.targetIndex >= 0)
+            {
+                if(targetsSettled[entry.targetIndex])
+                    continue;
+                targetsSettled[entry.targetIndex] = true;
+                outTimes[entry.targetIndex] = entry.time;
+                outDistances[entry.targetIndex] = entry.distance;
+                remainingTargets--;
+                continue;
+            }
+
+            const auto id = encodeRoutePointId(entry.road, entry.pointIndex, true);
+            if(settled.contains(id))
+                continue;
+            settled.insert(id);
+
+            if((++iterations & 0xff) == 0)
+            {
+                if(controller && controller->isAborted())
+                {
+                    outWarning = "Aborted";
+                    return false;
+                }
+                if(memoryLimitExceeded.load())
+                {
+                    outWarning = "There is no enough memory " + QString::number(context->_memoryUsageLimit/(1<<20)) + " Mb";
+                    return false;
+                }
+            }
+
+            const auto& road = entry.road;
+            const auto roadInfo = obtainRoadInfo(road);
+            const auto& point = road->points[entry.pointIndex];
+
+            // Targets attached to this road point
+            const auto itAttachments = targetsAttachments.constFind(id);
+            if(itAttachments != targetsAttachments.cend())
+            {
+                for(auto itAttachment = itAttachments->cbegin(); itAttachment != itAttachments->cend(); ++itAttachment)
+                    enqueueTarget(itAttachment->targetIndex, entry.time + itAttachment->distance / roadInfo->speed, entry.distance + itAttachment->distance);
+            }
+
+            // Continue along the same road
+            if(roadInfo->forwardAllowed && entry.pointIndex + 1 < road->points.size())
+            {
+                const auto nextPointIndex = entry.pointIndex + 1;
+                const auto obstacleTime = roadInfo->obstaclesTime.value(nextPointIndex, 0.0f);
+                if(obstacleTime >= 0.0f)
+                {
+                    const float distance = Utilities::distance31(point, road->points[nextPointIndex]);
+                    enqueue(road, nextPointIndex, entry.time + distance / roadInfo->speed + obstacleTime, entry.distance + distance);
+                }
+            }
+            if(roadInfo->backwardAllowed && entry.pointIndex > 0)
+            {
+                const auto nextPointIndex = entry.pointIndex - 1;
+                const auto obstacleTime = roadInfo->obstaclesTime.value(nextPointIndex, 0.0f);
+                if(obstacleTime >= 0.0f)
+                {
+                    const float distance = Utilities::distance31(point, road->points[nextPointIndex]);
+                    enqueue(road, nextPointIndex, entry.time + distance / roadInfo->speed + obstacleTime, entry.distance + distance);
+                }
+            }
+
+            // Switch to other roads that pass through this point
+            const auto junction = obtainJunction(point);
+            for(auto itJunctionPoint = junction.cbegin(); itJunctionPoint != junction.cend(); ++itJunctionPoint)
+            {
+                const auto& otherRoad = itJunctionPoint->first;
+                const auto otherPointIndex = itJunctionPoint->second;
+                if(otherRoad->id == road->id && otherPointIndex == entry.pointIndex)
+                    continue;
+
+                enqueue(otherRoad, otherPointIndex, entry.time, entry.distance);
+            }
+        }
+
+        return true;
+    }
+
+    struct FrontierLabel
+    {
+        float time;
+        std::shared_ptr<const Model::Road> road;
+        uint32_t pointIndex;
+        bool hasParent;
+        uint64_t parentId;
+    };
+
+    struct FrontierEdge
+    {
+        std::shared_ptr<const Model::Road> road;
+        uint32_t pointIndex;
+        bool switched;
+        uint64_t id;
+        float time;
+        float potential;
+    };
+
+    // Frontier entries are ordered by time plus potential of their point
+    struct FrontierQueueEntry
+    {
+        float key;
+        float time;
+        std::shared_ptr<const Model::Road> road;
+        uint32_t pointIndex;
+        bool switched;
+        uint64_t id;
+    };
+
+    struct FrontierQueueEntryComparator
+    {
+        bool operator()(const FrontierQueueEntry& l, const FrontierQueueEntry& r) const
+        {
+            return l.key > r.key;
+        }
+    };
+
+    // One side of bidirectional search. Reverse frontier moves from target against allowed road directions
+    struct Frontier
+    {
+        Frontier(const bool isReverse_, const PointI& ownEndpoint_, const PointI& otherEndpoint_, const float maxSpeed_)
+            : isReverse(isReverse_)
+            , ownEndpoint(ownEndpoint_)
+            , otherEndpoint(otherEndpoint_)
+            , maxSpeed(maxSpeed_)
+            , potentialOffset(Utilities::distance31(ownEndpoint_, otherEndpoint_) / maxSpeed_ / 2.0f)
+            , iterations(0)
+        {
+        }
+
+        const bool isReverse;
+        std::priority_queue<FrontierQueueEntry, std::vector<FrontierQueueEntry>, FrontierQueueEntryComparator> queue;
+        QHash<uint64_t, FrontierLabel> labels;
+        QSet<uint64_t> settled;
+
+        // Average of lower bounds of time to other endpoint and of time from own one (no road is faster than
+        // maxSpeed). Potentials of both frontiers sum up to the same constant at every point, so they stay
+        // admissible and consistent when frontiers meet anywhere. Offset keeps potentials non-negative
+        const PointI ownEndpoint;
+        const PointI otherEndpoint;
+        const float maxSpeed;
+        const float potentialOffset;
+
+        float potential(const PointI& point) const
+        {
+            const auto difference = Utilities::distance31(point, otherEndpoint) - Utilities::distance31(point, ownEndpoint);
+            return qMax(0.0f, static_cast<float>(difference / maxSpeed / 2.0f + potentialOffset));
+        }
+
+        unsigned int iterations;
+
+        // Own caches in front of shared ones, so frontiers rarely contend for graph locks
+        QHash<uint64_t, std::shared_ptr<const RoadInfo> > roadsInfo;
+        QHash<uint64_t, Junction> junctions;
+    };
+
+    // Everything frontiers of bidirectional search exchange, guarded by one mutex
+    struct FrontiersMeeting
+    {
+        FrontiersMeeting()
+            : finished(false)
+            , potentialsSum(0.0f)
+            , bestTime(std::numeric_limits<float>::max())
+            , isDirect(false)
+            , hasForwardPart(false)
+            , hasReversePart(false)
+            , forwardId(0)
+            , reverseId(0)
+        {
+            tops[0] = tops[1] = 0.0f;
+            exhausted[0] = exhausted[1] = false;
+        }
+
+        QMutex mutex;
+        // Time from own endpoint of every settled point, per frontier
+        QHash<uint64_t, float> settledTimes[2];
+        // Time from own endpoint of every initial point (endpoint projection leads there directly), per frontier
+        QHash<uint64_t, float> initialTimes[2];
+        // Key of last point settled by each frontier: all points with smaller keys are already settled
+        float tops[2];
+        bool exhausted[2];
+        bool finished;
+        QString warning;
+        // Sum of potentials of both frontiers, that is the same at every point
+        float potentialsSum;
+
+        float bestTime;
+        // Source and target are on the same segment and direct move is the best
+        bool isDirect;
+        bool hasForwardPart;
+        bool hasReversePart;
+        // Last point of forward part and first point of reverse part of best route
+        uint64_t forwardId;
+        uint64_t reverseId;
+    };
+
+    // Every road point is present in graph of bidirectional search twice: reached along its road, and reached by
+    // switching from other road at junction. Turn restriction applies to that switch, so point reached by switching
+    // is left only along its road
+    static uint64_t encodeFrontierPointId(const std::shared_ptr<const Model::Road>& road, const uint32_t pointIndex, const bool switched)
+    {
+        return encodeRoutePointId(road, pointIndex, !switched);
+    }
+
+    // Decides switch between roads at junction the same way processRestrictions() does for forward search:
+    // prohibitive restriction forbids only its road, while exclusive one forbids all other roads of junction
+    bool isSwitchAllowed(const std::shared_ptr<const Model::Road>& from, const std::shared_ptr<const Model::Road>& to, const Junction& junction) const
+    {
+        if(from->restrictions.isEmpty() || !context->profileContext->profile->restrictionsAware)
+            return true;
+
+        const auto isExclusive =
+            [](const Model::RoadRestriction type) -> bool
+            {
+                return type == Model::RoadRestriction::OnlyRightTurn || type == Model::RoadRestriction::OnlyLeftTurn || type == Model::RoadRestriction::OnlyStraightOn;
+            };
+
+        const auto itRestriction = from->restrictions.constFind(to->id);
+        if(itRestriction != from->restrictions.cend())
+        {
+            const auto type = *itRestriction;
+            if(type == Model::RoadRestriction::NoLeftTurn || type == Model::RoadRestriction::NoRightTurn || type == Model::RoadRestriction::NoUTurn || type == Model::RoadRestriction::NoStraightOn)
+                return false;
+            if(isExclusive(type))
+                return true;
+        }
+
+        for(auto itJunctionPoint = junction.cbegin(); itJunctionPoint != junction.cend(); ++itJunctionPoint)
+        {
+            const auto itOtherRestriction = from->restrictions.constFind(itJunctionPoint->first->id);
+            if(itOtherRestriction != from->restrictions.cend() && isExclusive(*itOtherRestriction))
+                return false;
+        }
+
+        return true;
+    }
+
+    std::shared_ptr<const RoadInfo> obtainRoadInfo(Frontier& frontier, const std::shared_ptr<const Model::Road>& road)
+    {
+        auto itRoadInfo = frontier.roadsInfo.constFind(road->id);
+        if(itRoadInfo == frontier.roadsInfo.cend())
+            itRoadInfo = frontier.roadsInfo.insert(road->id, obtainRoadInfo(road));
+        return *itRoadInfo;
+    }
+
+    const Junction& obtainJunction(Frontier& frontier, const PointI& point)
+    {
+        const uint64_t id = (static_cast<uint64_t>(point.x) << 31) | point.y;
+        auto itJunction = frontier.junctions.constFind(id);
+        if(itJunction == frontier.junctions.cend())
+            itJunction = frontier.junctions.insert(id, obtainJunction(point));
+        return *itJunction;
+    }
+
+    void seedFrontier(Frontier& frontier, FrontiersMeeting& meeting, const std::shared_ptr<const Model::Road>& road, const uint32_t pointIndex, const bool switched, const float time)
+    {
+        const auto id = encodeFrontierPointId(road, pointIndex, switched);
+
+        FrontierLabel label;
+        label.time = time;
+        label.road = road;
+        label.pointIndex = pointIndex;
+        label.hasParent = false;
+        label.parentId = 0;
+        frontier.labels.insert(id, label);
+        meeting.initialTimes[frontier.isReverse ? 1 : 0].insert(id, time);
+
+        FrontierQueueEntry entry;
+        entry.key = time + frontier.potential(road->points[pointIndex]);
+        entry.time = time;
+        entry.road = road;
+        entry.pointIndex = pointIndex;
+        entry.switched = switched;
+        entry.id = id;
+        frontier.queue.push(entry);
+    }
+
+    // Forward frontier leaves point along its road, and also switches to other roads if point was reached along its road.
+    // Reverse frontier comes to point reached along its road from neighbour points of that road (reached either way),
+    // and to point reached by switching from other roads of junction
+    void collectFrontierEdges(Frontier& frontier, const FrontierQueueEntry& entry, QVector<FrontierEdge>& outEdges)
+    {
+        outEdges.clear();
+
+        const auto& road = entry.road;
+        const auto& point = road->points[entry.pointIndex];
+        const auto entryPotential = entry.key - entry.time;
+
+        if(!frontier.isReverse || !entry.switched)
+        {
+            const auto roadInfo = obtainRoadInfo(frontier, road);
+
+            // Reverse frontier passes road segments against allowed direction, and obstacle belongs to the point
+            // where segment ends in forward direction, that is the point reverse frontier leaves
+            const auto increaseAllowed = frontier.isReverse ? roadInfo->backwardAllowed : roadInfo->forwardAllowed;
+            const auto decreaseAllowed = frontier.isReverse ? roadInfo->forwardAllowed : roadInfo->backwardAllowed;
+            for(int step = -1; step <= 1; step += 2)
+            {
+                if(!(step > 0 ? increaseAllowed : decreaseAllowed))
+                    continue;
+                if((step > 0 && entry.pointIndex + 1 >= road->points.size()) || (step < 0 && entry.pointIndex == 0))
+                    continue;
+
+                const uint32_t nextPointIndex = entry.pointIndex + step;
+                const auto obstacleTime = roadInfo->obstaclesTime.value(frontier.isReverse ? entry.pointIndex : nextPointIndex, 0.0f);
+                if(obstacleTime < 0.0f)
+                    continue;
+                const auto& nextPoint = road->points[nextPointIndex];
+
+                FrontierEdge edge;
+                edge.road = road;
+                edge.pointIndex = nextPointIndex;
+                edge.switched = false;
+                edge.id = encodeFrontierPointId(road, nextPointIndex, false);
+                edge.time = Utilities::distance31(point, nextPoint) / roadInfo->speed + obstacleTime;
+                edge.potential = frontier.potential(nextPoint);
+                outEdges.push_back(edge);
+
+                // Reverse frontier also comes from neighbour point reached by switching, if there is a junction to switch at
+                if(frontier.isReverse && obtainJunction(frontier, nextPoint).size() > 1)
+                {
+                    edge.switched = true;
+                    edge.id = encodeFrontierPointId(road, nextPointIndex, true);
+                    outEdges.push_back(edge);
+                }
+            }
+        }
+
+        if(frontier.isReverse != entry.switched)
+            return;
+
+        // Switch to (or, for reverse frontier, from) other roads that pass through this point
+        const auto& junction = obtainJunction(frontier, point);
+        for(auto itJunctionPoint = junction.cbegin(); itJunctionPoint != junction.cend(); ++itJunctionPoint)
+        {
+            const auto& otherRoad = itJunctionPoint->first;
+            const auto otherPointIndex = itJunctionPoint->second;
+            if(otherRoad->id == road->id && otherPointIndex == entry.pointIndex)
+                continue;
+            if(!(frontier.isReverse ? isSwitchAllowed(otherRoad, road, junction) : isSwitchAllowed(road, otherRoad, junction)))
+                continue;
+
+            FrontierEdge edge;
+            edge.road = otherRoad;
+            edge.pointIndex = otherPointIndex;
+            edge.switched = !frontier.isReverse;
+            edge.id = encodeFrontierPointId(otherRoad, otherPointIndex, edge.switched);
+            edge.time = 0.0f;
+            edge.potential = entryPotential;
+            outEdges.push_back(edge);
+        }
+    }
+
+    // Meeting mutex should be locked
+    static void checkFrontiersMeeting(FrontiersMeeting& meeting, const int side, const uint64_t id, const float time, const uint64_t otherId, const float edgeTime)
+    {
+        const auto& otherSettledTimes = meeting.settledTimes[1 - side];
+        const auto itOtherTime = otherSettledTimes.constFind(otherId);
+        if(itOtherTime == otherSettledTimes.cend())
+            return;
+
+        const auto routeTime = time + edgeTime + *itOtherTime;
+        if(routeTime >= meeting.bestTime)
+            return;
+
+        meeting.bestTime = routeTime;
+        meeting.isDirect = false;
+        meeting.hasForwardPart = meeting.hasReversePart = true;
+        meeting.forwardId = side == 0 ? id : otherId;
+        meeting.reverseId = side == 0 ? otherId : id;
+    }
+
+    // Expands frontier until route is known to be the best one. Frontiers of both sides run concurrently
+    void expandFrontier(Frontier& frontier, FrontiersMeeting& meeting, const IQueryController* const controller)
+    {
+        const int side = frontier.isReverse ? 1 : 0;
+
+        QVector<FrontierEdge> edges;
+        while(true)
+        {
+            if(frontier.queue.empty())
+            {
+                QMutexLocker scopedLocker(&meeting.mutex);
+
+                // Everything reachable is settled, so other frontier has to finish on its own
+                meeting.exhausted[side] = true;
+                if(meeting.exhausted[1 - side])
+                    meeting.finished = true;
+                return;
+            }
+
+            const auto entry = frontier.queue.top();
+            frontier.queue.pop();
+
+            const auto id = entry.id;
+            if(frontier.settled.contains(id))
+                continue;
+            frontier.settled.insert(id);
+
+            if((++frontier.iterations & 0xff) == 0)
+            {
+                QString warning;
+                if(controller && controller->isAborted())
+                    warning = "Aborted";
+                else if(memoryLimitExceeded.load())
+                    warning = "There is no enough memory " + QString::number(context->_memoryUsageLimit/(1<<20)) + " Mb";
+                if(!warning.isEmpty())
+                {
+                    QMutexLocker scopedLocker(&meeting.mutex);
+                    meeting.warning = warning;
+                    meeting.finished = true;
+                    return;
+                }
+            }
+
+            collectFrontierEdges(frontier, entry, edges);
+
+            {
+                QMutexLocker scopedLocker(&meeting.mutex);
+                if(meeting.finished)
+                    return;
+
+                meeting.tops[side] = entry.key;
+                meeting.settledTimes[side].insert(id, entry.time);
+
+                // Point may be already settled by other frontier, or be one of its initial points
+                checkFrontiersMeeting(meeting, side, id, entry.time, id, 0.0f);
+                const auto itOtherInitialTime = meeting.initialTimes[1 - side].constFind(id);
+                if(itOtherInitialTime != meeting.initialTimes[1 - side].cend() && entry.time + *itOtherInitialTime < meeting.bestTime)
+                {
+                    meeting.bestTime = entry.time + *itOtherInitialTime;
+                    meeting.isDirect = false;
+                    meeting.hasForwardPart = side == 0;
+                    meeting.hasReversePart = side == 1;
+                    meeting.forwardId = meeting.reverseId = id;
+                }
+
+                // Edges to points settled by other frontier. Each edge is checked by the frontier that settles its
+                // second end later, since both frontiers publish point before checking neighbours
+                for(auto itEdge = edges.cbegin(); itEdge != edges.cend(); ++itEdge)
+                    checkFrontiersMeeting(meeting, side, id, entry.time, itEdge->id, itEdge->time);
+
+                // Any route through points not settled yet by both frontiers is not shorter than sum of their tops
+                // without potentials, that sum up to the same constant everywhere
+                if(meeting.tops[0] + meeting.tops[1] >= meeting.bestTime + meeting.potentialsSum)
+                {
+                    meeting.finished = true;
+                    return;
+                }
+            }
+
+            for(auto itEdge = edges.cbegin(); itEdge != edges.cend(); ++itEdge)
+            {
+                const auto& edge = *itEdge;
+                if(frontier.settled.contains(edge.id))
+                    continue;
+
+                const auto time = entry.time + edge.time;
+                auto itLabel = frontier.labels.find(edge.id);
+                if(itLabel != frontier.labels.end() && itLabel->time <= time)
+                    continue;
+
+                FrontierLabel label;
+                label.time = time;
+                label.road = edge.road;
+                label.pointIndex = edge.pointIndex;
+                label.hasParent = true;
+                label.parentId = id;
+                frontier.labels[edge.id] = label;
+
+                FrontierQueueEntry nextEntry;
+                nextEntry.key = time + edge.potential;
+                nextEntry.time = time;
+                nextEntry.road = edge.road;
+                nextEntry.pointIndex = edge.pointIndex;
+                nextEntry.switched = edge.switched;
+                nextEntry.id = edge.id;
+                frontier.queue.push(nextEntry);
+            }
+        }
+    }
+
+    // Finds the fastest route between source and target, running forward frontier on calling thread and reverse one
+    // on dedicated thread. Route is returned as sequence of road points, empty if route goes directly between
+    // projections on the same segment (outIsDirect is set then). Iterations and queues of frontiers are reported
+    // to statistics, if given
+    bool searchBidirectional(
+        const Anchor& source,
+        const Anchor& target,
+        QList< std::pair< std::shared_ptr<const Model::Road>, uint32_t > >& outPath,
+        bool& outIsDirect,
+        const IQueryController* const controller,
+        QString& outWarning,
+        RouteStatistics* const statistics = nullptr)
+    {
+        const auto maxSpeed = context->profileContext->profile->maxDefaultSpeed;
+        Frontier forwardFrontier(false, source.projection, target.projection, maxSpeed);
+        Frontier reverseFrontier(true, target.projection, source.projection, maxSpeed);
+        FrontiersMeeting meeting;
+        meeting.potentialsSum = forwardFrontier.potentialOffset + reverseFrontier.potentialOffset;
+
+        // Forward frontier starts from source projection towards both ends of its segment, reverse one
+        // from both ends of target segment towards target projection
+        const auto sourceRoadInfo = obtainRoadInfo(forwardFrontier, source.road);
+        const auto& sourceSegmentStart = source.road->points[source.pointIndex - 1];
+        const auto& sourceSegmentEnd = source.road->points[source.pointIndex];
+        if(sourceRoadInfo->forwardAllowed)
+            seedFrontier(forwardFrontier, meeting, source.road, source.pointIndex, false, Utilities::distance31(source.projection, sourceSegmentEnd) / sourceRoadInfo->speed);
+        if(sourceRoadInfo->backwardAllowed)
+            seedFrontier(forwardFrontier, meeting, source.road, source.pointIndex - 1, false, Utilities::distance31(source.projection, sourceSegmentStart) / sourceRoadInfo->speed);
+        const auto targetRoadInfo = obtainRoadInfo(reverseFrontier, target.road);
+        const auto& targetSegmentStart = target.road->points[target.pointIndex - 1];
+        const auto& targetSegmentEnd = target.road->points[target.pointIndex];
+        // Route may come to target segment either along target road or by switching to it
+        for(int switched = 0; switched <= 1; switched++)
+        {
+            if(targetRoadInfo->forwardAllowed)
+                seedFrontier(reverseFrontier, meeting, target.road, target.pointIndex - 1, switched != 0, Utilities::distance31(targetSegmentStart, target.projection) / targetRoadInfo->speed);
+            if(targetRoadInfo->backwardAllowed)
+                seedFrontier(reverseFrontier, meeting, target.road, target.pointIndex, switched != 0, Utilities::distance31(targetSegmentEnd, target.projection) / targetRoadInfo->speed);
+        }
+
+        // Target may lie on the same segment as source
+        if(target.road->id == source.road->id && target.pointIndex == source.pointIndex)
+        {
+            const float sourceOffset = Utilities::distance31(sourceSegmentStart, source.projection);
+            const float targetOffset = Utilities::distance31(sourceSegmentStart, target.projection);
+            if((targetOffset >= sourceOffset && sourceRoadInfo->forwardAllowed) || (targetOffset <= sourceOffset && sourceRoadInfo->backwardAllowed))
+            {
+                meeting.bestTime = qAbs(targetOffset - sourceOffset) / sourceRoadInfo->speed;
+                meeting.isDirect = true;
+            }
+        }
+
+        // Reverse frontier gets own thread, since shared routing pool may be saturated by other searches
+        // or even be the one calling thread belongs to
+        Concurrent::Thread reverseFrontierThread(
+            [this, &reverseFrontier, &meeting, controller]
+            ()
+            {
+                expandFrontier(reverseFrontier, meeting, controller);
+            });
+        reverseFrontierThread.start();
+        expandFrontier(forwardFrontier, meeting, controller);
+        reverseFrontierThread.wait();
+
+        if(statistics)
+        {
+            statistics->forwardIterations += forwardFrontier.iterations;
+            statistics->backwardIterations += reverseFrontier.iterations;
+            statistics->sizeOfDQueue = forwardFrontier.queue.size();
+            statistics->sizeOfRQueue = reverseFrontier.queue.size();
+        }
+
+        if(!meeting.warning.isEmpty())
+        {
+            outWarning = meeting.warning;
+            return false;
+        }
+        if(meeting.bestTime == std::numeric_limits<float>::max())
+        {
+            outWarning = "Route is not found to selected target point.";
+            return false;
+        }
+
+        outIsDirect = meeting.isDirect;
+        if(meeting.isDirect)
+            return true;
+
+        // Forward part is restored from its last point back to source, reverse part from its first point to target
+        if(meeting.hasForwardPart)
+        {
+            for(auto itLabel = forwardFrontier.labels.constFind(meeting.forwardId); ; itLabel = forwardFrontier.labels.constFind(itLabel->parentId))
+            {
+                outPath.push_front(std::make_pair(itLabel->road, itLabel->pointIndex));
+                if(!itLabel->hasParent)
+                    break;
+            }
+        }
+        if(meeting.hasReversePart)
+        {
+            auto itLabel = reverseFrontier.labels.constFind(meeting.reverseId);
+            if(meeting.hasForwardPart && meeting.forwardId == meeting.reverseId)
+                itLabel = itLabel->hasParent ? reverseFrontier.labels.constFind(itLabel->parentId) : reverseFrontier.labels.cend();
+            for(; itLabel != reverseFrontier.labels.cend(); itLabel = itLabel->hasParent ? reverseFrontier.labels.constFind(itLabel->parentId) : reverseFrontier.labels.cend())
+                outPath.push_back(std::make_pair(itLabel->road, itLabel->pointIndex));
+        }
+
+        return true;
+    }
+};
+
+OsmAnd::RouteMatrixResult OsmAnd::RoutePlanner::calculateRouteMatrix(
+    OsmAnd::RoutePlannerContext* context,
+    const QList< std::pair<double, double> >& sources,
+    const QList< std::pair<double, double> >& targets,
+    unsigned int threadsCount /*= 0*/,
+    const IQueryController* const controller /*= nullptr*/)
+{
+    assert(context != nullptr);
+
+    RouteMatrixResult result(sources.size(), targets.size());
+    if(sources.isEmpty() || targets.isEmpty())
+        return result;
+
+    RouteMatrixGraph graph(context);
+
+    // Snap all points to roads once, searches only reference snapped anchors
+    QVector<RouteMatrixGraph::Anchor> sourcesAnchors(sources.size());
+    for(int sourceIndex = 0; sourceIndex < sources.size(); sourceIndex++)
+    {
+        if(!graph.snap(sources[sourceIndex], sourcesAnchors[sourceIndex]))
+            result.warnMessage = "Source point was not found";
+    }
+    graph.targets.resize(targets.size());
+    for(int targetIndex = 0; targetIndex < targets.size(); targetIndex++)
+    {
+        if(!graph.snap(targets[targetIndex], graph.targets[targetIndex]))
+            result.warnMessage = "Target point was not found";
+    }
+    graph.attachTargets();
+
+    QMutex warningMutex;
+    const auto searchFromSource =
+        [&graph, &sourcesAnchors, &targets, controller, &warningMutex, &result]
+        (const int sourceIndex)
+        {
+            const auto outTimes = result.times.data() + sourceIndex * targets.size();
+            const auto outDistances = result.distances.data() + sourceIndex * targets.size();
+            QString warning;
+            if(graph.searchFromSource(sourcesAnchors[sourceIndex], outTimes, outDistances, controller, warning))
+                return;
+
+            QMutexLocker scopedLocker(&warningMutex);
+            result.warnMessage = warning;
+        };
+
+    // Waiting for shared routing pool from its own worker may deadlock, so searches run on calling thread then
+    if(threadsCount == 0 && Concurrent::pools->routing->isCurrentThreadWorker())
+    {
+        for(int sourceIndex = 0; sourceIndex < sources.size(); sourceIndex++)
+        {
+            if(sourcesAnchors[sourceIndex].road)
+                searchFromSource(sourceIndex);
+        }
+        return result;
+    }
+
+    // Searches run on shared routing pool, unless caller has limited number of threads explicitly
+    std::unique_ptr<Concurrent::WorkersPool> ownPool;
+    if(threadsCount > 0)
+        ownPool.reset(new Concurrent::WorkersPool(QLatin1String("routeMatrix"), threadsCount, Concurrent::pools->routing->getPriority()));
+    const auto pool = ownPool ? ownPool.get() : Concurrent::pools->routing.get();
+
+    QMutex pendingSearchesMutex;
+    QWaitCondition pendingSearchesCondition;
+    auto pendingSearchesCount = 0;
+    for(int sourceIndex = 0; sourceIndex < sources.size(); sourceIndex++)
+    {
+        if(!sourcesAnchors[sourceIndex].road)
+            continue;
+
+        {
+            QMutexLocker scopedLocker(&pendingSearchesMutex);
+            pendingSearchesCount++;
+        }
+        pool->start(new Concurrent::Task(
+            [&searchFromSource, sourceIndex]
+            (Concurrent::Task* task, QEventLoop& eventLoop)
+            {
+                searchFromSource(sourceIndex);
+            },
+            nullptr,
+            [&pendingSearchesMutex, &pendingSearchesCondition, &pendingSearchesCount]
+            (Concurrent::Task* task, bool wasCancelled)
+            {
+                QMutexLocker scopedLocker(&pendingSearchesMutex);
+                if(--pendingSearchesCount == 0)
+                    pendingSearchesCondition.wakeAll();
+            }));
+    }
+
+    // Shared pool may be busy with other work, so wait only for own searches
+    {
+        QMutexLocker scopedLocker(&pendingSearchesMutex);
+        while(pendingSearchesCount > 0)
+            pendingSearchesCondition.wait(&pendingSearchesMutex);
+    }
+
+    return result;
+}
+
+OsmAnd::RouteCalculationResult OsmAnd::RoutePlanner::calculateRouteParallel(
+    OsmAnd::RoutePlannerContext* context,
+    const QList< std::pair<double, double> >& points,
+    bool leftSideNavigation,
+    const IQueryController* const controller /*= nullptr*/)
+{
+    assert(context != nullptr);
+    assert(points.size() == 2);
+
+    const auto& routeStatistics = context->_routeStatistics;
+    if(routeStatistics)
+    {
+        routeStatistics->timeToLoad = 0;
+        routeStatistics->timeToCalculate = 0;
+        routeStatistics->forwardIterations = 0;
+        routeStatistics->backwardIterations = 0;
+        routeStatistics->prefetchedTiles = 0;
+        routeStatistics->prefetchHits = 0;
+        routeStatistics->prefetchWasted = 0;
+        routeStatistics->timeToCalculateBegin = std::chrono::steady_clock::now();
+    }
+
+    RouteMatrixGraph graph(context);
+
+    RouteMatrixGraph::Anchor source;
+    if(!graph.snap(points.first(), source))
+        return OsmAnd::RouteCalculationResult("Start point was not found");
+    RouteMatrixGraph::Anchor target;
+    if(!graph.snap(points.last(), target))
+        return OsmAnd::RouteCalculationResult("End point was not found");
+
+    QList< std::pair< std::shared_ptr<const Model::Road>, uint32_t > > path;
+    bool isDirect = false;
+    QString warning;
+    const auto searchSucceeded = graph.searchBidirectional(source, target, path, isDirect, controller, warning, routeStatistics.get());
+    if(routeStatistics)
+    {
+        routeStatistics->timeToCalculate += static_cast<uint64_t>(
+            std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - routeStatistics->timeToCalculateBegin).count());
+    }
+    if(!searchSucceeded)
+        return OsmAnd::RouteCalculationResult(warning);
+
+    // Projections of source and target are inserted into roads they lie on, as findClosestRouteSegment() does
+    const std::shared_ptr<const Model::Road> sourceRoad(new Model::Road(source.road, source.pointIndex, source.projection.x, source.projection.y));
+    const auto sourceShift = [&source](const uint32_t pointIndex) { return pointIndex >= source.pointIndex ? pointIndex + 1 : pointIndex; };
+
+    QVector< std::shared_ptr<RouteSegment> > route;
+    if(isDirect)
+    {
+        // Target is inserted on the other side of source projection in the same segment
+        const auto targetAfterSource =
+            Utilities::distance31(source.road->points[source.pointIndex - 1], target.projection) >=
+            Utilities::distance31(source.road->points[source.pointIndex - 1], source.projection);
+        const auto targetPointIndex = targetAfterSource ? source.pointIndex + 1 : source.pointIndex;
+        const std::shared_ptr<const Model::Road> road(new Model::Road(sourceRoad, targetPointIndex, target.projection.x, target.projection.y));
+        route.push_back(std::shared_ptr<RouteSegment>(new RouteSegment(road, targetAfterSource ? source.pointIndex : source.pointIndex + 1, targetPointIndex)));
+    }
+    else
+    {
+        // Split path into runs of consecutive points along the same road and in the same direction
+        struct Run
+        {
+            std::shared_ptr<const Model::Road> road;
+            uint32_t startPointIndex;
+            uint32_t endPointIndex;
+        };
+        QList<Run> runs;
+        for(auto itPathPoint = path.cbegin(); itPathPoint != path.cend(); ++itPathPoint)
+        {
+            const auto& road = itPathPoint->first;
+            const auto pointIndex = itPathPoint->second;
+            if(!runs.isEmpty())
+            {
+                auto& run = runs.last();
+                const auto continuesRun =
+                    run.road->id == road->id && (
+                        (run.startPointIndex == run.endPointIndex && qAbs(static_cast<int64_t>(pointIndex) - run.endPointIndex) == 1) ||
+                        (run.startPointIndex < run.endPointIndex && pointIndex == run.endPointIndex + 1) ||
+                        (run.startPointIndex > run.endPointIndex && pointIndex + 1 == run.endPointIndex));
+                if(continuesRun)
+                {
+                    run.endPointIndex = pointIndex;
+                    continue;
+                }
+            }
+
+            Run run;
+            run.road = road;
+            run.startPointIndex = run.endPointIndex = pointIndex;
+            runs.push_back(run);
+        }
+
+        // First run starts at source projection and last one ends at target projection
+        auto& firstRun = runs.first();
+        firstRun.road = sourceRoad;
+        firstRun.startPointIndex = source.pointIndex;
+        firstRun.endPointIndex = sourceShift(firstRun.endPointIndex);
+        auto& lastRun = runs.last();
+        const auto targetPointIndex = runs.size() == 1 ? sourceShift(target.pointIndex) : target.pointIndex;
+        lastRun.road.reset(new Model::Road(lastRun.road, targetPointIndex, target.projection.x, target.projection.y));
+        if(lastRun.startPointIndex >= targetPointIndex)
+            lastRun.startPointIndex++;
+        lastRun.endPointIndex = targetPointIndex;
+
+        for(auto itRun = runs.cbegin(); itRun != runs.cend(); ++itRun)
+        {
+            std::shared_ptr<RouteSegment> routeSegment(new RouteSegment(itRun->road, itRun->startPointIndex, itRun->endPointIndex));
+            addRouteSegmentToRoute(route, routeSegment, false);
+        }
+    }
+    if(route.isEmpty())
+        return OsmAnd::RouteCalculationResult("Route could not be calculated");
+
+    std::unique_ptr<RoutePlannerContext::CalculationContext> calculationContext(new RoutePlannerContext::CalculationContext(context));
+    if(!validateAllPointsConnected(route))
+        return OsmAnd::RouteCalculationResult("Calculated route has broken paths");
+    splitRoadsAndAttachRoadSegments(calculationContext.get(), route);
+    calculateTimeSpeedInRoute(calculationContext.get(), route);
+
+    addTurnInfoToRoute(leftSideNavigation, route);
+
+    printRouteInfo(route);
+    OsmAnd::RouteCalculationResult result;
+    result.list = route.toList();
+    context->_previouslyCalculatedRoute = result.list;
+    return result;
+}
+
+OsmAnd::MapMatchingResult OsmAnd::RoutePlanner::matchTrace(
+    OsmAnd::RoutePlannerContext* context,
+    const QList< std::pair<double, double> >& trace,
+    const MapMatchingParameters& parameters /*= MapMatchingParameters()*/,
+    const IQueryController* const controller /*= nullptr*/)
+{
+    assert(context != nullptr);
+
+    RouteMatrixGraph graph(context);
+    return matchTrace(graph, trace, parameters, controller);
+}
+
+void OsmAnd::RoutePlanner::matchTraces(
+    OsmAnd::RoutePlannerContext* context,
+    const QList< QList< std::pair<double, double> > >& traces,
+    const std::function<void (int traceIndex, const MapMatchingResult& result)>& resultCallback,
+    const MapMatchingParameters& parameters /*= MapMatchingParameters()*/,
+    unsigned int threadsCount /*= 0*/,
+    const IQueryController* const controller /*= nullptr*/)
+{
+    assert(context != nullptr);
+
+    if(traces.isEmpty())
+        return;
+
+    RouteMatrixGraph graph(context);
+
+    QMutex resultCallbackMutex;
+    const auto matchOneTrace =
+        [&graph, &traces, &parameters, controller, &resultCallbackMutex, &resultCallback]
+        (const int traceIndex)
+        {
+            const auto result = matchTrace(graph, traces[traceIndex], parameters, controller);
+            graph.trim();
+
+            QMutexLocker scopedLocker(&resultCallbackMutex);
+            resultCallback(traceIndex, result);
+        };
+
+    // Waiting for shared routing pool from its own worker may deadlock, so traces are matched on calling thread then
+    if(threadsCount == 0 && Concurrent::pools->routing->isCurrentThreadWorker())
+    {
+        for(int traceIndex = 0; traceIndex < traces.size(); traceIndex++)
+            matchOneTrace(traceIndex);
+        return;
+    }
+
+    std::unique_ptr<Concurrent::WorkersPool> ownPool;
+    if(threadsCount > 0)
+        ownPool.reset(new Concurrent::WorkersPool(QLatin1String("mapMatching"), threadsCount, Concurrent::pools->routing->getPriority()));
+    const auto pool = ownPool ? ownPool.get() : Concurrent::pools->routing.get();
+
+    QMutex pendingTracesMutex;
+    QWaitCondition pendingTracesCondition;
+    auto pendingTracesCount = 0;
+    for(int traceIndex = 0; traceIndex < traces.size(); traceIndex++)
+    {
+        {
+            QMutexLocker scopedLocker(&pendingTracesMutex);
+            pendingTracesCount++;
+        }
+        pool->start(new Concurrent::Task(
+            [&matchOneTrace, traceIndex]
+            (Concurrent::Task* task, QEventLoop& eventLoop)
+            {
+                matchOneTrace(traceIndex);
+            },
+            nullptr,
+            [&pendingTracesMutex, &pendingTracesCondition, &pendingTracesCount]
+            (Concurrent::Task* task, bool wasCancelled)
+            {
+                QMutexLocker scopedLocker(&pendingTracesMutex);
+                if(--pendingTracesCount == 0)
+                    pendingTracesCondition.wakeAll();
+            }));
+    }
+
+    {
+        QMutexLocker scopedLocker(&pendingTracesMutex);
+        while(pendingTracesCount > 0)
+            pendingTracesCondition.wait(&pendingTracesMutex);
+    }
+}
+
+OsmAnd::MapMatchingResult OsmAnd::RoutePlanner::matchTrace(
+    RouteMatrixGraph& graph,
+    const QList< std::pair<double, double> >& trace,
+    const MapMatchingParameters& parameters,
+    const IQueryController* const controller)
+{
+    MapMatchingResult result(trace.size());
+
+    // One step of Viterbi algorithm per point that has candidates. Scores are log-probabilities
+    // of the most probable path that ends at each candidate
+    struct Step
+    {
+        int pointIndex;
+        PointI point31;
+        QVector<RouteMatrixGraph::Anchor> candidates;
+        QVector<double> candidatesDistances;
+        QVector<double> scores;
+        QVector<int> predecessors;
+    };
+    QList<Step> chain;
+
+    // Backtrack most probable path of current chain into result
+    const auto finishChain =
+        [&result, &chain]
+        ()
+        {
+            if(chain.isEmpty())
+                return;
+
+            const auto& lastStep = chain.last();
+            auto candidateIndex = 0;
+            for(int idx = 1; idx < lastStep.scores.size(); idx++)
+            {
+                if(lastStep.scores[idx] > lastStep.scores[candidateIndex])
+                    candidateIndex = idx;
+            }
+            for(int stepIdx = chain.size() - 1; stepIdx >= 0 && candidateIndex >= 0; stepIdx--)
+            {
+                const auto& step = chain[stepIdx];
+                const auto& candidate = step.candidates[candidateIndex];
+
+                auto& matchedPoint = result.points[step.pointIndex];
+                matchedPoint.road = candidate.road;
+                matchedPoint.pointIndex = candidate.pointIndex;
+                matchedPoint.sqDistance = step.candidatesDistances[candidateIndex] * step.candidatesDistances[candidateIndex];
+                matchedPoint.x31 = candidate.projection.x;
+                matchedPoint.y31 = candidate.projection.y;
+                result.matchedCount++;
+
+                candidateIndex = step.predecessors[candidateIndex];
+            }
+
+            chain.clear();
+        };
+
+    const auto sqGpsSigma = parameters.gpsSigma * parameters.gpsSigma;
+    QHash<uint64_t, QList<RouteMatrixGraph::TargetAttachment> > attachments;
+    QVector<float> times;
+    QVector<float> distances;
+    for(int pointIndex = 0; pointIndex < trace.size(); pointIndex++)
+    {
+        if(controller && controller->isAborted())
+        {
+            result.warnMessage = "Aborted";
+            break;
+        }
+
+        const auto& point = trace[pointIndex];
+
+        Step step;
+        step.pointIndex = pointIndex;
+        step.point31.x = Utilities::get31TileNumberX(point.second);
+        step.point31.y = Utilities::get31TileNumberY(point.first);
+        graph.snapCandidates(point, parameters.candidatesCount, parameters.maxCandidateDistance, step.candidates, step.candidatesDistances);
+        if(step.candidates.isEmpty())
+            continue;
+        const auto candidatesCount = step.candidates.size();
+
+        // Emission: GPS noise is assumed to be normally distributed
+        QVector<double> emissions(candidatesCount);
+        for(int candidateIdx = 0; candidateIdx < candidatesCount; candidateIdx++)
+        {
+            const auto distance = step.candidatesDistances[candidateIdx];
+            emissions[candidateIdx] = -0.5 * distance * distance / sqGpsSigma;
+        }
+
+        step.scores.fill(-std::numeric_limits<double>::infinity(), candidatesCount);
+        step.predecessors.fill(-1, candidatesCount);
+        if(!chain.isEmpty())
+        {
+            const auto& prevStep = chain.last();
+
+            // Transition: route between candidates should be about as long as straight line between GPS points
+            const auto straightDistance = Utilities::distance31(prevStep.point31, step.point31);
+            const float maxRouteDistance = straightDistance * parameters.maxRouteDistanceFactor + 2.0 * parameters.maxCandidateDistance;
+            attachments.clear();
+            graph.attachTargets(step.candidates, attachments);
+            for(int prevCandidateIdx = 0; prevCandidateIdx < prevStep.candidates.size(); prevCandidateIdx++)
+            {
+                const auto prevScore = prevStep.scores[prevCandidateIdx];
+                if(prevScore == -std::numeric_limits<double>::infinity())
+                    continue;
+                const auto& prevCandidate = prevStep.candidates[prevCandidateIdx];
+
+                times.fill(-1.0f, candidatesCount);
+                distances.fill(-1.0f, candidatesCount);
+                QString warning;
+                if(!graph.search(prevCandidate, step.candidates, attachments, maxRouteDistance, times.data(), distances.data(), controller, warning))
+                {
+                    result.warnMessage = warning;
+                    finishChain();
+                    return result;
+                }
+
+                for(int candidateIdx = 0; candidateIdx < candidatesCount; candidateIdx++)
+                {
+                    const auto& candidate = step.candidates[candidateIdx];
+
+                    double routeDistance = distances[candidateIdx];
+                    if(routeDistance < 0.0)
+                    {
+                        // GPS jitter may move projection slightly backwards on one-way segment, which is not routable
+                        if(candidate.road->id != prevCandidate.road->id || candidate.pointIndex != prevCandidate.pointIndex)
+                            continue;
+                        routeDistance = Utilities::distance31(prevCandidate.projection, candidate.projection);
+                        if(routeDistance > parameters.gpsSigma)
+                            continue;
+                    }
+
+                    const auto transition = -qAbs(routeDistance - straightDistance) / parameters.transitionBeta;
+                    const auto score = prevScore + transition + emissions[candidateIdx];
+                    if(score > step.scores[candidateIdx])
+                    {
+                        step.scores[candidateIdx] = score;
+                        step.predecessors[candidateIdx] = prevCandidateIdx;
+                    }
+                }
+            }
+
+            // No candidate is reachable from previous ones, so chain is broken here
+            auto isReachable = false;
+            for(int candidateIdx = 0; candidateIdx < candidatesCount && !isReachable; candidateIdx++)
+                isReachable = step.predecessors[candidateIdx] >= 0;
+            if(!isReachable)
+            {
+                finishChain();
+                result.breaksCount++;
+            }
+        }
+        if(chain.isEmpty())
+        {
+            step.scores = emissions;
+            step.predecessors.fill(-1, candidatesCount);
+        }
+
+        chain.push_back(qMove(step));
+    }
+    finishChain();
+
+    return result;
+}
@@ -5,6 +5,8 @@
 
 #include "OsmAndCore/Utilities.h"
 #include "ObfReader.h"
+#include "RoadSegmentsIndex.h"
+#include "RoutingTilesPrefetcher.h"
 
 OsmAnd::RoutePlannerContext::RoutePlannerContext(
     const QList< std::shared_ptr<ObfReader> >& sources,
@@ -27,6 +29,9 @@ OsmAnd::RoutePlannerContext::RoutePlannerContext(
     _heuristicCoefficient = Utilities::parseArbitraryFloat(configuration->resolveAttribute(vehicle, "heuristicCoefficient"), 1.0f);
     _planRoadDirection = Utilities::parseArbitraryInt(configuration->resolveAttribute(vehicle, "planRoadDirection"), 0);
     _roadTilesLoadingZoomLevel = Utilities::parseArbitraryUInt(configuration->resolveAttribute(vehicle, "zoomToLoadTiles"), DefaultRoadTilesLoadingZoomLevel);
+    _prefetchTilesAhead = Utilities::parseArbitraryUInt(configuration->resolveAttribute(vehicle, "prefetchTilesAhead"), DefaultPrefetchTilesAhead);
+    if(_prefetchTilesAhead > 0)
+        _tilesPrefetcher.reset(new RoutingTilesPrefetcher());
 
     for(auto itSource = sources.cbegin(); itSource != sources.cend(); ++itSource)
     {
@@ -55,6 +60,10 @@ OsmAnd::RoutePlannerContext::RoutingSubsectionContext::~RoutingSubsectionContext
 }
 
 
+std::shared_ptr<const OsmAnd::RouteStatistics> OsmAnd::RoutePlannerContext::getRouteStatistics() const
+{
+    return _routeStatistics;
+}
 
 uint32_t OsmAnd::RoutePlannerContext::getCurrentlyLoadedTiles() {
     uint32_t cnt = 0;
@@ -115,8 +124,7 @@ void OsmAnd::RoutePlannerContext::unloadUnusedTiles(size_t memoryTarget) {
 
     }
     if(_routeStatistics) {
-        OsmAnd::LogPrintf(OsmAnd::LogSeverityLevel::Info, "Unloaded tiles %d (loaded prevUnloaded %d, currently loaded %d)",  _routeStatistics->unloadedTiles,  _routeStatistics->loadedPrevUnloadedTiles, getCurrentlyLoadedTiles());
-        OsmAnd::LogFlush();
+        OSMAND_LOG(Info, "Unloaded tiles %d (loaded prevUnloaded %d, currently loaded %d)",  _routeStatistics->unloadedTiles,  _routeStatistics->loadedPrevUnloadedTiles, getCurrentlyLoadedTiles());
     }
     for(std::shared_ptr<OsmAnd::RoutePlannerContext::RoutingSubsectionContext> t : _subsectionsContexts) {
         t->_access /= 3;
@@ -125,6 +133,8 @@ void OsmAnd::RoutePlannerContext::unloadUnusedTiles(size_t memoryTarget) {
 
 void OsmAnd::RoutePlannerContext::RoutingSubsectionContext::registerRoad( const std::shared_ptr<const Model::Road>& road )
 {
+    _segmentsIndex.reset();
+
     uint32_t idx = 0;
     for(auto itPoint = road->points.cbegin(); itPoint != road->points.cend(); ++itPoint, idx++)
     {
@@ -203,6 +213,21 @@ void OsmAnd::RoutePlannerContext::RoutingSubsectionContext::unload()
 {
     _mixedLoadsCounter = -qAbs(_mixedLoadsCounter);
     _roadSegments.clear();
+    _segmentsIndex.reset();
+}
+
+std::shared_ptr<const OsmAnd::RoadSegmentsIndex> OsmAnd::RoutePlannerContext::RoutingSubsectionContext::obtainSegmentsIndex()
+{
+    if(!_segmentsIndex)
+    {
+        QList< std::shared_ptr<const Model::Road> > roads;
+        QMap<uint64_t, std::shared_ptr<const Model::Road> > duplicates;
+        collectRoads(roads, &duplicates);
+
+        _segmentsIndex.reset(new RoadSegmentsIndex(roads));
+    }
+
+    return _segmentsIndex;
 }
 
 std::shared_ptr<OsmAnd::RoutePlannerContext::RouteCalculationSegment> OsmAnd::RoutePlannerContext::RoutingSubsectionContext::loadRouteCalculationSegment(
@@ -239,12 +264,14 @@ std::shared_ptr<OsmAnd::RoutePlannerContext::RouteCalculationSegment> OsmAnd::Ro
 }
 
 OsmAnd::RoutePlannerContext::CalculationContext::CalculationContext( RoutePlannerContext* owner )
-    : owner(owner)
+    : _partialRecalculation(false)
+    , owner(owner)
 {
 }
 
 OsmAnd::RoutePlannerContext::CalculationContext::~CalculationContext()
 {
+    RoutePlanner::cancelTilesPrefetch(this);
 }
 
 OsmAnd::RoutePlannerContext::RouteCalculationSegment::RouteCalculationSegment( const std::shared_ptr<const Model::Road>& road_, uint32_t pointIndex )
@@ -0,0 +1,165 @@
+/**
+* @file
+*
+* @section LICENSE
+*
+* OsmAnd - Android navigation software based on OSM maps.
+* Copyright (C) 2010-2013  OsmAnd Authors listed in AUTHORS file
+*
+* This program is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+
+* You should have received a copy of the GNU General Public License
+* along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "RoutingTilesPrefetcher.h"
+
+#include "ObfReader.h"
+#include "ObfRoutingSectionReader.h"
+#include "ObfRoutingSectionInfo.h"
+#include "Road.h"
+#include "Concurrent.h"
+
+OsmAnd::RoutingTilesPrefetcher::RoutingTilesPrefetcher()
+    : _state(new State())
+{
+}
+
+OsmAnd::RoutingTilesPrefetcher::~RoutingTilesPrefetcher()
+{
+    cancel();
+}
+
+void OsmAnd::RoutingTilesPrefetcher::State::releaseReader( const std::shared_ptr<ObfReader>& origin, const std::shared_ptr<ObfReader>& reader )
+{
+    auto& originFreeReaders = freeReaders[origin.get()];
+    if(originFreeReaders.size() < MaxFreeReadersPerSource)
+        originFreeReaders.push_back(reader);
+}
+
+std::shared_ptr<OsmAnd::ObfReader> OsmAnd::RoutingTilesPrefetcher::obtainReader( const std::shared_ptr<ObfReader>& origin )
+{
+    {
+        QMutexLocker scopedLocker(&_state->mutex);
+
+        const auto itFreeReaders = _state->freeReaders.find(origin.get());
+        if(itFreeReaders != _state->freeReaders.end() && !itFreeReaders->isEmpty())
+            return itFreeReaders->takeLast();
+    }
+
+    return origin->createSiblingReader();
+}
+
+void OsmAnd::RoutingTilesPrefetcher::decode(
+    const std::shared_ptr<State>& state,
+    const std::shared_ptr<Entry>& entry,
+    const std::shared_ptr<ObfReader>& origin,
+    const std::shared_ptr<ObfReader>& reader,
+    const std::shared_ptr<const ObfRoutingSubsectionInfo>& subsection )
+{
+    {
+        QMutexLocker scopedLocker(&state->mutex);
+
+        // Entry may have been taken while queued or cancelled
+        const auto itEntry = state->entries.constFind(subsection.get());
+        if(itEntry == state->entries.cend() || *itEntry != entry)
+        {
+            state->releaseReader(origin, reader);
+            return;
+        }
+        entry->state = EntryState::Decoding;
+    }
+
+    QList< std::shared_ptr<const Model::Road> > roads;
+    ObfRoutingSectionReader::loadSubsectionData(reader, subsection, &roads);
+
+    {
+        QMutexLocker scopedLocker(&state->mutex);
+
+        entry->roads = qMove(roads);
+        entry->state = EntryState::Ready;
+        state->releaseReader(origin, reader);
+        state->entryReadyCondition.wakeAll();
+    }
+}
+
+bool OsmAnd::RoutingTilesPrefetcher::prefetch( const std::shared_ptr<ObfReader>& origin, const std::shared_ptr<const ObfRoutingSubsectionInfo>& subsection )
+{
+    if(isScheduled(subsection.get()))
+        return false;
+
+    const auto reader = obtainReader(origin);
+    if(!reader)
+        return false;
+
+    const std::shared_ptr<Entry> entry(new Entry());
+    entry->state = EntryState::Queued;
+    {
+        QMutexLocker scopedLocker(&_state->mutex);
+
+        _state->entries.insert(subsection.get(), entry);
+    }
+
+    const auto state = _state;
+    Concurrent::pools->localStorage->start(new Concurrent::Task(
+        [state, entry, origin, reader, subsection]
+        (Concurrent::Task* task, QEventLoop& eventLoop)
+        {
+            decode(state, entry, origin, reader, subsection);
+        }));
+
+    return true;
+}
+
+bool OsmAnd::RoutingTilesPrefetcher::isScheduled( const ObfRoutingSubsectionInfo* subsection ) const
+{
+    QMutexLocker scopedLocker(&_state->mutex);
+
+    return _state->entries.contains(subsection);
+}
+
+bool OsmAnd::RoutingTilesPrefetcher::take( const ObfRoutingSubsectionInfo* subsection, QList< std::shared_ptr<const Model::Road> >& outRoads, bool* outDropped /*= nullptr*/ )
+{
+    QMutexLocker scopedLocker(&_state->mutex);
+
+    if(outDropped)
+        *outDropped = false;
+
+    const auto itEntry = _state->entries.find(subsection);
+    if(itEntry == _state->entries.end())
+        return false;
+    const auto entry = *itEntry;
+    _state->entries.erase(itEntry);
+
+    // Decoding that has already started is running on a worker, so waiting for it can't block on pool itself
+    if(entry->state == EntryState::Queued)
+    {
+        if(outDropped)
+            *outDropped = true;
+        return false;
+    }
+    while(entry->state != EntryState::Ready)
+        _state->entryReadyCondition.wait(&_state->mutex);
+
+    outRoads = qMove(entry->roads);
+    return true;
+}
+
+unsigned int OsmAnd::RoutingTilesPrefetcher::cancel()
+{
+    QMutexLocker scopedLocker(&_state->mutex);
+
+    const auto droppedCount = _state->entries.size();
+    _state->entries.clear();
+    _state->freeReaders.clear();
+
+    return droppedCount;
+}
@@ -0,0 +1,108 @@
+/**
+* @file
+*
+* @section LICENSE
+*
+* OsmAnd - Android navigation software based on OSM maps.
+* Copyright (C) 2010-2013  OsmAnd Authors listed in AUTHORS file
+*
+* This program is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+
+* You should have received a copy of the GNU General Public License
+* along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef _OSMAND_CORE_ROUTING_TILES_PREFETCHER_H_
+#define _OSMAND_CORE_ROUTING_TILES_PREFETCHER_H_
+
+#include <OsmAndCore/stdlib_common.h>
+
+#include <OsmAndCore/QtExtensions.h>
+#include <QMutex>
+#include <QWaitCondition>
+#include <QHash>
+#include <QList>
+
+#include <OsmAndCore.h>
+#include <CommonTypes.h>
+
+namespace OsmAnd {
+
+    class ObfReader;
+    class ObfRoutingSubsectionInfo;
+    namespace Model {
+        class Road;
+    }
+
+    // Decodes roads of routing subsections on background threads, before route search asks for them.
+    // Each task reads using own sibling reader of subsection origin, since single reader can not be shared between threads.
+    // Roads are not filtered by routing profile: that's done by consumer.
+    class RoutingTilesPrefetcher
+    {
+        Q_DISABLE_COPY(RoutingTilesPrefetcher);
+    private:
+        enum {
+            // Sibling readers kept open per source for next tasks, others are closed right after decoding
+            MaxFreeReadersPerSource = 2,
+        };
+        enum class EntryState
+        {
+            Queued,
+            Decoding,
+            Ready,
+        };
+        struct Entry
+        {
+            EntryState state;
+            QList< std::shared_ptr<const Model::Road> > roads;
+        };
+        // Shared with tasks, so that prefetcher doesn't have to wait for tasks that are still queued in pool
+        struct State
+        {
+            QMutex mutex;
+            QWaitCondition entryReadyCondition;
+            QHash< const ObfRoutingSubsectionInfo*, std::shared_ptr<Entry> > entries;
+            QHash< const ObfReader*, QList< std::shared_ptr<ObfReader> > > freeReaders;
+
+            void releaseReader(const std::shared_ptr<ObfReader>& origin, const std::shared_ptr<ObfReader>& reader);
+        };
+
+        const std::shared_ptr<State> _state;
+
+        std::shared_ptr<ObfReader> obtainReader(const std::shared_ptr<ObfReader>& origin);
+        static void decode(
+            const std::shared_ptr<State>& state,
+            const std::shared_ptr<Entry>& entry,
+            const std::shared_ptr<ObfReader>& origin,
+            const std::shared_ptr<ObfReader>& reader,
+            const std::shared_ptr<const ObfRoutingSubsectionInfo>& subsection);
+    protected:
+    public:
+        RoutingTilesPrefetcher();
+        virtual ~RoutingTilesPrefetcher();
+
+        // Schedules decoding of subsection. Returns false if it's already scheduled or origin can't be read from other thread
+        bool prefetch(const std::shared_ptr<ObfReader>& origin, const std::shared_ptr<const ObfRoutingSubsectionInfo>& subsection);
+        bool isScheduled(const ObfRoutingSubsectionInfo* subsection) const;
+
+        // Hands over decoded roads of subsection, waiting for decoding to finish if it has already started.
+        // Returns false if subsection was not scheduled, or it's still queued (it's faster to read it in place then).
+        // In the latter case queued subsection is dropped, which is reported by outDropped
+        bool take(const ObfRoutingSubsectionInfo* subsection, QList< std::shared_ptr<const Model::Road> >& outRoads, bool* outDropped = nullptr);
+
+        // Drops all subsections that were not taken and closes idle readers, without waiting for tasks:
+        // queued ones will find their entries gone and finish without decoding. Returns number of dropped subsections
+        unsigned int cancel();
+    };
+
+} // namespace OsmAnd
+
+#endif // _OSMAND_CORE_ROUTING_TILES_PREFETCHER_H_
@@ -1,17 +1,112 @@
 #include "TileDB.h"
 
 #include <cassert>
+#include <algorithm>
+#include <limits>
 
 #include <OsmAndCore/QtExtensions.h>
+#include <QThread>
+#include <QThreadStorage>
+#include <QAtomicInt>
 #include <QtSql>
 
 #include "Logging.h"
 #include "Utilities.h"
 
-OsmAnd::TileDB::TileDB( const QDir& dataPath_, const QString& indexFilename_/* = QString()*/ )
+struct OsmAnd::TileDB::FileEntry
+{
+    struct Connection
+    {
+        Connection(const QString& connectionName, const QString& dbFilename)
+            : name(connectionName)
+        {
+            db = QSqlDatabase::addDatabase("QSQLITE", name);
+            db.setDatabaseName(dbFilename);
+            db.setConnectOptions("QSQLITE_OPEN_READONLY");
+            if(!db.open())
+            {
+                LogPrintf(LogSeverityLevel::Error, "Failed to open TileDB from '%s': %s", qPrintable(dbFilename), qPrintable(db.lastError().text()));
+                return;
+            }
+
+            selectTileQuery.reset(new QSqlQuery(db));
+            if(!selectTileQuery->prepare("SELECT data FROM tiles WHERE x=? AND y=? AND zoom=?"))
+                selectTileQuery.reset();
+        }
+
+        ~Connection()
+        {
+            selectTileQuery.reset();
+            if(db.isOpen())
+                db.close();
+            db = QSqlDatabase();
+            QSqlDatabase::removeDatabase(name);
+        }
+
+        const QString name;
+        QSqlDatabase db;
+        std::unique_ptr<QSqlQuery> selectTileQuery;
+    };
+
+    // Qt allows to use SQL connection only from thread that created it, so every thread owns its connections.
+    // They are closed on that thread: when it exits, or on its next request after file entry is gone (e.g. index was rebuilt)
+    struct ThreadConnections
+    {
+        struct Item
+        {
+            std::weak_ptr<FileEntry> file;
+            std::shared_ptr<Connection> connection;
+        };
+        QHash< const FileEntry*, Item > items;
+    };
+    static QThreadStorage<ThreadConnections*> threadsConnections;
+    static QAtomicInt connectionsCounter;
+
+    FileEntry(const QString& filename_)
+        : filename(filename_)
+    {
+    }
+
+    const QString filename;
+
+    static std::shared_ptr<Connection> obtainConnection(const std::shared_ptr<FileEntry>& file)
+    {
+        if(!threadsConnections.hasLocalData())
+            threadsConnections.setLocalData(new ThreadConnections());
+        auto& items = threadsConnections.localData()->items;
+
+        auto itItem = items.find(file.get());
+        if(itItem != items.end() && itItem->file.lock() == file)
+            return itItem->connection;
+
+        // Close connections of files that are gone, since their addresses may be reused
+        for(auto itOtherItem = items.begin(); itOtherItem != items.end();)
+        {
+            if(itOtherItem->file.expired())
+                itOtherItem = items.erase(itOtherItem);
+            else
+                ++itOtherItem;
+        }
+
+        const auto connectionName = QString("tiledb-sqlite-ro:%1#%2")
+            .arg(file->filename)
+            .arg(connectionsCounter.fetchAndAddOrdered(1));
+        ThreadConnections::Item item;
+        item.file = file;
+        item.connection.reset(new Connection(connectionName, file->filename));
+        items.insert(file.get(), item);
+        return item.connection;
+    }
+};
+
+QThreadStorage<OsmAnd::TileDB::FileEntry::ThreadConnections*> OsmAnd::TileDB::FileEntry::threadsConnections;
+QAtomicInt OsmAnd::TileDB::FileEntry::connectionsCounter(0);
+
+OsmAnd::TileDB::TileDB( const QDir& dataPath_, const QString& indexFilename_/* = QString()*/, const AccessMode accessMode_ /*= AccessMode::Serialized*/ )
     : _indexMutex(QMutex::Recursive)
     , dataPath(dataPath_)
     , indexFilename(indexFilename_)
+    , accessMode(accessMode_)
 {
     auto indexConnectionName = QLatin1String("tiledb-sqlite-index:") + dataPath_.absolutePath();
 
@@ -160,6 +255,12 @@ bool OsmAnd::TileDB::rebuildIndex()
 
     _indexDb.commit();
 
+    // In-memory index will be reloaded on next request
+    {
+        QWriteLocker scopedLocker(&_inMemoryIndexLock);
+        _inMemoryIndex.reset();
+    }
+
     auto endTimestamp = std::chrono::steady_clock::now();
     auto duration = std::chrono::duration_cast< std::chrono::duration<uint64_t, std::milli> >(endTimestamp - beginTimestamp).count();
     LogPrintf(LogSeverityLevel::Info, "Finished indexing '%s', took %lldms, average %lldms/db", qPrintable(dataPath.absolutePath()), duration, duration / files.length());
@@ -169,6 +270,22 @@ bool OsmAnd::TileDB::rebuildIndex()
 
 bool OsmAnd::TileDB::obtainTileData( const TileId tileId, const ZoomLevel zoom, QByteArray& data )
 {
+    if(accessMode == AccessMode::Concurrent)
+    {
+        const auto index = obtainInMemoryIndex();
+        if(!index)
+            return false;
+
+        QList<int> filesIndices;
+        collectFilesWithTile(*index, tileId, zoom, filesIndices);
+        for(auto itFileIndex = filesIndices.cbegin(); itFileIndex != filesIndices.cend(); ++itFileIndex)
+        {
+            if(readTileData(index->files[*itFileIndex], tileId, zoom, data))
+                return true;
+        }
+        return false;
+    }
+
     QMutexLocker scopeLock(&_indexMutex);
 
     // Check that index is available
@@ -228,3 +345,216 @@ bool OsmAnd::TileDB::obtainTileData( const TileId tileId, const ZoomLevel zoom,
     
     return hit;
 }
+
+bool OsmAnd::TileDB::obtainTilesData( const QList<TileId>& tileIds, const ZoomLevel zoom, QHash<uint64_t, QByteArray>& outData )
+{
+    if(accessMode != AccessMode::Concurrent)
+    {
+        bool anyHit = false;
+        for(auto itTileId = tileIds.cbegin(); itTileId != tileIds.cend(); ++itTileId)
+        {
+            QByteArray data;
+            if(!obtainTileData(*itTileId, zoom, data))
+                continue;
+            outData.insert(*itTileId, data);
+            anyHit = true;
+        }
+        return anyHit;
+    }
+
+    const auto index = obtainInMemoryIndex();
+    if(!index)
+        return false;
+
+    // Group tiles by file, so that each file is queried once per round. Tiles not found in a file
+    // are moved to next file that covers them in next round.
+    QHash< int, QList< std::pair<TileId, QList<int> > > > pendingTilesByFile;
+    for(auto itTileId = tileIds.cbegin(); itTileId != tileIds.cend(); ++itTileId)
+    {
+        QList<int> filesIndices;
+        collectFilesWithTile(*index, *itTileId, zoom, filesIndices);
+        if(filesIndices.isEmpty())
+            continue;
+        const auto fileIndex = filesIndices.takeFirst();
+        pendingTilesByFile[fileIndex].push_back(std::make_pair(*itTileId, filesIndices));
+    }
+
+    bool anyHit = false;
+    while(!pendingTilesByFile.isEmpty())
+    {
+        QHash< int, QList< std::pair<TileId, QList<int> > > > nextPendingTilesByFile;
+        for(auto itFileTiles = pendingTilesByFile.cbegin(); itFileTiles != pendingTilesByFile.cend(); ++itFileTiles)
+        {
+            const auto& file = index->files[itFileTiles.key()];
+            for(auto itTile = itFileTiles->cbegin(); itTile != itFileTiles->cend(); ++itTile)
+            {
+                const auto& tileId = itTile->first;
+
+                QByteArray data;
+                if(readTileData(file, tileId, zoom, data))
+                {
+                    outData.insert(tileId, data);
+                    anyHit = true;
+                    continue;
+                }
+
+                auto filesIndices = itTile->second;
+                if(filesIndices.isEmpty())
+                    continue;
+                const auto fileIndex = filesIndices.takeFirst();
+                nextPendingTilesByFile[fileIndex].push_back(std::make_pair(tileId, filesIndices));
+            }
+        }
+        pendingTilesByFile = qMove(nextPendingTilesByFile);
+    }
+
+    return anyHit;
+}
+
+std::shared_ptr<const OsmAnd::TileDB::InMemoryIndex> OsmAnd::TileDB::obtainInMemoryIndex()
+{
+    {
+        QReadLocker scopedLocker(&_inMemoryIndexLock);
+
+        if(_inMemoryIndex)
+            return _inMemoryIndex;
+    }
+
+    QMutexLocker scopeLock(&_indexMutex);
+
+    // Check that index is available
+    if(!_indexDb.isOpen())
+    {
+        if(!openIndex())
+            return nullptr;
+    }
+
+    // Index may have been loaded by other thread while waiting for lock
+    {
+        QReadLocker scopedLocker(&_inMemoryIndexLock);
+
+        if(_inMemoryIndex)
+            return _inMemoryIndex;
+    }
+
+    const std::shared_ptr<InMemoryIndex> index(new InMemoryIndex());
+
+    QHash<qlonglong, int> filesIndicesById;
+    QSqlQuery filesQuery("SELECT id, filename FROM tiledb_files", _indexDb);
+    if(!filesQuery.exec())
+    {
+        LogPrintf(LogSeverityLevel::Error, "Failed to load TileDB index of '%s': %s", qPrintable(dataPath.absolutePath()), qPrintable(filesQuery.lastError().text()));
+        return nullptr;
+    }
+    while(filesQuery.next())
+    {
+        filesIndicesById.insert(filesQuery.value(0).toLongLong(), index->files.size());
+        index->files.push_back(std::shared_ptr<FileEntry>(new FileEntry(filesQuery.value(1).toString())));
+    }
+
+    QSqlQuery entriesQuery("SELECT xMin, yMin, xMax, yMax, zoom, id FROM tiledb_index", _indexDb);
+    if(!entriesQuery.exec())
+    {
+        LogPrintf(LogSeverityLevel::Error, "Failed to load TileDB index of '%s': %s", qPrintable(dataPath.absolutePath()), qPrintable(entriesQuery.lastError().text()));
+        return nullptr;
+    }
+    while(entriesQuery.next())
+    {
+        const auto zoom = entriesQuery.value(4).toInt();
+        const auto itFileIndex = filesIndicesById.constFind(entriesQuery.value(5).toLongLong());
+        if(zoom < MinZoomLevel || zoom > MaxZoomLevel || itFileIndex == filesIndicesById.cend())
+            continue;
+
+        IndexEntry entry;
+        entry.bbox.left = entriesQuery.value(0).toInt();
+        entry.bbox.top = entriesQuery.value(1).toInt();
+        entry.bbox.right = entriesQuery.value(2).toInt();
+        entry.bbox.bottom = entriesQuery.value(3).toInt();
+        entry.fileIndex = *itFileIndex;
+        entry.subtreeMaxRight = entry.bbox.right;
+        index->entries[zoom].push_back(entry);
+    }
+    for(auto itEntries = index->entries.begin(); itEntries != index->entries.end(); ++itEntries)
+    {
+        std::sort(itEntries->begin(), itEntries->end(), [](const IndexEntry& l, const IndexEntry& r) -> bool
+        {
+            return l.bbox.left < r.bbox.left;
+        });
+        buildIndexEntriesTree(*itEntries, 0, itEntries->size());
+    }
+
+    QWriteLocker scopedLocker(&_inMemoryIndexLock);
+    _inMemoryIndex = index;
+    return _inMemoryIndex;
+}
+
+int32_t OsmAnd::TileDB::buildIndexEntriesTree( QVector<IndexEntry>& entries, const int begin, const int end )
+{
+    if(begin >= end)
+        return std::numeric_limits<int32_t>::min();
+
+    const auto middle = begin + (end - begin) / 2;
+    auto& entry = entries[middle];
+    entry.subtreeMaxRight = qMax(entry.bbox.right, qMax(
+        buildIndexEntriesTree(entries, begin, middle),
+        buildIndexEntriesTree(entries, middle + 1, end)));
+    return entry.subtreeMaxRight;
+}
+
+void OsmAnd::TileDB::collectIndexEntriesWithTile( const QVector<IndexEntry>& entries, const int begin, const int end, const TileId tileId, QList<int>& outFilesIndices )
+{
+    if(begin >= end)
+        return;
+
+    const auto middle = begin + (end - begin) / 2;
+    const auto& entry = entries[middle];
+
+    // No entry of this subtree reaches the tile
+    if(entry.subtreeMaxRight < tileId.x)
+        return;
+
+    // Traverse in order, so files are collected sorted by left edge
+    collectIndexEntriesWithTile(entries, begin, middle, tileId, outFilesIndices);
+
+    // Entries are sorted by left edge, so none of following can contain this tile
+    if(entry.bbox.left > tileId.x)
+        return;
+
+    if(entry.bbox.right >= tileId.x && entry.bbox.top <= tileId.y && entry.bbox.bottom >= tileId.y)
+    {
+        if(!outFilesIndices.contains(entry.fileIndex))
+            outFilesIndices.push_back(entry.fileIndex);
+    }
+
+    collectIndexEntriesWithTile(entries, middle + 1, end, tileId, outFilesIndices);
+}
+
+void OsmAnd::TileDB::collectFilesWithTile( const InMemoryIndex& index, const TileId tileId, const ZoomLevel zoom, QList<int>& outFilesIndices ) const
+{
+    const auto& entries = index.entries[zoom];
+    collectIndexEntriesWithTile(entries, 0, entries.size(), tileId, outFilesIndices);
+}
+
+bool OsmAnd::TileDB::readTileData( const std::shared_ptr<FileEntry>& file, const TileId tileId, const ZoomLevel zoom, QByteArray& data )
+{
+    const auto connection = FileEntry::obtainConnection(file);
+    if(!connection->selectTileQuery)
+        return false;
+
+    auto& query = *connection->selectTileQuery;
+    query.addBindValue(tileId.x);
+    query.addBindValue(tileId.y);
+    query.addBindValue(static_cast<int>(zoom));
+    if(!query.exec())
+        return false;
+
+    bool hit = false;
+    if(query.next())
+    {
+        data = query.value(0).toByteArray();
+        hit = true;
+    }
+    query.finish();
+
+    return hit;
+}
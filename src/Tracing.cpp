@@ -0,0 +1,474 @@
+#include "Tracing.h"
+
+#include <cassert>
+#include <cmath>
+
+#include <QAtomicInt>
+#include <QElapsedTimer>
+#include <QMutex>
+#include <QThread>
+#include <QThreadStorage>
+#include <QVector>
+#include <QHash>
+#include <QMap>
+#include <QFile>
+#include <QByteArray>
+#include <QCoreApplication>
+
+namespace
+{
+    struct RawEvent
+    {
+        const char* name;
+        const char* category;
+        QString details;
+        quintptr threadId;
+        qint64 beginTime;
+        qint64 duration;
+    };
+
+    // Spans are recorded to buffer of their thread, so that threads do not contend for global lock.
+    // Buffers are merged into global state when they fill up and whenever collected data is requested
+    struct ThreadBuffer
+    {
+        enum {
+            FlushThreshold = 256
+        };
+
+        ThreadBuffer()
+            : threadId(reinterpret_cast<quintptr>(QThread::currentThreadId()))
+        {
+            events.reserve(FlushThreshold);
+        }
+
+        // Taken by owning thread for each span, and by other threads only while merging
+        QMutex lock;
+        const quintptr threadId;
+        QVector<RawEvent> events;
+        QHash<const char*, OsmAnd::Tracing::StageStatistics> statistics;
+    };
+
+    struct TracingState
+    {
+        enum {
+            DefaultBufferCapacity = 65536
+        };
+
+        TracingState()
+            : enabled(0)
+            , bufferCapacity(DefaultBufferCapacity)
+            , nextEventIndex(0)
+        {
+            clock.start();
+        }
+
+        QAtomicInt enabled;
+        QElapsedTimer clock;
+
+        QMutex lock;
+        unsigned int bufferCapacity;
+        QVector<RawEvent> events;
+        int nextEventIndex;
+
+        // Same name in different translation units may have different addresses, these are merged on request
+        QHash<const char*, OsmAnd::Tracing::StageStatistics> statistics;
+
+        // Buffers of finished threads are dropped once they are merged
+        QList< std::shared_ptr<ThreadBuffer> > threadBuffers;
+    };
+}
+
+static TracingState _state;
+static QThreadStorage< std::shared_ptr<ThreadBuffer> > _threadBuffer;
+
+static unsigned int getBucketIndex(const qint64 duration)
+{
+    auto microseconds = static_cast<quint64>(duration / 1000);
+    unsigned int bucketIndex = 0;
+    while(microseconds > 1 && bucketIndex < OsmAnd::Tracing::StageStatistics::BucketsCount - 1)
+    {
+        microseconds >>= 1;
+        bucketIndex++;
+    }
+    return bucketIndex;
+}
+
+static void mergeStatistics(OsmAnd::Tracing::StageStatistics& target, const OsmAnd::Tracing::StageStatistics& source)
+{
+    if(target.count == 0)
+    {
+        const auto name = target.name;
+        target = source;
+        target.name = name;
+        return;
+    }
+    if(source.count == 0)
+        return;
+
+    target.minTime = qMin(target.minTime, source.minTime);
+    target.maxTime = qMax(target.maxTime, source.maxTime);
+    target.totalTime += source.totalTime;
+    target.count += source.count;
+    for(auto bucketIndex = 0u; bucketIndex < OsmAnd::Tracing::StageStatistics::BucketsCount; bucketIndex++)
+        target.buckets[bucketIndex] += source.buckets[bucketIndex];
+}
+
+// Expects global lock to be held
+static void mergeThreadBuffer(ThreadBuffer& threadBuffer)
+{
+    QMutexLocker scopedLocker(&threadBuffer.lock);
+
+    for(auto itStatistics = threadBuffer.statistics.cbegin(); itStatistics != threadBuffer.statistics.cend(); ++itStatistics)
+        mergeStatistics(_state.statistics[itStatistics.key()], itStatistics.value());
+    threadBuffer.statistics.clear();
+
+    if(_state.bufferCapacity == 0)
+    {
+        threadBuffer.events.clear();
+        return;
+    }
+    for(auto itEvent = threadBuffer.events.begin(); itEvent != threadBuffer.events.end(); ++itEvent)
+    {
+        if(_state.events.size() < static_cast<int>(_state.bufferCapacity))
+        {
+            _state.events.push_back(qMove(*itEvent));
+        }
+        else
+        {
+            _state.events[_state.nextEventIndex] = qMove(*itEvent);
+            _state.nextEventIndex = (_state.nextEventIndex + 1) % _state.events.size();
+        }
+    }
+    threadBuffer.events.clear();
+}
+
+// Expects global lock to be held
+static void mergeThreadBuffers()
+{
+    auto itThreadBuffer = _state.threadBuffers.begin();
+    while(itThreadBuffer != _state.threadBuffers.end())
+    {
+        mergeThreadBuffer(**itThreadBuffer);
+
+        // Only registry references buffer of finished thread
+        if(itThreadBuffer->use_count() == 1)
+            itThreadBuffer = _state.threadBuffers.erase(itThreadBuffer);
+        else
+            ++itThreadBuffer;
+    }
+}
+
+static ThreadBuffer& getThreadBuffer()
+{
+    if(!_threadBuffer.hasLocalData())
+    {
+        const std::shared_ptr<ThreadBuffer> threadBuffer(new ThreadBuffer());
+        _threadBuffer.setLocalData(threadBuffer);
+
+        QMutexLocker scopedLocker(&_state.lock);
+        _state.threadBuffers.push_back(threadBuffer);
+    }
+    return *_threadBuffer.localData();
+}
+
+static void recordEvent(const char* name, const char* category, QString&& details, const qint64 beginTime, const qint64 endTime)
+{
+    const auto duration = endTime - beginTime;
+    const auto durationInSeconds = static_cast<double>(duration) / 1000000000.0;
+    const auto bucketIndex = getBucketIndex(duration);
+
+    auto& threadBuffer = getThreadBuffer();
+    bool needsMerge;
+    {
+        QMutexLocker scopedLocker(&threadBuffer.lock);
+
+        auto& stageStatistics = threadBuffer.statistics[name];
+        if(stageStatistics.count == 0 || durationInSeconds < stageStatistics.minTime)
+            stageStatistics.minTime = durationInSeconds;
+        if(durationInSeconds > stageStatistics.maxTime)
+            stageStatistics.maxTime = durationInSeconds;
+        stageStatistics.totalTime += durationInSeconds;
+        stageStatistics.count++;
+        stageStatistics.buckets[bucketIndex]++;
+
+        RawEvent event;
+        event.name = name;
+        event.category = category;
+        event.details = qMove(details);
+        event.threadId = threadBuffer.threadId;
+        event.beginTime = beginTime;
+        event.duration = duration;
+        threadBuffer.events.push_back(qMove(event));
+
+        needsMerge = (threadBuffer.events.size() >= ThreadBuffer::FlushThreshold);
+    }
+
+    if(needsMerge)
+    {
+        QMutexLocker scopedLocker(&_state.lock);
+
+        mergeThreadBuffer(threadBuffer);
+    }
+}
+
+static QByteArray escapeJsonString(const QString& value)
+{
+    QByteArray result;
+    result.reserve(value.size() + 2);
+    result.append('"');
+    const auto utf8 = value.toUtf8();
+    for(auto itChar = utf8.cbegin(); itChar != utf8.cend(); ++itChar)
+    {
+        const auto c = *itChar;
+        switch(c)
+        {
+        case '"':
+            result.append("\\\"");
+            break;
+        case '\\':
+            result.append("\\\\");
+            break;
+        case '\n':
+            result.append("\\n");
+            break;
+        case '\r':
+            result.append("\\r");
+            break;
+        case '\t':
+            result.append("\\t");
+            break;
+        default:
+            if(static_cast<unsigned char>(c) < 0x20)
+                result.append(QString().sprintf("\\u%04x", static_cast<unsigned int>(c)).toLatin1());
+            else
+                result.append(c);
+            break;
+        }
+    }
+    result.append('"');
+    return result;
+}
+
+OsmAnd::Tracing::StageStatistics::StageStatistics()
+    : count(0)
+    , totalTime(0.0)
+    , minTime(0.0)
+    , maxTime(0.0)
+{
+    buckets.fill(0);
+}
+
+double OsmAnd::Tracing::StageStatistics::getPercentile( const double percentile ) const
+{
+    if(count == 0)
+        return 0.0;
+
+    const auto targetCount = static_cast<uint64_t>(std::ceil(qBound(0.0, percentile, 1.0) * static_cast<double>(count)));
+    uint64_t accumulatedCount = 0;
+    for(auto bucketIndex = 0u; bucketIndex < BucketsCount; bucketIndex++)
+    {
+        accumulatedCount += buckets[bucketIndex];
+        if(accumulatedCount < targetCount || buckets[bucketIndex] == 0)
+            continue;
+
+        // Geometric middle of bucket range
+        const auto value = static_cast<double>(1ull << bucketIndex) * 1.41421356 / 1000000.0;
+        return qBound(minTime, value, maxTime);
+    }
+
+    return maxTime;
+}
+
+void OSMAND_CORE_CALL OsmAnd::Tracing::setEnabled( const bool enabled )
+{
+    _state.enabled.fetchAndStoreOrdered(enabled ? 1 : 0);
+}
+
+bool OSMAND_CORE_CALL OsmAnd::Tracing::isEnabled()
+{
+    return _state.enabled.load() != 0;
+}
+
+void OSMAND_CORE_CALL OsmAnd::Tracing::setBufferCapacity( const unsigned int capacity )
+{
+    QMutexLocker scopedLocker(&_state.lock);
+
+    mergeThreadBuffers();
+    _state.bufferCapacity = capacity;
+    _state.events.clear();
+    _state.events.reserve(qMin(capacity, static_cast<unsigned int>(TracingState::DefaultBufferCapacity)));
+    _state.nextEventIndex = 0;
+}
+
+unsigned int OSMAND_CORE_CALL OsmAnd::Tracing::getBufferCapacity()
+{
+    QMutexLocker scopedLocker(&_state.lock);
+
+    return _state.bufferCapacity;
+}
+
+QList<OsmAnd::Tracing::Event> OSMAND_CORE_CALL OsmAnd::Tracing::getEvents()
+{
+    QVector<RawEvent> rawEvents;
+    int firstEventIndex;
+    {
+        QMutexLocker scopedLocker(&_state.lock);
+
+        mergeThreadBuffers();
+        rawEvents = _state.events;
+        firstEventIndex = _state.nextEventIndex;
+    }
+
+    // Events of different threads are merged in batches, so they are ordered by time here
+    QList<Event> events;
+    events.reserve(rawEvents.size());
+    for(auto idx = 0; idx < rawEvents.size(); idx++)
+    {
+        const auto& rawEvent = rawEvents[(firstEventIndex + idx) % rawEvents.size()];
+
+        Event event;
+        event.name = QString::fromLatin1(rawEvent.name);
+        event.category = QString::fromLatin1(rawEvent.category);
+        event.details = rawEvent.details;
+        event.threadId = rawEvent.threadId;
+        event.beginTime = rawEvent.beginTime;
+        event.duration = rawEvent.duration;
+        events.push_back(qMove(event));
+    }
+    qStableSort(events.begin(), events.end(), [](const Event& l, const Event& r) -> bool
+    {
+        return l.beginTime < r.beginTime;
+    });
+
+    return events;
+}
+
+QList<OsmAnd::Tracing::StageStatistics> OSMAND_CORE_CALL OsmAnd::Tracing::getStagesStatistics()
+{
+    QHash<const char*, StageStatistics> statistics;
+    {
+        QMutexLocker scopedLocker(&_state.lock);
+
+        mergeThreadBuffers();
+        statistics = _state.statistics;
+    }
+
+    QMap<QString, StageStatistics> mergedStatistics;
+    for(auto itStatistics = statistics.cbegin(); itStatistics != statistics.cend(); ++itStatistics)
+    {
+        const auto name = QString::fromLatin1(itStatistics.key());
+        const auto& stageStatistics = itStatistics.value();
+
+        auto itMergedStatistics = mergedStatistics.find(name);
+        if(itMergedStatistics == mergedStatistics.end())
+        {
+            itMergedStatistics = mergedStatistics.insert(name, stageStatistics);
+            itMergedStatistics->name = name;
+            continue;
+        }
+
+        mergeStatistics(*itMergedStatistics, stageStatistics);
+    }
+
+    return mergedStatistics.values();
+}
+
+void OSMAND_CORE_CALL OsmAnd::Tracing::clear()
+{
+    QMutexLocker scopedLocker(&_state.lock);
+
+    mergeThreadBuffers();
+    _state.events.clear();
+    _state.nextEventIndex = 0;
+    _state.statistics.clear();
+}
+
+bool OSMAND_CORE_CALL OsmAnd::Tracing::exportChromeTrace( QIODevice& output )
+{
+    const auto events = getEvents();
+    const auto pid = QByteArray::number(QCoreApplication::applicationPid());
+
+    // Thread handles are too large for trace viewers, so sequential ids are used and original ones are
+    // exported as thread names
+    QHash<quintptr, int> threadIds;
+    for(auto itEvent = events.cbegin(); itEvent != events.cend(); ++itEvent)
+    {
+        if(!threadIds.contains(itEvent->threadId))
+            threadIds.insert(itEvent->threadId, threadIds.size() + 1);
+    }
+
+    QByteArray json;
+    json.append("{\"displayTimeUnit\":\"ms\",\"traceEvents\":[");
+    bool first = true;
+    for(auto itThreadId = threadIds.cbegin(); itThreadId != threadIds.cend(); ++itThreadId)
+    {
+        if(!first)
+            json.append(',');
+        first = false;
+
+        json.append("\n{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":" + pid + ",\"tid\":" + QByteArray::number(itThreadId.value()));
+        json.append(",\"args\":{\"name\":\"0x" + QByteArray::number(static_cast<qulonglong>(itThreadId.key()), 16) + "\"}}");
+    }
+    for(auto itEvent = events.cbegin(); itEvent != events.cend(); ++itEvent)
+    {
+        const auto& event = *itEvent;
+
+        if(!first)
+            json.append(',');
+        first = false;
+
+        json.append("\n{\"name\":" + escapeJsonString(event.name));
+        json.append(",\"cat\":" + escapeJsonString(event.category));
+        json.append(",\"ph\":\"X\",\"pid\":" + pid);
+        json.append(",\"tid\":" + QByteArray::number(threadIds[event.threadId]));
+        json.append(",\"ts\":" + QByteArray::number(static_cast<double>(event.beginTime) / 1000.0, 'f', 3));
+        json.append(",\"dur\":" + QByteArray::number(static_cast<double>(event.duration) / 1000.0, 'f', 3));
+        if(!event.details.isEmpty())
+            json.append(",\"args\":{\"details\":" + escapeJsonString(event.details) + "}");
+        json.append('}');
+    }
+    json.append("\n]}\n");
+
+    return output.write(json) == json.size();
+}
+
+bool OSMAND_CORE_CALL OsmAnd::Tracing::exportChromeTrace( const QString& fileName )
+{
+    QFile file(fileName);
+    if(!file.open(QIODevice::WriteOnly | QIODevice::Truncate))
+        return false;
+    const auto ok = exportChromeTrace(file);
+    file.close();
+    return ok;
+}
+
+OsmAnd::Tracing::Span::Span( const char* name, const char* category /*= "core"*/ )
+    : _name(name)
+    , _category(category)
+    , _beginTime(_state.enabled.load() ? _state.clock.nsecsElapsed() : -1)
+{
+}
+
+OsmAnd::Tracing::Span::~Span()
+{
+    end();
+}
+
+bool OsmAnd::Tracing::Span::isActive() const
+{
+    return _beginTime >= 0;
+}
+
+void OsmAnd::Tracing::Span::setDetails( const QString& details )
+{
+    _details = details;
+}
+
+void OsmAnd::Tracing::Span::end()
+{
+    if(_beginTime < 0)
+        return;
+
+    recordEvent(_name, _category, qMove(_details), _beginTime, _state.clock.nsecsElapsed());
+    _beginTime = -1;
+}
@@ -461,3 +461,93 @@ OSMAND_CORE_API void OSMAND_CORE_CALL OsmAnd::Utilities::scanlineFillPolygon( co
     for(auto itEdge = edges.cbegin(); itEdge != edges.cend(); ++itEdge)
         delete *itEdge;
 }
+
+OSMAND_CORE_API void OSMAND_CORE_CALL OsmAnd::Utilities::simplifyPolyline( const QVector<PointI>& points, const double tolerance31, QVector<PointI>& outSimplified )
+{
+    const auto pointsCount = points.size();
+
+    // Nothing can be removed from a segment, so share original data
+    if(pointsCount <= 2 || tolerance31 <= 0.0)
+    {
+        outSimplified = points;
+        return;
+    }
+
+    // Douglas-Peucker, implemented without recursion since polylines (especially coastlines)
+    // may contain tens of thousands of vertices
+    const auto squareTolerance31 = tolerance31 * tolerance31;
+    const auto pPoints = points.constData();
+    QVector<bool> keep(pointsCount, false);
+    keep[0] = true;
+    keep[pointsCount - 1] = true;
+    int keptCount = 2;
+
+    QVector< std::pair<int, int> > stack;
+    stack.reserve(64);
+    stack.push_back(std::make_pair(0, pointsCount - 1));
+    while(!stack.isEmpty())
+    {
+        const auto range = stack.last();
+        stack.pop_back();
+
+        const auto& p0 = pPoints[range.first];
+        const auto& p1 = pPoints[range.second];
+        const auto dx = static_cast<double>(p1.x - p0.x);
+        const auto dy = static_cast<double>(p1.y - p0.y);
+        const auto squareLength = dx*dx + dy*dy;
+
+        auto maxSquareDistance = -1.0;
+        auto maxIdx = -1;
+        for(auto idx = range.first + 1; idx < range.second; idx++)
+        {
+            const auto& p = pPoints[idx];
+            const auto px = static_cast<double>(p.x - p0.x);
+            const auto py = static_cast<double>(p.y - p0.y);
+
+            double squareDistance;
+            if(squareLength <= 0.0)
+            {
+                // Degenerate segment (e.g. closed ring), so measure distance to the point
+                squareDistance = px*px + py*py;
+            }
+            else
+            {
+                const auto t = qBound(0.0, (px*dx + py*dy) / squareLength, 1.0);
+                const auto ex = px - t*dx;
+                const auto ey = py - t*dy;
+                squareDistance = ex*ex + ey*ey;
+            }
+
+            if(squareDistance > maxSquareDistance)
+            {
+                maxSquareDistance = squareDistance;
+                maxIdx = idx;
+            }
+        }
+
+        if(maxIdx < 0 || maxSquareDistance <= squareTolerance31)
+            continue;
+
+        keep[maxIdx] = true;
+        keptCount++;
+        if(maxIdx - range.first > 1)
+            stack.push_back(std::make_pair(range.first, maxIdx));
+        if(range.second - maxIdx > 1)
+            stack.push_back(std::make_pair(maxIdx, range.second));
+    }
+
+    // If nothing was removed, share original data
+    if(keptCount == pointsCount)
+    {
+        outSimplified = points;
+        return;
+    }
+
+    outSimplified.clear();
+    outSimplified.reserve(keptCount);
+    for(auto idx = 0; idx < pointsCount; idx++)
+    {
+        if(keep[idx])
+            outSimplified.push_back(pPoints[idx]);
+    }
+}
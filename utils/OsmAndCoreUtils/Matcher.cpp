@@ -0,0 +1,334 @@
+#include "Matcher.h"
+
+#include <iostream>
+#include <sstream>
+#include <chrono>
+#include <random>
+
+#include <OsmAndCore/QtExtensions.h>
+#include <QtMath>
+#include <QThread>
+#include <QVector>
+
+#include <OsmAndCore/Common.h>
+#include <OsmAndCore/Utilities.h>
+#include <OsmAndCore/Data/ObfReader.h>
+#include <OsmAndCore/Routing/RoutePlannerContext.h>
+
+OsmAnd::Matcher::Configuration::Configuration()
+    : verbose(false)
+    , vehicle("car")
+    , tracesCount(100)
+    , samplingInterval(30.0)
+    , noiseSigma(10.0)
+    , seed(0)
+    , threadsCount(QThread::idealThreadCount())
+    , routingConfig(new RoutingConfiguration())
+{
+}
+
+OSMAND_CORE_UTILS_API bool OSMAND_CORE_UTILS_CALL OsmAnd::Matcher::parseCommandLineArguments( const QStringList& cmdLineArgs, Configuration& cfg, QString& error )
+{
+    bool wasObfRootSpecified = false;
+    bool wasRouterConfigSpecified = false;
+    bool wasBBoxSpecified = false;
+    for(auto itArg = cmdLineArgs.cbegin(); itArg != cmdLineArgs.cend(); ++itArg)
+    {
+        auto arg = *itArg;
+        if (arg.startsWith("-config="))
+        {
+            QFile configFile(arg.mid(strlen("-config=")));
+            if(!configFile.exists())
+            {
+                error = "Router configuration file does not exist";
+                return false;
+            }
+            configFile.open(QIODevice::ReadOnly | QIODevice::Text);
+            if(!RoutingConfiguration::parseConfiguration(&configFile, *cfg.routingConfig.get()))
+            {
+                error = "Bad router configuration";
+                return false;
+            }
+            configFile.close();
+            wasRouterConfigSpecified = true;
+        }
+        else if (arg == "-verbose")
+        {
+            cfg.verbose = true;
+        }
+        else if (arg.startsWith("-obfsDir="))
+        {
+            QDir obfRoot(arg.mid(strlen("-obfsDir=")));
+            if(!obfRoot.exists())
+            {
+                error = "OBF directory does not exist";
+                return false;
+            }
+            Utilities::findFiles(obfRoot, QStringList() << "*.obf", cfg.obfs);
+            wasObfRootSpecified = true;
+        }
+        else if (arg.startsWith("-vehicle="))
+        {
+            cfg.vehicle = arg.mid(strlen("-vehicle="));
+        }
+        else if(arg.startsWith("-bbox="))
+        {
+            auto values = arg.mid(strlen("-bbox=")).split(",");
+            if(values.size() != 4)
+            {
+                error = "Bounding box must be specified as 'left,top,right,bottom'";
+                return false;
+            }
+            cfg.bbox.left = values[0].toDouble();
+            cfg.bbox.top = values[1].toDouble();
+            cfg.bbox.right = values[2].toDouble();
+            cfg.bbox.bottom =  values[3].toDouble();
+            wasBBoxSpecified = true;
+        }
+        else if(arg.startsWith("-traces="))
+        {
+            cfg.tracesCount = arg.mid(strlen("-traces=")).toInt();
+        }
+        else if(arg.startsWith("-interval="))
+        {
+            cfg.samplingInterval = arg.mid(strlen("-interval=")).toDouble();
+        }
+        else if(arg.startsWith("-noise="))
+        {
+            cfg.noiseSigma = arg.mid(strlen("-noise=")).toDouble();
+        }
+        else if(arg.startsWith("-seed="))
+        {
+            cfg.seed = arg.mid(strlen("-seed=")).toUInt();
+        }
+        else if(arg.startsWith("-threads="))
+        {
+            cfg.threadsCount = arg.mid(strlen("-threads=")).toInt();
+        }
+        else if(arg.startsWith("-candidates="))
+        {
+            cfg.parameters.candidatesCount = arg.mid(strlen("-candidates=")).toUInt();
+        }
+        else if(arg.startsWith("-sigma="))
+        {
+            cfg.parameters.gpsSigma = arg.mid(strlen("-sigma=")).toDouble();
+        }
+        else if(arg.startsWith("-beta="))
+        {
+            cfg.parameters.transitionBeta = arg.mid(strlen("-beta=")).toDouble();
+        }
+    }
+
+    if(!wasBBoxSpecified)
+    {
+        error = "Bounding box of synthetic traces was not specified";
+        return false;
+    }
+    if(cfg.tracesCount < 1)
+    {
+        error = "Bad traces count";
+        return false;
+    }
+    if(cfg.samplingInterval <= 0.0 || cfg.noiseSigma < 0.0)
+    {
+        error = "Bad sampling interval or noise";
+        return false;
+    }
+    if(cfg.threadsCount < 1)
+    {
+        error = "Bad threads count";
+        return false;
+    }
+    if(cfg.parameters.candidatesCount < 1 || cfg.parameters.gpsSigma <= 0.0 || cfg.parameters.transitionBeta <= 0.0)
+    {
+        error = "Bad map-matching parameters";
+        return false;
+    }
+
+    if(!wasObfRootSpecified)
+        Utilities::findFiles(QDir::current(), QStringList() << "*.obf", cfg.obfs);
+    if(cfg.obfs.isEmpty())
+    {
+        error = "No OBF files loaded";
+        return false;
+    }
+    if(!wasRouterConfigSpecified)
+        RoutingConfiguration::loadDefault(*cfg.routingConfig);
+
+    return true;
+}
+
+#if defined(_UNICODE) || defined(UNICODE)
+static void benchmark(std::wostream &output, const OsmAnd::Matcher::Configuration& cfg);
+#else
+static void benchmark(std::ostream &output, const OsmAnd::Matcher::Configuration& cfg);
+#endif
+
+OSMAND_CORE_UTILS_API void OSMAND_CORE_UTILS_CALL OsmAnd::Matcher::benchmarkToStdOut( const Configuration& cfg )
+{
+#if defined(_UNICODE) || defined(UNICODE)
+    benchmark(std::wcout, cfg);
+#else
+    benchmark(std::cout, cfg);
+#endif
+}
+
+OSMAND_CORE_UTILS_API QString OSMAND_CORE_UTILS_CALL OsmAnd::Matcher::benchmarkToString( const Configuration& cfg )
+{
+#if defined(_UNICODE) || defined(UNICODE)
+    std::wostringstream output;
+    benchmark(output, cfg);
+    return QString::fromStdWString(output.str());
+#else
+    std::ostringstream output;
+    benchmark(output, cfg);
+    return QString::fromStdString(output.str());
+#endif
+}
+
+namespace
+{
+    struct SyntheticTrace
+    {
+        QList< std::pair<double, double> > points;
+        // Road on which every point was originally located
+        QVector<uint64_t> roadsIds;
+    };
+
+    // Samples route geometry every 'interval' meters and moves every sample by gaussian noise
+    void sampleRoute(
+        const QList< std::shared_ptr<OsmAnd::RouteSegment> >& route,
+        const double interval,
+        const double noiseSigma,
+        std::mt19937& randomGenerator,
+        SyntheticTrace& outTrace)
+    {
+        std::normal_distribution<double> noise(0.0, noiseSigma);
+        const auto metersPerDegree = 111320.0;
+
+        auto distanceToNextSample = 0.0;
+        for(auto itSegment = route.cbegin(); itSegment != route.cend(); ++itSegment)
+        {
+            const auto& segment = *itSegment;
+            const auto& points = segment->road->points;
+            const int step = segment->startPointIndex <= segment->endPointIndex ? 1 : -1;
+            for(int pointIdx = segment->startPointIndex; pointIdx != static_cast<int>(segment->endPointIndex); pointIdx += step)
+            {
+                const auto& from = points[pointIdx];
+                const auto& to = points[pointIdx + step];
+                const auto length = OsmAnd::Utilities::distance31(from, to);
+
+                auto offset = distanceToNextSample;
+                for(; offset < length; offset += interval)
+                {
+                    const auto factor = offset / length;
+                    const auto x31 = from.x + (to.x - from.x) * factor;
+                    const auto y31 = from.y + (to.y - from.y) * factor;
+                    const auto latitude = OsmAnd::Utilities::get31LatitudeY(y31);
+                    const auto longitude = OsmAnd::Utilities::get31LongitudeX(x31);
+
+                    outTrace.points.push_back(std::make_pair(
+                        latitude + noise(randomGenerator) / metersPerDegree,
+                        longitude + noise(randomGenerator) / (metersPerDegree * qCos(qDegreesToRadians(latitude)))));
+                    outTrace.roadsIds.push_back(segment->road->id);
+                }
+                distanceToNextSample = offset - length;
+            }
+        }
+    }
+}
+
+#if defined(_UNICODE) || defined(UNICODE)
+static void benchmark(std::wostream &output, const OsmAnd::Matcher::Configuration& cfg)
+#else
+static void benchmark(std::ostream &output, const OsmAnd::Matcher::Configuration& cfg)
+#endif
+{
+    QList< std::shared_ptr<OsmAnd::ObfReader> > obfData;
+    for(auto itObf = cfg.obfs.cbegin(); itObf != cfg.obfs.cend(); ++itObf)
+    {
+        const auto& obf = *itObf;
+        std::shared_ptr<OsmAnd::ObfReader> obfReader(new OsmAnd::ObfReader(std::shared_ptr<QIODevice>(new QFile(obf.absoluteFilePath()))));
+        obfData.push_back(obfReader);
+    }
+    OsmAnd::RoutePlannerContext plannerContext(obfData, cfg.routingConfig, cfg.vehicle, false);
+
+    // Generate synthetic traces from routes between random points
+    std::mt19937 randomGenerator(cfg.seed);
+    std::uniform_real_distribution<double> latitudes(qMin(cfg.bbox.top, cfg.bbox.bottom), qMax(cfg.bbox.top, cfg.bbox.bottom));
+    std::uniform_real_distribution<double> longitudes(qMin(cfg.bbox.left, cfg.bbox.right), qMax(cfg.bbox.left, cfg.bbox.right));
+    QList<SyntheticTrace> syntheticTraces;
+    QList< QList< std::pair<double, double> > > traces;
+    auto pointsCount = 0;
+    auto attemptsLeft = cfg.tracesCount * 10;
+    const auto generationStart = std::chrono::steady_clock::now();
+    while(syntheticTraces.size() < cfg.tracesCount && attemptsLeft-- > 0)
+    {
+        QList< std::pair<double, double> > endpoints;
+        endpoints.push_back(std::make_pair(latitudes(randomGenerator), longitudes(randomGenerator)));
+        endpoints.push_back(std::make_pair(latitudes(randomGenerator), longitudes(randomGenerator)));
+        const auto route = OsmAnd::RoutePlanner::calculateRoute(&plannerContext, endpoints, false);
+        if(route.list.isEmpty())
+            continue;
+
+        SyntheticTrace trace;
+        sampleRoute(route.list, cfg.samplingInterval, cfg.noiseSigma, randomGenerator, trace);
+        if(trace.points.size() < 2)
+            continue;
+
+        pointsCount += trace.points.size();
+        traces.push_back(trace.points);
+        syntheticTraces.push_back(qMove(trace));
+    }
+    const auto generationFinish = std::chrono::steady_clock::now();
+    output << xT("Generated ") << syntheticTraces.size() << xT(" traces with ") << pointsCount << xT(" points in ")
+        << std::chrono::duration<double>(generationFinish - generationStart).count() << xT(" s") << std::endl;
+    if(traces.isEmpty())
+    {
+        output << xT("Failed to generate any trace inside given bounding box") << std::endl;
+        return;
+    }
+
+    // Match all traces
+    auto matchedPointsCount = 0;
+    auto correctPointsCount = 0;
+    auto breaksCount = 0;
+    const auto matchingStart = std::chrono::steady_clock::now();
+    OsmAnd::RoutePlanner::matchTraces(&plannerContext, traces,
+        [&syntheticTraces, &matchedPointsCount, &correctPointsCount, &breaksCount, &output, &cfg]
+        (int traceIndex, const OsmAnd::MapMatchingResult& result)
+        {
+            const auto& trace = syntheticTraces[traceIndex];
+
+            auto correctCount = 0;
+            for(int pointIdx = 0; pointIdx < result.points.size(); pointIdx++)
+            {
+                const auto& matchedRoad = result.points[pointIdx].road;
+                if(matchedRoad && matchedRoad->id == trace.roadsIds[pointIdx])
+                    correctCount++;
+            }
+            matchedPointsCount += result.matchedCount;
+            correctPointsCount += correctCount;
+            breaksCount += result.breaksCount;
+
+            if(cfg.verbose)
+            {
+                output << xT("Trace #") << traceIndex << xT(": ") << trace.points.size() << xT(" points, ")
+                    << result.matchedCount << xT(" matched, ") << correctCount << xT(" on original road, ")
+                    << result.breaksCount << xT(" breaks");
+                if(!result.warnMessage.isEmpty())
+                    output << xT(" (") << QStringToStlString(result.warnMessage) << xT(")");
+                output << std::endl;
+            }
+        },
+        cfg.parameters,
+        cfg.threadsCount);
+    const auto matchingFinish = std::chrono::steady_clock::now();
+
+    const auto matchingTime = std::chrono::duration<double>(matchingFinish - matchingStart).count();
+    output << xT("Matched ") << traces.size() << xT(" traces in ") << matchingTime << xT(" s using ") << cfg.threadsCount << xT(" threads") << std::endl;
+    output << xT("Throughput: ") << (pointsCount / matchingTime) << xT(" points/s, ") << (traces.size() / matchingTime) << xT(" traces/s") << std::endl;
+    output << xT("Matched points: ") << matchedPointsCount << xT(" of ") << pointsCount << std::endl;
+    output << xT("Points on original road: ") << (100.0 * correctPointsCount / pointsCount) << xT("%") << std::endl;
+    output << xT("Breaks: ") << breaksCount << std::endl;
+}
@@ -0,0 +1,70 @@
+/**
+* @file
+*
+* @section LICENSE
+*
+* OsmAnd - Android navigation software based on OSM maps.
+* Copyright (C) 2010-2013  OsmAnd Authors listed in AUTHORS file
+*
+* This program is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+
+* You should have received a copy of the GNU General Public License
+* along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef __MATCHER_H_
+#define __MATCHER_H_
+
+#include <memory>
+
+#include <OsmAndCore/QtExtensions.h>
+#include <QString>
+#include <QStringList>
+#include <QDir>
+#include <QFile>
+
+#include <OsmAndCoreUtils.h>
+#include <OsmAndCore/CommonTypes.h>
+#include <OsmAndCore/Routing/RoutingConfiguration.h>
+#include <OsmAndCore/Routing/RoutePlanner.h>
+
+namespace OsmAnd
+{
+    // Matcher benchmarks GPS trace map-matching on synthetic traces: routes between random points
+    // inside bounding box are sampled at fixed interval and distorted by gaussian noise, then all traces
+    // are matched back to roads and throughput and share of points matched to original road are reported.
+    namespace Matcher
+    {
+        struct OSMAND_CORE_UTILS_API Configuration
+        {
+            Configuration();
+
+            bool verbose;
+            QFileInfoList obfs;
+            QString vehicle;
+            AreaD bbox;
+            int tracesCount;
+            double samplingInterval;
+            double noiseSigma;
+            unsigned int seed;
+            int threadsCount;
+            MapMatchingParameters parameters;
+
+            std::shared_ptr<RoutingConfiguration> routingConfig;
+        };
+        OSMAND_CORE_UTILS_API bool OSMAND_CORE_UTILS_CALL parseCommandLineArguments(const QStringList& cmdLineArgs, Configuration& cfg, QString& error);
+        OSMAND_CORE_UTILS_API void OSMAND_CORE_UTILS_CALL benchmarkToStdOut(const Configuration& cfg);
+        OSMAND_CORE_UTILS_API QString OSMAND_CORE_UTILS_CALL benchmarkToString(const Configuration& cfg);
+    } // namespace Matcher
+
+} // namespace OsmAnd 
+
+#endif // __MATCHER_H_
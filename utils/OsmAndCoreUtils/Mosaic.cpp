@@ -0,0 +1,620 @@
+#include "Mosaic.h"
+
+#include <iostream>
+#include <sstream>
+#include <chrono>
+#include <algorithm>
+
+#include <SkBitmap.h>
+#include <SkStream.h>
+#include <SkImageEncoder.h>
+
+#include <OsmAndCore/QtExtensions.h>
+#include <QtMath>
+#include <QThread>
+#include <QMutex>
+#include <QWaitCondition>
+#include <QAtomicInt>
+#include <QByteArray>
+#include <QVector>
+#include <QSet>
+#include <QVariant>
+#include <QSqlDatabase>
+#include <QSqlQuery>
+#include <QSqlError>
+
+#include <OsmAndCore/Common.h>
+#include <OsmAndCore/Utilities.h>
+#include <OsmAndCore/Concurrent.h>
+#include <OsmAndCore/Data/ObfsCollection.h>
+#include <OsmAndCore/Map/IMapBitmapTileProvider.h>
+#include <OsmAndCore/Map/OfflineMapDataProvider.h>
+#include <OsmAndCore/Map/OfflineMapRasterTileProvider_Software.h>
+
+OsmAnd::Mosaic::Configuration::Configuration()
+    : verbose(false)
+    , styleName("default")
+    , bbox(85.0511, -180, -85.0511, 179.9999999999)
+    , minZoom(ZoomLevel0)
+    , maxZoom(ZoomLevel10)
+    , tileSide(256)
+    , densityFactor(1.0)
+    , threadsCount(QThread::idealThreadCount())
+    , batchSize(256)
+{
+}
+
+OSMAND_CORE_UTILS_API bool OSMAND_CORE_UTILS_CALL OsmAnd::Mosaic::parseCommandLineArguments( const QStringList& cmdLineArgs, Configuration& cfg, QString& error )
+{
+    bool wasObfRootSpecified = false;
+
+    for(auto itArg = cmdLineArgs.cbegin(); itArg != cmdLineArgs.cend(); ++itArg)
+    {
+        auto arg = *itArg;
+        if (arg == "-verbose")
+        {
+            cfg.verbose = true;
+        }
+        else if (arg.startsWith("-stylesPath="))
+        {
+            auto path = arg.mid(strlen("-stylesPath="));
+            QDir dir(path);
+            if(!dir.exists())
+            {
+                error = "Style directory '" + path + "' does not exist";
+                return false;
+            }
+
+            Utilities::findFiles(dir, QStringList() << "*.render.xml", cfg.styleFiles);
+        }
+        else if (arg.startsWith("-style="))
+        {
+            cfg.styleName = arg.mid(strlen("-style="));
+        }
+        else if (arg.startsWith("-obfsDir="))
+        {
+            QDir obfRoot(arg.mid(strlen("-obfsDir=")));
+            if(!obfRoot.exists())
+            {
+                error = "OBF directory does not exist";
+                return false;
+            }
+            cfg.obfsDir = obfRoot;
+            wasObfRootSpecified = true;
+        }
+        else if(arg.startsWith("-bbox="))
+        {
+            auto values = arg.mid(strlen("-bbox=")).split(",");
+            if(values.size() != 4)
+            {
+                error = "Bounding box must be specified as 'left,top,right,bottom'";
+                return false;
+            }
+            cfg.bbox.left = values[0].toDouble();
+            cfg.bbox.top = values[1].toDouble();
+            cfg.bbox.right = values[2].toDouble();
+            cfg.bbox.bottom =  values[3].toDouble();
+        }
+        else if(arg.startsWith("-zoom="))
+        {
+            cfg.minZoom = cfg.maxZoom = static_cast<ZoomLevel>(arg.mid(strlen("-zoom=")).toInt());
+        }
+        else if(arg.startsWith("-minZoom="))
+        {
+            cfg.minZoom = static_cast<ZoomLevel>(arg.mid(strlen("-minZoom=")).toInt());
+        }
+        else if(arg.startsWith("-maxZoom="))
+        {
+            cfg.maxZoom = static_cast<ZoomLevel>(arg.mid(strlen("-maxZoom=")).toInt());
+        }
+        else if(arg.startsWith("-tileSide="))
+        {
+            cfg.tileSide = arg.mid(strlen("-tileSide=")).toInt();
+        }
+        else if(arg.startsWith("-density="))
+        {
+            cfg.densityFactor = arg.mid(strlen("-density=")).toFloat();
+        }
+        else if(arg.startsWith("-threads="))
+        {
+            cfg.threadsCount = arg.mid(strlen("-threads=")).toInt();
+        }
+        else if(arg.startsWith("-batch="))
+        {
+            cfg.batchSize = arg.mid(strlen("-batch=")).toInt();
+        }
+        else if(arg.startsWith("-output="))
+        {
+            cfg.output = arg.mid(strlen("-output="));
+        }
+    }
+
+    if(cfg.minZoom < MinZoomLevel || cfg.maxZoom > MaxZoomLevel || cfg.minZoom > cfg.maxZoom)
+    {
+        error = "Bad zoom range";
+        return false;
+    }
+    if(cfg.threadsCount < 1)
+    {
+        error = "Bad threads count";
+        return false;
+    }
+    if(cfg.batchSize < 1)
+    {
+        error = "Bad batch size";
+        return false;
+    }
+    if(cfg.output.isEmpty())
+    {
+        error = "Output MBTiles file was not specified";
+        return false;
+    }
+
+    if(!wasObfRootSpecified)
+        cfg.obfsDir = QDir::current();
+
+    return true;
+}
+
+#if defined(_UNICODE) || defined(UNICODE)
+static void render(std::wostream &output, const OsmAnd::Mosaic::Configuration& cfg);
+#else
+static void render(std::ostream &output, const OsmAnd::Mosaic::Configuration& cfg);
+#endif
+
+OSMAND_CORE_UTILS_API void OSMAND_CORE_UTILS_CALL OsmAnd::Mosaic::renderToStdOut( const Configuration& cfg )
+{
+#if defined(_UNICODE) || defined(UNICODE)
+    render(std::wcout, cfg);
+#else
+    render(std::cout, cfg);
+#endif
+}
+
+OSMAND_CORE_UTILS_API QString OSMAND_CORE_UTILS_CALL OsmAnd::Mosaic::renderToString( const Configuration& cfg )
+{
+#if defined(_UNICODE) || defined(UNICODE)
+    std::wostringstream output;
+    render(output, cfg);
+    return QString::fromStdWString(output.str());
+#else
+    std::ostringstream output;
+    render(output, cfg);
+    return QString::fromStdString(output.str());
+#endif
+}
+
+namespace
+{
+    struct RenderedTile
+    {
+        OsmAnd::TileId tileId;
+        OsmAnd::ZoomLevel zoom;
+
+        // Empty data means that there was nothing to render in this tile
+        QByteArray data;
+    };
+
+    // Bounded queue between rendering workers and the only thread that writes to output database.
+    // SQLite does not benefit from concurrent writers, so all inserts are funneled through one connection.
+    class WriteQueue
+    {
+    private:
+        mutable QMutex _mutex;
+        QWaitCondition _notEmpty;
+        QWaitCondition _notFull;
+        QList<RenderedTile> _items;
+        const int _capacity;
+        bool _finished;
+        bool _aborted;
+    public:
+        WriteQueue(const int capacity)
+            : _capacity(capacity)
+            , _finished(false)
+            , _aborted(false)
+        {
+        }
+
+        bool push(const RenderedTile& item)
+        {
+            QMutexLocker scopedLocker(&_mutex);
+
+            while(_items.size() >= _capacity && !_aborted)
+                _notFull.wait(&_mutex);
+            if(_aborted)
+                return false;
+
+            _items.push_back(item);
+            _notEmpty.wakeOne();
+            return true;
+        }
+
+        bool pop(QList<RenderedTile>& outItems, const int maxCount)
+        {
+            QMutexLocker scopedLocker(&_mutex);
+
+            while(_items.isEmpty() && !_finished && !_aborted)
+                _notEmpty.wait(&_mutex);
+            if(_aborted || _items.isEmpty())
+                return false;
+
+            while(!_items.isEmpty() && outItems.size() < maxCount)
+                outItems.push_back(_items.takeFirst());
+            _notFull.wakeAll();
+            return true;
+        }
+
+        void finish()
+        {
+            QMutexLocker scopedLocker(&_mutex);
+
+            _finished = true;
+            _notEmpty.wakeAll();
+        }
+
+        void abort()
+        {
+            QMutexLocker scopedLocker(&_mutex);
+
+            _aborted = true;
+            _notEmpty.wakeAll();
+            _notFull.wakeAll();
+        }
+
+        bool isAborted() const
+        {
+            QMutexLocker scopedLocker(&_mutex);
+
+            return _aborted;
+        }
+    };
+
+    // Position of (x, y) along Hilbert curve that covers n*n grid (n is power of 2).
+    // Rendering tiles in this order keeps neighbouring tiles close in time, so OBF blocks and
+    // shared rasterizer caches loaded for one tile are still warm when its neighbours are rendered.
+    uint64_t hilbertIndex(const uint32_t n, uint32_t x, uint32_t y)
+    {
+        uint64_t d = 0;
+        for(uint32_t s = n / 2; s > 0; s /= 2)
+        {
+            const uint32_t rx = (x & s) ? 1 : 0;
+            const uint32_t ry = (y & s) ? 1 : 0;
+            d += static_cast<uint64_t>(s) * s * ((3 * rx) ^ ry);
+
+            if(ry == 0)
+            {
+                if(rx == 1)
+                {
+                    x = n - 1 - x;
+                    y = n - 1 - y;
+                }
+                std::swap(x, y);
+            }
+        }
+        return d;
+    }
+
+    QVector<OsmAnd::TileId> planTiles(const OsmAnd::AreaD& bbox, const OsmAnd::ZoomLevel zoom)
+    {
+        const auto maxTileNumber = static_cast<int32_t>((1u << zoom) - 1u);
+        const auto x0 = qBound(0, static_cast<int32_t>(qFloor(OsmAnd::Utilities::getTileNumberX(zoom, bbox.left))), maxTileNumber);
+        const auto x1 = qBound(0, static_cast<int32_t>(qFloor(OsmAnd::Utilities::getTileNumberX(zoom, bbox.right))), maxTileNumber);
+        const auto y0 = qBound(0, static_cast<int32_t>(qFloor(OsmAnd::Utilities::getTileNumberY(zoom, bbox.top))), maxTileNumber);
+        const auto y1 = qBound(0, static_cast<int32_t>(qFloor(OsmAnd::Utilities::getTileNumberY(zoom, bbox.bottom))), maxTileNumber);
+
+        uint32_t gridSize = 1;
+        while(gridSize < static_cast<uint32_t>(qMax(x1 - x0, y1 - y0) + 1))
+            gridSize <<= 1;
+
+        QVector< std::pair<uint64_t, OsmAnd::TileId> > orderedTiles;
+        orderedTiles.reserve((x1 - x0 + 1) * (y1 - y0 + 1));
+        for(int32_t y = y0; y <= y1; y++)
+        {
+            for(int32_t x = x0; x <= x1; x++)
+            {
+                OsmAnd::TileId tileId;
+                tileId.x = x;
+                tileId.y = y;
+                orderedTiles.push_back(std::make_pair(hilbertIndex(gridSize, x - x0, y - y0), tileId));
+            }
+        }
+        std::sort(orderedTiles.begin(), orderedTiles.end(),
+            [](const std::pair<uint64_t, OsmAnd::TileId>& l, const std::pair<uint64_t, OsmAnd::TileId>& r) -> bool
+            {
+                return l.first < r.first;
+            });
+
+        QVector<OsmAnd::TileId> tiles;
+        tiles.reserve(orderedTiles.size());
+        for(auto itEntry = orderedTiles.cbegin(); itEntry != orderedTiles.cend(); ++itEntry)
+            tiles.push_back(itEntry->second);
+        return tiles;
+    }
+
+    // MBTiles uses TMS tile rows, that grow from south to north
+    inline int32_t toTmsRow(const OsmAnd::TileId tileId, const OsmAnd::ZoomLevel zoom)
+    {
+        return static_cast<int32_t>((1u << zoom) - 1u) - tileId.y;
+    }
+
+    bool prepareOutput(QSqlDatabase& db, const OsmAnd::Mosaic::Configuration& cfg, QString& error)
+    {
+        QSqlQuery q(db);
+        const QStringList statements = QStringList()
+            << "PRAGMA journal_mode=WAL"
+            << "CREATE TABLE IF NOT EXISTS metadata (name TEXT, value TEXT)"
+            << "CREATE UNIQUE INDEX IF NOT EXISTS metadata_name ON metadata (name)"
+            << "CREATE TABLE IF NOT EXISTS tiles (zoom_level INTEGER, tile_column INTEGER, tile_row INTEGER, tile_data BLOB)"
+            << "CREATE UNIQUE INDEX IF NOT EXISTS tile_index ON tiles (zoom_level, tile_column, tile_row)"
+            << "CREATE TABLE IF NOT EXISTS empty_tiles (zoom_level INTEGER, tile_column INTEGER, tile_row INTEGER)"
+            << "CREATE UNIQUE INDEX IF NOT EXISTS empty_tile_index ON empty_tiles (zoom_level, tile_column, tile_row)";
+        for(auto itStatement = statements.cbegin(); itStatement != statements.cend(); ++itStatement)
+        {
+            if(!q.exec(*itStatement))
+            {
+                error = q.lastError().text();
+                return false;
+            }
+        }
+
+        QList< std::pair<QString, QString> > metadata;
+        metadata.push_back(std::make_pair(QString("name"), QFileInfo(cfg.output).completeBaseName()));
+        metadata.push_back(std::make_pair(QString("type"), QString("baselayer")));
+        metadata.push_back(std::make_pair(QString("version"), QString("1.0")));
+        metadata.push_back(std::make_pair(QString("description"), QString("Rendered with '%1' style").arg(cfg.styleName)));
+        metadata.push_back(std::make_pair(QString("format"), QString("png")));
+        metadata.push_back(std::make_pair(QString("bounds"), QString("%1,%2,%3,%4").arg(cfg.bbox.left).arg(cfg.bbox.bottom).arg(cfg.bbox.right).arg(cfg.bbox.top)));
+        metadata.push_back(std::make_pair(QString("minzoom"), QString::number(cfg.minZoom)));
+        metadata.push_back(std::make_pair(QString("maxzoom"), QString::number(cfg.maxZoom)));
+
+        q.prepare("INSERT OR REPLACE INTO metadata (name, value) VALUES (?, ?)");
+        for(auto itEntry = metadata.cbegin(); itEntry != metadata.cend(); ++itEntry)
+        {
+            q.addBindValue(itEntry->first);
+            q.addBindValue(itEntry->second);
+            if(!q.exec())
+            {
+                error = q.lastError().text();
+                return false;
+            }
+        }
+
+        return true;
+    }
+
+    void collectPresentTiles(QSqlDatabase& db, const OsmAnd::ZoomLevel zoom, QSet<uint64_t>& outPresentTiles)
+    {
+        const QStringList tables = QStringList() << "tiles" << "empty_tiles";
+        for(auto itTable = tables.cbegin(); itTable != tables.cend(); ++itTable)
+        {
+            QSqlQuery q(db);
+            q.prepare(QString("SELECT tile_column, tile_row FROM %1 WHERE zoom_level=?").arg(*itTable));
+            q.addBindValue(static_cast<int>(zoom));
+            if(!q.exec())
+                continue;
+            while(q.next())
+            {
+                OsmAnd::TileId tileId;
+                tileId.x = q.value(0).toInt();
+                tileId.y = static_cast<int32_t>((1u << zoom) - 1u) - q.value(1).toInt();
+                outPresentTiles.insert(tileId);
+            }
+        }
+    }
+}
+
+#if defined(_UNICODE) || defined(UNICODE)
+static void render(std::wostream &output, const OsmAnd::Mosaic::Configuration& cfg)
+#else
+static void render(std::ostream &output, const OsmAnd::Mosaic::Configuration& cfg)
+#endif
+{
+    // Obtain rasterization style
+    OsmAnd::MapStyles stylesCollection;
+    for(auto itStyleFile = cfg.styleFiles.cbegin(); itStyleFile != cfg.styleFiles.cend(); ++itStyleFile)
+    {
+        const auto& styleFile = *itStyleFile;
+
+        if(!stylesCollection.registerStyle(styleFile.absoluteFilePath()))
+            output << xT("Failed to parse metadata of '") << QStringToStlString(styleFile.fileName()) << xT("' or duplicate style") << std::endl;
+    }
+    std::shared_ptr<const OsmAnd::MapStyle> style;
+    if(!stylesCollection.obtainStyle(cfg.styleName, style))
+    {
+        output << xT("Failed to resolve style '") << QStringToStlString(cfg.styleName) << xT("'") << std::endl;
+        return;
+    }
+
+    std::shared_ptr<OsmAnd::ObfsCollection> obfsCollection(new OsmAnd::ObfsCollection());
+    obfsCollection->watchDirectory(cfg.obfsDir);
+
+    std::shared_ptr<OsmAnd::OfflineMapDataProvider> dataProvider(new OsmAnd::OfflineMapDataProvider(obfsCollection, style, cfg.densityFactor));
+    std::shared_ptr<OsmAnd::OfflineMapRasterTileProvider_Software> tileProvider(new OsmAnd::OfflineMapRasterTileProvider_Software(dataProvider, cfg.tileSide, cfg.densityFactor));
+
+    // Prepare output database and collect tiles that were already rendered by previous runs
+    const QString schemaConnectionName = QLatin1String("mosaic-schema");
+    const QString writerConnectionName = QLatin1String("mosaic-writer");
+    QList< QSet<uint64_t> > presentTiles;
+    QString outputError;
+    {
+        auto db = QSqlDatabase::addDatabase("QSQLITE", schemaConnectionName);
+        db.setDatabaseName(cfg.output);
+        if(!db.open())
+            outputError = db.lastError().text();
+        else if(prepareOutput(db, cfg, outputError))
+        {
+            for(auto zoom = cfg.minZoom; zoom <= cfg.maxZoom; zoom = static_cast<OsmAnd::ZoomLevel>(zoom + 1))
+            {
+                QSet<uint64_t> zoomPresentTiles;
+                collectPresentTiles(db, zoom, zoomPresentTiles);
+                presentTiles.push_back(qMove(zoomPresentTiles));
+            }
+        }
+        db.close();
+    }
+    QSqlDatabase::removeDatabase(schemaConnectionName);
+    if(!outputError.isEmpty())
+    {
+        output << xT("Failed to prepare '") << QStringToStlString(cfg.output) << xT("': ") << QStringToStlString(outputError) << std::endl;
+        return;
+    }
+
+    // Start writer. It owns the only connection used for inserts
+    WriteQueue writeQueue(cfg.batchSize * 4);
+    QString writerError;
+    QAtomicInt writtenTilesCount(0);
+    OsmAnd::Concurrent::Thread writerThread([&cfg, &writeQueue, &writerError, &writtenTilesCount, writerConnectionName]()
+    {
+        {
+            auto db = QSqlDatabase::addDatabase("QSQLITE", writerConnectionName);
+            db.setDatabaseName(cfg.output);
+            if(!db.open())
+            {
+                writerError = db.lastError().text();
+                writeQueue.abort();
+            }
+            else
+            {
+                QSqlQuery insertTile(db);
+                insertTile.prepare("INSERT OR REPLACE INTO tiles (zoom_level, tile_column, tile_row, tile_data) VALUES (?, ?, ?, ?)");
+                QSqlQuery insertEmptyTile(db);
+                insertEmptyTile.prepare("INSERT OR REPLACE INTO empty_tiles (zoom_level, tile_column, tile_row) VALUES (?, ?, ?)");
+
+                QList<RenderedTile> batch;
+                while(writeQueue.pop(batch, cfg.batchSize))
+                {
+                    db.transaction();
+                    for(auto itTile = batch.cbegin(); itTile != batch.cend(); ++itTile)
+                    {
+                        const auto& tile = *itTile;
+                        auto& query = tile.data.isEmpty() ? insertEmptyTile : insertTile;
+
+                        query.addBindValue(static_cast<int>(tile.zoom));
+                        query.addBindValue(tile.tileId.x);
+                        query.addBindValue(toTmsRow(tile.tileId, tile.zoom));
+                        if(!tile.data.isEmpty())
+                            query.addBindValue(tile.data);
+                        if(!query.exec())
+                        {
+                            writerError = query.lastError().text();
+                            break;
+                        }
+                    }
+                    if(!writerError.isEmpty() || !db.commit())
+                    {
+                        if(writerError.isEmpty())
+                            writerError = db.lastError().text();
+                        db.rollback();
+                        writeQueue.abort();
+                        break;
+                    }
+                    writtenTilesCount.fetchAndAddOrdered(batch.size());
+                    batch.clear();
+                }
+            }
+            db.close();
+        }
+        QSqlDatabase::removeDatabase(writerConnectionName);
+    });
+    writerThread.start();
+
+    // Render zoom levels one by one, so that throughput can be reported per zoom level
+    OsmAnd::Concurrent::WorkersPool workersPool(QLatin1String("mosaic"), cfg.threadsCount);
+    unsigned int totalRenderedCount = 0;
+    const auto renderingStart = std::chrono::steady_clock::now();
+    for(auto zoom = cfg.minZoom; zoom <= cfg.maxZoom && !writeQueue.isAborted(); zoom = static_cast<OsmAnd::ZoomLevel>(zoom + 1))
+    {
+        const auto& zoomPresentTiles = presentTiles[zoom - cfg.minZoom];
+        const auto plannedTiles = planTiles(cfg.bbox, zoom);
+        QVector<OsmAnd::TileId> tiles;
+        tiles.reserve(plannedTiles.size());
+        for(auto itTileId = plannedTiles.cbegin(); itTileId != plannedTiles.cend(); ++itTileId)
+        {
+            if(!zoomPresentTiles.contains(*itTileId))
+                tiles.push_back(*itTileId);
+        }
+
+        QAtomicInt nextTileIndex(0);
+        QAtomicInt renderedCount(0);
+        QAtomicInt emptyCount(0);
+        QAtomicInt failedCount(0);
+        const auto zoomStart = std::chrono::steady_clock::now();
+        for(int workerIdx = 0; workerIdx < cfg.threadsCount; workerIdx++)
+        {
+            const auto worker = new OsmAnd::Concurrent::Task(
+                [&tiles, zoom, tileProvider, &writeQueue, &nextTileIndex, &renderedCount, &emptyCount, &failedCount]
+                (OsmAnd::Concurrent::Task* task, QEventLoop& eventLoop)
+                {
+                    std::unique_ptr<SkImageEncoder> encoder(CreatePNGImageEncoder());
+                    for(;;)
+                    {
+                        const auto tileIndex = nextTileIndex.fetchAndAddOrdered(1);
+                        if(tileIndex >= tiles.size())
+                            break;
+                        const auto tileId = tiles[tileIndex];
+
+                        std::shared_ptr<const OsmAnd::MapTile> tile;
+                        if(!tileProvider->obtainTile(tileId, zoom, tile))
+                        {
+                            failedCount.fetchAndAddOrdered(1);
+                            continue;
+                        }
+
+                        RenderedTile renderedTile;
+                        renderedTile.tileId = tileId;
+                        renderedTile.zoom = zoom;
+                        if(tile)
+                        {
+                            const auto bitmapTile = std::static_pointer_cast<const OsmAnd::MapBitmapTile>(tile);
+                            SkDynamicMemoryWStream encodedStream;
+                            if(!encoder->encodeStream(&encodedStream, *bitmapTile->bitmap, 100))
+                            {
+                                failedCount.fetchAndAddOrdered(1);
+                                continue;
+                            }
+                            renderedTile.data.resize(encodedStream.getOffset());
+                            encodedStream.copyTo(renderedTile.data.data());
+                            renderedCount.fetchAndAddOrdered(1);
+                        }
+                        else
+                        {
+                            emptyCount.fetchAndAddOrdered(1);
+                        }
+
+                        // Release rasterization surface before possibly blocking on the queue
+                        tile.reset();
+
+                        if(!writeQueue.push(renderedTile))
+                            break;
+                    }
+                });
+            workersPool.start(worker);
+        }
+        workersPool.waitForDone();
+        const auto zoomFinish = std::chrono::steady_clock::now();
+
+        const auto elapsed = std::chrono::duration<double>(zoomFinish - zoomStart).count();
+        const auto processedCount = renderedCount.load() + emptyCount.load();
+        totalRenderedCount += processedCount;
+        output << xT("Zoom ") << zoom << xT(": ")
+            << plannedTiles.size() << xT(" tiles planned, ")
+            << (plannedTiles.size() - tiles.size()) << xT(" already present, ")
+            << renderedCount.load() << xT(" rendered, ")
+            << emptyCount.load() << xT(" empty, ")
+            << failedCount.load() << xT(" failed in ")
+            << elapsed << xT(" s (")
+            << (elapsed > 0.0 ? processedCount / elapsed : 0.0) << xT(" tiles/s)") << std::endl;
+    }
+
+    writeQueue.finish();
+    writerThread.wait();
+    const auto renderingFinish = std::chrono::steady_clock::now();
+
+    if(!writerError.isEmpty())
+        output << xT("Failed to write '") << QStringToStlString(cfg.output) << xT("': ") << QStringToStlString(writerError) << std::endl;
+    if(cfg.verbose)
+    {
+        const auto elapsed = std::chrono::duration<double>(renderingFinish - renderingStart).count();
+        output << xT("Processed ") << totalRenderedCount << xT(" tiles, written ") << writtenTilesCount.load() << xT(" in ") << elapsed << xT(" s") << std::endl;
+    }
+}
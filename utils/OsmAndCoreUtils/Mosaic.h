@@ -0,0 +1,69 @@
+/**
+* @file
+*
+* @section LICENSE
+*
+* OsmAnd - Android navigation software based on OSM maps.
+* Copyright (C) 2010-2013  OsmAnd Authors listed in AUTHORS file
+*
+* This program is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+
+* You should have received a copy of the GNU General Public License
+* along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+#ifndef __MOSAIC_H_
+#define __MOSAIC_H_
+
+#include <memory>
+
+#include <OsmAndCore/QtExtensions.h>
+#include <QString>
+#include <QStringList>
+#include <QDir>
+#include <QFile>
+
+#include <OsmAndCoreUtils.h>
+#include <OsmAndCore/CommonTypes.h>
+#include <OsmAndCore/Map/MapStyle.h>
+#include <OsmAndCore/Map/MapStyles.h>
+
+namespace OsmAnd
+{
+    // Mosaic pre-renders all tiles covering a bounding box over a range of zoom levels
+    // into a single MBTiles (SQLite) file. Tiles already present in the output are
+    // skipped, so an interrupted run can be resumed by simply starting it again.
+    namespace Mosaic
+    {
+        struct OSMAND_CORE_UTILS_API Configuration
+        {
+            Configuration();
+
+            bool verbose;
+            QFileInfoList styleFiles;
+            QDir obfsDir;
+            QString styleName;
+            AreaD bbox;
+            ZoomLevel minZoom;
+            ZoomLevel maxZoom;
+            uint32_t tileSide;
+            float densityFactor;
+            int threadsCount;
+            int batchSize;
+            QString output;
+        };
+        OSMAND_CORE_UTILS_API bool OSMAND_CORE_UTILS_CALL parseCommandLineArguments(const QStringList& cmdLineArgs, Configuration& cfg, QString& error);
+        OSMAND_CORE_UTILS_API void OSMAND_CORE_UTILS_CALL renderToStdOut(const Configuration& cfg);
+        OSMAND_CORE_UTILS_API QString OSMAND_CORE_UTILS_CALL renderToString(const Configuration& cfg);
+    } // namespace Mosaic
+
+} // namespace OsmAnd 
+
+#endif // __MOSAIC_H_
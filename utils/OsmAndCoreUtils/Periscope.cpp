@@ -0,0 +1,240 @@
+#include "Periscope.h"
+
+#include <iostream>
+#include <sstream>
+#include <chrono>
+
+#include <OsmAndCore/QtExtensions.h>
+#include <QMap>
+
+#include <OsmAndCore/Common.h>
+#include <OsmAndCore/CommonTypes.h>
+#include <OsmAndCore/Utilities.h>
+#include <OsmAndCore/Map/IMapRenderer.h>
+
+OsmAnd::Periscope::Configuration::Configuration()
+    : verbose(false)
+    , viewportWidth(1024)
+    , viewportHeight(768)
+    , densityFactor(1.0f)
+    , fieldOfView(16.5f)
+    , latitude(52.3702)
+    , longitude(4.8952)
+    , minZoom(3)
+    , maxZoom(19)
+    , iterations(100)
+{
+    elevationAngles << 90.0f << 75.0f << 60.0f << 45.0f << 30.0f << 20.0f;
+    azimuths << 0.0f << 45.0f;
+}
+
+static bool parseFloatsList(const QString& value, QList<float>& outList)
+{
+    outList.clear();
+    const auto items = value.split(",", QString::SkipEmptyParts);
+    for(auto itItem = items.cbegin(); itItem != items.cend(); ++itItem)
+    {
+        bool ok = false;
+        outList.push_back(itItem->toFloat(&ok));
+        if(!ok)
+            return false;
+    }
+    return !outList.isEmpty();
+}
+
+OSMAND_CORE_UTILS_API bool OSMAND_CORE_UTILS_CALL OsmAnd::Periscope::parseCommandLineArguments( const QStringList& cmdLineArgs, Configuration& cfg, QString& error )
+{
+    for(auto itArg = cmdLineArgs.cbegin(); itArg != cmdLineArgs.cend(); ++itArg)
+    {
+        auto arg = *itArg;
+        if (arg == "-verbose")
+        {
+            cfg.verbose = true;
+        }
+        else if(arg.startsWith("-viewport="))
+        {
+            const auto values = arg.mid(strlen("-viewport=")).split("x");
+            if(values.size() != 2)
+            {
+                error = "Viewport has to be specified as WIDTHxHEIGHT";
+                return false;
+            }
+            cfg.viewportWidth = values[0].toInt();
+            cfg.viewportHeight = values[1].toInt();
+        }
+        else if(arg.startsWith("-density="))
+        {
+            cfg.densityFactor = arg.mid(strlen("-density=")).toFloat();
+        }
+        else if(arg.startsWith("-fov="))
+        {
+            cfg.fieldOfView = arg.mid(strlen("-fov=")).toFloat();
+        }
+        else if(arg.startsWith("-latitude="))
+        {
+            cfg.latitude = arg.mid(strlen("-latitude=")).toDouble();
+        }
+        else if(arg.startsWith("-longitude="))
+        {
+            cfg.longitude = arg.mid(strlen("-longitude=")).toDouble();
+        }
+        else if(arg.startsWith("-minZoom="))
+        {
+            cfg.minZoom = arg.mid(strlen("-minZoom=")).toInt();
+        }
+        else if(arg.startsWith("-maxZoom="))
+        {
+            cfg.maxZoom = arg.mid(strlen("-maxZoom=")).toInt();
+        }
+        else if(arg.startsWith("-elevationAngles="))
+        {
+            if(!parseFloatsList(arg.mid(strlen("-elevationAngles=")), cfg.elevationAngles))
+            {
+                error = "Elevation angles have to be comma-separated numbers";
+                return false;
+            }
+        }
+        else if(arg.startsWith("-azimuths="))
+        {
+            if(!parseFloatsList(arg.mid(strlen("-azimuths=")), cfg.azimuths))
+            {
+                error = "Azimuths have to be comma-separated numbers";
+                return false;
+            }
+        }
+        else if(arg.startsWith("-iterations="))
+        {
+            cfg.iterations = qMax(1, arg.mid(strlen("-iterations=")).toInt());
+        }
+    }
+
+    if(cfg.viewportWidth <= 0 || cfg.viewportHeight <= 0)
+    {
+        error = "Viewport is empty";
+        return false;
+    }
+    if(cfg.minZoom > cfg.maxZoom)
+    {
+        error = "Minimal zoom is greater than maximal one";
+        return false;
+    }
+
+    return true;
+}
+
+#if defined(_UNICODE) || defined(UNICODE)
+bool survey(std::wostream &output, const OsmAnd::Periscope::Configuration& cfg);
+#else
+bool survey(std::ostream &output, const OsmAnd::Periscope::Configuration& cfg);
+#endif
+
+OSMAND_CORE_UTILS_API bool OSMAND_CORE_UTILS_CALL OsmAnd::Periscope::surveyToStdOut( const Configuration& cfg )
+{
+#if defined(_UNICODE) || defined(UNICODE)
+    return survey(std::wcout, cfg);
+#else
+    return survey(std::cout, cfg);
+#endif
+}
+
+OSMAND_CORE_UTILS_API QString OSMAND_CORE_UTILS_CALL OsmAnd::Periscope::surveyToString( const Configuration& cfg )
+{
+#if defined(_UNICODE) || defined(UNICODE)
+    std::wostringstream output;
+    survey(output, cfg);
+    return QString::fromStdWString(output.str());
+#else
+    std::ostringstream output;
+    survey(output, cfg);
+    return QString::fromStdString(output.str());
+#endif
+}
+
+#if defined(_UNICODE) || defined(UNICODE)
+bool survey(std::wostream &output, const OsmAnd::Periscope::Configuration& cfg)
+#else
+bool survey(std::ostream &output, const OsmAnd::Periscope::Configuration& cfg)
+#endif
+{
+    // Renderer is only set up, rendering itself is never initialized
+    std::shared_ptr<OsmAnd::IMapRenderer> renderer;
+#if defined(OSMAND_OPENGL_RENDERER_SUPPORTED)
+    renderer = OsmAnd::createAtlasMapRenderer_OpenGL();
+#elif defined(OSMAND_OPENGLES2_RENDERER_SUPPORTED)
+    renderer = OsmAnd::createAtlasMapRenderer_OpenGLES2();
+#endif
+    if(!renderer)
+    {
+        output << xT("No map renderer is supported on this platform") << std::endl;
+        return false;
+    }
+
+    OsmAnd::MapRendererSetupOptions setupOptions;
+    setupOptions.displayDensityFactor = cfg.densityFactor;
+    if(!renderer->setup(setupOptions))
+    {
+        output << xT("Failed to setup map renderer") << std::endl;
+        return false;
+    }
+    renderer->setWindowSize(OsmAnd::PointI(cfg.viewportWidth, cfg.viewportHeight));
+    renderer->setViewport(OsmAnd::AreaI(0, 0, cfg.viewportHeight, cfg.viewportWidth));
+    renderer->setFieldOfView(cfg.fieldOfView);
+    renderer->setTarget(OsmAnd::PointI(
+        OsmAnd::Utilities::get31TileNumberX(cfg.longitude),
+        OsmAnd::Utilities::get31TileNumberY(cfg.latitude)));
+
+    bool success = true;
+    uint64_t totalTilesCount = 0;
+    double totalDuration = 0.0;
+    for(auto zoom = cfg.minZoom; zoom <= cfg.maxZoom; zoom++)
+    {
+        renderer->setZoom(static_cast<float>(zoom));
+        for(auto itElevationAngle = cfg.elevationAngles.cbegin(); itElevationAngle != cfg.elevationAngles.cend(); ++itElevationAngle)
+        {
+            renderer->setElevationAngle(*itElevationAngle);
+            for(auto itAzimuth = cfg.azimuths.cbegin(); itAzimuth != cfg.azimuths.cend(); ++itAzimuth)
+            {
+                renderer->setAzimuth(*itAzimuth);
+
+                QMap< OsmAnd::ZoomLevel, QList<OsmAnd::TileId> > visibleTiles;
+                bool ok = true;
+                const auto computationStart = std::chrono::steady_clock::now();
+                for(auto iteration = 0; iteration < cfg.iterations && ok; iteration++)
+                    ok = renderer->obtainVisibleTileset(visibleTiles);
+                const auto computationFinish = std::chrono::steady_clock::now();
+                if(!ok)
+                {
+                    output << xT("Failed to compute tileset at zoom ") << zoom << xT(", elevation ") << *itElevationAngle
+                        << xT(", azimuth ") << *itAzimuth << std::endl;
+                    success = false;
+                    continue;
+                }
+                const auto duration = std::chrono::duration<double, std::micro>(computationFinish - computationStart).count() / cfg.iterations;
+                totalDuration += duration;
+
+                auto tilesCount = 0;
+                for(auto itVisibleTiles = visibleTiles.cbegin(); itVisibleTiles != visibleTiles.cend(); ++itVisibleTiles)
+                    tilesCount += itVisibleTiles->size();
+                totalTilesCount += tilesCount;
+
+                output << xT("zoom ") << zoom << xT(", elevation ") << *itElevationAngle << xT(", azimuth ") << *itAzimuth
+                    << xT(": ") << tilesCount << xT(" tiles, ") << duration << xT(" us");
+                if(cfg.verbose)
+                {
+                    output << xT(" (");
+                    for(auto itVisibleTiles = visibleTiles.cbegin(); itVisibleTiles != visibleTiles.cend(); ++itVisibleTiles)
+                    {
+                        if(itVisibleTiles != visibleTiles.cbegin())
+                            output << xT(", ");
+                        output << static_cast<int>(itVisibleTiles.key()) << xT(":") << itVisibleTiles->size();
+                    }
+                    output << xT(")");
+                }
+                output << std::endl;
+            }
+        }
+    }
+
+    output << xT("Total ") << totalTilesCount << xT(" tiles, ") << totalDuration << xT(" us") << std::endl;
+    return success;
+}
@@ -0,0 +1,68 @@
+/**
+* @file
+*
+* @section LICENSE
+*
+* OsmAnd - Android navigation software based on OSM maps.
+* Copyright (C) 2010-2013  OsmAnd Authors listed in AUTHORS file
+*
+* This program is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+
+* You should have received a copy of the GNU General Public License
+* along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+#ifndef __PERISCOPE_H_
+#define __PERISCOPE_H_
+
+#include <memory>
+
+#include <OsmAndCore/QtExtensions.h>
+#include <QString>
+#include <QStringList>
+#include <QList>
+
+#include <OsmAndCoreUtils.h>
+
+namespace OsmAnd
+{
+    // Periscope counts tiles that map renderer requests for each camera pose and measures how long it takes
+    // to compute them. Only CPU is used, so no rendering context is needed.
+    namespace Periscope
+    {
+        struct OSMAND_CORE_UTILS_API Configuration
+        {
+            Configuration();
+
+            bool verbose;
+            int viewportWidth;
+            int viewportHeight;
+            float densityFactor;
+            float fieldOfView;
+            double latitude;
+            double longitude;
+            int minZoom;
+            int maxZoom;
+            QList<float> elevationAngles;
+            QList<float> azimuths;
+            // Each pose is computed this many times to measure time
+            int iterations;
+        };
+        OSMAND_CORE_UTILS_API bool OSMAND_CORE_UTILS_CALL parseCommandLineArguments(const QStringList& cmdLineArgs, Configuration& cfg, QString& error);
+
+        OSMAND_CORE_UTILS_API bool OSMAND_CORE_UTILS_CALL surveyToStdOut(const Configuration& cfg);
+        OSMAND_CORE_UTILS_API QString OSMAND_CORE_UTILS_CALL surveyToString(const Configuration& cfg);
+    } // namespace Periscope
+
+} // namespace OsmAnd 
+
+#endif // __PERISCOPE_H_
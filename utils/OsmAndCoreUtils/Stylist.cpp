@@ -0,0 +1,320 @@
+#include "Stylist.h"
+
+#include <iostream>
+#include <sstream>
+#include <limits>
+#include <iterator>
+
+#include <OsmAndCore/QtExtensions.h>
+#include <QSet>
+#include <QHash>
+#include <QVariant>
+#include <QXmlStreamReader>
+
+#include <OsmAndCore/Common.h>
+#include <OsmAndCore/Utilities.h>
+#include <OsmAndCore/EmbeddedResources.h>
+#include <OsmAndCore/Map/MapStyle.h>
+#include <OsmAndCore/Map/MapStyles.h>
+#include <OsmAndCore/Map/MapStyleValueDefinition.h>
+#include <OsmAndCore/Map/MapStyleBuiltinValueDefinitions.h>
+#include <OsmAndCore/Map/MapStyleEvaluator.h>
+#include <OsmAndCore/Map/MapStyleEvaluationResult.h>
+
+OsmAnd::Stylist::Configuration::Configuration()
+    : verbose(false)
+    , styleName("default")
+    , minZoom(1)
+    , maxZoom(21)
+    , densityFactor(1.0f)
+{
+}
+
+OSMAND_CORE_UTILS_API bool OSMAND_CORE_UTILS_CALL OsmAnd::Stylist::parseCommandLineArguments( const QStringList& cmdLineArgs, Configuration& cfg, QString& error )
+{
+    for(auto itArg = cmdLineArgs.cbegin(); itArg != cmdLineArgs.cend(); ++itArg)
+    {
+        auto arg = *itArg;
+        if (arg == "-verbose")
+        {
+            cfg.verbose = true;
+        }
+        else if (arg.startsWith("-stylesPath="))
+        {
+            auto path = arg.mid(strlen("-stylesPath="));
+            QDir dir(path);
+            if(!dir.exists())
+            {
+                error = "Style directory '" + path + "' does not exist";
+                return false;
+            }
+
+            Utilities::findFiles(dir, QStringList() << "*.render.xml", cfg.styleFiles);
+        }
+        else if (arg.startsWith("-style="))
+        {
+            cfg.styleName = arg.mid(strlen("-style="));
+        }
+        else if (arg.startsWith("-compiled="))
+        {
+            cfg.compiledPath = arg.mid(strlen("-compiled="));
+        }
+        else if(arg.startsWith("-minZoom="))
+        {
+            cfg.minZoom = arg.mid(strlen("-minZoom=")).toInt();
+        }
+        else if(arg.startsWith("-maxZoom="))
+        {
+            cfg.maxZoom = arg.mid(strlen("-maxZoom=")).toInt();
+        }
+        else if(arg.startsWith("-density="))
+        {
+            cfg.densityFactor = arg.mid(strlen("-density=")).toFloat();
+        }
+    }
+
+    if(cfg.minZoom > cfg.maxZoom)
+    {
+        error = "Minimal zoom is greater than maximal one";
+        return false;
+    }
+
+    if(cfg.compiledPath.isEmpty())
+        cfg.compiledPath = QDir::temp().absoluteFilePath(cfg.styleName + ".render.compiled");
+
+    return true;
+}
+
+#if defined(_UNICODE) || defined(UNICODE)
+bool check(std::wostream &output, const OsmAnd::Stylist::Configuration& cfg);
+#else
+bool check(std::ostream &output, const OsmAnd::Stylist::Configuration& cfg);
+#endif
+
+OSMAND_CORE_UTILS_API bool OSMAND_CORE_UTILS_CALL OsmAnd::Stylist::checkToStdOut( const Configuration& cfg )
+{
+#if defined(_UNICODE) || defined(UNICODE)
+    return check(std::wcout, cfg);
+#else
+    return check(std::cout, cfg);
+#endif
+}
+
+OSMAND_CORE_UTILS_API QString OSMAND_CORE_UTILS_CALL OsmAnd::Stylist::checkToString( const Configuration& cfg )
+{
+#if defined(_UNICODE) || defined(UNICODE)
+    std::wostringstream output;
+    check(output, cfg);
+    return QString::fromStdWString(output.str());
+#else
+    std::ostringstream output;
+    check(output, cfg);
+    return QString::fromStdString(output.str());
+#endif
+}
+
+// Collects every tag/value pair and every attribute name mentioned by style source. Value is paired with innermost tag
+// it's nested in, since that is how rules are keyed. Empty value is added for each tag, to hit tag-only rules.
+static void collectStyleInputs(const QByteArray& content, QHash< QString, QSet<QString> >& tagsValues, QSet<QString>& attributes)
+{
+    QXmlStreamReader xmlReader(content);
+    QList<QString> tagsStack;
+    while(!xmlReader.atEnd() && !xmlReader.hasError())
+    {
+        xmlReader.readNext();
+        if(xmlReader.isStartElement())
+        {
+            const auto& xmlAttributes = xmlReader.attributes();
+            for(auto itAttribute = xmlAttributes.cbegin(); itAttribute != xmlAttributes.cend(); ++itAttribute)
+                attributes.insert(itAttribute->name().toString());
+
+            auto tag = xmlAttributes.value("tag").toString();
+            if(tag.isEmpty() && !tagsStack.isEmpty())
+                tag = tagsStack.last();
+            tagsStack.push_back(tag);
+            if(tag.isEmpty())
+                continue;
+
+            auto& values = tagsValues[tag];
+            values.insert(QString());
+            if(xmlAttributes.hasAttribute("value"))
+                values.insert(xmlAttributes.value("value").toString());
+        }
+        else if(xmlReader.isEndElement())
+        {
+            tagsStack.pop_back();
+        }
+    }
+}
+
+// Output value definition identifiers are allocated by each style on its own, so results are compared by names
+static QHash<QString, QVariant> namedResult(
+    OsmAnd::MapStyleEvaluationResult& result,
+    const QHash<int, QString>& names)
+{
+    OsmAnd::MapStyleEvaluationResult::PackedResult packedResult;
+    result.pack(packedResult);
+
+    QHash<QString, QVariant> named;
+    for(auto itEntry = packedResult.cbegin(); itEntry != packedResult.cend(); ++itEntry)
+    {
+        const auto itName = names.constFind(itEntry->first);
+        const auto name = (itName != names.cend()) ? *itName : QString("#%1").arg(itEntry->first);
+        named.insert(name, itEntry->second);
+    }
+    return named;
+}
+
+static QHash<int, QString> resolveNames(const std::shared_ptr<const OsmAnd::MapStyle>& style, const QSet<QString>& names)
+{
+    QHash<int, QString> resolved;
+    for(auto itName = names.cbegin(); itName != names.cend(); ++itName)
+    {
+        std::shared_ptr<const OsmAnd::MapStyleValueDefinition> valueDef;
+        if(style->resolveValueDefinition(*itName, valueDef))
+            resolved.insert(valueDef->id, valueDef->name);
+    }
+    return resolved;
+}
+
+static QString variantToString(const QVariant& value)
+{
+    return value.isValid() ? value.toString() : QString("<none>");
+}
+
+#if defined(_UNICODE) || defined(UNICODE)
+bool check(std::wostream &output, const OsmAnd::Stylist::Configuration& cfg)
+#else
+bool check(std::ostream &output, const OsmAnd::Stylist::Configuration& cfg)
+#endif
+{
+    // Obtain source style and compile it
+    OsmAnd::MapStyles sourceStyles;
+    for(auto itStyleFile = cfg.styleFiles.cbegin(); itStyleFile != cfg.styleFiles.cend(); ++itStyleFile)
+    {
+        const auto& styleFile = *itStyleFile;
+
+        if(!sourceStyles.registerStyle(styleFile.absoluteFilePath()))
+            output << xT("Failed to parse metadata of '") << QStringToStlString(styleFile.fileName()) << xT("' or duplicate style") << std::endl;
+    }
+    std::shared_ptr<const OsmAnd::MapStyle> sourceStyle;
+    if(!sourceStyles.obtainStyle(cfg.styleName, sourceStyle))
+    {
+        output << xT("Failed to resolve style '") << QStringToStlString(cfg.styleName) << xT("'") << std::endl;
+        return false;
+    }
+    if(!sourceStyle->saveCompiled(cfg.compiledPath))
+    {
+        output << xT("Failed to compile style '") << QStringToStlString(cfg.styleName) << xT("' to '") << QStringToStlString(cfg.compiledPath) << xT("'") << std::endl;
+        return false;
+    }
+
+    // Load compiled image back in a collection of its own, so nothing is shared with source style
+    OsmAnd::MapStyles compiledStyles;
+    std::shared_ptr<const OsmAnd::MapStyle> compiledStyle;
+    if(!compiledStyles.registerCompiledStyle(cfg.compiledPath) || !compiledStyles.obtainStyle(cfg.styleName, compiledStyle) || !compiledStyle->isCompiled)
+    {
+        output << xT("Failed to load compiled style from '") << QStringToStlString(cfg.compiledPath) << xT("'") << std::endl;
+        return false;
+    }
+
+    // Collect inputs from every source the style may have inherited rules from
+    QHash< QString, QSet<QString> > tagsValues;
+    QSet<QString> attributes;
+    collectStyleInputs(OsmAnd::EmbeddedResources::decompressResource("map/styles/default.render.xml"), tagsValues, attributes);
+    for(auto itStyleFile = cfg.styleFiles.cbegin(); itStyleFile != cfg.styleFiles.cend(); ++itStyleFile)
+    {
+        QFile styleFile(itStyleFile->absoluteFilePath());
+        if(!styleFile.open(QIODevice::ReadOnly | QIODevice::Text))
+            continue;
+        collectStyleInputs(styleFile.readAll(), tagsValues, attributes);
+        styleFile.close();
+    }
+    const auto sourceNames = resolveNames(sourceStyle, attributes);
+    const auto compiledNames = resolveNames(compiledStyle, attributes);
+
+    const auto builtinValueDefs = OsmAnd::MapStyle::getBuiltinValueDefinitions();
+    const OsmAnd::MapStyleRulesetType rulesets[] = {
+        OsmAnd::MapStyleRulesetType::Point,
+        OsmAnd::MapStyleRulesetType::Polyline,
+        OsmAnd::MapStyleRulesetType::Polygon,
+        OsmAnd::MapStyleRulesetType::Text,
+        OsmAnd::MapStyleRulesetType::Order,
+    };
+
+    OsmAnd::MapStyleEvaluator sourceEvaluator(sourceStyle, cfg.densityFactor);
+    OsmAnd::MapStyleEvaluator compiledEvaluator(compiledStyle, cfg.densityFactor);
+    OsmAnd::MapStyleEvaluationResult sourceResult;
+    OsmAnd::MapStyleEvaluationResult compiledResult;
+    uint64_t evaluationsCount = 0;
+    uint64_t mismatchesCount = 0;
+    const uint64_t maxReportedMismatches = cfg.verbose ? std::numeric_limits<uint64_t>::max() : 10;
+    for(auto itTagValues = tagsValues.cbegin(); itTagValues != tagsValues.cend(); ++itTagValues)
+    {
+        const auto& tag = itTagValues.key();
+        for(auto itValue = itTagValues->cbegin(); itValue != itTagValues->cend(); ++itValue)
+        {
+            const auto& value = *itValue;
+            for(auto zoom = cfg.minZoom; zoom <= cfg.maxZoom; zoom++)
+            {
+                for(auto nightMode = 0; nightMode <= 1; nightMode++)
+                {
+                    for(auto itRuleset = std::begin(rulesets); itRuleset != std::end(rulesets); ++itRuleset)
+                    {
+                        OsmAnd::MapStyleEvaluator* const evaluators[] = { &sourceEvaluator, &compiledEvaluator };
+                        for(auto itEvaluator = std::begin(evaluators); itEvaluator != std::end(evaluators); ++itEvaluator)
+                        {
+                            const auto evaluator = *itEvaluator;
+                            evaluator->setStringValue(builtinValueDefs->id_INPUT_TAG, tag);
+                            evaluator->setStringValue(builtinValueDefs->id_INPUT_VALUE, value);
+                            evaluator->setIntegerValue(builtinValueDefs->id_INPUT_MINZOOM, zoom);
+                            evaluator->setIntegerValue(builtinValueDefs->id_INPUT_MAXZOOM, zoom);
+                            evaluator->setBooleanValue(builtinValueDefs->id_INPUT_NIGHT_MODE, nightMode != 0);
+                        }
+
+                        sourceResult.clear();
+                        compiledResult.clear();
+                        const auto sourceEvaluated = sourceEvaluator.evaluate(nullptr, *itRuleset, &sourceResult);
+                        const auto compiledEvaluated = compiledEvaluator.evaluate(nullptr, *itRuleset, &compiledResult);
+                        evaluationsCount++;
+
+                        const auto sourceValues = namedResult(sourceResult, sourceNames);
+                        const auto compiledValues = namedResult(compiledResult, compiledNames);
+                        if(sourceEvaluated == compiledEvaluated && sourceValues == compiledValues)
+                            continue;
+
+                        mismatchesCount++;
+                        if(mismatchesCount > maxReportedMismatches)
+                            continue;
+
+                        output << xT("Mismatch at ruleset ") << static_cast<uint32_t>(*itRuleset)
+                            << xT(", tag '") << QStringToStlString(tag) << xT("', value '") << QStringToStlString(value)
+                            << xT("', zoom ") << zoom << (nightMode ? xT(", night") : xT(", day")) << xT(":") << std::endl;
+                        if(sourceEvaluated != compiledEvaluated)
+                        {
+                            output << xT("\tsource ") << (sourceEvaluated ? xT("matched") : xT("did not match"))
+                                << xT(", compiled ") << (compiledEvaluated ? xT("matched") : xT("did not match")) << std::endl;
+                        }
+                        auto names = sourceValues.keys().toSet();
+                        names.unite(compiledValues.keys().toSet());
+                        for(auto itName = names.cbegin(); itName != names.cend(); ++itName)
+                        {
+                            const auto sourceValue = sourceValues.value(*itName);
+                            const auto compiledValue = compiledValues.value(*itName);
+                            if(sourceValue == compiledValue)
+                                continue;
+
+                            output << xT("\t") << QStringToStlString(*itName)
+                                << xT(": source '") << QStringToStlString(variantToString(sourceValue))
+                                << xT("', compiled '") << QStringToStlString(variantToString(compiledValue)) << xT("'") << std::endl;
+                        }
+                    }
+                }
+            }
+        }
+    }
+
+    output << evaluationsCount << xT(" evaluations of ") << tagsValues.size() << xT(" tags, ")
+        << mismatchesCount << xT(" mismatches") << std::endl;
+    return (mismatchesCount == 0);
+}
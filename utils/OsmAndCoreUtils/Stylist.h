@@ -0,0 +1,66 @@
+/**
+* @file
+*
+* @section LICENSE
+*
+* OsmAnd - Android navigation software based on OSM maps.
+* Copyright (C) 2010-2013  OsmAnd Authors listed in AUTHORS file
+*
+* This program is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+
+* You should have received a copy of the GNU General Public License
+* along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+#ifndef __STYLIST_H_
+#define __STYLIST_H_
+
+#include <memory>
+
+#include <OsmAndCore/QtExtensions.h>
+#include <QString>
+#include <QStringList>
+#include <QDir>
+#include <QFile>
+
+#include <OsmAndCoreUtils.h>
+
+namespace OsmAnd
+{
+    // Stylist checks compiled map style images: style is compiled, compiled image is loaded back and both styles
+    // are evaluated for every tag and value mentioned by style sources, at every zoom, by day and by night,
+    // in every ruleset. Any difference in evaluated output values is reported.
+    namespace Stylist
+    {
+        struct OSMAND_CORE_UTILS_API Configuration
+        {
+            Configuration();
+
+            bool verbose;
+            QFileInfoList styleFiles;
+            QString styleName;
+            // Compiled image is written here, temporary file is used if empty
+            QString compiledPath;
+            int minZoom;
+            int maxZoom;
+            float densityFactor;
+        };
+        OSMAND_CORE_UTILS_API bool OSMAND_CORE_UTILS_CALL parseCommandLineArguments(const QStringList& cmdLineArgs, Configuration& cfg, QString& error);
+
+        // Returns false if compiled style could not be produced or it evaluates differently from source one
+        OSMAND_CORE_UTILS_API bool OSMAND_CORE_UTILS_CALL checkToStdOut(const Configuration& cfg);
+        OSMAND_CORE_UTILS_API QString OSMAND_CORE_UTILS_CALL checkToString(const Configuration& cfg);
+    } // namespace Stylist
+
+} // namespace OsmAnd 
+
+#endif // __STYLIST_H_
@@ -4,12 +4,24 @@
 #include <sstream>
 #include <ctime>
 #include <chrono>
+#include <limits>
 
 #include <OsmAndCore/QtExtensions.h>
 #include <QDateTime>
 #include <QTextStream>
+#include <QtMath>
+#include <QThread>
+#include <QMutex>
+#include <QWaitCondition>
+#include <QAtomicInt>
+#include <QVector>
+#include <QHash>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QJsonArray>
 
 #include <OsmAndCore/Common.h>
+#include <OsmAndCore/Concurrent.h>
 #include <OsmAndCore/Data/ObfReader.h>
 #include <OsmAndCore/Utilities.h>
 #include <OsmAndCore/Routing/RoutePlanner.h>
@@ -19,6 +31,7 @@ OsmAnd::Voyager::Configuration::Configuration()
     : verbose(false)
     , generateXml(false)
     , doRecalculate(false)
+    , parallelSearch(false)
     , vehicle("car")
     , memoryLimit(0)
     , startLatitude(0)
@@ -26,6 +39,9 @@ OsmAnd::Voyager::Configuration::Configuration()
     , endLatitude(0)
     , endLongitude(0)
     , leftSide(false)
+    , threadsCount(QThread::idealThreadCount())
+    , resultTolerance(1.0)
+    , performanceTolerance(20.0)
     , routingConfig(new RoutingConfiguration())
 {
 }
@@ -66,6 +82,10 @@ OSMAND_CORE_UTILS_API bool OSMAND_CORE_UTILS_CALL OsmAnd::Voyager::parseCommandL
         {
             cfg.doRecalculate = true;
         }
+        else if (arg == "-parallel")
+        {
+            cfg.parallelSearch = true;
+        }
         else if (arg.startsWith("-obfsDir="))
         {
             QDir obfRoot(arg.mid(strlen("-obfsDir=")));
@@ -118,6 +138,50 @@ OSMAND_CORE_UTILS_API bool OSMAND_CORE_UTILS_CALL OsmAnd::Voyager::parseCommandL
         {
             cfg.gpxPath = arg.mid(strlen("-gpx="));
         }
+        else if (arg.startsWith("-batch="))
+        {
+            cfg.batchPath = arg.mid(strlen("-batch="));
+            if(!QFile::exists(cfg.batchPath))
+            {
+                error = "Batch file does not exist";
+                return false;
+            }
+        }
+        else if (arg.startsWith("-threads="))
+        {
+            cfg.threadsCount = arg.mid(strlen("-threads=")).toInt();
+            if(cfg.threadsCount < 1)
+            {
+                error = "Bad threads count";
+                return false;
+            }
+        }
+        else if (arg.startsWith("-report="))
+        {
+            cfg.reportPath = arg.mid(strlen("-report="));
+        }
+        else if (arg.startsWith("-baseline="))
+        {
+            cfg.baselinePath = arg.mid(strlen("-baseline="));
+            if(!QFile::exists(cfg.baselinePath))
+            {
+                error = "Baseline report does not exist";
+                return false;
+            }
+        }
+        else if (arg.startsWith("-tolerance="))
+        {
+            cfg.resultTolerance = arg.mid(strlen("-tolerance=")).toDouble();
+        }
+        else if (arg.startsWith("-perfTolerance="))
+        {
+            cfg.performanceTolerance = arg.mid(strlen("-perfTolerance=")).toDouble();
+        }
+    }
+    if(cfg.resultTolerance < 0.0 || cfg.performanceTolerance < 0.0)
+    {
+        error = "Bad tolerance";
+        return false;
     }
 
     if(!wasObfRootSpecified)
@@ -282,8 +346,9 @@ void performJourney(std::ostream &output, const OsmAnd::Voyager::Configuration&
             output << xT("-->");
         output << std::endl;
     }
-    OsmAnd::RouteCalculationResult routeFound =
-            OsmAnd::RoutePlanner::calculateRoute(&plannerContext, points, cfg.leftSide, nullptr);
+    OsmAnd::RouteCalculationResult routeFound = (cfg.parallelSearch && cfg.waypoints.isEmpty())
+            ? OsmAnd::RoutePlanner::calculateRouteParallel(&plannerContext, points, cfg.leftSide, nullptr)
+            : OsmAnd::RoutePlanner::calculateRoute(&plannerContext, points, cfg.leftSide, nullptr);
     route = routeFound.list;
     auto routeCalculationFinish = std::chrono::steady_clock::now();
     if(cfg.verbose)
@@ -307,7 +372,7 @@ void performJourney(std::ostream &output, const OsmAnd::Voyager::Configuration&
                 output << xT("-->");
             output << std::endl;
         }
-        routeFound = OsmAnd::RoutePlanner::calculateRoute(&plannerContext, points, cfg.leftSide, nullptr);
+        routeFound = OsmAnd::RoutePlanner::recalculateRoute(&plannerContext, cfg.startLatitude, cfg.startLongitude, cfg.leftSide, nullptr);
         route = routeFound.list;
         auto routeRecalculationFinish = std::chrono::steady_clock::now();
         if(cfg.verbose)
@@ -315,6 +380,7 @@ void performJourney(std::ostream &output, const OsmAnd::Voyager::Configuration&
             if(cfg.generateXml)
                 output << xT("<!--");
             output << xT("Finished route recalculation ") << QStringToStlString(QTime::currentTime().toString()) << xT(", took ") << std::chrono::duration<double, std::milli> (routeRecalculationFinish - routeRecalculationStart).count() << xT(" ms");
+            output << xT(", reused ") << routeFound.reusedDistance << xT(" m of previous route");
             if(cfg.generateXml)
                 output << xT("-->");
             output << std::endl;
@@ -449,3 +515,445 @@ void performJourney(std::ostream &output, const OsmAnd::Voyager::Configuration&
     if(cfg.generateXml)
         output << xT("</test>") << std::endl;
 }
+
+#if defined(_UNICODE) || defined(UNICODE)
+static bool benchmark(std::wostream &output, const OsmAnd::Voyager::Configuration& cfg);
+#else
+static bool benchmark(std::ostream &output, const OsmAnd::Voyager::Configuration& cfg);
+#endif
+
+OSMAND_CORE_UTILS_API bool OSMAND_CORE_UTILS_CALL OsmAnd::Voyager::benchmarkToStdOut( const Configuration& cfg )
+{
+#if defined(_UNICODE) || defined(UNICODE)
+    return benchmark(std::wcout, cfg);
+#else
+    return benchmark(std::cout, cfg);
+#endif
+}
+
+OSMAND_CORE_UTILS_API QString OSMAND_CORE_UTILS_CALL OsmAnd::Voyager::benchmarkToString( const Configuration& cfg )
+{
+#if defined(_UNICODE) || defined(UNICODE)
+    std::wostringstream output;
+    benchmark(output, cfg);
+    return QString::fromStdWString(output.str());
+#else
+    std::ostringstream output;
+    benchmark(output, cfg);
+    return QString::fromStdString(output.str());
+#endif
+}
+
+namespace
+{
+    struct BatchRoute
+    {
+        QString id;
+        std::pair<double, double> start;
+        std::pair<double, double> end;
+
+        bool success;
+        QString warnMessage;
+        float distance;
+        float time;
+        // In milliseconds
+        double latency;
+        uint32_t iterations;
+        uint32_t loadedTiles;
+        uint32_t maxLoadedTiles;
+        uint32_t estimatedMemory;
+    };
+
+    bool loadBatch(const QString& path, QVector<BatchRoute>& outRoutes, QString& error)
+    {
+        QFile batchFile(path);
+        if(!batchFile.open(QIODevice::ReadOnly | QIODevice::Text))
+        {
+            error = "Failed to open batch file";
+            return false;
+        }
+
+        QTextStream batchStream(&batchFile);
+        auto lineNumber = 0;
+        while(!batchStream.atEnd())
+        {
+            const auto line = batchStream.readLine().trimmed();
+            lineNumber++;
+            if(line.isEmpty() || line.startsWith(QChar('#')))
+                continue;
+
+            const auto values = line.split(QChar(';'));
+            bool ok[4] = { false, false, false, false };
+            BatchRoute route;
+            if(values.size() == 4 || values.size() == 5)
+            {
+                route.start.first = values[0].toDouble(&ok[0]);
+                route.start.second = values[1].toDouble(&ok[1]);
+                route.end.first = values[2].toDouble(&ok[2]);
+                route.end.second = values[3].toDouble(&ok[3]);
+            }
+            if(!ok[0] || !ok[1] || !ok[2] || !ok[3])
+            {
+                error = QString("Bad route at line %1 of batch file").arg(lineNumber);
+                return false;
+            }
+            route.id = (values.size() == 5) ? values[4].trimmed() : QString::number(lineNumber);
+            route.success = false;
+            route.distance = route.time = 0.0f;
+            route.latency = 0.0;
+            route.iterations = route.loadedTiles = route.maxLoadedTiles = route.estimatedMemory = 0;
+
+            outRoutes.push_back(route);
+        }
+
+        if(outRoutes.isEmpty())
+        {
+            error = "Batch file contains no routes";
+            return false;
+        }
+        return true;
+    }
+
+    void calculateBatchRoute(
+        const OsmAnd::Voyager::Configuration& cfg,
+        const QList< std::shared_ptr<OsmAnd::ObfReader> >& obfData,
+        QMutex& contextsMutex,
+        BatchRoute& route)
+    {
+        // Every route gets clean context, so that its statistics don't depend on routes calculated before it on same thread
+        std::unique_ptr<OsmAnd::RoutePlannerContext> plannerContext;
+        {
+            // Contexts access routing configuration, that is shared between threads
+            QMutexLocker scopedLocker(&contextsMutex);
+
+            plannerContext.reset(cfg.memoryLimit > 0
+                ? new OsmAnd::RoutePlannerContext(obfData, cfg.routingConfig, cfg.vehicle, false, std::numeric_limits<float>::quiet_NaN(), nullptr, cfg.memoryLimit)
+                : new OsmAnd::RoutePlannerContext(obfData, cfg.routingConfig, cfg.vehicle, false));
+        }
+
+        QList< std::pair<double, double> > points;
+        points.push_back(route.start);
+        points.push_back(route.end);
+
+        const auto routeCalculationStart = std::chrono::steady_clock::now();
+        const auto routeFound = cfg.parallelSearch
+            ? OsmAnd::RoutePlanner::calculateRouteParallel(plannerContext.get(), points, cfg.leftSide, nullptr)
+            : OsmAnd::RoutePlanner::calculateRoute(plannerContext.get(), points, cfg.leftSide, nullptr);
+        const auto routeCalculationFinish = std::chrono::steady_clock::now();
+
+        route.latency = std::chrono::duration<double, std::milli>(routeCalculationFinish - routeCalculationStart).count();
+        route.success = !routeFound.list.isEmpty();
+        route.warnMessage = routeFound.warnMessage;
+        for(auto itSegment = routeFound.list.cbegin(); itSegment != routeFound.list.cend(); ++itSegment)
+        {
+            const auto& segment = *itSegment;
+
+            route.time += segment->time;
+            route.distance += segment->distance;
+        }
+
+        if(const auto routeStatistics = plannerContext->getRouteStatistics())
+        {
+            route.iterations = routeStatistics->forwardIterations + routeStatistics->backwardIterations;
+            route.loadedTiles = routeStatistics->loadedTiles;
+            route.maxLoadedTiles = qMax(routeStatistics->maxLoadedTiles, plannerContext->getCurrentlyLoadedTiles());
+        }
+        route.estimatedMemory = plannerContext->getCurrentEstimatedSize();
+    }
+
+    // Percentiles are taken by nearest-rank method
+    QJsonObject summarize(QVector<double> values)
+    {
+        QJsonObject summary;
+        if(values.isEmpty())
+            return summary;
+        qSort(values);
+
+        const auto percentile = [&values](double p)
+        {
+            const auto rank = qBound(1, static_cast<int>(qCeil(p / 100.0 * values.size())), values.size());
+            return values[rank - 1];
+        };
+        auto sum = 0.0;
+        for(auto itValue = values.cbegin(); itValue != values.cend(); ++itValue)
+            sum += *itValue;
+
+        summary.insert("min", values.first());
+        summary.insert("mean", sum / values.size());
+        summary.insert("p50", percentile(50.0));
+        summary.insert("p90", percentile(90.0));
+        summary.insert("p95", percentile(95.0));
+        summary.insert("p99", percentile(99.0));
+        summary.insert("max", values.last());
+        return summary;
+    }
+
+    QJsonObject makeRegression(const QString& id, const QString& metric, double baselineValue, double currentValue)
+    {
+        QJsonObject regression;
+        if(!id.isEmpty())
+            regression.insert("id", id);
+        regression.insert("metric", metric);
+        regression.insert("baseline", baselineValue);
+        regression.insert("current", currentValue);
+        return regression;
+    }
+
+    bool exceedsTolerance(double baselineValue, double currentValue, double tolerance)
+    {
+        return qAbs(currentValue - baselineValue) > qAbs(baselineValue) * tolerance / 100.0;
+    }
+
+    // Route results must stay within tolerance both ways, while performance may only improve beyond it
+    QJsonArray compareWithBaseline(const OsmAnd::Voyager::Configuration& cfg, const QJsonObject& report, const QJsonObject& baseline)
+    {
+        QJsonArray regressions;
+
+        QHash<QString, QJsonObject> baselineRoutes;
+        const auto baselineRoutesArray = baseline.value("routes").toArray();
+        for(auto itRoute = baselineRoutesArray.constBegin(); itRoute != baselineRoutesArray.constEnd(); ++itRoute)
+        {
+            const auto baselineRoute = (*itRoute).toObject();
+            baselineRoutes.insert(baselineRoute.value("id").toString(), baselineRoute);
+        }
+
+        const auto routesArray = report.value("routes").toArray();
+        for(auto itRoute = routesArray.constBegin(); itRoute != routesArray.constEnd(); ++itRoute)
+        {
+            const auto route = (*itRoute).toObject();
+            const auto id = route.value("id").toString();
+            const auto itBaselineRoute = baselineRoutes.constFind(id);
+            if(itBaselineRoute == baselineRoutes.cend())
+                continue;
+            const auto& baselineRoute = *itBaselineRoute;
+
+            if(!baselineRoute.value("success").toBool())
+                continue;
+            if(!route.value("success").toBool())
+            {
+                regressions.append(makeRegression(id, "success", 1, 0));
+                continue;
+            }
+
+            const char* const resultMetrics[] = { "distance", "time" };
+            for(auto metric : resultMetrics)
+            {
+                const auto baselineValue = baselineRoute.value(metric).toDouble();
+                const auto currentValue = route.value(metric).toDouble();
+                if(exceedsTolerance(baselineValue, currentValue, cfg.resultTolerance))
+                    regressions.append(makeRegression(id, metric, baselineValue, currentValue));
+            }
+        }
+
+        const auto summary = report.value("summary").toObject();
+        const auto baselineSummary = baseline.value("summary").toObject();
+        const char* const performanceMetrics[] = { "latency", "iterations" };
+        const char* const percentiles[] = { "p50", "p95" };
+        for(auto metric : performanceMetrics)
+        {
+            for(auto percentile : percentiles)
+            {
+                const auto baselineValue = baselineSummary.value(metric).toObject().value(percentile).toDouble();
+                const auto currentValue = summary.value(metric).toObject().value(percentile).toDouble();
+                if(currentValue > baselineValue && exceedsTolerance(baselineValue, currentValue, cfg.performanceTolerance))
+                    regressions.append(makeRegression(QString(), QString("%1.%2").arg(metric).arg(percentile), baselineValue, currentValue));
+            }
+        }
+
+        return regressions;
+    }
+}
+
+#if defined(_UNICODE) || defined(UNICODE)
+static bool benchmark(std::wostream &output, const OsmAnd::Voyager::Configuration& cfg)
+#else
+static bool benchmark(std::ostream &output, const OsmAnd::Voyager::Configuration& cfg)
+#endif
+{
+    QString error;
+    QVector<BatchRoute> routes;
+    if(!loadBatch(cfg.batchPath, routes, error))
+    {
+        output << QStringToStlString(error) << std::endl;
+        return false;
+    }
+
+    QJsonObject baseline;
+    if(!cfg.baselinePath.isEmpty())
+    {
+        QFile baselineFile(cfg.baselinePath);
+        if(baselineFile.open(QIODevice::ReadOnly))
+            baseline = QJsonDocument::fromJson(baselineFile.readAll()).object();
+        if(baseline.isEmpty())
+        {
+            output << xT("Failed to read baseline report") << std::endl;
+            return false;
+        }
+    }
+
+    // Each worker has own readers, since reader can't be used by several threads at once
+    const auto routesCount = routes.size();
+    const auto pRoutes = routes.data();
+    QAtomicInt nextRouteIndex(0);
+    QMutex contextsMutex;
+    QMutex pendingWorkersMutex;
+    QWaitCondition pendingWorkersCondition;
+    auto pendingWorkersCount = 0;
+    const auto benchmarkStart = std::chrono::steady_clock::now();
+    {
+        OsmAnd::Concurrent::WorkersPool pool(QLatin1String("voyagerBatch"), cfg.threadsCount);
+        for(auto workerIdx = 0; workerIdx < cfg.threadsCount; workerIdx++)
+        {
+            {
+                QMutexLocker scopedLocker(&pendingWorkersMutex);
+                pendingWorkersCount++;
+            }
+            pool.start(new OsmAnd::Concurrent::Task(
+                [&cfg, pRoutes, routesCount, &nextRouteIndex, &contextsMutex]
+                (OsmAnd::Concurrent::Task* task, QEventLoop& eventLoop)
+                {
+                    QList< std::shared_ptr<OsmAnd::ObfReader> > obfData;
+                    for(auto itObf = cfg.obfs.cbegin(); itObf != cfg.obfs.cend(); ++itObf)
+                    {
+                        const auto& obf = *itObf;
+                        std::shared_ptr<OsmAnd::ObfReader> obfReader(new OsmAnd::ObfReader(std::shared_ptr<QIODevice>(new QFile(obf.absoluteFilePath()))));
+                        obfData.push_back(obfReader);
+                    }
+
+                    for(;;)
+                    {
+                        const auto routeIndex = nextRouteIndex.fetchAndAddOrdered(1);
+                        if(routeIndex >= routesCount)
+                            break;
+
+                        calculateBatchRoute(cfg, obfData, contextsMutex, pRoutes[routeIndex]);
+                    }
+                },
+                nullptr,
+                [&pendingWorkersMutex, &pendingWorkersCondition, &pendingWorkersCount]
+                (OsmAnd::Concurrent::Task* task, bool wasCancelled)
+                {
+                    QMutexLocker scopedLocker(&pendingWorkersMutex);
+                    if(--pendingWorkersCount == 0)
+                        pendingWorkersCondition.wakeAll();
+                }));
+        }
+
+        QMutexLocker scopedLocker(&pendingWorkersMutex);
+        while(pendingWorkersCount > 0)
+            pendingWorkersCondition.wait(&pendingWorkersMutex);
+    }
+    const auto benchmarkFinish = std::chrono::steady_clock::now();
+
+    // Statistics are summarized over found routes only
+    QJsonArray routesArray;
+    QVector<double> latencies, iterations, loadedTiles, maxLoadedTiles, estimatedMemory;
+    auto failedCount = 0;
+    for(auto itRoute = routes.cbegin(); itRoute != routes.cend(); ++itRoute)
+    {
+        const auto& route = *itRoute;
+
+        QJsonObject routeObject;
+        routeObject.insert("id", route.id);
+        routeObject.insert("startLat", route.start.first);
+        routeObject.insert("startLon", route.start.second);
+        routeObject.insert("endLat", route.end.first);
+        routeObject.insert("endLon", route.end.second);
+        routeObject.insert("success", route.success);
+        if(!route.warnMessage.isEmpty())
+            routeObject.insert("warning", route.warnMessage);
+        routeObject.insert("distance", route.distance);
+        routeObject.insert("time", route.time);
+        routeObject.insert("latency", route.latency);
+        routeObject.insert("iterations", static_cast<double>(route.iterations));
+        routeObject.insert("loadedTiles", static_cast<double>(route.loadedTiles));
+        routeObject.insert("maxLoadedTiles", static_cast<double>(route.maxLoadedTiles));
+        routeObject.insert("estimatedMemory", static_cast<double>(route.estimatedMemory));
+        routesArray.append(routeObject);
+
+        if(!route.success)
+        {
+            failedCount++;
+            continue;
+        }
+        latencies.push_back(route.latency);
+        iterations.push_back(route.iterations);
+        loadedTiles.push_back(route.loadedTiles);
+        maxLoadedTiles.push_back(route.maxLoadedTiles);
+        estimatedMemory.push_back(route.estimatedMemory);
+    }
+
+    QJsonObject summary;
+    summary.insert("latency", summarize(latencies));
+    summary.insert("iterations", summarize(iterations));
+    summary.insert("loadedTiles", summarize(loadedTiles));
+    summary.insert("maxLoadedTiles", summarize(maxLoadedTiles));
+    summary.insert("estimatedMemory", summarize(estimatedMemory));
+
+    const auto wallTime = std::chrono::duration<double>(benchmarkFinish - benchmarkStart).count();
+    QJsonObject report;
+    report.insert("vehicle", cfg.vehicle);
+    report.insert("threads", cfg.threadsCount);
+    report.insert("parallelSearch", cfg.parallelSearch);
+    report.insert("routesCount", routesCount);
+    report.insert("failedCount", failedCount);
+    report.insert("wallTime", wallTime);
+    report.insert("summary", summary);
+    report.insert("routes", routesArray);
+
+    QJsonArray regressions;
+    if(!baseline.isEmpty())
+    {
+        regressions = compareWithBaseline(cfg, report, baseline);
+        report.insert("baseline", cfg.baselinePath);
+        report.insert("regressions", regressions);
+    }
+
+    const auto reportJson = QJsonDocument(report).toJson();
+    if(cfg.reportPath.isEmpty())
+    {
+        output << QStringToStlString(QString::fromUtf8(reportJson));
+        return regressions.isEmpty();
+    }
+
+    QFile reportFile(cfg.reportPath);
+    const auto reportWritten = reportFile.open(QIODevice::WriteOnly | QIODevice::Truncate) && reportFile.write(reportJson) == reportJson.size();
+    reportFile.close();
+    if(!reportWritten)
+        output << xT("Failed to write report to ") << QStringToStlString(cfg.reportPath) << std::endl;
+
+    const auto latencySummary = summary.value("latency").toObject();
+    output << xT("Calculated ") << routesCount << xT(" routes (") << failedCount << xT(" failed) in ") << wallTime
+        << xT(" s using ") << cfg.threadsCount << xT(" threads") << std::endl;
+    output << xT("Latency p50 ") << latencySummary.value("p50").toDouble() << xT(" ms, p95 ") << latencySummary.value("p95").toDouble()
+        << xT(" ms, p99 ") << latencySummary.value("p99").toDouble() << xT(" ms") << std::endl;
+    if(cfg.verbose)
+    {
+        for(auto itRoute = routes.cbegin(); itRoute != routes.cend(); ++itRoute)
+        {
+            const auto& route = *itRoute;
+            output << xT("Route ") << QStringToStlString(route.id) << xT(": ");
+            if(route.success)
+                output << route.distance << xT(" m, ") << route.time << xT(" s, took ") << route.latency << xT(" ms, ") << route.iterations << xT(" iterations");
+            else
+                output << xT("FAILED ") << QStringToStlString(route.warnMessage);
+            output << std::endl;
+        }
+    }
+    if(!baseline.isEmpty())
+    {
+        output << xT("Regressions against baseline: ") << regressions.size() << std::endl;
+        for(auto itRegression = regressions.constBegin(); itRegression != regressions.constEnd(); ++itRegression)
+        {
+            const auto regression = (*itRegression).toObject();
+            output << xT("\t");
+            if(regression.contains("id"))
+                output << xT("Route ") << QStringToStlString(regression.value("id").toString()) << xT(" ");
+            output << QStringToStlString(regression.value("metric").toString()) << xT(": ")
+                << regression.value("baseline").toDouble() << xT(" -> ") << regression.value("current").toDouble() << std::endl;
+        }
+    }
+
+    // Run without report is a failure, otherwise missing report would pass unnoticed
+    return reportWritten && regressions.isEmpty();
+}
@@ -45,6 +45,7 @@ namespace OsmAnd
             bool verbose;
             bool generateXml;
             bool doRecalculate;
+            bool parallelSearch;
             QFileInfoList obfs;
             QString vehicle;
             int memoryLimit;
@@ -56,11 +57,27 @@ namespace OsmAnd
             bool leftSide;
             QString gpxPath;
 
+            // Batch benchmark: file with one 'startLat;startLon;endLat;endLon[;id]' route per line
+            QString batchPath;
+            int threadsCount;
+            // JSON report is written here instead of output, which then gets short summary
+            QString reportPath;
+            // Report of previous run to compare against
+            QString baselinePath;
+            // Allowed differences from baseline in percents: of route distance and time, and of latency and iterations percentiles
+            double resultTolerance;
+            double performanceTolerance;
+
             std::shared_ptr<RoutingConfiguration> routingConfig;
         };
         OSMAND_CORE_UTILS_API bool OSMAND_CORE_UTILS_CALL parseCommandLineArguments(const QStringList& cmdLineArgs, Configuration& cfg, QString& error);
         OSMAND_CORE_UTILS_API void OSMAND_CORE_UTILS_CALL logJourneyToStdOut(const Configuration& cfg);
         OSMAND_CORE_UTILS_API QString OSMAND_CORE_UTILS_CALL logJourneyToString(const Configuration& cfg);
+
+        // Calculates all routes of batch file, each in own planner context, and reports per-route latency, iterations,
+        // loaded tiles and memory together with their percentiles. Returns false if results regressed against baseline
+        OSMAND_CORE_UTILS_API bool OSMAND_CORE_UTILS_CALL benchmarkToStdOut(const Configuration& cfg);
+        OSMAND_CORE_UTILS_API QString OSMAND_CORE_UTILS_CALL benchmarkToString(const Configuration& cfg);
     } // namespace Voyager
 
 } // namespace OsmAnd 